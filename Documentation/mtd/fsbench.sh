@@ -0,0 +1,139 @@
+#!/bin/sh
+#
+# Compare flash file systems on the same simulated NAND chip.
+# See Documentation/mtd/fsbench.txt.
+#
+# Needs nandsim and mtd_fsbench as modules, debugfs, and flash_eraseall,
+# ubiattach, ubimkvol and ubidetach from mtd-utils for UBIFS.
+
+FSLIST=${FSLIST:-"yaffs2 jffs2 ubifs"}
+MNT=${MNT:-/mnt/fsbench}
+DBG=${DBG:-/sys/kernel/debug/nandsim}
+# 128MiB, 2KiB pages, 128KiB blocks, typical timings of such a chip
+NANDSIM=${NANDSIM:-"first_id_byte=0x98 second_id_byte=0xf1 \
+third_id_byte=0x00 fourth_id_byte=0x15 access_delay=25 \
+programm_delay=250 erase_delay=2 do_delays=1"}
+BENCH=${BENCH:-""}
+# programs and erases into the churn before the power is cut
+CUT=${CUT:-3000}
+
+now_ms()
+{
+	awk '{ printf "%d\n", $1 * 1000 }' /proc/uptime
+}
+
+free_kb()
+{
+	sync
+	echo 3 > /proc/sys/vm/drop_caches
+	awk '/^MemFree:/ { print $2 }' /proc/meminfo
+}
+
+nstat()
+{
+	awk -v k=$1 '$1 == k { print $2 }' $DBG/stats
+}
+
+attach()
+{
+	case $1 in
+	ubifs)
+		ubiattach /dev/ubi_ctrl -m 0 > /dev/null || return 1
+		[ -c /dev/ubi0_0 ] || ubimkvol /dev/ubi0 -m -N bench > /dev/null
+		;;
+	esac
+}
+
+detach()
+{
+	case $1 in
+	ubifs) ubidetach /dev/ubi_ctrl -m 0 > /dev/null ;;
+	esac
+}
+
+do_mount()
+{
+	case $1 in
+	yaffs2) mount -t yaffs2 /dev/mtdblock0 $MNT ;;
+	jffs2)  mount -t jffs2 mtd0 $MNT ;;
+	ubifs)  mount -t ubifs ubi0:bench $MNT ;;
+	esac
+}
+
+# timed attach and mount, prints the time and the memory it took
+mount_fs()
+{
+	before=$(free_kb)
+	t0=$(now_ms)
+	attach $1 && do_mount $1 || return 1
+	t1=$(now_ms)
+	after=$(free_kb)
+	echo "$2 mount: $((t1 - t0)) ms, $((before - after)) KiB RAM"
+}
+
+umount_fs()
+{
+	umount $MNT
+	detach $1
+}
+
+# run one workload, print its result and the flash traffic it caused
+run()
+{
+	echo > $DBG/stats
+	dmesg -c > /dev/null
+	modprobe mtd_fsbench dir=$MNT test=$2 $BENCH
+	res=$(dmesg | sed -n "s/.*mtd_fsbench: $2 //p")
+	rmmod mtd_fsbench 2> /dev/null
+	if [ -z "$res" ]; then
+		echo "$1 $2: failed"
+		dmesg | grep mtd_fsbench
+		return 1
+	fi
+
+	bytes=$(echo "$res" | sed -n 's/.*bytes=\([0-9]*\).*/\1/p')
+	written=$(( $(nstat pages_written) * $(nstat page_size) ))
+	echo "$1 $2: $res"
+	echo "$1 $2: flash pages_read=$(nstat pages_read)" \
+	     "pages_written=$(nstat pages_written)" \
+	     "blocks_erased=$(nstat blocks_erased)" \
+	     "busy_ms=$(( $(nstat busy_us) / 1000 ))" \
+	     "write_amp=$(awk -v w=$written -v b=$bytes \
+	     'BEGIN { if (b) printf "%.2f", w / b; else print "-" }')"
+}
+
+bench()
+{
+	fs=$1
+
+	modprobe nandsim $NANDSIM || return 1
+	[ $fs = jffs2 ] && flash_eraseall -j -q /dev/mtd0
+
+	mount_fs $fs "$fs first" || return 1
+	for t in seqwrite seqread randwrite randread churn; do
+		run $fs $t || break
+	done
+	umount_fs $fs
+
+	mount_fs $fs "$fs clean" || return 1
+
+	# lose everything written after the cut, then see how long the
+	# file system takes to come back
+	echo $CUT > $DBG/powercut
+	modprobe mtd_fsbench dir=$MNT test=churn $BENCH > /dev/null 2>&1
+	rmmod mtd_fsbench 2> /dev/null
+	umount_fs $fs
+	echo 0 > $DBG/powercut
+
+	mount_fs $fs "$fs unclean" || return 1
+	umount_fs $fs
+
+	rmmod nandsim
+}
+
+mkdir -p $MNT
+grep -q debugfs /proc/mounts || mount -t debugfs none /sys/kernel/debug
+
+for fs in $FSLIST; do
+	bench $fs || echo "$fs: failed"
+done
@@ -0,0 +1,244 @@
+/*
+ * UDP packet rate benchmark for recvmmsg() and sendmmsg().
+ *
+ * One side receives, the other sends small datagrams as fast as it can.
+ * Both move up to -b datagrams per system call; -b 1 uses plain
+ * recvfrom() and sendto() instead, for comparison. Once a second the
+ * receiver prints the datagrams and system calls per second and the
+ * average batch it got back.
+ *
+ *   receiver:  mmsgbench -r [-p port] [-b batch] [-t secs]
+ *   sender:    mmsgbench -s host [-p port] [-b batch] [-l len] [-t secs]
+ *
+ * The receiver uses MSG_WAITFORONE: it sleeps until the first datagram
+ * is there and then takes whatever else is queued, up to the batch.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <netdb.h>
+
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <netinet/in.h>
+
+#ifndef __NR_recvmmsg
+# error "need kernel headers with __NR_recvmmsg and __NR_sendmmsg"
+#endif
+
+#ifndef MSG_WAITFORONE
+# define MSG_WAITFORONE	0x10000
+#endif
+
+#define MAX_BATCH	1024
+#define MAX_LEN		2048
+
+/* struct mmsghdr of <linux/socket.h>, libc may not have it */
+struct bench_mmsghdr {
+	struct msghdr	msg_hdr;
+	unsigned	msg_len;
+};
+
+static int do_recvmmsg(int fd, struct bench_mmsghdr *mmsg, unsigned int vlen,
+		       unsigned int flags, struct timespec *timeout)
+{
+	return syscall(__NR_recvmmsg, fd, mmsg, vlen, flags, timeout);
+}
+
+static int do_sendmmsg(int fd, struct bench_mmsghdr *mmsg, unsigned int vlen,
+		       unsigned int flags)
+{
+	return syscall(__NR_sendmmsg, fd, mmsg, vlen, flags);
+}
+
+static void bail(const char *what)
+{
+	perror(what);
+	exit(1);
+}
+
+static void usage(void)
+{
+	fprintf(stderr,
+		"usage: mmsgbench -r [-p port] [-b batch] [-t secs]\n"
+		"       mmsgbench -s host [-p port] [-b batch] [-l len] [-t secs]\n"
+		"  -b 1 uses recvfrom()/sendto() instead of recvmmsg()/sendmmsg()\n");
+	exit(1);
+}
+
+static double now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static char bufs[MAX_BATCH][MAX_LEN];
+static struct iovec iovs[MAX_BATCH];
+static struct bench_mmsghdr msgs[MAX_BATCH];
+
+static void setup_msgs(int batch, int len, struct sockaddr_in *to)
+{
+	int i;
+
+	memset(msgs, 0, sizeof(msgs));
+	for (i = 0; i < batch; i++) {
+		iovs[i].iov_base = bufs[i];
+		iovs[i].iov_len = len;
+		msgs[i].msg_hdr.msg_iov = &iovs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+		if (to) {
+			msgs[i].msg_hdr.msg_name = to;
+			msgs[i].msg_hdr.msg_namelen = sizeof(*to);
+		}
+	}
+}
+
+static void receiver(int fd, int batch, int secs)
+{
+	unsigned long pkts = 0, calls = 0, total = 0;
+	double start, last, t;
+	struct timeval tv = { 1, 0 };
+	int n;
+
+	/* wake up once a second when nothing comes in */
+	if (setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) < 0)
+		bail("SO_RCVTIMEO");
+
+	setup_msgs(batch, sizeof(bufs[0]), NULL);
+	start = last = now();
+
+	for (;;) {
+		if (batch == 1)
+			n = recvfrom(fd, bufs[0], sizeof(bufs[0]), 0,
+				     NULL, NULL) < 0 ? -1 : 1;
+		else
+			n = do_recvmmsg(fd, msgs, batch, MSG_WAITFORONE, NULL);
+		if (n < 0 && errno != EAGAIN && errno != EINTR)
+			bail(batch == 1 ? "recvfrom" : "recvmmsg");
+		if (n > 0) {
+			pkts += n;
+			calls++;
+		}
+
+		t = now();
+		if (t - last < 1.0)
+			continue;
+
+		printf("%8.0f pkt/s %8.0f calls/s %6.1f pkt/call\n",
+		       pkts / (t - last), calls / (t - last),
+		       calls ? (double)pkts / calls : 0.0);
+		fflush(stdout);
+		total += pkts;
+		pkts = calls = 0;
+		last = t;
+
+		if (secs && t - start >= secs)
+			break;
+	}
+	printf("total %lu packets in %.1f s\n", total, last - start);
+}
+
+static void sender(int fd, struct sockaddr_in *to, int batch, int len, int secs)
+{
+	unsigned long pkts = 0, calls = 0;
+	double start, t;
+	int n;
+
+	setup_msgs(batch, len, to);
+	start = t = now();
+
+	for (;;) {
+		if (batch == 1)
+			n = sendto(fd, bufs[0], len, 0, (struct sockaddr *)to,
+				   sizeof(*to)) < 0 ? -1 : 1;
+		else
+			n = do_sendmmsg(fd, msgs, batch, 0);
+		/* ENOBUFS and ECONNREFUSED: the receiver is slower than us */
+		if (n < 0 && errno != ENOBUFS && errno != ECONNREFUSED)
+			bail(batch == 1 ? "sendto" : "sendmmsg");
+		if (n > 0)
+			pkts += n;
+
+		/* look at the clock only now and then */
+		if (++calls % 64)
+			continue;
+		t = now();
+		if (secs && t - start >= secs)
+			break;
+	}
+
+	printf("sent %lu packets in %.1f s, %.0f pkt/s\n",
+	       pkts, t - start, pkts / (t - start));
+}
+
+int main(int argc, char **argv)
+{
+	struct sockaddr_in addr;
+	struct hostent *host;
+	char *dest = NULL;
+	int rx = 0, port = 6000, batch = 64, len = 64, secs = 10;
+	int fd, c;
+
+	while ((c = getopt(argc, argv, "rs:p:b:l:t:")) != -1) {
+		switch (c) {
+		case 'r':
+			rx = 1;
+			break;
+		case 's':
+			dest = optarg;
+			break;
+		case 'p':
+			port = atoi(optarg);
+			break;
+		case 'b':
+			batch = atoi(optarg);
+			break;
+		case 'l':
+			len = atoi(optarg);
+			break;
+		case 't':
+			secs = atoi(optarg);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (rx == !!dest || batch < 1 || batch > MAX_BATCH ||
+	    len < 1 || len > MAX_LEN)
+		usage();
+
+	fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (fd < 0)
+		bail("socket");
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+
+	if (rx) {
+		addr.sin_addr.s_addr = htonl(INADDR_ANY);
+		if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+			bail("bind");
+		receiver(fd, batch, secs);
+	} else {
+		host = gethostbyname(dest);
+		if (!host) {
+			fprintf(stderr, "unknown host %s\n", dest);
+			return 1;
+		}
+		memcpy(&addr.sin_addr, host->h_addr, sizeof(addr.sin_addr));
+		sender(fd, &addr, batch, len, secs);
+	}
+	return 0;
+}
@@ -2,7 +2,8 @@
  * misc.c
  * 
  * This is a collection of several routines from gzip-1.0.3 
- * adapted for Linux.
+ * adapted for Linux.  LZO compressed kernels are decoded with
+ * lib/decompress_unlzo.c instead.
  *
  * malloc by Hannu Savolainen 1993 and Matthias Urlichs 1994
  *
@@ -185,16 +186,54 @@ static inline __ptr_t memcpy(__ptr_t __dest, __const __ptr_t __src,
 	return __dest;
 }
 
-/*
- * gzip delarations
- */
-#define OF(args)  args
 #define STATIC static
 
 typedef unsigned char  uch;
 typedef unsigned short ush;
 typedef unsigned long  ulg;
 
+static void error(char *m);
+
+extern char input_data[];
+extern char input_data_end[];
+
+static uch *output_data;
+static ulg output_ptr;
+
+static void putstr(const char *);
+
+extern int end;
+static ulg free_mem_ptr;
+static ulg free_mem_end_ptr;
+
+#ifdef CONFIG_KERNEL_LZO
+
+#include <linux/decompress/mm.h>
+#include "../../../../lib/decompress_unlzo.c"
+
+/*
+ * unlzo() writes straight into the kernel's final location; this only
+ * keeps count of the output so head.S knows where the kernel ends.
+ */
+static int flush_lzo(void *buf, unsigned int len)
+{
+	output_ptr += len;
+	return len;
+}
+
+static void do_decompress(void)
+{
+	unlzo((u8 *)input_data, input_data_end - input_data, NULL, flush_lzo,
+	      output_data, NULL, error);
+}
+
+#else /* CONFIG_KERNEL_LZO */
+
+/*
+ * gzip delarations
+ */
+#define OF(args)  args
+
 #define WSIZE 0x8000		/* Window size must be at least 32k, */
 				/* and a power of two */
 
@@ -235,23 +274,9 @@ static unsigned outcnt;		/* bytes in output buffer */
 
 static int  fill_inbuf(void);
 static void flush_window(void);
-static void error(char *m);
 
-extern char input_data[];
-extern char input_data_end[];
-
-static uch *output_data;
-static ulg output_ptr;
 static ulg bytes_out;
 
-static void error(char *m);
-
-static void putstr(const char *);
-
-extern int end;
-static ulg free_mem_ptr;
-static ulg free_mem_end_ptr;
-
 #ifdef STANDALONE_DEBUG
 #define NO_INFLATE_MALLOC
 #endif
@@ -299,6 +324,14 @@ void flush_window(void)
 	putstr(".");
 }
 
+static void do_decompress(void)
+{
+	makecrc();
+	gunzip();
+}
+
+#endif /* CONFIG_KERNEL_LZO */
+
 #ifndef arch_error
 #define arch_error(x)
 #endif
@@ -327,9 +360,8 @@ decompress_kernel(ulg output_start, ulg free_mem_ptr_p, ulg free_mem_ptr_end_p,
 
 	arch_decomp_setup();
 
-	makecrc();
 	putstr("Uncompressing Linux...");
-	gunzip();
+	do_decompress();
 	putstr(" done, booting the kernel.\n");
 	return output_ptr;
 }
@@ -341,9 +373,8 @@ int main()
 {
 	output_data = output_buffer;
 
-	makecrc();
 	putstr("Uncompressing Linux...");
-	gunzip();
+	do_decompress();
 	putstr("done.\n");
 	return 0;
 }
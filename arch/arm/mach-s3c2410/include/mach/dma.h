@@ -110,7 +110,7 @@ enum s3c2410_dma_loadst {
 					    * waiting for reloads */
 #define S3C2410_DMAF_AUTOSTART    (1<<1)   /* auto-start if buffer queued */
 
-#define S3C2410_DMAF_CIRCULAR	(1 << 2)	/* no circular dma support */
+#define S3C2410_DMAF_CIRCULAR	(1 << 2)	/* requeue buffers once done */
 
 /* dma buffer */
 
@@ -198,7 +198,7 @@ typedef unsigned long dma_device_t;
 
 static inline bool s3c_dma_has_circular(void)
 {
-	return false;
+	return true;
 }
 
 #endif /* __ASM_ARCH_DMA_H */
@@ -0,0 +1,724 @@
+/*
+ * Just-In-Time compiler for BPF filters on 32bit ARM
+ *
+ * Translates classic socket filter programs to native code when they are
+ * attached. Only ARMv4 instructions are generated so the result runs on
+ * every ARM core the kernel supports, ARM920T included. Programs using
+ * instructions the JIT does not handle keep running in sk_run_filter().
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; version 2 of the License.
+ */
+
+#include <linux/bitops.h>
+#include <linux/compiler.h>
+#include <linux/errno.h>
+#include <linux/moduleloader.h>
+#include <linux/netdevice.h>
+#include <linux/skbuff.h>
+#include <linux/filter.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/workqueue.h>
+#include <asm/cacheflush.h>
+#include <asm/unaligned.h>
+
+#include "bpf_jit_32.h"
+
+/*
+ * ABI:
+ *
+ * r0	scratch register, return value
+ * r1	offset of a packet load
+ * r2	scratch register
+ * r3	scratch register
+ * r4	A register
+ * r5	X register
+ * r6	pointer to the skb
+ * r7	skb->data
+ * r8	skb_headlen(skb)
+ */
+
+#define r_scratch	ARM_R0
+#define r_off		ARM_R1
+#define r_A		ARM_R4
+#define r_X		ARM_R5
+#define r_skb		ARM_R6
+#define r_skb_data	ARM_R7
+#define r_skb_hl	ARM_R8
+
+/* 64 bit return values of the helpers: value in one register, error in the other */
+#ifdef __ARMEB__
+#define r_ret_val	ARM_R1
+#define r_ret_err	ARM_R0
+#else
+#define r_ret_val	ARM_R0
+#define r_ret_err	ARM_R1
+#endif
+
+#define SEEN_MEM		(1 << 0) /* use mem[] for temporary storage */
+#define SEEN_DATA		(1 << 1) /* loads from the packet */
+#define SEEN_X			(1 << 2) /* X is used */
+
+#define SCRATCH_SIZE		(BPF_MEMWORDS * 4)
+
+/* registers saved by the prologue and restored by the epilogue */
+#define SAVED_REGS	((1 << r_A) | (1 << r_X) | (1 << r_skb) | \
+			 (1 << r_skb_data) | (1 << r_skb_hl))
+
+struct jit_ctx {
+	const struct sk_filter *skf;
+	unsigned idx;
+	unsigned epilogue_idx;
+	unsigned ret0_idx;
+	u32 seen;
+	u32 *offsets;
+	u32 *target;
+};
+
+int bpf_jit_enable __read_mostly;
+
+/*
+ * Slow path packet loads, used when the bytes are not all in the linear
+ * part of the skb or the offset is negative (SKF_NET_OFF, SKF_LL_OFF).
+ * The error is returned in the upper word.
+ */
+static u64 jit_get_skb_b(struct sk_buff *skb, int offset)
+{
+	u8 buf, *ptr;
+
+	ptr = bpf_load_pointer(skb, offset, 1, &buf);
+	if (!ptr)
+		return (u64)1 << 32;
+	return *ptr;
+}
+
+static u64 jit_get_skb_h(struct sk_buff *skb, int offset)
+{
+	u16 buf;
+	void *ptr;
+
+	ptr = bpf_load_pointer(skb, offset, 2, &buf);
+	if (!ptr)
+		return (u64)1 << 32;
+	return get_unaligned_be16(ptr);
+}
+
+static u64 jit_get_skb_w(struct sk_buff *skb, int offset)
+{
+	u32 buf;
+	void *ptr;
+
+	ptr = bpf_load_pointer(skb, offset, 4, &buf);
+	if (!ptr)
+		return (u64)1 << 32;
+	return get_unaligned_be32(ptr);
+}
+
+/* skb->protocol is a bitfield, so it cannot be loaded directly */
+static u32 jit_get_protocol(struct sk_buff *skb)
+{
+	return ntohs(skb->protocol);
+}
+
+/* ARMv4 has no divide instruction */
+static u32 jit_udiv(u32 dividend, u32 divisor)
+{
+	return dividend / divisor;
+}
+
+static inline void _emit(int cond, u32 inst, struct jit_ctx *ctx)
+{
+	if (ctx->target != NULL)
+		ctx->target[ctx->idx] = inst | (cond << 28);
+
+	ctx->idx++;
+}
+
+/*
+ * Emit an instruction that will be executed unconditionally.
+ */
+static inline void emit(u32 inst, struct jit_ctx *ctx)
+{
+	_emit(ARM_COND_AL, inst, ctx);
+}
+
+/*
+ * Fill in a forward branch emitted at @idx now that its target (the
+ * current position) is known.
+ */
+static inline void fixup_branch(int cond, unsigned idx, struct jit_ctx *ctx)
+{
+	if (ctx->target != NULL)
+		ctx->target[idx] = ARM_B(ctx->idx - idx - 2) | (cond << 28);
+}
+
+static inline u32 b_imm(unsigned tgt, struct jit_ctx *ctx)
+{
+	/* the PC is 8 bytes ahead of the branch */
+	return tgt - (ctx->idx + 2);
+}
+
+/*
+ * Encode @x as an 8 bit value rotated right by an even amount, the
+ * operand2 immediate format. Returns -1 if that is impossible.
+ */
+static int imm8m(u32 x)
+{
+	u32 rot;
+
+	if (x <= 0xff)
+		return x;
+
+	for (rot = 1; rot < 16; rot++)
+		if ((x & ~ror32(0xff, 2 * rot)) == 0)
+			return rol32(x, 2 * rot) | (rot << 8);
+
+	return -1;
+}
+
+/*
+ * Load a 32 bit constant without a literal pool: mov/mvn when it fits,
+ * otherwise mov followed by an orr for each further 8 bit chunk. The
+ * length only depends on @val so every pass lays the code out the same.
+ */
+static void emit_mov_i(int rd, u32 val, struct jit_ctx *ctx)
+{
+	int imm12;
+	int first = 1;
+
+	imm12 = imm8m(val);
+	if (imm12 >= 0) {
+		emit(ARM_MOV_I(rd, imm12), ctx);
+		return;
+	}
+
+	imm12 = imm8m(~val);
+	if (imm12 >= 0) {
+		emit(ARM_MVN_I(rd, imm12), ctx);
+		return;
+	}
+
+	while (val) {
+		unsigned shift = __ffs(val) & ~1;
+		u32 chunk = val & ((u32)0xff << shift);
+
+		val &= ~chunk;
+		imm12 = imm8m(chunk);
+		emit(first ? ARM_MOV_I(rd, imm12) : ARM_ORR_I(rd, rd, imm12),
+		     ctx);
+		first = 0;
+	}
+}
+
+static void emit_call(void *func, struct jit_ctx *ctx)
+{
+	emit_mov_i(ARM_IP, (u32)func, ctx);
+	emit(ARM_MOV_R(ARM_LR, ARM_PC), ctx);
+	emit(ARM_MOV_R(ARM_PC, ARM_IP), ctx);
+}
+
+/*
+ * Stack below the saved registers: mem[] if the program uses it, padded
+ * so that SP stays 8 byte aligned across the helper calls, as the AAPCS
+ * requires.
+ */
+static u32 stack_size(struct jit_ctx *ctx)
+{
+	u32 pushed = 4 * hweight32(SAVED_REGS | (1 << ARM_LR));
+	u32 size = ctx->seen & SEEN_MEM ? SCRATCH_SIZE : 0;
+
+	return ALIGN(pushed + size, 8) - pushed;
+}
+
+static void build_prologue(struct jit_ctx *ctx)
+{
+	emit(ARM_PUSH(SAVED_REGS | (1 << ARM_LR)), ctx);
+
+	emit(ARM_MOV_R(r_skb, ARM_R0), ctx);
+	emit(ARM_MOV_I(r_A, 0), ctx);
+	if (ctx->seen & SEEN_X)
+		emit(ARM_MOV_I(r_X, 0), ctx);
+
+	if (ctx->seen & SEEN_DATA) {
+		emit(ARM_LDR_I(r_skb_data, r_skb,
+			       offsetof(struct sk_buff, data)), ctx);
+		emit(ARM_LDR_I(r_skb_hl, r_skb,
+			       offsetof(struct sk_buff, len)), ctx);
+		emit(ARM_LDR_I(r_scratch, r_skb,
+			       offsetof(struct sk_buff, data_len)), ctx);
+		emit(ARM_SUB_R(r_skb_hl, r_skb_hl, r_scratch), ctx);
+	}
+
+	if (stack_size(ctx))
+		emit(ARM_SUB_I(ARM_SP, ARM_SP, stack_size(ctx)), ctx);
+}
+
+static void build_return(struct jit_ctx *ctx)
+{
+	if (stack_size(ctx))
+		emit(ARM_ADD_I(ARM_SP, ARM_SP, stack_size(ctx)), ctx);
+	emit(ARM_POP(SAVED_REGS | (1 << ARM_PC)), ctx);
+}
+
+static void build_epilogue(struct jit_ctx *ctx)
+{
+	ctx->epilogue_idx = ctx->idx;
+	build_return(ctx);
+
+	/* failed packet loads and divisions by zero end up here */
+	ctx->ret0_idx = ctx->idx;
+	emit(ARM_MOV_I(ARM_R0, 0), ctx);
+	build_return(ctx);
+}
+
+/*
+ * Load @size bytes at the offset in r_off into @rd. The bytes are read
+ * straight from skb->data when they are all in the linear part, anything
+ * else goes through bpf_load_pointer() like the interpreter does.
+ */
+static void emit_load(int rd, unsigned size, struct jit_ctx *ctx)
+{
+	unsigned slow_idx, done_idx;
+	void *helper;
+
+	ctx->seen |= SEEN_DATA;
+
+	/* headlen >= off && headlen - off >= size */
+	emit(ARM_CMP_R(r_skb_hl, r_off), ctx);
+	_emit(ARM_COND_HS, ARM_SUB_R(ARM_R2, r_skb_hl, r_off), ctx);
+	_emit(ARM_COND_HS, ARM_CMP_I(ARM_R2, size), ctx);
+	slow_idx = ctx->idx++;
+
+	/* packet data is big endian and need not be aligned */
+	switch (size) {
+	case 1:
+		emit(ARM_LDRB_R(rd, r_skb_data, r_off), ctx);
+		helper = jit_get_skb_b;
+		break;
+	case 2:
+		emit(ARM_ADD_R(ARM_R3, r_skb_data, r_off), ctx);
+		emit(ARM_LDRB_I(ARM_R2, ARM_R3, 0), ctx);
+		emit(ARM_LDRB_I(ARM_R3, ARM_R3, 1), ctx);
+		emit(ARM_ORR_S(rd, ARM_R3, ARM_R2, SRTYPE_LSL, 8), ctx);
+		helper = jit_get_skb_h;
+		break;
+	default:
+		emit(ARM_ADD_R(ARM_R3, r_skb_data, r_off), ctx);
+		emit(ARM_LDRB_I(ARM_R0, ARM_R3, 0), ctx);
+		emit(ARM_LDRB_I(ARM_R1, ARM_R3, 1), ctx);
+		emit(ARM_LDRB_I(ARM_R2, ARM_R3, 2), ctx);
+		emit(ARM_LDRB_I(ARM_R3, ARM_R3, 3), ctx);
+		emit(ARM_ORR_S(ARM_R0, ARM_R1, ARM_R0, SRTYPE_LSL, 8), ctx);
+		emit(ARM_ORR_S(ARM_R0, ARM_R2, ARM_R0, SRTYPE_LSL, 8), ctx);
+		emit(ARM_ORR_S(rd, ARM_R3, ARM_R0, SRTYPE_LSL, 8), ctx);
+		helper = jit_get_skb_w;
+		break;
+	}
+	done_idx = ctx->idx++;
+
+	fixup_branch(ARM_COND_LO, slow_idx, ctx);
+	emit(ARM_MOV_R(ARM_R0, r_skb), ctx);
+	emit_call(helper, ctx);
+	emit(ARM_CMP_I(r_ret_err, 0), ctx);
+	_emit(ARM_COND_NE, ARM_B(b_imm(ctx->ret0_idx, ctx)), ctx);
+	emit(ARM_MOV_R(rd, r_ret_val), ctx);
+
+	fixup_branch(ARM_COND_AL, done_idx, ctx);
+}
+
+/* A = A <op> k, going through r3 when k is not a valid immediate */
+static void emit_alu_k(u32 inst_i, u32 inst_r, u32 k, struct jit_ctx *ctx)
+{
+	int imm12 = imm8m(k);
+
+	if (imm12 >= 0) {
+		emit(inst_i | r_A << 12 | r_A << 16 | imm12, ctx);
+	} else {
+		emit_mov_i(ARM_R3, k, ctx);
+		emit(inst_r | r_A << 12 | r_A << 16 | ARM_R3, ctx);
+	}
+}
+
+static void emit_cmp_k(u32 inst_i, u32 inst_r, u32 k, struct jit_ctx *ctx)
+{
+	int imm12 = imm8m(k);
+
+	if (imm12 >= 0) {
+		emit(inst_i | r_A << 16 | imm12, ctx);
+	} else {
+		emit_mov_i(ARM_R3, k, ctx);
+		emit(inst_r | r_A << 16 | ARM_R3, ctx);
+	}
+}
+
+static void emit_udiv(struct jit_ctx *ctx)
+{
+	emit(ARM_MOV_R(ARM_R0, r_A), ctx);
+	emit_call(jit_udiv, ctx);
+	emit(ARM_MOV_R(r_A, ARM_R0), ctx);
+}
+
+static int build_body(struct jit_ctx *ctx)
+{
+	const struct sk_filter *prog = ctx->skf;
+	const struct sock_filter *inst;
+	unsigned i, load_size, jt, jf;
+	int cond;
+	u32 k;
+
+	for (i = 0; i < prog->len; i++) {
+		inst = &(prog->insns[i]);
+		/* K as an immediate value operand */
+		k = inst->k;
+
+		/* compute offsets only in the fake pass */
+		if (ctx->target == NULL)
+			ctx->offsets[i] = ctx->idx;
+
+		switch (inst->code) {
+		case BPF_LD|BPF_IMM:
+			emit_mov_i(r_A, k, ctx);
+			break;
+		case BPF_LD|BPF_W|BPF_LEN:
+			emit(ARM_LDR_I(r_A, r_skb, offsetof(struct sk_buff, len)),
+			     ctx);
+			break;
+		case BPF_LD|BPF_MEM:
+			ctx->seen |= SEEN_MEM;
+			emit(ARM_LDR_I(r_A, ARM_SP, k * 4), ctx);
+			break;
+		case BPF_LD|BPF_W|BPF_ABS:
+			load_size = 4;
+			goto load_abs;
+		case BPF_LD|BPF_H|BPF_ABS:
+			load_size = 2;
+			goto load_abs;
+		case BPF_LD|BPF_B|BPF_ABS:
+			load_size = 1;
+load_abs:
+			if ((int)k >= SKF_AD_OFF && (int)k < SKF_AD_OFF + SKF_AD_MAX)
+				goto load_ancillary;
+			emit_mov_i(r_off, k, ctx);
+			emit_load(r_A, load_size, ctx);
+			break;
+		case BPF_LD|BPF_W|BPF_IND:
+			load_size = 4;
+			goto load_ind;
+		case BPF_LD|BPF_H|BPF_IND:
+			load_size = 2;
+			goto load_ind;
+		case BPF_LD|BPF_B|BPF_IND:
+			load_size = 1;
+load_ind:
+			ctx->seen |= SEEN_X;
+			if (imm8m(k) >= 0) {
+				emit(ARM_ADD_I(r_off, r_X, imm8m(k)), ctx);
+			} else {
+				emit_mov_i(r_off, k, ctx);
+				emit(ARM_ADD_R(r_off, r_X, r_off), ctx);
+			}
+			emit_load(r_A, load_size, ctx);
+			break;
+		case BPF_LDX|BPF_IMM:
+			ctx->seen |= SEEN_X;
+			emit_mov_i(r_X, k, ctx);
+			break;
+		case BPF_LDX|BPF_W|BPF_LEN:
+			ctx->seen |= SEEN_X;
+			emit(ARM_LDR_I(r_X, r_skb, offsetof(struct sk_buff, len)),
+			     ctx);
+			break;
+		case BPF_LDX|BPF_MEM:
+			ctx->seen |= SEEN_X | SEEN_MEM;
+			emit(ARM_LDR_I(r_X, ARM_SP, k * 4), ctx);
+			break;
+		case BPF_LDX|BPF_B|BPF_MSH:
+			/* x = ((*(frame + k)) & 0xf) << 2; */
+			ctx->seen |= SEEN_X;
+			emit_mov_i(r_off, k, ctx);
+			emit_load(r_scratch, 1, ctx);
+			emit(ARM_AND_I(r_scratch, r_scratch, 0x0f), ctx);
+			emit(ARM_LSL_I(r_X, r_scratch, 2), ctx);
+			break;
+		case BPF_ST:
+			ctx->seen |= SEEN_MEM;
+			emit(ARM_STR_I(r_A, ARM_SP, k * 4), ctx);
+			break;
+		case BPF_STX:
+			ctx->seen |= SEEN_MEM | SEEN_X;
+			emit(ARM_STR_I(r_X, ARM_SP, k * 4), ctx);
+			break;
+		case BPF_ALU|BPF_ADD|BPF_K:
+			emit_alu_k(ARM_INST_ADD_I, ARM_INST_ADD_R, k, ctx);
+			break;
+		case BPF_ALU|BPF_ADD|BPF_X:
+			ctx->seen |= SEEN_X;
+			emit(ARM_ADD_R(r_A, r_A, r_X), ctx);
+			break;
+		case BPF_ALU|BPF_SUB|BPF_K:
+			emit_alu_k(ARM_INST_SUB_I, ARM_INST_SUB_R, k, ctx);
+			break;
+		case BPF_ALU|BPF_SUB|BPF_X:
+			ctx->seen |= SEEN_X;
+			emit(ARM_SUB_R(r_A, r_A, r_X), ctx);
+			break;
+		case BPF_ALU|BPF_MUL|BPF_K:
+			/* ARMv4 wants the destination and Rm to differ */
+			emit_mov_i(ARM_R3, k, ctx);
+			emit(ARM_MUL(r_A, ARM_R3, r_A), ctx);
+			break;
+		case BPF_ALU|BPF_MUL|BPF_X:
+			ctx->seen |= SEEN_X;
+			emit(ARM_MUL(r_A, r_X, r_A), ctx);
+			break;
+		case BPF_ALU|BPF_DIV|BPF_K:
+			/* sk_chk_filter() rejects k == 0 */
+			if (is_power_of_2(k)) {
+				if (k != 1)
+					emit(ARM_LSR_I(r_A, r_A, ilog2(k)), ctx);
+				break;
+			}
+			emit_mov_i(ARM_R1, k, ctx);
+			emit_udiv(ctx);
+			break;
+		case BPF_ALU|BPF_DIV|BPF_X:
+			ctx->seen |= SEEN_X;
+			emit(ARM_CMP_I(r_X, 0), ctx);
+			_emit(ARM_COND_EQ, ARM_B(b_imm(ctx->ret0_idx, ctx)), ctx);
+			emit(ARM_MOV_R(ARM_R1, r_X), ctx);
+			emit_udiv(ctx);
+			break;
+		case BPF_ALU|BPF_OR|BPF_K:
+			emit_alu_k(ARM_INST_ORR_I, ARM_INST_ORR_R, k, ctx);
+			break;
+		case BPF_ALU|BPF_OR|BPF_X:
+			ctx->seen |= SEEN_X;
+			emit(ARM_ORR_R(r_A, r_A, r_X), ctx);
+			break;
+		case BPF_ALU|BPF_AND|BPF_K:
+			emit_alu_k(ARM_INST_AND_I, ARM_INST_AND_R, k, ctx);
+			break;
+		case BPF_ALU|BPF_AND|BPF_X:
+			ctx->seen |= SEEN_X;
+			emit(ARM_AND_R(r_A, r_A, r_X), ctx);
+			break;
+		case BPF_ALU|BPF_LSH|BPF_K:
+			if (k < 32) {
+				if (k)
+					emit(ARM_LSL_I(r_A, r_A, k), ctx);
+				break;
+			}
+			/* same result as the interpreter's register shift */
+			emit_mov_i(ARM_R3, k, ctx);
+			emit(ARM_LSL_R(r_A, r_A, ARM_R3), ctx);
+			break;
+		case BPF_ALU|BPF_LSH|BPF_X:
+			ctx->seen |= SEEN_X;
+			emit(ARM_LSL_R(r_A, r_A, r_X), ctx);
+			break;
+		case BPF_ALU|BPF_RSH|BPF_K:
+			/* an immediate LSR #0 encodes LSR #32 */
+			if (k < 32) {
+				if (k)
+					emit(ARM_LSR_I(r_A, r_A, k), ctx);
+				break;
+			}
+			emit_mov_i(ARM_R3, k, ctx);
+			emit(ARM_LSR_R(r_A, r_A, ARM_R3), ctx);
+			break;
+		case BPF_ALU|BPF_RSH|BPF_X:
+			ctx->seen |= SEEN_X;
+			emit(ARM_LSR_R(r_A, r_A, r_X), ctx);
+			break;
+		case BPF_ALU|BPF_NEG:
+			/* A = -A */
+			emit(ARM_RSB_I(r_A, r_A, 0), ctx);
+			break;
+		case BPF_JMP|BPF_JA:
+			/* pc += K */
+			emit(ARM_B(b_imm(ctx->offsets[i + 1 + k], ctx)), ctx);
+			break;
+		case BPF_JMP|BPF_JEQ|BPF_K:
+			/* pc += (A == K) ? pc->jt : pc->jf */
+			cond = ARM_COND_EQ;
+			goto cmp_imm;
+		case BPF_JMP|BPF_JGT|BPF_K:
+			/* pc += (A > K) ? pc->jt : pc->jf */
+			cond = ARM_COND_HI;
+			goto cmp_imm;
+		case BPF_JMP|BPF_JGE|BPF_K:
+			/* pc += (A >= K) ? pc->jt : pc->jf */
+			cond = ARM_COND_HS;
+cmp_imm:
+			emit_cmp_k(ARM_INST_CMP_I, ARM_INST_CMP_R, k, ctx);
+			goto cond_jump;
+		case BPF_JMP|BPF_JSET|BPF_K:
+			/* pc += (A & K) ? pc->jt : pc->jf */
+			cond = ARM_COND_NE;
+			emit_cmp_k(ARM_INST_TST_I, ARM_INST_TST_R, k, ctx);
+			goto cond_jump;
+		case BPF_JMP|BPF_JEQ|BPF_X:
+			cond = ARM_COND_EQ;
+			goto cmp_x;
+		case BPF_JMP|BPF_JGT|BPF_X:
+			cond = ARM_COND_HI;
+			goto cmp_x;
+		case BPF_JMP|BPF_JGE|BPF_X:
+			cond = ARM_COND_HS;
+cmp_x:
+			ctx->seen |= SEEN_X;
+			emit(ARM_CMP_R(r_A, r_X), ctx);
+			goto cond_jump;
+		case BPF_JMP|BPF_JSET|BPF_X:
+			cond = ARM_COND_NE;
+			ctx->seen |= SEEN_X;
+			emit(ARM_TST_R(r_A, r_X), ctx);
+cond_jump:
+			jt = inst->jt;
+			jf = inst->jf;
+			if (jt && jf) {
+				_emit(cond, ARM_B(b_imm(ctx->offsets[i + 1 + jt],
+							ctx)), ctx);
+				emit(ARM_B(b_imm(ctx->offsets[i + 1 + jf], ctx)),
+				     ctx);
+			} else if (jt) {
+				_emit(cond, ARM_B(b_imm(ctx->offsets[i + 1 + jt],
+							ctx)), ctx);
+			} else if (jf) {
+				/* the inverse condition is the next code */
+				_emit(cond ^ 1,
+				      ARM_B(b_imm(ctx->offsets[i + 1 + jf], ctx)),
+				      ctx);
+			}
+			break;
+		case BPF_RET|BPF_A:
+			emit(ARM_MOV_R(ARM_R0, r_A), ctx);
+			goto b_epilogue;
+		case BPF_RET|BPF_K:
+			if (k == 0 && i != prog->len - 1) {
+				emit(ARM_B(b_imm(ctx->ret0_idx, ctx)), ctx);
+				break;
+			}
+			emit_mov_i(ARM_R0, k, ctx);
+b_epilogue:
+			/* the last instruction falls through to the epilogue */
+			if (i != prog->len - 1)
+				emit(ARM_B(b_imm(ctx->epilogue_idx, ctx)), ctx);
+			break;
+		case BPF_MISC|BPF_TAX:
+			/* X = A */
+			ctx->seen |= SEEN_X;
+			emit(ARM_MOV_R(r_X, r_A), ctx);
+			break;
+		case BPF_MISC|BPF_TXA:
+			/* A = X */
+			ctx->seen |= SEEN_X;
+			emit(ARM_MOV_R(r_A, r_X), ctx);
+			break;
+		default:
+			/* hit an opcode the JIT does not know about */
+			return -1;
+		}
+		continue;
+
+load_ancillary:
+		switch (k - SKF_AD_OFF) {
+		case SKF_AD_PROTOCOL:
+			/* A = ntohs(skb->protocol) */
+			emit(ARM_MOV_R(ARM_R0, r_skb), ctx);
+			emit_call(jit_get_protocol, ctx);
+			emit(ARM_MOV_R(r_A, ARM_R0), ctx);
+			break;
+		case SKF_AD_IFINDEX:
+			/* A = skb->dev->ifindex */
+			BUILD_BUG_ON(offsetof(struct net_device, ifindex) > 0xfff);
+			emit(ARM_LDR_I(ARM_R3, r_skb,
+				       offsetof(struct sk_buff, dev)), ctx);
+			emit(ARM_CMP_I(ARM_R3, 0), ctx);
+			_emit(ARM_COND_EQ, ARM_B(b_imm(ctx->ret0_idx, ctx)), ctx);
+			emit(ARM_LDR_I(r_A, ARM_R3,
+				       offsetof(struct net_device, ifindex)), ctx);
+			break;
+		default:
+			/* pkttype and the netlink attribute lookups */
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+void bpf_jit_compile(struct sk_filter *fp)
+{
+	struct jit_ctx ctx;
+	unsigned alloc_size;
+
+	if (!bpf_jit_enable)
+		return;
+
+	/* all the sk_buff fields we touch must be reachable by ldr */
+	BUILD_BUG_ON(sizeof(struct sk_buff) > 0xfff);
+
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.skf = fp;
+
+	ctx.offsets = kzalloc(4 * (fp->len + 1), GFP_KERNEL);
+	if (ctx.offsets == NULL)
+		return;
+
+	/* fake pass to find out which registers the program needs */
+	if (unlikely(build_body(&ctx)))
+		goto out;
+
+	/* second fake pass to lay out the code */
+	ctx.idx = 0;
+	build_prologue(&ctx);
+	build_body(&ctx);
+	build_epilogue(&ctx);
+
+	/* big enough to be reused as the work item that frees it */
+	alloc_size = max_t(unsigned, 4 * ctx.idx, sizeof(struct work_struct));
+	ctx.target = module_alloc(alloc_size);
+	if (unlikely(ctx.target == NULL))
+		goto out;
+
+	ctx.idx = 0;
+	build_prologue(&ctx);
+	build_body(&ctx);
+	build_epilogue(&ctx);
+
+	flush_icache_range((u32)ctx.target, (u32)(ctx.target + ctx.idx));
+
+	if (bpf_jit_enable > 1)
+		print_hex_dump(KERN_INFO, "BPF JIT code: ",
+			       DUMP_PREFIX_ADDRESS, 16, 4, ctx.target,
+			       alloc_size, false);
+
+	fp->bpf_func = (void *)ctx.target;
+out:
+	kfree(ctx.offsets);
+	return;
+}
+
+static void bpf_jit_free_worker(struct work_struct *work)
+{
+	module_free(NULL, work);
+}
+
+/*
+ * Called from the RCU callback that frees the filter, in softirq, where
+ * module_free() cannot vfree(): the code is no longer run, so free it
+ * from a work item stored in the code itself.
+ */
+void bpf_jit_free(struct sk_filter *fp)
+{
+	struct work_struct *work;
+
+	if (fp->bpf_func != sk_run_filter) {
+		work = (struct work_struct *)fp->bpf_func;
+		INIT_WORK(work, bpf_jit_free_worker);
+		schedule_work(work);
+	}
+}
@@ -149,6 +149,10 @@ int __init oprofile_arch_init(struct oprofile_operations *ops)
 	spec = &op_armv7_spec;
 #endif
 
+#ifdef CONFIG_OPROFILE_S3C24XX_FIQ
+	spec = &op_s3c24xx_fiq_spec;
+#endif
+
 	if (spec) {
 		ret = spec->init();
 		if (ret < 0)
@@ -167,6 +171,8 @@ int __init oprofile_arch_init(struct oprofile_operations *ops)
 		ops->start = op_arm_start;
 		ops->stop = op_arm_stop;
 		ops->cpu_type = op_arm_model->name;
+		if (spec->backtrace)
+			ops->backtrace = spec->backtrace;
 		printk(KERN_INFO "oprofile: using %s\n", spec->name);
 	}
 
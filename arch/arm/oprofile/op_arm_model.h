@@ -17,6 +17,7 @@ struct op_arm_model_spec {
 	int (*setup_ctrs)(void);
 	int (*start)(void);
 	void (*stop)(void);
+	void (*backtrace)(struct pt_regs * const regs, unsigned int depth);
 	char *name;
 };
 
@@ -27,6 +28,7 @@ extern struct op_arm_model_spec op_xscale_spec;
 extern struct op_arm_model_spec op_armv6_spec;
 extern struct op_arm_model_spec op_mpcore_spec;
 extern struct op_arm_model_spec op_armv7_spec;
+extern struct op_arm_model_spec op_s3c24xx_fiq_spec;
 
 extern void arm_backtrace(struct pt_regs * const regs, unsigned int depth);
 
@@ -0,0 +1,355 @@
+/**
+ * @file op_model_s3c24xx.c
+ * FIQ sampling on the PWM timers of S3C24XX SoCs
+ *
+ * @remark Read the file COPYING
+ *
+ * The ARM920T has no performance counters, so the only samples oprofile
+ * gets are from the timer interrupt, which never lands in code running
+ * with interrupts disabled. This routes a spare PWM timer to the FIQ
+ * instead, which local_irq_save() does not mask.
+ *
+ * The FIQ handler records the interrupted pc, and the kernel call stack
+ * for samples taken in SVC mode, in a per-CPU ring that it is the only
+ * writer of. It then routes the timer back to the IRQ, so that the
+ * still pending timer interrupt is taken as soon as the interrupted
+ * code enables interrupts again. The IRQ handler passes the recorded
+ * samples on to oprofile in the context of the same task, and routes
+ * the timer to the FIQ again for the next sample.
+ *
+ * The samples are reported with cpu_type "timer", so that the oprofile
+ * tools drive this as they drive the timer interrupt fallback. The
+ * sampling period in microseconds can be set in counter 0's "count".
+ */
+
+#include <linux/types.h>
+#include <linux/errno.h>
+#include <linux/err.h>
+#include <linux/sched.h>
+#include <linux/oprofile.h>
+#include <linux/interrupt.h>
+#include <linux/irq.h>
+#include <linux/clk.h>
+#include <linux/io.h>
+#include <linux/math64.h>
+#include <linux/percpu.h>
+#include <linux/platform_device.h>
+
+#include <asm/fiq.h>
+#include <asm/stacktrace.h>
+
+#include <mach/irqs.h>
+#include <mach/regs-irq.h>
+#include <plat/regs-timer.h>
+#include <plat/fiq.h>
+
+#include "op_counter.h"
+#include "op_arm_model.h"
+
+#define OP_FIQ_TIMER	CONFIG_OPROFILE_S3C24XX_FIQ_TIMER
+#define OP_FIQ_IRQ	(IRQ_TIMER0 + OP_FIQ_TIMER)
+
+/*
+ * A prime number of microseconds, so that the samples do not beat
+ * against the tick or other periodic work.
+ */
+#define OP_FIQ_PERIOD	1009
+#define OP_FIQ_MIN	20
+
+#define OP_FIQ_SAMPLES	8	/* power of 2 */
+#define OP_FIQ_DEPTH	16
+#define OP_FIQ_STACK	1024
+
+struct op_fiq_sample {
+	unsigned long pc;
+	unsigned int kernel;
+	unsigned int depth;
+	unsigned long trace[OP_FIQ_DEPTH];
+};
+
+struct op_fiq_buffer {
+	unsigned int head;		/* written by the FIQ only */
+	unsigned int tail;		/* written by the IRQ only */
+	unsigned int lost;		/* written by the FIQ only */
+	unsigned int lost_seen;
+	struct op_fiq_sample sample[OP_FIQ_SAMPLES];
+};
+
+static DEFINE_PER_CPU(struct op_fiq_buffer, op_fiq_buffer);
+
+static unsigned long op_fiq_stack[OP_FIQ_STACK / sizeof(unsigned long)]
+	__attribute__((aligned(8)));
+static struct op_fiq_sample *op_fiq_replay;
+static unsigned long op_fiq_period;
+static struct clk *op_fiq_tin;
+static struct clk *op_fiq_tdiv;
+
+extern unsigned char op_s3c24xx_fiq_start, op_s3c24xx_fiq_end;
+
+static struct fiq_handler op_fiq_handler = {
+	.name	= "oprofile",
+};
+
+/* TCON bits of the timer, as in arch/arm/plat-s3c/pwm.c */
+#define OP_FIQ_TCON_BASE	(OP_FIQ_TIMER ? OP_FIQ_TIMER * 4 + 4 : 0)
+#define OP_FIQ_TCON_START	(1 << (OP_FIQ_TCON_BASE + 0))
+#define OP_FIQ_TCON_MANUALUPD	(1 << (OP_FIQ_TCON_BASE + 1))
+#define OP_FIQ_TCON_RELOAD	(1 << (OP_FIQ_TCON_BASE + 3))
+
+#if defined(CONFIG_FRAME_POINTER) && !defined(CONFIG_ARM_UNWIND)
+static int notrace op_fiq_trace(struct stackframe *frame, void *d)
+{
+	struct op_fiq_sample *s = d;
+
+	s->trace[s->depth++] = frame->pc;
+	return s->depth == OP_FIQ_DEPTH;
+}
+#endif
+
+/*
+ * Called from the FIQ handler in op_model_s3c24xx_fiq.S, in FIQ mode and
+ * on its own stack, so this must not look at current or take any lock.
+ */
+asmlinkage void notrace op_s3c24xx_fiq_sample(struct pt_regs *regs)
+{
+	struct op_fiq_buffer *buf = &__get_cpu_var(op_fiq_buffer);
+	unsigned int head = buf->head;
+	struct op_fiq_sample *s;
+
+	/* leave the timer interrupt pending for s3c24xx_fiq_interrupt() */
+	s3c24xx_set_fiq(OP_FIQ_IRQ, false);
+
+	if (head - buf->tail >= OP_FIQ_SAMPLES) {
+		buf->lost++;
+		return;
+	}
+
+	s = &buf->sample[head & (OP_FIQ_SAMPLES - 1)];
+	s->pc = instruction_pointer(regs);
+	s->kernel = !user_mode(regs);
+	s->depth = 0;
+
+	/*
+	 * The stack can only be trusted in SVC mode, and a user stack
+	 * can't be read from a FIQ as it may fault. The unwind tables
+	 * are searched under a spinlock, so only frame pointers are used.
+	 */
+#if defined(CONFIG_FRAME_POINTER) && !defined(CONFIG_ARM_UNWIND)
+	if (processor_mode(regs) == SVC_MODE) {
+		struct stackframe frame;
+
+		frame.fp = regs->ARM_fp;
+		frame.sp = regs->ARM_sp;
+		frame.lr = regs->ARM_lr;
+		frame.pc = regs->ARM_pc;
+		walk_stackframe(&frame, op_fiq_trace, s);
+	}
+#endif
+
+	smp_wmb();
+	buf->head = head + 1;
+}
+
+static void s3c24xx_fiq_backtrace(struct pt_regs * const regs,
+				  unsigned int depth)
+{
+	struct op_fiq_sample *s = op_fiq_replay;
+	unsigned int i;
+
+	/* the first entry is the sampled pc itself */
+	for (i = 1; s && i < s->depth && i <= depth; i++)
+		oprofile_add_trace(s->trace[i]);
+}
+
+static irqreturn_t s3c24xx_fiq_interrupt(int irq, void *arg)
+{
+	struct op_fiq_buffer *buf = &__get_cpu_var(op_fiq_buffer);
+	unsigned int head = buf->head;
+	struct op_fiq_sample *s;
+
+	smp_rmb();
+	while (buf->tail != head) {
+		s = &buf->sample[buf->tail & (OP_FIQ_SAMPLES - 1)];
+
+		op_fiq_replay = s;
+		oprofile_add_ext_sample(s->pc, get_irq_regs(), 0, s->kernel);
+		op_fiq_replay = NULL;
+
+		smp_mb();
+		buf->tail++;
+	}
+
+	while (buf->lost_seen != buf->lost) {
+		oprofile_cpu_buffer_inc_smpl_lost();
+		buf->lost_seen++;
+	}
+
+	s3c24xx_set_fiq(OP_FIQ_IRQ, true);
+
+	return IRQ_HANDLED;
+}
+
+static int s3c24xx_fiq_setup_ctrs(void)
+{
+	unsigned long period = counter_config[0].count;
+
+	if (!period)
+		period = OP_FIQ_PERIOD;
+	if (period < OP_FIQ_MIN || period > USEC_PER_SEC)
+		return -EINVAL;
+
+	op_fiq_period = period;
+	return 0;
+}
+
+static int s3c24xx_fiq_timer_start(void)
+{
+	unsigned long rate, tcnt, tcon, flags;
+	unsigned int div;
+	int ret;
+
+	/* the slowest clock the timer can count the period in */
+	rate = clk_get_rate(clk_get_parent(op_fiq_tdiv));
+	for (div = 2; div <= 16; div *= 2) {
+		tcnt = div_u64((u64)(rate / div) * op_fiq_period,
+			       USEC_PER_SEC);
+		if (tcnt <= 0x10000)
+			break;
+	}
+	if (div > 16)
+		return -ERANGE;
+
+	ret = clk_set_rate(op_fiq_tdiv, rate / div);
+	if (!ret)
+		ret = clk_set_parent(op_fiq_tin, op_fiq_tdiv);
+	if (ret)
+		return ret;
+
+	tcnt = div_u64((u64)clk_get_rate(op_fiq_tin) * op_fiq_period,
+		       USEC_PER_SEC);
+	if (tcnt < 2)
+		return -ERANGE;
+
+	clk_enable(op_fiq_tin);
+
+	local_irq_save(flags);
+
+	/* timers reload after counting zero, so reduce the count by 1 */
+	__raw_writel(tcnt - 1, S3C2410_TCNTB(OP_FIQ_TIMER));
+	__raw_writel(0, S3C2410_TCMPB(OP_FIQ_TIMER));
+
+	tcon = __raw_readl(S3C2410_TCON);
+	tcon &= ~OP_FIQ_TCON_START;
+	tcon |= OP_FIQ_TCON_RELOAD | OP_FIQ_TCON_MANUALUPD;
+	__raw_writel(tcon, S3C2410_TCON);
+
+	tcon &= ~OP_FIQ_TCON_MANUALUPD;
+	tcon |= OP_FIQ_TCON_START;
+	__raw_writel(tcon, S3C2410_TCON);
+
+	local_irq_restore(flags);
+
+	return 0;
+}
+
+static void s3c24xx_fiq_timer_stop(void)
+{
+	unsigned long tcon, flags;
+
+	local_irq_save(flags);
+
+	tcon = __raw_readl(S3C2410_TCON);
+	tcon &= ~(OP_FIQ_TCON_START | OP_FIQ_TCON_RELOAD);
+	__raw_writel(tcon, S3C2410_TCON);
+
+	local_irq_restore(flags);
+
+	clk_disable(op_fiq_tin);
+}
+
+static int s3c24xx_fiq_start(void)
+{
+	struct op_fiq_buffer *buf = &__get_cpu_var(op_fiq_buffer);
+	struct pt_regs regs;
+	int ret;
+
+	ret = claim_fiq(&op_fiq_handler);
+	if (ret) {
+		printk(KERN_ERR "oprofile: unable to claim the FIQ\n");
+		return ret;
+	}
+
+	buf->head = buf->tail = 0;
+	buf->lost = buf->lost_seen = 0;
+
+	set_fiq_handler(&op_s3c24xx_fiq_start,
+			&op_s3c24xx_fiq_end - &op_s3c24xx_fiq_start);
+	memset(&regs, 0, sizeof(regs));
+	regs.ARM_sp = (unsigned long)op_fiq_stack + sizeof(op_fiq_stack);
+	set_fiq_regs(&regs);
+
+	ret = request_irq(OP_FIQ_IRQ, s3c24xx_fiq_interrupt, IRQF_DISABLED,
+			  "oprofile", NULL);
+	if (ret < 0) {
+		printk(KERN_ERR "oprofile: unable to request IRQ%d for "
+		       "PWM timer %d\n", OP_FIQ_IRQ, OP_FIQ_TIMER);
+		goto err_release;
+	}
+
+	s3c24xx_set_fiq(OP_FIQ_IRQ, true);
+
+	ret = s3c24xx_fiq_timer_start();
+	if (ret)
+		goto err_free;
+
+	return 0;
+
+err_free:
+	free_irq(OP_FIQ_IRQ, NULL);
+	s3c24xx_set_fiq(OP_FIQ_IRQ, false);
+err_release:
+	release_fiq(&op_fiq_handler);
+	return ret;
+}
+
+static void s3c24xx_fiq_stop(void)
+{
+	s3c24xx_fiq_timer_stop();
+	free_irq(OP_FIQ_IRQ, NULL);
+	s3c24xx_set_fiq(OP_FIQ_IRQ, false);
+	release_fiq(&op_fiq_handler);
+}
+
+static int s3c24xx_fiq_init(void)
+{
+	struct platform_device tmpdev;
+
+	memset(&tmpdev, 0, sizeof(tmpdev));
+	tmpdev.dev.bus = &platform_bus_type;
+	tmpdev.id = OP_FIQ_TIMER;
+
+	op_fiq_tin = clk_get(&tmpdev.dev, "pwm-tin");
+	if (IS_ERR(op_fiq_tin))
+		return PTR_ERR(op_fiq_tin);
+
+	op_fiq_tdiv = clk_get(&tmpdev.dev, "pwm-tdiv");
+	if (IS_ERR(op_fiq_tdiv)) {
+		clk_put(op_fiq_tin);
+		return PTR_ERR(op_fiq_tdiv);
+	}
+
+	op_fiq_period = OP_FIQ_PERIOD;
+	printk(KERN_INFO "oprofile: FIQ sampling on PWM timer %d\n",
+	       OP_FIQ_TIMER);
+	return 0;
+}
+
+struct op_arm_model_spec op_s3c24xx_fiq_spec = {
+	.init		= s3c24xx_fiq_init,
+	.num_counters	= 1,
+	.setup_ctrs	= s3c24xx_fiq_setup_ctrs,
+	.start		= s3c24xx_fiq_start,
+	.stop		= s3c24xx_fiq_stop,
+	.backtrace	= s3c24xx_fiq_backtrace,
+	.name		= "timer",
+};
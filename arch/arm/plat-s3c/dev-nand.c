@@ -10,6 +10,7 @@
 #include <linux/platform_device.h>
 
 #include <mach/map.h>
+#include <mach/irqs.h>
 #include <plat/devs.h>
 
 static struct resource s3c_nand_resource[] = {
@@ -17,7 +18,14 @@ static struct resource s3c_nand_resource[] = {
 		.start = S3C_PA_NAND,
 		.end   = S3C_PA_NAND + SZ_1M,
 		.flags = IORESOURCE_MEM,
-	}
+	},
+#ifdef CONFIG_PLAT_S3C24XX
+	[1] = {
+		.start = IRQ_NFCON,
+		.end   = IRQ_NFCON,
+		.flags = IORESOURCE_IRQ,
+	},
+#endif
 };
 
 struct platform_device s3c_device_nand = {
@@ -17,6 +17,7 @@
  *			Setting this flag will allow the kernel to
  *			look for it at boot time and also skip the NAND
  *			scan.
+ * @cache_read:		The chips support sequential cache reads (31h/3Fh)
  * @nr_chips:		Number of chips in this set
  * @nr_partitions:	Number of partitions pointed to by @partitions
  * @name:		Name of set (optional)
@@ -30,6 +31,7 @@
 struct s3c2410_nand_set {
 	unsigned int		disable_ecc:1;
 	unsigned int		flash_bbt:1;
+	unsigned int		cache_read:1;
 
 	int			nr_chips;
 	int			nr_partitions;
@@ -529,6 +529,28 @@ s3c2410_dma_freebuf(struct s3c2410_dma_buf *buf)
 	}
 }
 
+/* s3c2410_dma_requeue
+ *
+ * put a finished buffer back on the end of the queue of a circular
+ * channel, so that the buffers are loaded round and round through the
+ * auto-reload without the client having to queue them again.
+*/
+
+static inline void
+s3c2410_dma_requeue(struct s3c2410_dma_chan *chan, struct s3c2410_dma_buf *buf)
+{
+	if (chan->curr == NULL) {
+		chan->curr = buf;
+		chan->end  = buf;
+	} else {
+		chan->end->next = buf;
+		chan->end = buf;
+	}
+
+	if (chan->next == NULL)
+		chan->next = buf;
+}
+
 /* s3c2410_dma_lastxfer
  *
  * called when the system is out of buffers, to ensure that the channel
@@ -643,8 +665,12 @@ s3c2410_dma_irq(int irq, void *devpw)
 
 		s3c2410_dma_buffdone(chan, buf, S3C2410_RES_OK);
 
-		/* free resouces */
-		s3c2410_dma_freebuf(buf);
+		/* free resouces, circular channels keep them until flushed */
+		if ((chan->flags & S3C2410_DMAF_CIRCULAR) &&
+		    chan->state != S3C2410_DMA_IDLE)
+			s3c2410_dma_requeue(chan, buf);
+		else
+			s3c2410_dma_freebuf(buf);
 	} else {
 	}
 
@@ -810,6 +836,7 @@ int s3c2410_dma_free(unsigned int channel, struct s3c2410_dma_client *client)
 
 	chan->client = NULL;
 	chan->in_use = 0;
+	chan->flags &= ~S3C2410_DMAF_CIRCULAR;
 
 	if (chan->irq_claimed)
 		free_irq(chan->irq, (void *)chan);
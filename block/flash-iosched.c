@@ -0,0 +1,565 @@
+/*
+ *  Flash I/O scheduler, for SD and MMC cards.
+ *
+ *  Based on the deadline scheduler,
+ *  Copyright (C) 2002 Jens Axboe <axboe@kernel.dk>
+ *
+ *  The flash translation layer of a memory card writes whole allocation
+ *  units (AUs), typically 512KB to 4MB erase blocks. Writes that fill an
+ *  AU from start to end are fast. Small writes that hop between AUs
+ *  force the card to copy and erase partially written units, and this
+ *  is where the long write latencies of cheap cards come from.
+ *
+ *  Reads cost nothing to reorder on flash, so this scheduler:
+ *
+ *  - dispatches reads in arrival order and ahead of writes, except that
+ *    a write goes out after writes_starved reads if writes are waiting;
+ *  - holds asynchronous writes back for up to write_hold, or until an AU
+ *    worth of them is queued, so that writes from several streams can be
+ *    gathered per AU;
+ *  - dispatches writes one AU at a time in ascending sector order,
+ *    preferring the AU written last (the one the card has open), then
+ *    the AU with the most data queued, unless the oldest write has waited
+ *    for write_expire.
+ *
+ *  The AU size comes from the optimal I/O size the driver sets for the
+ *  queue, which the MMC block driver takes from the card registers. It
+ *  can be overridden with au_size_kb.
+ *
+ *  See Documentation/block/flash-iosched.txt
+ */
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/blkdev.h>
+#include <linux/elevator.h>
+#include <linux/bio.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/init.h>
+#include <linux/compiler.h>
+#include <linux/rbtree.h>
+#include <linux/timer.h>
+#include <linux/workqueue.h>
+
+static const int write_hold = HZ / 20;	/* max time to gather writes */
+static const int write_expire = HZ;	/* max time before a write is taken
+					   out of its AU order */
+static const int writes_starved = 16;	/* max reads dispatched while
+					   writes wait */
+static const unsigned int default_au_sectors = 8192;	/* 4MB */
+
+struct flash_data {
+	struct request_queue *q;
+
+	/*
+	 * requests are present on both sort_list and fifo_list
+	 */
+	struct rb_root sort_list[2];
+	struct list_head fifo_list[2];
+
+	/*
+	 * next write of the AU being written, or NULL between AUs
+	 */
+	struct request *next_write;
+	sector_t last_au;		/* AU written last */
+	unsigned int starved;		/* reads dispatched while writes wait */
+
+	struct timer_list hold_timer;	/* ends the hold on writes */
+	struct work_struct unplug_work;
+
+	/*
+	 * settings that change how the i/o scheduler behaves
+	 */
+	unsigned int au_sectors;	/* 0: use the queue optimal I/O size */
+	int write_hold;
+	int write_expire;
+	int writes_starved;
+	int front_merges;
+};
+
+static inline struct rb_root *
+flash_rb_root(struct flash_data *fd, struct request *rq)
+{
+	return &fd->sort_list[rq_data_dir(rq)];
+}
+
+static unsigned int flash_au_sectors(struct flash_data *fd)
+{
+	if (fd->au_sectors)
+		return fd->au_sectors;
+	if (queue_io_opt(fd->q) >= 512)
+		return queue_io_opt(fd->q) >> 9;
+	return default_au_sectors;
+}
+
+/*
+ * the AU the request starts in
+ */
+static inline sector_t flash_au(struct request *rq, unsigned int au_sectors)
+{
+	sector_t au = blk_rq_pos(rq);
+
+	sector_div(au, au_sectors);
+	return au;
+}
+
+/*
+ * the queued write after @rq in the same AU, if any
+ */
+static struct request *
+flash_next_in_au(struct flash_data *fd, struct request *rq)
+{
+	unsigned int au_sectors = flash_au_sectors(fd);
+	struct rb_node *node = rb_next(&rq->rb_node);
+	struct request *next;
+
+	if (!node)
+		return NULL;
+
+	next = rb_entry_rq(node);
+	if (flash_au(next, au_sectors) != flash_au(rq, au_sectors))
+		return NULL;
+	return next;
+}
+
+/*
+ * the first queued write in the AU of @rq
+ */
+static struct request *
+flash_first_in_au(struct flash_data *fd, struct request *rq)
+{
+	unsigned int au_sectors = flash_au_sectors(fd);
+	sector_t au = flash_au(rq, au_sectors);
+	struct rb_node *node;
+
+	while ((node = rb_prev(&rq->rb_node)) != NULL &&
+	       flash_au(rb_entry_rq(node), au_sectors) == au)
+		rq = rb_entry_rq(node);
+
+	return rq;
+}
+
+static void flash_move_to_dispatch(struct flash_data *, struct request *);
+
+static void
+flash_add_rq_rb(struct flash_data *fd, struct request *rq)
+{
+	struct rb_root *root = flash_rb_root(fd, rq);
+	struct request *__alias;
+
+	while (unlikely(__alias = elv_rb_add(root, rq)))
+		flash_move_to_dispatch(fd, __alias);
+}
+
+static inline void
+flash_del_rq_rb(struct flash_data *fd, struct request *rq)
+{
+	if (fd->next_write == rq)
+		fd->next_write = flash_next_in_au(fd, rq);
+
+	elv_rb_del(flash_rb_root(fd, rq), rq);
+}
+
+/*
+ * add rq to rbtree and fifo
+ */
+static void
+flash_add_request(struct request_queue *q, struct request *rq)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	const int data_dir = rq_data_dir(rq);
+
+	flash_add_rq_rb(fd, rq);
+
+	/*
+	 * the fifo time is the arrival time, the hold and expiry are
+	 * measured from it
+	 */
+	rq_set_fifo_time(rq, jiffies);
+	list_add_tail(&rq->queuelist, &fd->fifo_list[data_dir]);
+}
+
+/*
+ * remove rq from rbtree and fifo.
+ */
+static void flash_remove_request(struct request_queue *q, struct request *rq)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+
+	rq_fifo_clear(rq);
+	flash_del_rq_rb(fd, rq);
+}
+
+static int
+flash_merge(struct request_queue *q, struct request **req, struct bio *bio)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	struct request *__rq;
+
+	/*
+	 * check for front merge
+	 */
+	if (fd->front_merges) {
+		sector_t sector = bio->bi_sector + bio_sectors(bio);
+
+		__rq = elv_rb_find(&fd->sort_list[bio_data_dir(bio)], sector);
+		if (__rq) {
+			BUG_ON(sector != blk_rq_pos(__rq));
+
+			if (elv_rq_merge_ok(__rq, bio)) {
+				*req = __rq;
+				return ELEVATOR_FRONT_MERGE;
+			}
+		}
+	}
+
+	return ELEVATOR_NO_MERGE;
+}
+
+static void flash_merged_request(struct request_queue *q,
+				 struct request *req, int type)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+
+	/*
+	 * if the merge was a front merge, we need to reposition request
+	 */
+	if (type == ELEVATOR_FRONT_MERGE) {
+		if (fd->next_write == req)
+			fd->next_write = NULL;
+		elv_rb_del(flash_rb_root(fd, req), req);
+		flash_add_rq_rb(fd, req);
+	}
+}
+
+static void
+flash_merged_requests(struct request_queue *q, struct request *req,
+		      struct request *next)
+{
+	/*
+	 * if next arrived before rq, rq takes over its arrival time and
+	 * its place in the fifo
+	 */
+	if (!list_empty(&req->queuelist) && !list_empty(&next->queuelist)) {
+		if (time_before(rq_fifo_time(next), rq_fifo_time(req))) {
+			list_move(&req->queuelist, &next->queuelist);
+			rq_set_fifo_time(req, rq_fifo_time(next));
+		}
+	}
+
+	/*
+	 * kill knowledge of next, this one is a goner
+	 */
+	flash_remove_request(q, next);
+}
+
+/*
+ * move request from sort list to dispatch queue.
+ */
+static void
+flash_move_to_dispatch(struct flash_data *fd, struct request *rq)
+{
+	struct request_queue *q = rq->q;
+
+	if (rq_data_dir(rq) == WRITE) {
+		fd->last_au = flash_au(rq, flash_au_sectors(fd));
+		fd->next_write = flash_next_in_au(fd, rq);
+	}
+
+	flash_remove_request(q, rq);
+	elv_dispatch_add_tail(q, rq);
+}
+
+/*
+ * Pick the write that starts the next AU, or return NULL if writes are
+ * held back to gather more of them.
+ */
+static struct request *flash_choose_write(struct flash_data *fd, int force)
+{
+	unsigned int au_sectors = flash_au_sectors(fd);
+	struct request *oldest, *rq, *best = NULL, *first = NULL;
+	unsigned long total = 0, queued = 0, best_queued = 0;
+	sector_t au = 0;
+	struct rb_node *node;
+	int sync = 0, best_is_last = 0;
+
+	oldest = rq_entry_fifo(fd->fifo_list[WRITE].next);
+	if (time_after_eq(jiffies, rq_fifo_time(oldest) + fd->write_expire))
+		return flash_first_in_au(fd, oldest);
+
+	/*
+	 * the writes of an AU are next to each other in sector order, find
+	 * the AU written last or else the one with the most data queued
+	 */
+	for (node = rb_first(&fd->sort_list[WRITE]); node;
+	     node = rb_next(node)) {
+		rq = rb_entry_rq(node);
+		if (!first || flash_au(rq, au_sectors) != au) {
+			first = rq;
+			au = flash_au(rq, au_sectors);
+			queued = 0;
+		}
+
+		queued += blk_rq_sectors(rq);
+		total += blk_rq_sectors(rq);
+		sync |= rq_is_sync(rq);
+
+		if (best == first) {
+			best_queued = queued;
+		} else if (!best || au == fd->last_au ||
+			   (!best_is_last && queued > best_queued)) {
+			best = first;
+			best_queued = queued;
+			best_is_last = au == fd->last_au;
+		}
+	}
+
+	if (force || sync || total >= au_sectors)
+		return best;
+
+	if (time_before(jiffies, rq_fifo_time(oldest) + fd->write_hold)) {
+		mod_timer(&fd->hold_timer,
+			  rq_fifo_time(oldest) + fd->write_hold);
+		return NULL;
+	}
+
+	return best;
+}
+
+/*
+ * flash_dispatch_requests selects the next request: reads first, then
+ * writes one AU at a time
+ */
+static int flash_dispatch_requests(struct request_queue *q, int force)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	const int reads = !list_empty(&fd->fifo_list[READ]);
+	const int writes = !list_empty(&fd->fifo_list[WRITE]);
+	struct request *rq;
+
+	if (reads && (!writes || fd->starved < fd->writes_starved)) {
+		if (writes)
+			fd->starved++;
+		rq = rq_entry_fifo(fd->fifo_list[READ].next);
+		goto dispatch_request;
+	}
+
+	if (!writes)
+		return 0;
+
+	rq = fd->next_write;
+	if (!rq) {
+		rq = flash_choose_write(fd, force);
+		if (!rq) {
+			/* writes are being held, a read may still go */
+			if (!reads)
+				return 0;
+			rq = rq_entry_fifo(fd->fifo_list[READ].next);
+			goto dispatch_request;
+		}
+	}
+
+	fd->starved = 0;
+
+dispatch_request:
+	flash_move_to_dispatch(fd, rq);
+
+	return 1;
+}
+
+static int flash_queue_empty(struct request_queue *q)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+
+	return list_empty(&fd->fifo_list[WRITE])
+		&& list_empty(&fd->fifo_list[READ]);
+}
+
+/*
+ * The hold on writes is over, run the queue from kblockd so that the
+ * driver picks them up.
+ */
+static void flash_hold_timeout(unsigned long data)
+{
+	struct flash_data *fd = (struct flash_data *)data;
+
+	kblockd_schedule_work(fd->q, &fd->unplug_work);
+}
+
+static void flash_kick_queue(struct work_struct *work)
+{
+	struct flash_data *fd =
+		container_of(work, struct flash_data, unplug_work);
+
+	blk_run_queue(fd->q);
+}
+
+static void flash_exit_queue(struct elevator_queue *e)
+{
+	struct flash_data *fd = e->elevator_data;
+
+	del_timer_sync(&fd->hold_timer);
+	cancel_work_sync(&fd->unplug_work);
+
+	BUG_ON(!list_empty(&fd->fifo_list[READ]));
+	BUG_ON(!list_empty(&fd->fifo_list[WRITE]));
+
+	kfree(fd);
+}
+
+/*
+ * initialize elevator private data (flash_data).
+ */
+static void *flash_init_queue(struct request_queue *q)
+{
+	struct flash_data *fd;
+
+	fd = kmalloc_node(sizeof(*fd), GFP_KERNEL | __GFP_ZERO, q->node);
+	if (!fd)
+		return NULL;
+
+	fd->q = q;
+	INIT_LIST_HEAD(&fd->fifo_list[READ]);
+	INIT_LIST_HEAD(&fd->fifo_list[WRITE]);
+	fd->sort_list[READ] = RB_ROOT;
+	fd->sort_list[WRITE] = RB_ROOT;
+	setup_timer(&fd->hold_timer, flash_hold_timeout, (unsigned long)fd);
+	INIT_WORK(&fd->unplug_work, flash_kick_queue);
+	fd->write_hold = write_hold;
+	fd->write_expire = write_expire;
+	fd->writes_starved = writes_starved;
+	fd->front_merges = 1;
+	return fd;
+}
+
+/*
+ * sysfs parts below
+ */
+
+static ssize_t
+flash_var_show(int var, char *page)
+{
+	return sprintf(page, "%d\n", var);
+}
+
+static ssize_t
+flash_var_store(int *var, const char *page, size_t count)
+{
+	char *p = (char *) page;
+
+	*var = simple_strtol(p, &p, 10);
+	return count;
+}
+
+#define SHOW_FUNCTION(__FUNC, __VAR, __CONV)				\
+static ssize_t __FUNC(struct elevator_queue *e, char *page)		\
+{									\
+	struct flash_data *fd = e->elevator_data;			\
+	int __data = __VAR;						\
+	if (__CONV)							\
+		__data = jiffies_to_msecs(__data);			\
+	return flash_var_show(__data, (page));				\
+}
+SHOW_FUNCTION(flash_write_hold_show, fd->write_hold, 1);
+SHOW_FUNCTION(flash_write_expire_show, fd->write_expire, 1);
+SHOW_FUNCTION(flash_writes_starved_show, fd->writes_starved, 0);
+SHOW_FUNCTION(flash_front_merges_show, fd->front_merges, 0);
+SHOW_FUNCTION(flash_au_size_kb_show, flash_au_sectors(fd) / 2, 0);
+#undef SHOW_FUNCTION
+
+#define STORE_FUNCTION(__FUNC, __PTR, MIN, MAX, __CONV)			\
+static ssize_t __FUNC(struct elevator_queue *e, const char *page, size_t count)	\
+{									\
+	struct flash_data *fd = e->elevator_data;			\
+	int __data;							\
+	int ret = flash_var_store(&__data, (page), count);		\
+	if (__data < (MIN))						\
+		__data = (MIN);						\
+	else if (__data > (MAX))					\
+		__data = (MAX);						\
+	if (__CONV)							\
+		*(__PTR) = msecs_to_jiffies(__data);			\
+	else								\
+		*(__PTR) = __data;					\
+	return ret;							\
+}
+STORE_FUNCTION(flash_write_hold_store, &fd->write_hold, 0, INT_MAX, 1);
+STORE_FUNCTION(flash_write_expire_store, &fd->write_expire, 0, INT_MAX, 1);
+STORE_FUNCTION(flash_writes_starved_store, &fd->writes_starved, 0, INT_MAX, 0);
+STORE_FUNCTION(flash_front_merges_store, &fd->front_merges, 0, 1, 0);
+#undef STORE_FUNCTION
+
+/*
+ * The AU size in KB, 0 goes back to the size reported by the driver.
+ * Changing it ends the AU being written.
+ */
+static ssize_t
+flash_au_size_kb_store(struct elevator_queue *e, const char *page,
+		       size_t count)
+{
+	struct flash_data *fd = e->elevator_data;
+	int kb;
+	int ret = flash_var_store(&kb, page, count);
+
+	if (kb < 0)
+		kb = 0;
+	else if (kb > INT_MAX / 2)
+		kb = INT_MAX / 2;
+
+	spin_lock_irq(fd->q->queue_lock);
+	fd->au_sectors = kb * 2;
+	fd->next_write = NULL;
+	spin_unlock_irq(fd->q->queue_lock);
+
+	return ret;
+}
+
+#define FD_ATTR(name) \
+	__ATTR(name, S_IRUGO|S_IWUSR, flash_##name##_show, \
+				      flash_##name##_store)
+
+static struct elv_fs_entry flash_attrs[] = {
+	FD_ATTR(au_size_kb),
+	FD_ATTR(write_hold),
+	FD_ATTR(write_expire),
+	FD_ATTR(writes_starved),
+	FD_ATTR(front_merges),
+	__ATTR_NULL
+};
+
+static struct elevator_type iosched_flash = {
+	.ops = {
+		.elevator_merge_fn = 		flash_merge,
+		.elevator_merged_fn =		flash_merged_request,
+		.elevator_merge_req_fn =	flash_merged_requests,
+		.elevator_dispatch_fn =		flash_dispatch_requests,
+		.elevator_add_req_fn =		flash_add_request,
+		.elevator_queue_empty_fn =	flash_queue_empty,
+		.elevator_former_req_fn =	elv_rb_former_request,
+		.elevator_latter_req_fn =	elv_rb_latter_request,
+		.elevator_init_fn =		flash_init_queue,
+		.elevator_exit_fn =		flash_exit_queue,
+	},
+
+	.elevator_attrs = flash_attrs,
+	.elevator_name = "flash",
+	.elevator_owner = THIS_MODULE,
+};
+
+static int __init flash_init(void)
+{
+	elv_register(&iosched_flash);
+
+	return 0;
+}
+
+static void __exit flash_exit(void)
+{
+	elv_unregister(&iosched_flash);
+}
+
+module_init(flash_init);
+module_exit(flash_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("flash memory card IO scheduler");
@@ -1,3 +1,4 @@
+#include <linux/async.h>
 
 /**
  * struct bus_type_private - structure to hold the private to the driver core portions of the bus_type structure.
@@ -33,6 +34,7 @@ struct driver_private {
 	struct klist_node knode_bus;
 	struct module_kobject *mkobj;
 	struct device_driver *driver;
+	async_cookie_t attach_cookie;
 };
 #define to_driver(obj) container_of(obj, struct driver_private, kobj)
 
@@ -117,6 +119,8 @@ extern void bus_remove_driver(struct device_driver *drv);
 
 extern void driver_detach(struct device_driver *drv);
 extern int driver_probe_device(struct device_driver *drv, struct device *dev);
+extern int driver_attach_boot(struct device_driver *drv);
+extern void driver_attach_wait(struct device_driver *drv);
 static inline int driver_match_device(struct device_driver *drv,
 				      struct device *dev)
 {
@@ -24,10 +24,17 @@
 #include <linux/wait.h>
 #include <linux/async.h>
 #include <linux/pm_runtime.h>
+#include <linux/ktime.h>
 
 #include "base.h"
 #include "power/power.h"
 
+extern int initcall_debug;
+
+/* set to 0 on the command line to probe every driver synchronously */
+static int driver_async_probe = 1;
+core_param(driver_async_probe, driver_async_probe, bool, 0644);
+
 
 static void driver_bound(struct device *dev)
 {
@@ -103,8 +110,12 @@ static DECLARE_WAIT_QUEUE_HEAD(probe_waitqueue);
 
 static int really_probe(struct device *dev, struct device_driver *drv)
 {
+	ktime_t calltime = ktime_set(0, 0);
 	int ret = 0;
 
+	if (initcall_debug)
+		calltime = ktime_get();
+
 	atomic_inc(&probe_count);
 	pr_debug("bus: '%s': %s: probing driver %s with device %s\n",
 		 drv->bus->name, __func__, drv->name, dev_name(dev));
@@ -150,6 +161,11 @@ probe_failed:
 	 */
 	ret = 0;
 done:
+	/* initcall_debug can be switched on while we probe */
+	if (initcall_debug && calltime.tv64)
+		printk("probe of %s by %s %s after %Ld usecs\n",
+		       dev_name(dev), drv->name, ret ? "bound" : "failed",
+		       (long long)ktime_us_delta(ktime_get(), calltime));
 	atomic_dec(&probe_count);
 	wake_up(&probe_waitqueue);
 	return ret;
@@ -302,6 +318,50 @@ int driver_attach(struct device_driver *drv)
 }
 EXPORT_SYMBOL_GPL(driver_attach);
 
+static void driver_attach_async(void *data, async_cookie_t cookie)
+{
+	struct device_driver *drv = data;
+
+	if (driver_attach(drv))
+		printk(KERN_ERR "%s: attaching %s failed\n", __func__,
+		       drv->name);
+}
+
+/**
+ * driver_attach_boot - bind a newly registered driver to its devices.
+ * @drv: driver.
+ *
+ * While the kernel boots, drivers that set probe_async are bound from
+ * an async thread, so that their probes overlap with each other and
+ * with the initcalls that follow. Everything that needs the devices
+ * waits for them with wait_for_device_probe() or async_synchronize_full(),
+ * as the root mount and the freeing of the init sections already do.
+ * Other drivers, and all drivers once the kernel has booted, are bound
+ * synchronously by driver_attach().
+ */
+int driver_attach_boot(struct device_driver *drv)
+{
+	if (!drv->probe_async || !driver_async_probe ||
+	    system_state != SYSTEM_BOOTING)
+		return driver_attach(drv);
+
+	drv->p->attach_cookie = async_schedule(driver_attach_async, drv);
+	return 0;
+}
+
+/**
+ * driver_attach_wait - wait for driver_attach_boot() to finish.
+ * @drv: driver.
+ *
+ * Called before a driver is unbound from its devices, so that it is
+ * never removed while it is still being probed from an async thread.
+ */
+void driver_attach_wait(struct device_driver *drv)
+{
+	if (drv->p->attach_cookie)
+		async_synchronize_cookie(drv->p->attach_cookie + 1);
+}
+
 /*
  * __device_release_driver() must be called with @dev->sem held.
  * When called for a USB interface, @dev->parent->sem must be held as well.
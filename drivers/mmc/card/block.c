@@ -469,6 +469,19 @@ static inline int mmc_blk_readonly(struct mmc_card *card)
 	       !(card->csd.cmdclass & CCC_BLOCK_WRITE);
 }
 
+/*
+ * Size of the card's allocation unit (erase block) in sectors, or 0 if
+ * the card does not tell.
+ */
+static unsigned int mmc_blk_erase_size(struct mmc_card *card)
+{
+	if (mmc_card_sd(card))
+		return card->ssr.au;
+	if (card->ext_csd.hc_erase_size)
+		return card->ext_csd.hc_erase_size;
+	return card->csd.erase_size;
+}
+
 static struct mmc_blk_data *mmc_blk_alloc(struct mmc_card *card)
 {
 	struct mmc_blk_data *md;
@@ -531,6 +544,14 @@ static struct mmc_blk_data *mmc_blk_alloc(struct mmc_card *card)
 
 	blk_queue_logical_block_size(md->queue.queue, 512);
 
+	/*
+	 * Writes aligned to the allocation unit are much faster, let the
+	 * I/O scheduler and mkfs tools know about it.
+	 */
+	if (mmc_blk_erase_size(card))
+		blk_queue_io_opt(md->queue.queue,
+				 mmc_blk_erase_size(card) << 9);
+
 	if (!mmc_card_sd(card) && mmc_card_blockaddr(card)) {
 		/*
 		 * The EXT_CSD sector count is in number or 512 byte
@@ -150,6 +150,13 @@ static int mmc_decode_csd(struct mmc_card *card)
 	csd->write_blkbits = UNSTUFF_BITS(resp, 22, 4);
 	csd->write_partial = UNSTUFF_BITS(resp, 21, 1);
 
+	/* erase group, in write blocks */
+	e = UNSTUFF_BITS(resp, 42, 5);
+	m = UNSTUFF_BITS(resp, 37, 5);
+	csd->erase_size = (e + 1) * (m + 1);
+	if (csd->write_blkbits >= 9)
+		csd->erase_size <<= csd->write_blkbits - 9;
+
 	return 0;
 }
 
@@ -247,6 +254,15 @@ static int mmc_read_ext_csd(struct mmc_card *card)
 		if (sa_shift > 0 && sa_shift <= 0x17)
 			card->ext_csd.sa_timeout =
 					1 << ext_csd[EXT_CSD_S_A_TIMEOUT];
+
+		/*
+		 * high capacity erase group, in units of 512KB; it only
+		 * applies once ERASE_GROUP_DEF is set, otherwise the card
+		 * still erases in the groups the CSD describes
+		 */
+		if (ext_csd[EXT_CSD_ERASE_GROUP_DEF] & 1)
+			card->ext_csd.hc_erase_size =
+				ext_csd[EXT_CSD_HC_ERASE_GRP_SIZE] << 10;
 	}
 
 out:
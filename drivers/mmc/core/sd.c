@@ -181,6 +181,54 @@ static int mmc_decode_scr(struct mmc_card *card)
 	return 0;
 }
 
+/*
+ * AU_SIZE of the SD status in sectors: 16KB to 4MB, then the sizes
+ * added by SD 3.0, 8MB to 64MB.
+ */
+static const unsigned int sd_au_size[] = {
+	0,	32,	64,	128,	256,	512,	1024,	2048,
+	4096,	8192,	16384,	24576,	32768,	49152,	65536,	131072,
+};
+
+/*
+ * Fetches and decodes the SD status, of which only the allocation
+ * unit size is of interest. It is only a hint, so failing to read it
+ * is not an error.
+ */
+static int mmc_read_ssr(struct mmc_card *card)
+{
+	int err, i;
+	u32 *ssr;
+
+	if (!(card->csd.cmdclass & CCC_APP_SPEC))
+		return 0;
+
+	ssr = kmalloc(64, GFP_KERNEL);
+	if (!ssr)
+		return -ENOMEM;
+
+	err = mmc_app_sd_status(card, ssr);
+	if (err) {
+		printk(KERN_WARNING "%s: problem reading SD Status "
+			"register.\n", mmc_hostname(card->host));
+		err = 0;
+		goto out;
+	}
+
+	for (i = 0; i < 16; i++)
+		ssr[i] = be32_to_cpu(ssr[i]);
+
+	/*
+	 * UNSTUFF_BITS only works with four u32s, so the bit position of
+	 * AU_SIZE (bits 431:428 of 512) is taken relative to word 2.
+	 */
+	card->ssr.au = sd_au_size[UNSTUFF_BITS(ssr, 428 - 384, 4)];
+
+out:
+	kfree(ssr);
+	return err;
+}
+
 /*
  * Fetches and decodes switch information
  */
@@ -440,6 +488,13 @@ static int mmc_sd_init_card(struct mmc_host *host, u32 ocr,
 		if (err < 0)
 			goto free_card;
 
+		/*
+		 * Fetch the allocation unit size from the SD status.
+		 */
+		err = mmc_read_ssr(card);
+		if (err)
+			goto free_card;
+
 		/*
 		 * Fetch switch information from card.
 		 */
@@ -1908,6 +1908,7 @@ static struct platform_driver s3cmci_driver = {
 		.name	= "s3c-sdi",
 		.owner	= THIS_MODULE,
 		.pm	= s3cmci_pm_ops,
+		.probe_async = true,
 	},
 	.id_table	= s3cmci_driver_ids,
 	.probe		= s3cmci_probe,
@@ -7,10 +7,12 @@
 #include <linux/fs.h>
 #include <linux/mm.h>
 #include <linux/err.h>
+#include <linux/highmem.h>
 #include <linux/init.h>
 #include <linux/kernel.h>
 #include <linux/module.h>
 #include <linux/slab.h>
+#include <linux/vmalloc.h>
 #include <linux/sched.h>
 #include <linux/smp_lock.h>
 #include <linux/backing-dev.h>
@@ -132,20 +134,182 @@ static int mtd_close(struct inode *inode, struct file *file)
 	return 0;
 } /* mtd_close */
 
-/* FIXME: This _really_ needs to die. In 2.5, we should lock the
-   userspace buffer down and use it directly with readv/writev.
-*/
+/*
+ * Transfers to and from page aligned user buffers are done in place:
+ * the user pages are pinned and mapped into one kernel range, which is
+ * handed to the MTD driver, MTD_MAP_PAGES at a time. Anything else, and
+ * any chunk whose pages can't be pinned or mapped (VM_IO mappings, say),
+ * goes through a kernel bounce buffer of at most MAX_KMALLOC_SIZE, or less
+ * if memory is too fragmented for that.
+ */
 #define MAX_KMALLOC_SIZE 0x20000
+#define MTD_MAP_PAGES	128
+
+struct mtd_user_map {
+	struct page	**pages;
+	int		nr;
+	void		*addr;
+};
+
+static int mtd_can_map_user(struct mtd_file_info *mfi, const void __user *buf,
+			    size_t count)
+{
+	if (mfi->mode != MTD_MODE_NORMAL && mfi->mode != MTD_MODE_RAW)
+		return 0;
+
+	return count >= PAGE_SIZE && !offset_in_page(buf);
+}
+
+static void *mtd_map_user(struct mtd_user_map *map, const void __user *buf,
+			  size_t len, int write)
+{
+	unsigned long uaddr = (unsigned long)buf;
+	int n = DIV_ROUND_UP(offset_in_page(uaddr) + len, PAGE_SIZE);
+	int got, err;
+
+	got = get_user_pages_fast(uaddr & PAGE_MASK, n, write, map->pages);
+	if (got < n)
+		goto out_put;
+
+	map->addr = vmap(map->pages, n, VM_MAP, PAGE_KERNEL);
+	if (!map->addr)
+		goto out_put;
+
+	map->nr = n;
+	return map->addr + offset_in_page(uaddr);
+
+out_put:
+	err = got < 0 ? got : got < n ? -EFAULT : -ENOMEM;
+	while (got > 0)
+		put_page(map->pages[--got]);
+	return ERR_PTR(err);
+}
+
+static void mtd_unmap_user(struct mtd_user_map *map, int dirty)
+{
+	int i;
+
+	/* also writes back whatever the driver left in the cache */
+	vunmap(map->addr);
+
+	for (i = 0; i < map->nr; i++) {
+		if (dirty) {
+			flush_dcache_page(map->pages[i]);
+			set_page_dirty_lock(map->pages[i]);
+		}
+		put_page(map->pages[i]);
+	}
+}
+
+/*
+ * Allocate a bounce buffer of up to *size bytes, falling back to smaller
+ * ones instead of failing. *size is set to what was allocated, which
+ * stays a multiple of the write size.
+ */
+static void *mtd_kmalloc_up_to(const struct mtd_info *mtd, size_t *size)
+{
+	size_t min_alloc = roundup(PAGE_SIZE, mtd->writesize);
+	void *kbuf;
+
+	*size = min_t(size_t, *size, MAX_KMALLOC_SIZE);
+
+	while (*size > min_alloc) {
+		kbuf = kmalloc(*size, GFP_KERNEL | __GFP_NOWARN |
+			       __GFP_NORETRY);
+		if (kbuf)
+			return kbuf;
+
+		*size = (*size >> 1) / mtd->writesize * mtd->writesize;
+		*size = max(*size, min_alloc);
+	}
+
+	return kmalloc(*size, GFP_KERNEL);
+}
+
+static int mtd_read_buf(struct mtd_file_info *mfi, loff_t from, size_t len,
+			size_t *retlen, u_char *kbuf)
+{
+	struct mtd_info *mtd = mfi->mtd;
+	int ret;
+
+	switch (mfi->mode) {
+	case MTD_MODE_OTP_FACTORY:
+		ret = mtd->read_fact_prot_reg(mtd, from, len, retlen, kbuf);
+		break;
+	case MTD_MODE_OTP_USER:
+		ret = mtd->read_user_prot_reg(mtd, from, len, retlen, kbuf);
+		break;
+	case MTD_MODE_RAW:
+	{
+		struct mtd_oob_ops ops;
+
+		ops.mode = MTD_OOB_RAW;
+		ops.datbuf = kbuf;
+		ops.oobbuf = NULL;
+		ops.len = len;
+
+		ret = mtd->read_oob(mtd, from, &ops);
+		*retlen = ops.retlen;
+		break;
+	}
+	default:
+		ret = mtd->read(mtd, from, len, retlen, kbuf);
+	}
+
+	return ret;
+}
+
+static int mtd_write_buf(struct mtd_file_info *mfi, loff_t to, size_t len,
+			 size_t *retlen, const u_char *kbuf)
+{
+	struct mtd_info *mtd = mfi->mtd;
+	int ret;
+
+	switch (mfi->mode) {
+	case MTD_MODE_OTP_FACTORY:
+		ret = -EROFS;
+		break;
+	case MTD_MODE_OTP_USER:
+		if (!mtd->write_user_prot_reg) {
+			ret = -EOPNOTSUPP;
+			break;
+		}
+		ret = mtd->write_user_prot_reg(mtd, to, len, retlen,
+					       (u_char *)kbuf);
+		break;
+
+	case MTD_MODE_RAW:
+	{
+		struct mtd_oob_ops ops;
+
+		ops.mode = MTD_OOB_RAW;
+		ops.datbuf = (u_char *)kbuf;
+		ops.oobbuf = NULL;
+		ops.len = len;
+
+		ret = mtd->write_oob(mtd, to, &ops);
+		*retlen = ops.retlen;
+		break;
+	}
+
+	default:
+		ret = (*(mtd->write))(mtd, to, len, retlen, kbuf);
+	}
+
+	return ret;
+}
 
 static ssize_t mtd_read(struct file *file, char __user *buf, size_t count,loff_t *ppos)
 {
 	struct mtd_file_info *mfi = file->private_data;
 	struct mtd_info *mtd = mfi->mtd;
+	struct mtd_user_map map = { .pages = NULL };
 	size_t retlen=0;
 	size_t total_retlen=0;
+	size_t size;
 	int ret=0;
-	int len;
-	char *kbuf;
+	size_t len;
+	char *kbuf = NULL;
 
 	DEBUG(MTD_DEBUG_LEVEL0,"MTD_read\n");
 
@@ -155,47 +319,38 @@ static ssize_t mtd_read(struct file *file, char __user *buf, size_t count,loff_t
 	if (!count)
 		return 0;
 
-	/* FIXME: Use kiovec in 2.5 to lock down the user's buffers
-	   and pass them directly to the MTD functions */
-
-	if (count > MAX_KMALLOC_SIZE)
-		kbuf=kmalloc(MAX_KMALLOC_SIZE, GFP_KERNEL);
-	else
-		kbuf=kmalloc(count, GFP_KERNEL);
-
-	if (!kbuf)
-		return -ENOMEM;
+	if (mtd_can_map_user(mfi, buf, count))
+		map.pages = kmalloc(MTD_MAP_PAGES * sizeof(*map.pages),
+				    GFP_KERNEL);
 
 	while (count) {
-
-		if (count > MAX_KMALLOC_SIZE)
-			len = MAX_KMALLOC_SIZE;
-		else
-			len = count;
-
-		switch (mfi->mode) {
-		case MTD_MODE_OTP_FACTORY:
-			ret = mtd->read_fact_prot_reg(mtd, *ppos, len, &retlen, kbuf);
-			break;
-		case MTD_MODE_OTP_USER:
-			ret = mtd->read_user_prot_reg(mtd, *ppos, len, &retlen, kbuf);
-			break;
-		case MTD_MODE_RAW:
-		{
-			struct mtd_oob_ops ops;
-
-			ops.mode = MTD_OOB_RAW;
-			ops.datbuf = kbuf;
-			ops.oobbuf = NULL;
-			ops.len = len;
-
-			ret = mtd->read_oob(mtd, *ppos, &ops);
-			retlen = ops.retlen;
-			break;
+		u_char *ubuf = NULL;
+
+		if (map.pages) {
+			len = min_t(size_t, count, MTD_MAP_PAGES * PAGE_SIZE -
+				    offset_in_page(buf));
+			ubuf = mtd_map_user(&map, buf, len, 1);
+			/* e.g. VM_IO memory, read this chunk the old way */
+			if (IS_ERR(ubuf))
+				ubuf = NULL;
 		}
-		default:
-			ret = mtd->read(mtd, *ppos, len, &retlen, kbuf);
+
+		if (ubuf) {
+			ret = mtd_read_buf(mfi, *ppos, len, &retlen, ubuf);
+			mtd_unmap_user(&map, 1);
+		} else {
+			if (!kbuf) {
+				size = count;
+				kbuf = mtd_kmalloc_up_to(mtd, &size);
+				if (!kbuf) {
+					ret = -ENOMEM;
+					break;
+				}
+			}
+			len = min(count, size);
+			ret = mtd_read_buf(mfi, *ppos, len, &retlen, kbuf);
 		}
+
 		/* Nand returns -EBADMSG on ecc errors, but it returns
 		 * the data. For our userspace tools it is important
 		 * to dump areas with ecc errors !
@@ -207,9 +362,9 @@ static ssize_t mtd_read(struct file *file, char __user *buf, size_t count,loff_t
 		 */
 		if (!ret || (ret == -EUCLEAN) || (ret == -EBADMSG)) {
 			*ppos += retlen;
-			if (copy_to_user(buf, kbuf, retlen)) {
-				kfree(kbuf);
-				return -EFAULT;
+			if (!ubuf && copy_to_user(buf, kbuf, retlen)) {
+				ret = -EFAULT;
+				break;
 			}
 			else
 				total_retlen += retlen;
@@ -218,27 +373,29 @@ static ssize_t mtd_read(struct file *file, char __user *buf, size_t count,loff_t
 			buf += retlen;
 			if (retlen == 0)
 				count = 0;
+			ret = 0;
 		}
-		else {
-			kfree(kbuf);
-			return ret;
-		}
+		else
+			break;
 
 	}
 
+	kfree(map.pages);
 	kfree(kbuf);
-	return total_retlen;
+	return ret ? ret : total_retlen;
 } /* mtd_read */
 
 static ssize_t mtd_write(struct file *file, const char __user *buf, size_t count,loff_t *ppos)
 {
 	struct mtd_file_info *mfi = file->private_data;
 	struct mtd_info *mtd = mfi->mtd;
-	char *kbuf;
+	struct mtd_user_map map = { .pages = NULL };
+	char *kbuf = NULL;
 	size_t retlen;
 	size_t total_retlen=0;
+	size_t size;
 	int ret=0;
-	int len;
+	size_t len;
 
 	DEBUG(MTD_DEBUG_LEVEL0,"MTD_write\n");
 
@@ -251,69 +408,56 @@ static ssize_t mtd_write(struct file *file, const char __user *buf, size_t count
 	if (!count)
 		return 0;
 
-	if (count > MAX_KMALLOC_SIZE)
-		kbuf=kmalloc(MAX_KMALLOC_SIZE, GFP_KERNEL);
-	else
-		kbuf=kmalloc(count, GFP_KERNEL);
-
-	if (!kbuf)
-		return -ENOMEM;
+	if (mtd_can_map_user(mfi, buf, count))
+		map.pages = kmalloc(MTD_MAP_PAGES * sizeof(*map.pages),
+				    GFP_KERNEL);
 
 	while (count) {
-
-		if (count > MAX_KMALLOC_SIZE)
-			len = MAX_KMALLOC_SIZE;
-		else
-			len = count;
-
-		if (copy_from_user(kbuf, buf, len)) {
-			kfree(kbuf);
-			return -EFAULT;
+		const u_char *ubuf = NULL;
+
+		if (map.pages) {
+			len = min_t(size_t, count, MTD_MAP_PAGES * PAGE_SIZE -
+				    offset_in_page(buf));
+			ubuf = mtd_map_user(&map, buf, len, 0);
+			/* e.g. VM_IO memory, write this chunk the old way */
+			if (IS_ERR(ubuf))
+				ubuf = NULL;
 		}
 
-		switch (mfi->mode) {
-		case MTD_MODE_OTP_FACTORY:
-			ret = -EROFS;
-			break;
-		case MTD_MODE_OTP_USER:
-			if (!mtd->write_user_prot_reg) {
-				ret = -EOPNOTSUPP;
-				break;
+		if (ubuf) {
+			ret = mtd_write_buf(mfi, *ppos, len, &retlen, ubuf);
+			mtd_unmap_user(&map, 0);
+		} else {
+			if (!kbuf) {
+				size = count;
+				kbuf = mtd_kmalloc_up_to(mtd, &size);
+				if (!kbuf) {
+					ret = -ENOMEM;
+					break;
+				}
 			}
-			ret = mtd->write_user_prot_reg(mtd, *ppos, len, &retlen, kbuf);
-			break;
-
-		case MTD_MODE_RAW:
-		{
-			struct mtd_oob_ops ops;
+			len = min(count, size);
 
-			ops.mode = MTD_OOB_RAW;
-			ops.datbuf = kbuf;
-			ops.oobbuf = NULL;
-			ops.len = len;
-
-			ret = mtd->write_oob(mtd, *ppos, &ops);
-			retlen = ops.retlen;
-			break;
+			if (copy_from_user(kbuf, buf, len)) {
+				ret = -EFAULT;
+				break;
+			}
+			ret = mtd_write_buf(mfi, *ppos, len, &retlen, kbuf);
 		}
 
-		default:
-			ret = (*(mtd->write))(mtd, *ppos, len, &retlen, kbuf);
-		}
 		if (!ret) {
 			*ppos += retlen;
 			total_retlen += retlen;
 			count -= retlen;
 			buf += retlen;
 		}
-		else {
-			kfree(kbuf);
-			return ret;
-		}
+		else
+			break;
 	}
 
+	kfree(map.pages);
 	kfree(kbuf);
-	return total_retlen;
+	return ret ? ret : total_retlen;
 } /* mtd_write */
 
 /*======================================================================
@@ -19,7 +19,6 @@
  *	rework for 2K page size chips
  *
  *  TODO:
- *	Enable cached programming for 2k page size chips
  *	Check, if mtd->ecctype should be set to MTD_ECC_HW
  *	if we have HW ecc support.
  *	The AG-AND chips have nice features for speed improvement,
@@ -740,6 +739,12 @@ static int nand_wait(struct mtd_info *mtd, struct nand_chip *chip)
 	else
 		chip->cmdfunc(mtd, NAND_CMD_STATUS, -1, -1);
 
+	/* Program and erase take long enough to be worth sleeping for if
+	 * the controller can interrupt on ready/busy. The loop below then
+	 * only confirms the result, or keeps polling if the wait failed. */
+	if (chip->dev_wait && chip->dev_ready && time_before(jiffies, timeo))
+		chip->dev_wait(mtd, timeo - jiffies);
+
 	while (time_before(jiffies, timeo)) {
 		if (chip->dev_ready) {
 			if (chip->dev_ready(mtd))
@@ -1151,6 +1156,7 @@ static int nand_do_read_ops(struct mtd_info *mtd, loff_t from,
 	struct mtd_ecc_stats stats;
 	int blkcheck = (1 << (chip->phys_erase_shift - chip->page_shift)) - 1;
 	int sndcmd = 1;
+	int cacheread = 0;
 	int ret = 0;
 	uint32_t readlen = ops->len;
 	uint32_t oobreadlen = ops->ooblen;
@@ -1182,6 +1188,23 @@ static int nand_do_read_ops(struct mtd_info *mtd, loff_t from,
 				sndcmd = 0;
 			}
 
+			/*
+			 * If the whole of the next page is wanted as well,
+			 * have the chip load it into its data register
+			 * while this one is read out of the cache register.
+			 * Cache reads stop at block boundaries.
+			 */
+			if (NAND_HAS_CACHEREAD(chip) && aligned &&
+			    readlen - bytes >= mtd->writesize &&
+			    ((page + 1) & blkcheck) &&
+			    (realpage + 1 != chip->pagebuf || oob)) {
+				chip->cmdfunc(mtd, NAND_CMD_READCACHESEQ, -1, -1);
+				cacheread = 1;
+			} else if (cacheread) {
+				chip->cmdfunc(mtd, NAND_CMD_READCACHEEND, -1, -1);
+				cacheread = 0;
+			}
+
 			/* Now read the page into the buffer */
 			if (unlikely(ops->mode == MTD_OOB_RAW))
 				ret = chip->ecc.read_page_raw(mtd, chip,
@@ -1259,8 +1282,15 @@ static int nand_do_read_ops(struct mtd_info *mtd, loff_t from,
 		 */
 		if (!NAND_CANAUTOINCR(chip) || !(page & blkcheck))
 			sndcmd = 1;
+		/* The next page is on its way into the cache register */
+		if (cacheread)
+			sndcmd = 0;
 	}
 
+	/* Leave cache read mode if we stopped early */
+	if (cacheread)
+		chip->cmdfunc(mtd, NAND_CMD_READCACHEEND, -1, -1);
+
 	ops->retlen = ops->len - (size_t) readlen;
 	if (oob)
 		ops->oobretlen = ops->ooblen - oobreadlen;
@@ -1761,16 +1791,23 @@ static int nand_write_page(struct mtd_info *mtd, struct nand_chip *chip,
 	else
 		chip->ecc.write_page(mtd, chip, buf);
 
-	/*
-	 * Cached progamming disabled for now, Not sure if its worth the
-	 * trouble. The speed gain is not very impressive. (2.3->2.6Mib/s)
-	 */
+#ifdef CONFIG_MTD_NAND_VERIFY_WRITE
+	/* The page can't be read back while the chip is still busy with it */
 	cached = 0;
+#endif
 
 	if (!cached || !(chip->options & NAND_CACHEPRG)) {
 
 		chip->cmdfunc(mtd, NAND_CMD_PAGEPROG, -1, -1);
 		status = chip->waitfunc(mtd, chip);
+
+		/* This also finishes a previous cache program */
+		if (chip->cacheprg && (status & NAND_STATUS_FAIL_N1)) {
+			status |= NAND_STATUS_FAIL;
+			chip->cacheprg_fail = 1;
+		}
+		chip->cacheprg = 0;
+
 		/*
 		 * See if operation failed and additional status checks are
 		 * available
@@ -1782,8 +1819,22 @@ static int nand_write_page(struct mtd_info *mtd, struct nand_chip *chip,
 		if (status & NAND_STATUS_FAIL)
 			return -EIO;
 	} else {
+		/*
+		 * The chip takes the data into its cache register and
+		 * programs it while the next page is transferred. The
+		 * status only tells about the previous page, if any.
+		 */
 		chip->cmdfunc(mtd, NAND_CMD_CACHEDPROG, -1, -1);
 		status = chip->waitfunc(mtd, chip);
+
+		if (chip->cacheprg && (status & NAND_STATUS_FAIL_N1)) {
+			/* Abort this page too, the caller gives up here */
+			chip->cmdfunc(mtd, NAND_CMD_RESET, -1, -1);
+			chip->cacheprg = 0;
+			chip->cacheprg_fail = 1;
+			return -EIO;
+		}
+		chip->cacheprg = 1;
 	}
 
 #ifdef CONFIG_MTD_NAND_VERIFY_WRITE
@@ -1863,7 +1914,7 @@ static int nand_do_write_ops(struct mtd_info *mtd, loff_t to,
 	uint32_t writelen = ops->len;
 	uint8_t *oob = ops->oobbuf;
 	uint8_t *buf = ops->datbuf;
-	int ret, subpage;
+	int ret, subpage, prev_bytes = 0;
 
 	ops->retlen = 0;
 	if (!writelen)
@@ -1902,6 +1953,7 @@ static int nand_do_write_ops(struct mtd_info *mtd, loff_t to,
 	if (likely(!oob))
 		memset(chip->oob_poi, 0xff, mtd->oobsize);
 
+	chip->cacheprg_fail = 0;
 	while(1) {
 		int bytes = mtd->writesize;
 		int cached = writelen > bytes && page != blockmask;
@@ -1922,10 +1974,15 @@ static int nand_do_write_ops(struct mtd_info *mtd, loff_t to,
 
 		ret = chip->write_page(mtd, chip, wbuf, page, cached,
 				       (ops->mode == MTD_OOB_RAW));
-		if (ret)
+		if (ret) {
+			/* The previous page was not written either */
+			if (chip->cacheprg_fail)
+				writelen += prev_bytes;
 			break;
+		}
 
 		writelen -= bytes;
+		prev_bytes = cached ? bytes : 0;
 		if (!writelen)
 			break;
 
@@ -2860,6 +2917,12 @@ int nand_scan_tail(struct mtd_info *mtd)
 	}
 	chip->subpagesize = mtd->writesize >> mtd->subpage_sft;
 
+	/* Cache reads need large pages and a page read which goes
+	 * through the page in order */
+	if (mtd->writesize <= 512 ||
+	    chip->ecc.read_page == nand_read_page_hwecc_oob_first)
+		chip->options &= ~NAND_CACHERD;
+
 	/* Initialize state */
 	chip->state = FL_READY;
 
@@ -2868,6 +2931,7 @@ int nand_scan_tail(struct mtd_info *mtd)
 
 	/* Invalidate the pagebuffer reference */
 	chip->pagebuf = -1;
+	chip->cacheprg = 0;
 
 	/* Fill in remaining MTD driver data */
 	mtd->type = MTD_NANDFLASH;
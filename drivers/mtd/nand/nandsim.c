@@ -41,6 +41,8 @@
 #include <linux/sched.h>
 #include <linux/fs.h>
 #include <linux/pagemap.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 /* Default simulator parameters values */
 #if !defined(CONFIG_NANDSIM_FIRST_ID_BYTE)  || \
@@ -354,6 +356,20 @@ struct nandsim {
 	void *file_buf;
 	struct page *held_pages[NS_MAX_HELD_PAGES];
 	int held_cnt;
+
+	/* Flash traffic since the statistics were last reset */
+	struct nandsim_stats {
+		uint64_t pages_read;
+		uint64_t pages_written;
+		uint64_t blocks_erased;
+		uint64_t busy_us;   /* time the chip would have been busy */
+	} stats;
+
+	/* Simulated power cut */
+	uint powercut;      /* programs/erases until the power is cut, or 0 */
+	int powered_off;    /* programs and erases are dropped */
+
+	struct dentry *dfs_dir;
 };
 
 /*
@@ -1469,13 +1485,13 @@ static void read_page(struct nandsim *ns, int num)
 /*
  * Erase all pages in the specified sector.
  */
-static void erase_sector(struct nandsim *ns)
+static void erase_sector(struct nandsim *ns, int pages)
 {
 	union ns_mem *mypage;
 	int i;
 
 	if (ns->cfile) {
-		for (i = 0; i < ns->geom.pgsec; i++)
+		for (i = 0; i < pages; i++)
 			if (ns->pages_written[ns->regs.row + i]) {
 				NS_DBG("erase_sector: freeing page %d\n", ns->regs.row + i);
 				ns->pages_written[ns->regs.row + i] = 0;
@@ -1484,7 +1500,7 @@ static void erase_sector(struct nandsim *ns)
 	}
 
 	mypage = NS_GET_PAGE(ns);
-	for (i = 0; i < ns->geom.pgsec; i++) {
+	for (i = 0; i < pages; i++) {
 		if (mypage->byte != NULL) {
 			NS_DBG("erase_sector: freeing page %d\n", ns->regs.row+i);
 			kmem_cache_free(ns->nand_pages_slab, mypage->byte);
@@ -1568,6 +1584,24 @@ static int prog_page(struct nandsim *ns, int num)
 	return 0;
 }
 
+/*
+ * Count a program or erase towards the simulated power cut.
+ *
+ * RETURNS: 0 if it may go ahead, 1 if the power goes off half way through
+ * it and -1 if the power is already off, so the flash must not be touched.
+ */
+static int powercut_check(struct nandsim *ns)
+{
+	if (ns->powered_off)
+		return -1;
+	if (!ns->powercut || --ns->powercut)
+		return 0;
+
+	NS_WARN("simulating power cut\n");
+	ns->powered_off = 1;
+	return 1;
+}
+
 /*
  * If state has any action bit, perform this action.
  *
@@ -1578,6 +1612,7 @@ static int do_state_action(struct nandsim *ns, uint32_t action)
 	int num;
 	int busdiv = ns->busw == 8 ? 1 : 2;
 	unsigned int erase_block_no, page_no;
+	int cut;
 
 	action &= ACTION_MASK;
 
@@ -1615,6 +1650,13 @@ static int do_state_action(struct nandsim *ns, uint32_t action)
 		NS_UDELAY(access_delay);
 		NS_UDELAY(input_cycle * ns->geom.pgsz / 1000 / busdiv);
 
+		/* A random data output reads from the page register */
+		if (NS_STATE(ns->state) != STATE_CMD_RNDOUTSTART) {
+			ns->stats.pages_read++;
+			ns->stats.busy_us += access_delay +
+				input_cycle * ns->geom.pgsz / 1000 / busdiv;
+		}
+
 		break;
 
 	case ACTION_SECERASE:
@@ -1643,10 +1685,16 @@ static int do_state_action(struct nandsim *ns, uint32_t action)
 				ns->regs.row, NS_RAW_OFFSET(ns));
 		NS_LOG("erase sector %u\n", erase_block_no);
 
-		erase_sector(ns);
+		/* After a power cut nothing changes, the one it hits is torn */
+		cut = powercut_check(ns);
+		if (cut >= 0)
+			erase_sector(ns, cut ? ns->geom.pgsec / 2 : ns->geom.pgsec);
 
 		NS_MDELAY(erase_delay);
 
+		ns->stats.blocks_erased++;
+		ns->stats.busy_us += erase_delay * 1000;
+
 		if (erase_block_wear)
 			update_wear(erase_block_no);
 
@@ -1674,7 +1722,8 @@ static int do_state_action(struct nandsim *ns, uint32_t action)
 			return -1;
 		}
 
-		if (prog_page(ns, num) == -1)
+		cut = powercut_check(ns);
+		if (cut >= 0 && prog_page(ns, cut ? num / 2 : num) == -1)
 			return -1;
 
 		page_no = ns->regs.row;
@@ -1686,6 +1735,10 @@ static int do_state_action(struct nandsim *ns, uint32_t action)
 		NS_UDELAY(programm_delay);
 		NS_UDELAY(output_cycle * ns->geom.pgsz / 1000 / busdiv);
 
+		ns->stats.pages_written++;
+		ns->stats.busy_us += programm_delay +
+			output_cycle * ns->geom.pgsz / 1000 / busdiv;
+
 		if (write_error(page_no)) {
 			NS_WARN("simulating write failure in page %u\n", page_no);
 			return -1;
@@ -2217,6 +2270,97 @@ static int ns_nand_verify_buf(struct mtd_info *mtd, const u_char *buf, int len)
 	}
 }
 
+#ifdef CONFIG_DEBUG_FS
+static int ns_stats_show(struct seq_file *m, void *private)
+{
+	struct nandsim *ns = m->private;
+
+	seq_printf(m, "page_size %u\n", ns->geom.pgsz);
+	seq_printf(m, "block_size %u\n", ns->geom.secsz);
+	seq_printf(m, "pages_read %llu\n",
+		   (unsigned long long)ns->stats.pages_read);
+	seq_printf(m, "pages_written %llu\n",
+		   (unsigned long long)ns->stats.pages_written);
+	seq_printf(m, "blocks_erased %llu\n",
+		   (unsigned long long)ns->stats.blocks_erased);
+	seq_printf(m, "busy_us %llu\n",
+		   (unsigned long long)ns->stats.busy_us);
+	return 0;
+}
+
+static int ns_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, ns_stats_show, inode->i_private);
+}
+
+/* Writing anything resets the statistics */
+static ssize_t ns_stats_write(struct file *file, const char __user *buf,
+			      size_t count, loff_t *ppos)
+{
+	struct nandsim *ns = ((struct seq_file *)file->private_data)->private;
+
+	memset(&ns->stats, 0, sizeof(ns->stats));
+	return count;
+}
+
+static const struct file_operations ns_stats_fops = {
+	.owner   = THIS_MODULE,
+	.open    = ns_stats_open,
+	.read    = seq_read,
+	.write   = ns_stats_write,
+	.llseek  = seq_lseek,
+	.release = single_release,
+};
+
+static int ns_powercut_get(void *data, u64 *val)
+{
+	struct nandsim *ns = data;
+
+	*val = ns->powercut;
+	return 0;
+}
+
+/*
+ * Cut the power after this many more programs and erases, the last of
+ * which is torn. Writing 0 turns the power back on.
+ */
+static int ns_powercut_set(void *data, u64 val)
+{
+	struct nandsim *ns = data;
+
+	ns->powercut = val;
+	ns->powered_off = 0;
+	return 0;
+}
+
+DEFINE_SIMPLE_ATTRIBUTE(ns_powercut_fops, ns_powercut_get, ns_powercut_set,
+			"%llu\n");
+
+static void ns_debugfs_init(struct nandsim *ns)
+{
+	struct dentry *dir;
+
+	dir = debugfs_create_dir("nandsim", NULL);
+	if (!dir) {
+		NS_WARN("cannot create debugfs directory\n");
+		return;
+	}
+	debugfs_create_file("stats", S_IRUSR | S_IWUSR, dir, ns,
+			    &ns_stats_fops);
+	debugfs_create_file("powercut", S_IRUSR | S_IWUSR, dir, ns,
+			    &ns_powercut_fops);
+	ns->dfs_dir = dir;
+}
+
+static void ns_debugfs_exit(struct nandsim *ns)
+{
+	debugfs_remove_recursive(ns->dfs_dir);
+}
+#else
+static inline void ns_debugfs_init(struct nandsim *ns) {}
+static inline void ns_debugfs_exit(struct nandsim *ns) {}
+#endif
+
 /*
  * Module initialization function
  */
@@ -2325,6 +2469,8 @@ static int __init ns_init_module(void)
 	if ((retval = add_mtd_partitions(nsmtd, &nand->partitions[0], nand->nbparts)) != 0)
 		goto err_exit;
 
+	ns_debugfs_init(nand);
+
         return 0;
 
 err_exit:
@@ -2349,6 +2495,7 @@ static void __exit ns_cleanup_module(void)
 	struct nandsim *ns = (struct nandsim *)(((struct nand_chip *)nsmtd->priv)->priv);
 	int i;
 
+	ns_debugfs_exit(ns);
 	free_nandsim(ns);    /* Free nandsim private resources */
 	nand_release(nsmtd); /* Unregister driver */
 	for (i = 0;i < ARRAY_SIZE(ns->partitions); ++i)
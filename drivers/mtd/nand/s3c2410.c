@@ -34,6 +34,8 @@
 #include <linux/platform_device.h>
 #include <linux/delay.h>
 #include <linux/err.h>
+#include <linux/interrupt.h>
+#include <linux/completion.h>
 #include <linux/slab.h>
 #include <linux/clk.h>
 #include <linux/cpufreq.h>
@@ -132,6 +134,10 @@ struct s3c2410_nand_info {
 
 	enum s3c_cpu_type		cpu_type;
 
+	/* ready/busy interrupt, s3c2440 only */
+	int				irq;
+	struct completion		rnb_done;
+
 #ifdef CONFIG_CPU_FREQ
 	struct notifier_block	freq_transition;
 #endif
@@ -418,6 +424,65 @@ static int s3c2412_nand_devready(struct mtd_info *mtd)
 	return readb(info->regs + S3C2412_NFSTAT) & S3C2412_NFSTAT_READY;
 }
 
+/* s3c2440_nand_irq
+ *
+ * the ready/busy line has gone high, acknowledge it and wake the waiter.
+ * NFCONT is left alone here, the waiter turns the interrupt off again.
+*/
+
+static irqreturn_t s3c2440_nand_irq(int irq, void *dev_id)
+{
+	struct s3c2410_nand_info *info = dev_id;
+
+	if (!(readb(info->regs + S3C2440_NFSTAT) & S3C2440_NFSTAT_RnB_CHANGE))
+		return IRQ_NONE;
+
+	writeb(S3C2440_NFSTAT_RnB_CHANGE, info->regs + S3C2440_NFSTAT);
+	complete(&info->rnb_done);
+	return IRQ_HANDLED;
+}
+
+static void s3c2440_nand_rnbint(struct s3c2410_nand_info *info, int on)
+{
+	void __iomem *nfcont = info->regs + S3C2440_NFCONT;
+	unsigned long flags, cur;
+
+	local_irq_save(flags);
+
+	cur = readl(nfcont);
+	if (on)
+		cur |= S3C2440_NFCONT_RNBINT_EN;
+	else
+		cur &= ~S3C2440_NFCONT_RNBINT_EN;
+	writel(cur, nfcont);
+
+	local_irq_restore(flags);
+}
+
+/* s3c2440_nand_devwait()
+ *
+ * sleep until the ready/busy line rises or @timeout jiffies pass. The
+ * edge is cleared and the interrupt armed before the line is checked,
+ * so an edge between the check and the sleep still completes the wait.
+*/
+
+static int s3c2440_nand_devwait(struct mtd_info *mtd, unsigned long timeout)
+{
+	struct s3c2410_nand_info *info = s3c2410_nand_mtd_toinfo(mtd);
+
+	INIT_COMPLETION(info->rnb_done);
+
+	writeb(S3C2440_NFSTAT_RnB_CHANGE, info->regs + S3C2440_NFSTAT);
+	s3c2440_nand_rnbint(info, 1);
+
+	if (!s3c2440_nand_devready(mtd))
+		wait_for_completion_timeout(&info->rnb_done, timeout);
+
+	s3c2440_nand_rnbint(info, 0);
+
+	return s3c2440_nand_devready(mtd);
+}
+
 /* ECC handling functions */
 
 static int s3c2410_nand_correct_data(struct mtd_info *mtd, u_char *dat,
@@ -675,6 +740,9 @@ static int s3c24xx_nand_remove(struct platform_device *pdev)
 
 	s3c2410_nand_cpufreq_deregister(info);
 
+	if (info->irq > 0)
+		free_irq(info->irq, info);
+
 	/* Release all our mtds  and their partitions, then go through
 	 * freeing the resources used
 	 */
@@ -794,6 +862,8 @@ static void s3c2410_nand_init_chip(struct s3c2410_nand_info *info,
 		chip->dev_ready = s3c2440_nand_devready;
 		chip->read_buf  = s3c2440_nand_read_buf;
 		chip->write_buf	= s3c2440_nand_write_buf;
+		if (info->irq > 0)
+			chip->dev_wait = s3c2440_nand_devwait;
 		break;
 
 	case TYPE_S3C2412:
@@ -879,7 +949,8 @@ static void s3c2410_nand_init_chip(struct s3c2410_nand_info *info,
  * and the relevant per-chip information updated. This call ensure that
  * we update the internal state accordingly.
  *
- * The internal state is currently limited to the ECC state information.
+ * The internal state is currently limited to the ECC state information
+ * and the chip options which can not be told from the chip id.
 */
 static void s3c2410_nand_update_chip(struct s3c2410_nand_info *info,
 				     struct s3c2410_nand_mtd *nmtd)
@@ -889,6 +960,9 @@ static void s3c2410_nand_update_chip(struct s3c2410_nand_info *info,
 	dev_dbg(info->device, "chip %p => page shift %d\n",
 		chip, chip->page_shift);
 
+	if (nmtd->set != NULL && nmtd->set->cache_read)
+		chip->options |= NAND_CACHERD;
+
 	if (chip->ecc.mode != NAND_ECC_HW)
 		return;
 
@@ -986,6 +1060,22 @@ static int s3c24xx_nand_probe(struct platform_device *pdev)
 	if (err != 0)
 		goto exit_error;
 
+	/* the s3c2440 can interrupt when the ready/busy line rises, which
+	 * lets program and erase sleep instead of polling. Without the
+	 * interrupt we carry on polling as before. */
+
+	if (cpu_type == TYPE_S3C2440) {
+		int irq = platform_get_irq(pdev, 0);
+
+		init_completion(&info->rnb_done);
+
+		if (irq > 0 && request_irq(irq, s3c2440_nand_irq, 0,
+					   dev_name(&pdev->dev), info) == 0)
+			info->irq = irq;
+		else
+			dev_info(&pdev->dev, "no ready/busy irq, polling\n");
+	}
+
 	sets = (plat != NULL) ? plat->sets : NULL;
 	nr_sets = (plat != NULL) ? plat->nr_sets : 1;
 
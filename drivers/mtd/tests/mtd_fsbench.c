@@ -0,0 +1,474 @@
+/*
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * Flash file system workloads.
+ *
+ * Runs one or all of a set of standard workloads in a directory of a mounted
+ * file system and reports how long they took. Together with the flash
+ * statistics of nandsim this allows comparing file systems on the same
+ * simulated chip, see Documentation/mtd/fsbench.txt.
+ */
+
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/err.h>
+#include <linux/fs.h>
+#include <linux/namei.h>
+#include <linux/mount.h>
+#include <linux/pagemap.h>
+#include <linux/sched.h>
+#include <linux/vmalloc.h>
+#include <linux/math64.h>
+#include <asm/uaccess.h>
+
+#define PRINT_PREF KERN_INFO "mtd_fsbench: "
+
+static char *dir;
+module_param(dir, charp, S_IRUGO);
+MODULE_PARM_DESC(dir, "Directory on the file system to test");
+
+static char *test = "all";
+module_param(test, charp, S_IRUGO);
+MODULE_PARM_DESC(test, "Workload to run: seqwrite, seqread, randwrite, "
+		 "randread, churn, clean or all (default)");
+
+static unsigned int size = 8192;
+module_param(size, uint, S_IRUGO);
+MODULE_PARM_DESC(size, "Size of the file for the sequential and random "
+		 "workloads in KiB (default 8192)");
+
+static unsigned int bs = 65536;
+module_param(bs, uint, S_IRUGO);
+MODULE_PARM_DESC(bs, "Bytes per sequential read or write (default 65536)");
+
+static unsigned int rsize = 4096;
+module_param(rsize, uint, S_IRUGO);
+MODULE_PARM_DESC(rsize, "Bytes per random read or write (default 4096)");
+
+static unsigned int ops = 1000;
+module_param(ops, uint, S_IRUGO);
+MODULE_PARM_DESC(ops, "Random reads or writes, or files replaced by churn "
+		 "(default 1000)");
+
+static unsigned int files = 200;
+module_param(files, uint, S_IRUGO);
+MODULE_PARM_DESC(files, "Number of small files kept by churn (default 200)");
+
+static int compressible;
+module_param(compressible, int, S_IRUGO);
+MODULE_PARM_DESC(compressible, "Write text-like data instead of random data");
+
+static unsigned long seed = 1;
+module_param(seed, ulong, S_IRUGO);
+MODULE_PARM_DESC(seed, "Random seed, the same seed gives the same workload");
+
+#define DATA_FILE	"fsbench.dat"
+#define CHURN_MIN	512
+#define CHURN_MAX	16384
+
+static unsigned char *iobuf;
+static unsigned int iobuf_size;
+static struct timeval start, finish;
+static unsigned long next;
+
+static inline unsigned int simple_rand(void)
+{
+	next = next * 1103515245 + 12345;
+	return (unsigned int)((next / 65536) % 32768);
+}
+
+static unsigned int simple_rand_n(unsigned int n)
+{
+	return ((simple_rand() << 15) | simple_rand()) % n;
+}
+
+static void set_data(unsigned char *buf, size_t len)
+{
+	static const char words[] = "static int page buffer return NULL; ";
+	size_t i;
+
+	for (i = 0; i < len; ++i) {
+		if (compressible)
+			buf[i] = words[(i + simple_rand_n(4)) %
+				       (sizeof(words) - 1)];
+		else
+			buf[i] = simple_rand();
+	}
+}
+
+static inline void start_timing(void)
+{
+	do_gettimeofday(&start);
+}
+
+static inline void stop_timing(void)
+{
+	do_gettimeofday(&finish);
+}
+
+static long elapsed_ms(void)
+{
+	long ms;
+
+	ms = (finish.tv_sec - start.tv_sec) * 1000;
+	ms += (finish.tv_usec - start.tv_usec) / 1000;
+	return ms ? ms : 1;
+}
+
+/* print a result line which is easy to pick up from a script */
+static void report(const char *name, u64 bytes, unsigned int count)
+{
+	long ms = elapsed_ms();
+
+	printk(PRINT_PREF "%s bytes=%llu ops=%u ms=%ld kib_s=%llu ops_s=%llu\n",
+	       name, (unsigned long long)bytes, count, ms,
+	       (unsigned long long)div_u64(bytes * 1000, ms * 1024),
+	       (unsigned long long)div_u64((u64)count * 1000, ms));
+}
+
+static struct file *open_file(const char *name, int flags)
+{
+	char path[256];
+
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+	return filp_open(path, flags | O_LARGEFILE, 0644);
+}
+
+static ssize_t file_rw(struct file *file, int write, void *buf, size_t count,
+		       loff_t pos)
+{
+	mm_segment_t old_fs;
+	ssize_t tx;
+
+	old_fs = get_fs();
+	set_fs(get_ds());
+	if (write)
+		tx = vfs_write(file, (char __user *)buf, count, &pos);
+	else
+		tx = vfs_read(file, (char __user *)buf, count, &pos);
+	set_fs(old_fs);
+
+	if (tx >= 0 && tx != count)
+		tx = -EIO;
+	return tx;
+}
+
+static int close_file(struct file *file, int sync)
+{
+	int err = 0;
+
+	if (sync)
+		err = vfs_fsync(file, file->f_path.dentry, 0);
+	filp_close(file, NULL);
+	return err;
+}
+
+/* Make reads come from the flash rather than the page cache */
+static void drop_cache(struct file *file)
+{
+	invalidate_mapping_pages(file->f_mapping, 0, -1);
+}
+
+static int unlink_file(const char *name)
+{
+	struct path parent;
+	struct dentry *dentry;
+	struct inode *inode;
+	int err;
+
+	err = kern_path(dir, LOOKUP_FOLLOW | LOOKUP_DIRECTORY, &parent);
+	if (err)
+		return err;
+
+	inode = parent.dentry->d_inode;
+	mutex_lock_nested(&inode->i_mutex, I_MUTEX_PARENT);
+	dentry = lookup_one_len(name, parent.dentry, strlen(name));
+	if (IS_ERR(dentry)) {
+		err = PTR_ERR(dentry);
+	} else {
+		if (!dentry->d_inode) {
+			err = -ENOENT;
+		} else {
+			/* respect a read-only or remounting fs, as unlink does */
+			err = mnt_want_write(parent.mnt);
+			if (!err) {
+				err = vfs_unlink(inode, dentry);
+				mnt_drop_write(parent.mnt);
+			}
+		}
+		dput(dentry);
+	}
+	mutex_unlock(&inode->i_mutex);
+	path_put(&parent);
+	return err;
+}
+
+static int seqwrite(void)
+{
+	struct file *file;
+	loff_t pos, total = (loff_t)size * 1024;
+	size_t len;
+	int err = 0;
+
+	file = open_file(DATA_FILE, O_WRONLY | O_CREAT | O_TRUNC);
+	if (IS_ERR(file))
+		return PTR_ERR(file);
+
+	start_timing();
+	for (pos = 0; pos < total; pos += len) {
+		len = min_t(loff_t, bs, total - pos);
+		set_data(iobuf, len);
+		err = file_rw(file, 1, iobuf, len, pos);
+		if (err < 0)
+			break;
+		err = 0;
+		cond_resched();
+	}
+	if (!err)
+		err = close_file(file, 1);
+	else
+		close_file(file, 0);
+	stop_timing();
+
+	if (!err)
+		report("seqwrite", total, div_u64(total + bs - 1, bs));
+	return err;
+}
+
+static int seqread(void)
+{
+	struct file *file;
+	loff_t pos, total;
+	size_t len;
+	int err = 0;
+
+	file = open_file(DATA_FILE, O_RDONLY);
+	if (IS_ERR(file))
+		return PTR_ERR(file);
+	drop_cache(file);
+	total = i_size_read(file->f_mapping->host);
+
+	start_timing();
+	for (pos = 0; pos < total; pos += len) {
+		len = min_t(loff_t, bs, total - pos);
+		err = file_rw(file, 0, iobuf, len, pos);
+		if (err < 0)
+			break;
+		err = 0;
+		cond_resched();
+	}
+	stop_timing();
+	close_file(file, 0);
+
+	if (!err)
+		report("seqread", total, div_u64(total + bs - 1, bs));
+	return err;
+}
+
+static int randio(int write)
+{
+	struct file *file;
+	unsigned int i, blocks;
+	loff_t pos;
+	int err = 0;
+
+	file = open_file(DATA_FILE, write ? O_WRONLY : O_RDONLY);
+	if (IS_ERR(file))
+		return PTR_ERR(file);
+	if (!write)
+		drop_cache(file);
+
+	blocks = div_u64(i_size_read(file->f_mapping->host), rsize);
+	if (!blocks) {
+		printk(PRINT_PREF "%s is too small, run seqwrite first\n",
+		       DATA_FILE);
+		close_file(file, 0);
+		return -EINVAL;
+	}
+
+	start_timing();
+	for (i = 0; i < ops; i++) {
+		pos = (loff_t)simple_rand_n(blocks) * rsize;
+		if (write)
+			set_data(iobuf, rsize);
+		err = file_rw(file, write, iobuf, rsize, pos);
+		if (err < 0)
+			break;
+		err = 0;
+		cond_resched();
+	}
+	if (!err)
+		err = close_file(file, write);
+	else
+		close_file(file, 0);
+	stop_timing();
+
+	if (!err)
+		report(write ? "randwrite" : "randread", (u64)ops * rsize, ops);
+	return err;
+}
+
+static int randwrite(void)
+{
+	return randio(1);
+}
+
+static int randread(void)
+{
+	return randio(0);
+}
+
+static int write_small_file(unsigned int n, u64 *bytes)
+{
+	struct file *file;
+	char name[32];
+	size_t len;
+	int err;
+
+	snprintf(name, sizeof(name), "fsbench-%05u", n);
+	file = open_file(name, O_WRONLY | O_CREAT | O_TRUNC);
+	if (IS_ERR(file))
+		return PTR_ERR(file);
+
+	len = CHURN_MIN + simple_rand_n(CHURN_MAX - CHURN_MIN);
+	set_data(iobuf, len);
+	err = file_rw(file, 1, iobuf, len, 0);
+	if (err >= 0)
+		err = close_file(file, 1);
+	else
+		close_file(file, 0);
+
+	*bytes += len;
+	return err;
+}
+
+/*
+ * Keep @files small files, each written and synced like an application
+ * saving its state would, and replace @ops random ones of them.
+ */
+static int churn(void)
+{
+	char name[32];
+	unsigned int i, n;
+	u64 bytes = 0;
+	int err = 0;
+
+	for (i = 0; i < files && !err; i++)
+		err = write_small_file(i, &bytes);
+	if (err)
+		return err;
+
+	bytes = 0;
+	start_timing();
+	for (i = 0; i < ops; i++) {
+		n = simple_rand_n(files);
+		snprintf(name, sizeof(name), "fsbench-%05u", n);
+		err = unlink_file(name);
+		if (!err)
+			err = write_small_file(n, &bytes);
+		if (err)
+			break;
+		cond_resched();
+	}
+	stop_timing();
+
+	if (!err)
+		report("churn", bytes, ops);
+	return err;
+}
+
+static int clean(void)
+{
+	char name[32];
+	unsigned int i;
+	int err;
+
+	err = unlink_file(DATA_FILE);
+	if (err && err != -ENOENT)
+		return err;
+
+	for (i = 0; i < files; i++) {
+		snprintf(name, sizeof(name), "fsbench-%05u", i);
+		err = unlink_file(name);
+		if (err && err != -ENOENT)
+			return err;
+	}
+	return 0;
+}
+
+static const struct {
+	const char *name;
+	int (*run)(void);
+} workloads[] = {
+	{ "seqwrite", seqwrite },
+	{ "seqread", seqread },
+	{ "randwrite", randwrite },
+	{ "randread", randread },
+	{ "churn", churn },
+	{ "clean", clean },
+};
+
+static int __init mtd_fsbench_init(void)
+{
+	int i, err = -EINVAL;
+
+	printk(KERN_INFO "\n");
+	printk(KERN_INFO "=================================================\n");
+
+	if (!dir) {
+		printk(PRINT_PREF "Please specify a directory with dir=\n");
+		return -EINVAL;
+	}
+	if (!bs || !rsize || !files) {
+		printk(PRINT_PREF "bs, rsize and files must not be 0\n");
+		return -EINVAL;
+	}
+
+	iobuf_size = max_t(unsigned int, max(bs, rsize), CHURN_MAX);
+	iobuf = vmalloc(iobuf_size);
+	if (!iobuf) {
+		printk(PRINT_PREF "error: cannot allocate memory\n");
+		return -ENOMEM;
+	}
+
+	printk(PRINT_PREF "testing in %s\n", dir);
+
+	for (i = 0; i < ARRAY_SIZE(workloads); i++) {
+		if (strcmp(test, "all") && strcmp(test, workloads[i].name))
+			continue;
+		next = seed + i;
+		err = workloads[i].run();
+		if (err) {
+			printk(PRINT_PREF "error %d in %s\n", err,
+			       workloads[i].name);
+			break;
+		}
+	}
+
+	if (i == ARRAY_SIZE(workloads) && err == -EINVAL)
+		printk(PRINT_PREF "unknown workload %s\n", test);
+	else if (!err)
+		printk(PRINT_PREF "finished\n");
+
+	vfree(iobuf);
+	printk(KERN_INFO "=================================================\n");
+	return err;
+}
+module_init(mtd_fsbench_init);
+
+static void __exit mtd_fsbench_exit(void)
+{
+	return;
+}
+module_exit(mtd_fsbench_exit);
+
+MODULE_DESCRIPTION("Flash file system benchmark module");
+MODULE_LICENSE("GPL");
@@ -26,6 +26,9 @@
 
 #ifdef CONFIG_MTD_UBI_DEBUG
 
+#include <linux/debugfs.h>
+#include <linux/uaccess.h>
+#include <linux/math64.h>
 #include "ubi.h"
 
 /**
@@ -228,4 +231,309 @@ out:
 	return;
 }
 
+/**
+ * ubi_dbg_lat_add - account the latency of an operation.
+ * @ubi: UBI device description object
+ * @type: which histogram to add to (%UBI_DBG_LAT_WRITE, etc)
+ * @start: time the operation started, from 'ubi_dbg_lat_start()'
+ */
+void ubi_dbg_lat_add(struct ubi_device *ubi, int type, ktime_t start)
+{
+	struct ubi_lat_hist *h = &ubi->dbg.lat[type];
+	s64 delta = ktime_to_us(ktime_sub(ktime_get(), start));
+	unsigned long us = min_t(s64, delta, ULONG_MAX);
+	int slot = 0;
+
+	while (slot < UBI_DBG_LAT_SLOTS - 1 && (us >> slot))
+		slot += 1;
+
+	spin_lock(&h->lock);
+	h->count[slot] += 1;
+	if (us > h->max)
+		h->max = us;
+	spin_unlock(&h->lock);
+}
+
+/* Root of the UBI debugfs tree, each UBI device has a directory there */
+static struct dentry *dfs_rootdir;
+
+/**
+ * ubi_debugfs_init - create the UBI debugfs root directory.
+ *
+ * Returns zero in case of success and a negative error code in case of
+ * failure.
+ */
+int ubi_debugfs_init(void)
+{
+	dfs_rootdir = debugfs_create_dir("ubi", NULL);
+	if (IS_ERR(dfs_rootdir) || !dfs_rootdir) {
+		int err = dfs_rootdir ? PTR_ERR(dfs_rootdir) : -ENODEV;
+
+		ubi_err("cannot create \"ubi\" debugfs directory, error %d",
+			err);
+		return err;
+	}
+
+	return 0;
+}
+
+/**
+ * ubi_debugfs_exit - remove the UBI debugfs root directory.
+ */
+void ubi_debugfs_exit(void)
+{
+	debugfs_remove(dfs_rootdir);
+}
+
+static int dfs_open(struct inode *inode, struct file *file)
+{
+	file->private_data = inode->i_private;
+	return nonseekable_open(inode, file);
+}
+
+/* Percentile @permille of the histogram @h with @total entries, in slots */
+static int lat_percentile(const struct ubi_lat_hist *h, unsigned long total,
+			  int permille)
+{
+	u64 want = div_u64((u64)total * permille + 999, 1000);
+	unsigned long sum = 0;
+	int i;
+
+	for (i = 0; i < UBI_DBG_LAT_SLOTS - 1; i++) {
+		sum += h->count[i];
+		if (sum >= want)
+			break;
+	}
+	return i;
+}
+
+static int lat_print_percentile(char *p, const char *name,
+				const struct ubi_lat_hist *h,
+				unsigned long total, int permille)
+{
+	int i = lat_percentile(h, total, permille);
+
+	if (i == UBI_DBG_LAT_SLOTS - 1)
+		return sprintf(p, "%-12s>= %lu us\n", name,
+			       1UL << (UBI_DBG_LAT_SLOTS - 2));
+	return sprintf(p, "%-12s< %lu us\n", name, 1UL << i);
+}
+
+static ssize_t dfs_lat_read(struct file *file, char __user *u, size_t count,
+			    loff_t *ppos)
+{
+	struct ubi_lat_hist *h = file->private_data, hist;
+	unsigned long total = 0;
+	ssize_t ret;
+	char *buf, *p;
+	int i;
+
+	buf = kmalloc(PAGE_SIZE, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	spin_lock(&h->lock);
+	memcpy(hist.count, h->count, sizeof(hist.count));
+	hist.max = h->max;
+	spin_unlock(&h->lock);
+
+	for (i = 0; i < UBI_DBG_LAT_SLOTS; i++)
+		total += hist.count[i];
+
+	p = buf;
+	p += sprintf(p, "%-12s%lu\n", "operations:", total);
+	p += sprintf(p, "%-12s%lu us\n", "maximum:", hist.max);
+	if (total) {
+		p += lat_print_percentile(p, "50%:", &hist, total, 500);
+		p += lat_print_percentile(p, "99%:", &hist, total, 990);
+		p += lat_print_percentile(p, "99.9%:", &hist, total, 999);
+	}
+	p += sprintf(p, "\n");
+	for (i = 0; i < UBI_DBG_LAT_SLOTS - 1; i++)
+		p += sprintf(p, " < %7lu us: %lu\n", 1UL << i, hist.count[i]);
+	p += sprintf(p, ">= %7lu us: %lu\n", 1UL << (i - 1), hist.count[i]);
+
+	ret = simple_read_from_buffer(u, count, ppos, buf, p - buf);
+	kfree(buf);
+	return ret;
+}
+
+/* Writing anything to a latency file clears the histogram */
+static ssize_t dfs_lat_write(struct file *file, const char __user *u,
+			     size_t count, loff_t *ppos)
+{
+	struct ubi_lat_hist *h = file->private_data;
+
+	spin_lock(&h->lock);
+	memset(h->count, 0, sizeof(h->count));
+	h->max = 0;
+	spin_unlock(&h->lock);
+
+	return count;
+}
+
+static const struct file_operations dfs_lat_fops = {
+	.open = dfs_open,
+	.read = dfs_lat_read,
+	.write = dfs_lat_write,
+	.owner = THIS_MODULE,
+};
+
+static ssize_t dfs_pool_read(struct file *file, char __user *u, size_t count,
+			     loff_t *ppos)
+{
+	struct ubi_device *ubi = file->private_data;
+	char buf[256], *p = buf;
+
+	spin_lock(&ubi->wl_lock);
+	p += sprintf(p, "free PEBs:          %d\n", ubi->free_count);
+	p += sprintf(p, "lowest free PEBs:   %d\n", ubi->free_min);
+	p += sprintf(p, "erase-ahead:        %u\n", ubi->erase_ahead);
+	p += sprintf(p, "pending erasures:   %d\n", ubi->erase_pending);
+	p += sprintf(p, "writer stalls:      %d\n", ubi->free_stalls);
+	p += sprintf(p, "throttled writers:  %d\n", ubi->throttled);
+	spin_unlock(&ubi->wl_lock);
+
+	return simple_read_from_buffer(u, count, ppos, buf, p - buf);
+}
+
+/* Writing anything to the pool file restarts the low-water mark and counters */
+static ssize_t dfs_pool_write(struct file *file, const char __user *u,
+			      size_t count, loff_t *ppos)
+{
+	struct ubi_device *ubi = file->private_data;
+
+	spin_lock(&ubi->wl_lock);
+	ubi->free_min = ubi->free_count;
+	ubi->free_stalls = 0;
+	ubi->throttled = 0;
+	spin_unlock(&ubi->wl_lock);
+
+	return count;
+}
+
+static const struct file_operations dfs_pool_fops = {
+	.open = dfs_open,
+	.read = dfs_pool_read,
+	.write = dfs_pool_write,
+	.owner = THIS_MODULE,
+};
+
+/* The upper end of the CONFIG_MTD_UBI_ERASE_AHEAD range */
+#define UBI_MAX_ERASE_AHEAD 64
+
+static ssize_t dfs_erase_ahead_read(struct file *file, char __user *u,
+				    size_t count, loff_t *ppos)
+{
+	struct ubi_device *ubi = file->private_data;
+	char buf[16];
+	int len;
+
+	spin_lock(&ubi->wl_lock);
+	len = sprintf(buf, "%u\n", ubi->erase_ahead);
+	spin_unlock(&ubi->wl_lock);
+
+	return simple_read_from_buffer(u, count, ppos, buf, len);
+}
+
+/* Values above UBI_MAX_ERASE_AHEAD are clamped to it */
+static ssize_t dfs_erase_ahead_write(struct file *file, const char __user *u,
+				     size_t count, loff_t *ppos)
+{
+	struct ubi_device *ubi = file->private_data;
+	unsigned long val;
+	char buf[16];
+	size_t len = min(count, sizeof(buf) - 1);
+
+	if (copy_from_user(buf, u, len))
+		return -EFAULT;
+	buf[len] = '\0';
+	if (strict_strtoul(strstrip(buf), 0, &val))
+		return -EINVAL;
+
+	spin_lock(&ubi->wl_lock);
+	ubi->erase_ahead = min_t(unsigned long, val, UBI_MAX_ERASE_AHEAD);
+	spin_unlock(&ubi->wl_lock);
+
+	return count;
+}
+
+static const struct file_operations dfs_erase_ahead_fops = {
+	.open = dfs_open,
+	.read = dfs_erase_ahead_read,
+	.write = dfs_erase_ahead_write,
+	.owner = THIS_MODULE,
+};
+
+/**
+ * ubi_debugfs_init_dev - create debugfs files for an UBI device.
+ * @ubi: UBI device description object
+ *
+ * This function creates the "ubiX" debugfs directory with the following
+ * files:
+ *   o "erase_ahead" - the number of free PEBs to keep ready for writers,
+ *     at most %UBI_MAX_ERASE_AHEAD;
+ *   o "wl_pool" - how many free PEBs there are and how often writers had to
+ *     wait for one;
+ *   o "write_latency" - histogram of LEB write, change and map latencies;
+ *   o "get_peb_latency" - histogram of the time writers take to get a free
+ *     PEB.
+ * Writing to "wl_pool" or to a latency file resets its statistics. Returns
+ * zero in case of success and a negative error code in case of failure.
+ */
+int ubi_debugfs_init_dev(struct ubi_device *ubi)
+{
+	struct ubi_debug_info *d = &ubi->dbg;
+	struct dentry *dent;
+	const char *fname;
+
+	fname = ubi->ubi_name;
+	dent = debugfs_create_dir(fname, dfs_rootdir);
+	if (IS_ERR(dent) || !dent)
+		goto out;
+	d->dfs_dir = dent;
+
+	fname = "erase_ahead";
+	dent = debugfs_create_file(fname, S_IRUSR | S_IWUSR, d->dfs_dir, ubi,
+				   &dfs_erase_ahead_fops);
+	if (IS_ERR(dent) || !dent)
+		goto out_remove;
+
+	fname = "wl_pool";
+	dent = debugfs_create_file(fname, S_IRUSR | S_IWUSR, d->dfs_dir, ubi,
+				   &dfs_pool_fops);
+	if (IS_ERR(dent) || !dent)
+		goto out_remove;
+
+	fname = "write_latency";
+	dent = debugfs_create_file(fname, S_IRUSR | S_IWUSR, d->dfs_dir,
+				   &d->lat[UBI_DBG_LAT_WRITE], &dfs_lat_fops);
+	if (IS_ERR(dent) || !dent)
+		goto out_remove;
+
+	fname = "get_peb_latency";
+	dent = debugfs_create_file(fname, S_IRUSR | S_IWUSR, d->dfs_dir,
+				   &d->lat[UBI_DBG_LAT_GET_PEB], &dfs_lat_fops);
+	if (IS_ERR(dent) || !dent)
+		goto out_remove;
+
+	return 0;
+
+out_remove:
+	debugfs_remove_recursive(d->dfs_dir);
+	d->dfs_dir = NULL;
+out:
+	ubi_err("cannot create \"%s\" debugfs file or directory", fname);
+	return dent ? PTR_ERR(dent) : -ENODEV;
+}
+
+/**
+ * ubi_debugfs_remove_dev - remove debugfs files of an UBI device.
+ * @ubi: UBI device description object
+ */
+void ubi_debugfs_remove_dev(struct ubi_device *ubi)
+{
+	debugfs_remove_recursive(ubi->dbg.dfs_dir);
+}
+
 #endif /* CONFIG_MTD_UBI_DEBUG */
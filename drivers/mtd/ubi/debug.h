@@ -21,6 +21,17 @@
 #ifndef __UBI_DEBUG_H__
 #define __UBI_DEBUG_H__
 
+#include <linux/ktime.h>
+
+struct ubi_device;
+
+/* Latency histograms kept for each UBI device */
+enum {
+	UBI_DBG_LAT_WRITE,
+	UBI_DBG_LAT_GET_PEB,
+	UBI_DBG_LAT_CNT,
+};
+
 #ifdef CONFIG_MTD_UBI_DEBUG
 #include <linux/random.h>
 
@@ -150,6 +161,46 @@ static inline int ubi_dbg_is_erase_failure(void)
 #define ubi_dbg_is_erase_failure() 0
 #endif
 
+#define UBI_DBG_LAT_SLOTS 20
+
+/**
+ * struct ubi_lat_hist - latency histogram.
+ * @lock: protects the histogram
+ * @count: slot %0 counts latencies below 1 microsecond, slot @i latencies of
+ *         at least 2^(@i-1) and below 2^@i microseconds, and the last slot
+ *         everything longer
+ * @max: highest latency in microseconds
+ */
+struct ubi_lat_hist {
+	spinlock_t lock;
+	unsigned long count[UBI_DBG_LAT_SLOTS];
+	unsigned long max;
+};
+
+/**
+ * struct ubi_debug_info - debugging information for an UBI device.
+ * @lat: latency histograms, indexed by %UBI_DBG_LAT_WRITE, etc
+ * @dfs_dir: debugfs directory of the device
+ */
+struct ubi_debug_info {
+	struct ubi_lat_hist lat[UBI_DBG_LAT_CNT];
+	struct dentry *dfs_dir;
+};
+
+int ubi_debugfs_init(void);
+void ubi_debugfs_exit(void);
+int ubi_debugfs_init_dev(struct ubi_device *ubi);
+void ubi_debugfs_remove_dev(struct ubi_device *ubi);
+void ubi_dbg_lat_add(struct ubi_device *ubi, int type, ktime_t start);
+
+/**
+ * ubi_dbg_lat_start - start timing an operation for 'ubi_dbg_lat_add()'.
+ */
+static inline ktime_t ubi_dbg_lat_start(void)
+{
+	return ktime_get();
+}
+
 #else
 
 #define ubi_assert(expr)                 ({})
@@ -177,5 +228,20 @@ static inline int ubi_dbg_is_erase_failure(void)
 #define ubi_dbg_is_erase_failure() 0
 #define ubi_dbg_check_all_ff(ubi, pnum, offset, len) 0
 
+#define ubi_debugfs_init()          0
+#define ubi_debugfs_exit()          ({})
+#define ubi_debugfs_init_dev(ubi)   0
+#define ubi_debugfs_remove_dev(ubi) ({})
+
+static inline ktime_t ubi_dbg_lat_start(void)
+{
+	return ktime_set(0, 0);
+}
+
+static inline void ubi_dbg_lat_add(struct ubi_device *ubi, int type,
+				   ktime_t start)
+{
+}
+
 #endif /* !CONFIG_MTD_UBI_DEBUG */
 #endif /* !__UBI_DEBUG_H__ */
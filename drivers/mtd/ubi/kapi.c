@@ -410,6 +410,8 @@ int ubi_leb_write(struct ubi_volume_desc *desc, int lnum, const void *buf,
 	struct ubi_volume *vol = desc->vol;
 	struct ubi_device *ubi = vol->ubi;
 	int vol_id = vol->vol_id;
+	ktime_t start;
+	int err;
 
 	dbg_gen("write %d bytes to LEB %d:%d:%d", len, vol_id, lnum, offset);
 
@@ -434,7 +436,10 @@ int ubi_leb_write(struct ubi_volume_desc *desc, int lnum, const void *buf,
 	if (len == 0)
 		return 0;
 
-	return ubi_eba_write_leb(ubi, vol, lnum, buf, offset, len, dtype);
+	start = ubi_dbg_lat_start();
+	err = ubi_eba_write_leb(ubi, vol, lnum, buf, offset, len, dtype);
+	ubi_dbg_lat_add(ubi, UBI_DBG_LAT_WRITE, start);
+	return err;
 }
 EXPORT_SYMBOL_GPL(ubi_leb_write);
 
@@ -460,6 +465,8 @@ int ubi_leb_change(struct ubi_volume_desc *desc, int lnum, const void *buf,
 	struct ubi_volume *vol = desc->vol;
 	struct ubi_device *ubi = vol->ubi;
 	int vol_id = vol->vol_id;
+	ktime_t start;
+	int err;
 
 	dbg_gen("atomically write %d bytes to LEB %d:%d", len, vol_id, lnum);
 
@@ -483,7 +490,10 @@ int ubi_leb_change(struct ubi_volume_desc *desc, int lnum, const void *buf,
 	if (len == 0)
 		return 0;
 
-	return ubi_eba_atomic_leb_change(ubi, vol, lnum, buf, len, dtype);
+	start = ubi_dbg_lat_start();
+	err = ubi_eba_atomic_leb_change(ubi, vol, lnum, buf, len, dtype);
+	ubi_dbg_lat_add(ubi, UBI_DBG_LAT_WRITE, start);
+	return err;
 }
 EXPORT_SYMBOL_GPL(ubi_leb_change);
 
@@ -601,6 +611,8 @@ int ubi_leb_map(struct ubi_volume_desc *desc, int lnum, int dtype)
 {
 	struct ubi_volume *vol = desc->vol;
 	struct ubi_device *ubi = vol->ubi;
+	ktime_t start;
+	int err;
 
 	dbg_gen("unmap LEB %d:%d", vol->vol_id, lnum);
 
@@ -620,7 +632,10 @@ int ubi_leb_map(struct ubi_volume_desc *desc, int lnum, int dtype)
 	if (vol->eba_tbl[lnum] >= 0)
 		return -EBADMSG;
 
-	return ubi_eba_write_leb(ubi, vol, lnum, NULL, 0, 0, dtype);
+	start = ubi_dbg_lat_start();
+	err = ubi_eba_write_leb(ubi, vol, lnum, NULL, 0, 0, dtype);
+	ubi_dbg_lat_add(ubi, UBI_DBG_LAT_WRITE, start);
+	return err;
 }
 EXPORT_SYMBOL_GPL(ubi_leb_map);
 
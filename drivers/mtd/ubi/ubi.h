@@ -335,7 +335,8 @@ struct ubi_wl_entry;
  * @pq_head: protection queue head
  * @wl_lock: protects the @used, @free, @pq, @pq_head, @lookuptbl, @move_from,
  * 	     @move_to, @move_to_put @erase_pending, @wl_scheduled, @works,
- * 	     @erroneous, and @erroneous_peb_count fields
+ * 	     @erroneous, @erroneous_peb_count, @free_count, @free_min,
+ * 	     @free_stalls and @throttled fields
  * @move_mutex: serializes eraseblock moves
  * @work_sem: synchronizes the WL worker with use tasks
  * @wl_scheduled: non-zero if the wear-leveling was scheduled
@@ -346,6 +347,13 @@ struct ubi_wl_entry;
  * @move_to_put: if the "to" PEB was put
  * @works: list of pending works
  * @works_count: count of pending works
+ * @erase_pending: count of pending erasure works
+ * @free_count: count of physical eraseblocks in @free
+ * @free_min: lowest @free_count seen
+ * @erase_ahead: how many free physical eraseblocks to keep ready for writers
+ * @free_stalls: how many times a writer found no free physical eraseblock
+ * @throttled: how many times a writer did an erasure before taking a physical
+ *             eraseblock because @free was short of @erase_ahead
  * @bgt_thread: background thread description object
  * @thread_enabled: if the background thread is enabled
  * @bgt_name: background thread name
@@ -382,6 +390,7 @@ struct ubi_wl_entry;
  * @ckvol_mutex: serializes static volume checking when opening
  * @dbg_peb_buf: buffer of PEB size used for debugging
  * @dbg_buf_mutex: protects @dbg_peb_buf
+ * @dbg: debugging statistics and debugfs entries
  */
 struct ubi_device {
 	struct cdev cdev;
@@ -432,6 +441,12 @@ struct ubi_device {
 	int move_to_put;
 	struct list_head works;
 	int works_count;
+	int erase_pending;
+	int free_count;
+	int free_min;
+	unsigned int erase_ahead;
+	int free_stalls;
+	int throttled;
 	struct task_struct *bgt_thread;
 	int thread_enabled;
 	char bgt_name[sizeof(UBI_BGT_NAME_PATTERN)+2];
@@ -467,6 +482,9 @@ struct ubi_device {
 	void *dbg_peb_buf;
 	struct mutex dbg_buf_mutex;
 #endif
+#ifdef CONFIG_MTD_UBI_DEBUG
+	struct ubi_debug_info dbg;
+#endif
 };
 
 extern struct kmem_cache *ubi_wl_entry_slab;
@@ -36,6 +36,14 @@
  * done asynchronously in context of the per-UBI device background thread,
  * which is also managed by the WL sub-system.
  *
+ * Erasing takes milliseconds, so writers should not have to wait for it. While
+ * there are fewer than @ubi->erase_ahead free physical eraseblocks, pending
+ * erasures are done before other works, so the background thread refills the
+ * free pool first. If the pool still drains below half of @ubi->erase_ahead,
+ * each writer does one erasure itself before it gets its physical eraseblock.
+ * This slows writers down by one erasure at a time as the pool runs low, rather
+ * than stalling one of them for many erasures when it runs out.
+ *
  * The wear-leveling is ensured by means of moving the contents of used
  * physical eraseblocks with low erase counter to free physical eraseblocks
  * with high erase counter.
@@ -161,6 +169,9 @@ struct ubi_work {
 	int torture;
 };
 
+static int erase_worker(struct ubi_device *ubi, struct ubi_work *wl_wrk,
+			int cancel);
+
 #ifdef CONFIG_MTD_UBI_DEBUG_PARANOID
 static int paranoid_check_ec(struct ubi_device *ubi, int pnum, int ec);
 static int paranoid_check_in_wl_tree(struct ubi_wl_entry *e,
@@ -208,6 +219,56 @@ static void wl_tree_add(struct ubi_wl_entry *e, struct rb_root *root)
 	rb_insert_color(&e->u.rb, root);
 }
 
+/**
+ * free_tree_add - add a physical eraseblock to the free pool.
+ * @ubi: UBI device description object
+ * @e: the wear-leveling entry to add
+ *
+ * Note, @ubi->wl_lock has to be locked.
+ */
+static void free_tree_add(struct ubi_device *ubi, struct ubi_wl_entry *e)
+{
+	wl_tree_add(e, &ubi->free);
+	ubi->free_count += 1;
+}
+
+/**
+ * free_tree_del - take a physical eraseblock from the free pool.
+ * @ubi: UBI device description object
+ * @e: the wear-leveling entry to take
+ *
+ * Note, @ubi->wl_lock has to be locked.
+ */
+static void free_tree_del(struct ubi_device *ubi, struct ubi_wl_entry *e)
+{
+	rb_erase(&e->u.rb, &ubi->free);
+	ubi->free_count -= 1;
+	ubi_assert(ubi->free_count >= 0);
+	if (ubi->free_count < ubi->free_min)
+		ubi->free_min = ubi->free_count;
+}
+
+/**
+ * next_work - pick the pending work to do next.
+ * @ubi: UBI device description object
+ *
+ * Works are done in the order they were scheduled, except that pending
+ * erasures go first while the free pool is short of @ubi->erase_ahead
+ * physical eraseblocks. There is at most one wear-leveling work queued, so
+ * the erasure is found quickly. Note, @ubi->wl_lock has to be locked.
+ */
+static struct ubi_work *next_work(struct ubi_device *ubi)
+{
+	struct ubi_work *wrk;
+
+	if (ubi->erase_pending && ubi->free_count < ubi->erase_ahead)
+		list_for_each_entry(wrk, &ubi->works, list)
+			if (wrk->func == erase_worker)
+				return wrk;
+
+	return list_entry(ubi->works.next, struct ubi_work, list);
+}
+
 /**
  * do_work - do one pending work.
  * @ubi: UBI device description object
@@ -236,10 +297,12 @@ static int do_work(struct ubi_device *ubi)
 		return 0;
 	}
 
-	wrk = list_entry(ubi->works.next, struct ubi_work, list);
+	wrk = next_work(ubi);
 	list_del(&wrk->list);
 	ubi->works_count -= 1;
 	ubi_assert(ubi->works_count >= 0);
+	if (wrk->func == erase_worker)
+		ubi->erase_pending -= 1;
 	spin_unlock(&ubi->wl_lock);
 
 	/*
@@ -386,8 +449,9 @@ static struct ubi_wl_entry *find_wl_entry(struct rb_root *root, int max)
  */
 int ubi_wl_get_peb(struct ubi_device *ubi, int dtype)
 {
-	int err, medium_ec;
+	int err, medium_ec, throttled = 0;
 	struct ubi_wl_entry *e, *first, *last;
+	ktime_t start = ubi_dbg_lat_start();
 
 	ubi_assert(dtype == UBI_LONGTERM || dtype == UBI_SHORTTERM ||
 		   dtype == UBI_UNKNOWN);
@@ -401,6 +465,9 @@ retry:
 			spin_unlock(&ubi->wl_lock);
 			return -ENOSPC;
 		}
+		if (!throttled)
+			ubi->free_stalls += 1;
+		throttled = 1;
 		spin_unlock(&ubi->wl_lock);
 
 		err = produce_free_peb(ubi);
@@ -409,6 +476,23 @@ retry:
 		goto retry;
 	}
 
+	if (!throttled && ubi->erase_pending &&
+	    ubi->free_count * 2 < ubi->erase_ahead) {
+		/*
+		 * The free pool is running low, help the background thread
+		 * with one erasure so that writers slow down gradually
+		 * instead of stalling when the pool is empty.
+		 */
+		ubi->throttled += 1;
+		throttled = 1;
+		spin_unlock(&ubi->wl_lock);
+
+		err = do_work(ubi);
+		if (err)
+			return err;
+		goto retry;
+	}
+
 	switch (dtype) {
 	case UBI_LONGTERM:
 		/*
@@ -455,7 +539,7 @@ retry:
 	 * Move the physical eraseblock to the protection queue where it will
 	 * be protected from being moved for some time.
 	 */
-	rb_erase(&e->u.rb, &ubi->free);
+	free_tree_del(ubi, e);
 	dbg_wl("PEB %d EC %d", e->pnum, e->ec);
 	prot_queue_add(ubi, e);
 	spin_unlock(&ubi->wl_lock);
@@ -467,6 +551,7 @@ retry:
 		return err > 0 ? -EINVAL : err;
 	}
 
+	ubi_dbg_lat_add(ubi, UBI_DBG_LAT_GET_PEB, start);
 	return e->pnum;
 }
 
@@ -613,14 +698,13 @@ static void schedule_ubi_work(struct ubi_device *ubi, struct ubi_work *wrk)
 	list_add_tail(&wrk->list, &ubi->works);
 	ubi_assert(ubi->works_count >= 0);
 	ubi->works_count += 1;
+	if (wrk->func == erase_worker)
+		ubi->erase_pending += 1;
 	if (ubi->thread_enabled)
 		wake_up_process(ubi->bgt_thread);
 	spin_unlock(&ubi->wl_lock);
 }
 
-static int erase_worker(struct ubi_device *ubi, struct ubi_work *wl_wrk,
-			int cancel);
-
 /**
  * schedule_erase - schedule an erase work.
  * @ubi: UBI device description object
@@ -727,7 +811,7 @@ static int wear_leveling_worker(struct ubi_device *ubi, struct ubi_work *wrk,
 	}
 
 	paranoid_check_in_wl_tree(e2, &ubi->free);
-	rb_erase(&e2->u.rb, &ubi->free);
+	free_tree_del(ubi, e2);
 	ubi->move_from = e1;
 	ubi->move_to = e2;
 	spin_unlock(&ubi->wl_lock);
@@ -1020,7 +1104,7 @@ static int erase_worker(struct ubi_device *ubi, struct ubi_work *wl_wrk,
 		kfree(wl_wrk);
 
 		spin_lock(&ubi->wl_lock);
-		wl_tree_add(e, &ubi->free);
+		free_tree_add(ubi, e);
 		spin_unlock(&ubi->wl_lock);
 
 		/*
@@ -1397,6 +1481,8 @@ static void cancel_pending(struct ubi_device *ubi)
 
 		wrk = list_entry(ubi->works.next, struct ubi_work, list);
 		list_del(&wrk->list);
+		if (wrk->func == erase_worker)
+			ubi->erase_pending -= 1;
 		wrk->func(ubi, wrk, 1);
 		ubi->works_count -= 1;
 		ubi_assert(ubi->works_count >= 0);
@@ -1425,6 +1511,7 @@ int ubi_wl_init_scan(struct ubi_device *ubi, struct ubi_scan_info *si)
 	init_rwsem(&ubi->work_sem);
 	ubi->max_ec = si->max_ec;
 	INIT_LIST_HEAD(&ubi->works);
+	ubi->erase_ahead = CONFIG_MTD_UBI_ERASE_AHEAD;
 
 	sprintf(ubi->bgt_name, UBI_BGT_NAME_PATTERN, ubi->ubi_num);
 
@@ -1463,9 +1550,10 @@ int ubi_wl_init_scan(struct ubi_device *ubi, struct ubi_scan_info *si)
 		e->pnum = seb->pnum;
 		e->ec = seb->ec;
 		ubi_assert(e->ec >= 0);
-		wl_tree_add(e, &ubi->free);
+		free_tree_add(ubi, e);
 		ubi->lookuptbl[e->pnum] = e;
 	}
+	ubi->free_min = ubi->free_count;
 
 	list_for_each_entry(seb, &si->corr, u.list) {
 		cond_resched();
@@ -0,0 +1,431 @@
+/*
+ * xvmalloc memory allocator
+ *
+ * A TLSF style allocator for variable sized objects that lives on top of
+ * single (possibly highmem) pages, based on the compcache xvmalloc design.
+ *
+ * Released under the terms of GNU General Public License Version 2.0
+ *
+ * Objects never straddle a page boundary. Each page is carved into blocks,
+ * every block starting with a small header holding its size and the offset
+ * of the previous block, so that neighbours can be coalesced on free. Free
+ * blocks are kept on size segregated lists, and a two level bitmap finds a
+ * suitable non-empty list in O(1).
+ */
+
+#include <linux/bitops.h>
+#include <linux/errno.h>
+#include <linux/highmem.h>
+#include <linux/init.h>
+#include <linux/string.h>
+#include <linux/slab.h>
+
+#include "xvmalloc.h"
+#include "xvmalloc_int.h"
+
+static void stat_inc(u64 *value)
+{
+	*value = *value + 1;
+}
+
+static void stat_dec(u64 *value)
+{
+	*value = *value - 1;
+}
+
+static int test_flag(struct block_header *block, enum blockflags flag)
+{
+	return block->flags & (1 << flag);
+}
+
+static void set_flag(struct block_header *block, enum blockflags flag)
+{
+	block->flags |= (1 << flag);
+}
+
+static void clear_flag(struct block_header *block, enum blockflags flag)
+{
+	block->flags &= ~(1 << flag);
+}
+
+static void *get_ptr_atomic(struct page *page, u16 offset, enum km_type type)
+{
+	unsigned char *base;
+
+	base = kmap_atomic(page, type);
+	return base + offset;
+}
+
+static void put_ptr_atomic(void *ptr, enum km_type type)
+{
+	kunmap_atomic(ptr, type);
+}
+
+static struct link_free *get_link(struct block_header *block)
+{
+	return (struct link_free *)((char *)block + XV_HDR_SIZE);
+}
+
+/* The block following this one in its page, or NULL if it is the last */
+static struct block_header *get_next_block(struct block_header *block,
+						u16 offset)
+{
+	if (offset + XV_HDR_SIZE + block->size == PAGE_SIZE)
+		return NULL;
+
+	return (struct block_header *)((char *)block + XV_HDR_SIZE +
+					block->size);
+}
+
+/*
+ * Free list index for a block of the given size: the block may be handed
+ * out for any request that rounds to this list or a lower one.
+ */
+static u32 get_index_for_insert(u32 size)
+{
+	if (unlikely(size > XV_MAX_ALLOC_SIZE))
+		size = XV_MAX_ALLOC_SIZE;
+	size &= ~FL_DELTA_MASK;
+	return (size - XV_MIN_ALLOC_SIZE) >> FL_DELTA_SHIFT;
+}
+
+/* First free list whose every block is large enough for the given size */
+static u32 get_index(u32 size)
+{
+	if (unlikely(size < XV_MIN_ALLOC_SIZE))
+		size = XV_MIN_ALLOC_SIZE;
+	size = (size + FL_DELTA_MASK) & ~FL_DELTA_MASK;
+	return (size - XV_MIN_ALLOC_SIZE) >> FL_DELTA_SHIFT;
+}
+
+/*
+ * Find a free block of at least the given size. Returns the free list
+ * index and sets *page and *offset to the block, or sets *page to NULL
+ * if there is none.
+ */
+static u32 find_block(struct xv_pool *pool, u32 size,
+			struct page **page, u32 *offset)
+{
+	ulong flbitmap, slbitmap;
+	u32 flindex, slindex, index;
+
+	*page = NULL;
+
+	/* There are no free blocks in this pool */
+	if (!pool->flbitmap)
+		return 0;
+
+	index = get_index(size);
+	if (index >= NUM_FREE_LISTS)
+		return 0;
+
+	slindex = index % BITS_PER_LONG;
+	flindex = index / BITS_PER_LONG;
+
+	/* A suitable list in the same second level group? */
+	slbitmap = pool->slbitmap[flindex] >> slindex;
+	if (slbitmap) {
+		index += __ffs(slbitmap);
+		goto found;
+	}
+
+	/* Else the first non-empty group above it */
+	if (++flindex >= MAX_FLI)
+		return 0;
+
+	flbitmap = pool->flbitmap >> flindex;
+	if (!flbitmap)
+		return 0;
+
+	flindex += __ffs(flbitmap);
+	index = flindex * BITS_PER_LONG + __ffs(pool->slbitmap[flindex]);
+
+found:
+	*page = pool->freelist[index].page;
+	*offset = pool->freelist[index].offset;
+	return index;
+}
+
+/*
+ * Put a block on the head of its free list. The caller has the block
+ * mapped with KM_USER0, the old list head is mapped with KM_USER1.
+ */
+static void insert_block(struct xv_pool *pool, struct page *page, u32 offset,
+			struct block_header *block)
+{
+	u32 flindex, slindex, index;
+	struct link_free *link = get_link(block);
+	struct block_header *nextblock;
+
+	index = get_index_for_insert(block->size);
+	slindex = index % BITS_PER_LONG;
+	flindex = index / BITS_PER_LONG;
+
+	link->prev_page = NULL;
+	link->prev_offset = 0;
+	link->next_page = pool->freelist[index].page;
+	link->next_offset = pool->freelist[index].offset;
+	pool->freelist[index].page = page;
+	pool->freelist[index].offset = offset;
+
+	if (link->next_page) {
+		nextblock = get_ptr_atomic(link->next_page,
+					link->next_offset, KM_USER1);
+		get_link(nextblock)->prev_page = page;
+		get_link(nextblock)->prev_offset = offset;
+		put_ptr_atomic(nextblock, KM_USER1);
+	}
+
+	__set_bit(slindex, &pool->slbitmap[flindex]);
+	__set_bit(flindex, &pool->flbitmap);
+}
+
+/* Take a block off its free list, mapping neighbours with KM_USER1 */
+static void remove_block(struct xv_pool *pool, struct page *page, u32 offset,
+			struct block_header *block, u32 index)
+{
+	u32 flindex, slindex;
+	struct link_free *link = get_link(block);
+	struct block_header *tmpblock;
+
+	if (link->prev_page) {
+		tmpblock = get_ptr_atomic(link->prev_page,
+					link->prev_offset, KM_USER1);
+		get_link(tmpblock)->next_page = link->next_page;
+		get_link(tmpblock)->next_offset = link->next_offset;
+		put_ptr_atomic(tmpblock, KM_USER1);
+	}
+
+	if (link->next_page) {
+		tmpblock = get_ptr_atomic(link->next_page,
+					link->next_offset, KM_USER1);
+		get_link(tmpblock)->prev_page = link->prev_page;
+		get_link(tmpblock)->prev_offset = link->prev_offset;
+		put_ptr_atomic(tmpblock, KM_USER1);
+	}
+
+	/* Is this block the head of the free list? */
+	if (pool->freelist[index].page == page &&
+	    pool->freelist[index].offset == offset) {
+		pool->freelist[index].page = link->next_page;
+		pool->freelist[index].offset = link->next_offset;
+
+		if (!link->next_page) {
+			slindex = index % BITS_PER_LONG;
+			flindex = index / BITS_PER_LONG;
+			__clear_bit(slindex, &pool->slbitmap[flindex]);
+			if (!pool->slbitmap[flindex])
+				__clear_bit(flindex, &pool->flbitmap);
+		}
+	}
+}
+
+/* Add a fresh page to the pool as a single free block */
+static int grow_pool(struct xv_pool *pool, gfp_t flags)
+{
+	struct page *page;
+	struct block_header *block;
+
+	page = alloc_page(flags);
+	if (unlikely(!page))
+		return -ENOMEM;
+
+	spin_lock(&pool->lock);
+
+	stat_inc(&pool->total_pages);
+
+	block = get_ptr_atomic(page, 0, KM_USER0);
+	block->size = XV_MAX_ALLOC_SIZE;
+	block->prev_offset = 0;
+	block->flags = 0;
+	set_flag(block, BLOCK_FREE);
+	insert_block(pool, page, 0, block);
+	put_ptr_atomic(block, KM_USER0);
+
+	spin_unlock(&pool->lock);
+
+	return 0;
+}
+
+struct xv_pool *xv_create_pool(void)
+{
+	struct xv_pool *pool;
+
+	BUILD_BUG_ON(MAX_FLI > BITS_PER_LONG);
+	BUILD_BUG_ON(XV_MIN_ALLOC_SIZE < sizeof(struct link_free));
+	BUILD_BUG_ON(PAGE_SIZE > 65535);
+
+	pool = kzalloc(sizeof(*pool), GFP_KERNEL);
+	if (!pool)
+		return NULL;
+
+	spin_lock_init(&pool->lock);
+
+	return pool;
+}
+
+void xv_destroy_pool(struct xv_pool *pool)
+{
+	kfree(pool);
+}
+
+/**
+ * xv_malloc - Allocate a block of the given size from the pool.
+ * @pool: pool to allocate from
+ * @size: size of the block to allocate
+ * @page: page where the block was allocated
+ * @offset: offset of the block within that page
+ * @flags: gfp flags used if the pool has to grow
+ *
+ * The object can be accessed with kmap_atomic(page) + offset.
+ * Returns 0 on success and -ENOMEM on failure.
+ */
+int xv_malloc(struct xv_pool *pool, u32 size, struct page **page,
+		u32 *offset, gfp_t flags)
+{
+	int error;
+	u32 index, tmpsize, origsize, tmpoffset;
+	struct block_header *block, *tmpblock, *nextblock;
+
+	*page = NULL;
+	*offset = 0;
+	origsize = size;
+
+	if (unlikely(!size || size > XV_MAX_ALLOC_SIZE))
+		return -ENOMEM;
+
+	size = ALIGN(size, XV_ALIGN);
+	if (size < XV_MIN_ALLOC_SIZE)
+		size = XV_MIN_ALLOC_SIZE;
+
+	spin_lock(&pool->lock);
+
+	index = find_block(pool, size, page, offset);
+
+	if (!*page) {
+		spin_unlock(&pool->lock);
+		error = grow_pool(pool, flags);
+		if (unlikely(error))
+			return error;
+
+		spin_lock(&pool->lock);
+		index = find_block(pool, size, page, offset);
+	}
+
+	if (!*page) {
+		spin_unlock(&pool->lock);
+		return -ENOMEM;
+	}
+
+	block = get_ptr_atomic(*page, *offset, KM_USER0);
+
+	remove_block(pool, *page, *offset, block, index);
+
+	/* Split off the remainder if it is big enough to be a block */
+	tmpsize = block->size - size;
+	if (tmpsize >= XV_HDR_SIZE + XV_MIN_ALLOC_SIZE) {
+		tmpoffset = *offset + XV_HDR_SIZE + size;
+		tmpblock = (struct block_header *)((char *)block +
+						XV_HDR_SIZE + size);
+
+		tmpblock->size = tmpsize - XV_HDR_SIZE;
+		tmpblock->prev_offset = *offset;
+		tmpblock->flags = 0;
+		set_flag(tmpblock, BLOCK_FREE);
+
+		insert_block(pool, *page, tmpoffset, tmpblock);
+
+		/* Its successor was already marked as following a free block */
+		nextblock = get_next_block(tmpblock, tmpoffset);
+		if (nextblock)
+			nextblock->prev_offset = tmpoffset;
+
+		block->size = size;
+	} else {
+		nextblock = get_next_block(block, *offset);
+		if (nextblock)
+			clear_flag(nextblock, PREV_FREE);
+	}
+
+	clear_flag(block, BLOCK_FREE);
+
+	put_ptr_atomic(block, KM_USER0);
+	spin_unlock(&pool->lock);
+
+	*offset += XV_HDR_SIZE;
+
+	return 0;
+}
+
+/*
+ * Free the block at the given page and offset, coalescing it with free
+ * neighbours. Pages that become entirely free go back to the system.
+ */
+void xv_free(struct xv_pool *pool, struct page *page, u32 offset)
+{
+	void *page_start;
+	struct block_header *block, *tmpblock;
+
+	offset -= XV_HDR_SIZE;
+
+	spin_lock(&pool->lock);
+
+	page_start = get_ptr_atomic(page, 0, KM_USER0);
+	block = (struct block_header *)((char *)page_start + offset);
+
+	/* Merge with the next block if it is free */
+	tmpblock = get_next_block(block, offset);
+	if (tmpblock && test_flag(tmpblock, BLOCK_FREE)) {
+		remove_block(pool, page, offset + XV_HDR_SIZE + block->size,
+				tmpblock, get_index_for_insert(tmpblock->size));
+		block->size += XV_HDR_SIZE + tmpblock->size;
+	}
+
+	/* Merge with the previous block if it is free */
+	if (test_flag(block, PREV_FREE)) {
+		tmpblock = (struct block_header *)((char *)page_start +
+						block->prev_offset);
+		offset = block->prev_offset;
+		remove_block(pool, page, offset, tmpblock,
+				get_index_for_insert(tmpblock->size));
+		tmpblock->size += XV_HDR_SIZE + block->size;
+		block = tmpblock;
+	}
+
+	/* No allocated objects left in this page */
+	if (block->size == XV_MAX_ALLOC_SIZE) {
+		put_ptr_atomic(page_start, KM_USER0);
+		__free_page(page);
+		stat_dec(&pool->total_pages);
+		spin_unlock(&pool->lock);
+		return;
+	}
+
+	set_flag(block, BLOCK_FREE);
+	insert_block(pool, page, offset, block);
+
+	tmpblock = get_next_block(block, offset);
+	if (tmpblock) {
+		set_flag(tmpblock, PREV_FREE);
+		tmpblock->prev_offset = offset;
+	}
+
+	put_ptr_atomic(page_start, KM_USER0);
+	spin_unlock(&pool->lock);
+}
+
+u32 xv_get_object_size(void *obj)
+{
+	struct block_header *blk;
+
+	blk = (struct block_header *)((char *)(obj) - XV_HDR_SIZE);
+	return blk->size;
+}
+
+/*
+ * Returns total memory used by allocator (userdata + metadata)
+ */
+u64 xv_get_total_size_bytes(struct xv_pool *pool)
+{
+	return pool->total_pages << PAGE_SHIFT;
+}
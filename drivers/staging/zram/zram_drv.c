@@ -0,0 +1,850 @@
+/*
+ * Compressed RAM block device
+ *
+ * Pages written to the device are compressed with LZO and kept in memory
+ * allocated with xvmalloc. Used as a swap device this gives systems with
+ * little memory and no suitable backing store more effective memory.
+ *
+ * Released under the terms of GNU General Public License Version 2.0
+ */
+
+#define KMSG_COMPONENT "zram"
+#define pr_fmt(fmt) KMSG_COMPONENT ": " fmt
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/bio.h>
+#include <linux/bitops.h>
+#include <linux/blkdev.h>
+#include <linux/buffer_head.h>
+#include <linux/device.h>
+#include <linux/genhd.h>
+#include <linux/highmem.h>
+#include <linux/lzo.h>
+#include <linux/string.h>
+#include <linux/swap.h>
+#include <linux/vmalloc.h>
+
+#include "zram_drv.h"
+
+/* Globals */
+static int zram_major;
+static struct zram *devices;
+
+/* Module params (documentation at end) */
+static unsigned int num_devices = 1;
+static unsigned long disksize_kb;
+
+static int zram_test_flag(struct zram *zram, u32 index,
+			enum zram_pageflags flag)
+{
+	return zram->table[index].flags & BIT(flag);
+}
+
+static void zram_set_flag(struct zram *zram, u32 index,
+			enum zram_pageflags flag)
+{
+	zram->table[index].flags |= BIT(flag);
+}
+
+static void zram_clear_flag(struct zram *zram, u32 index,
+			enum zram_pageflags flag)
+{
+	zram->table[index].flags &= ~BIT(flag);
+}
+
+static int page_zero_filled(void *ptr)
+{
+	unsigned int pos;
+	unsigned long *page;
+
+	page = (unsigned long *)ptr;
+
+	for (pos = 0; pos != PAGE_SIZE / sizeof(*page); pos++) {
+		if (page[pos])
+			return 0;
+	}
+
+	return 1;
+}
+
+static void zram_stat64_add(struct zram *zram, u64 *v, u64 inc)
+{
+	spin_lock(&zram->stat64_lock);
+	*v = *v + inc;
+	spin_unlock(&zram->stat64_lock);
+}
+
+static void zram_stat64_sub(struct zram *zram, u64 *v, u64 dec)
+{
+	spin_lock(&zram->stat64_lock);
+	*v = *v - dec;
+	spin_unlock(&zram->stat64_lock);
+}
+
+static void zram_stat64_inc(struct zram *zram, u64 *v)
+{
+	zram_stat64_add(zram, v, 1);
+}
+
+static u64 zram_stat64_read(struct zram *zram, u64 *v)
+{
+	u64 val;
+
+	spin_lock(&zram->stat64_lock);
+	val = *v;
+	spin_unlock(&zram->stat64_lock);
+
+	return val;
+}
+
+static u64 zram_default_disksize(void)
+{
+	u64 disksize;
+
+	if (disksize_kb)
+		disksize = (u64)disksize_kb << 10;
+	else
+		disksize = ZRAM_DEFAULT_DISKSIZE_PERCENT *
+			((u64)totalram_pages << PAGE_SHIFT) / 100;
+
+	return disksize & PAGE_MASK;
+}
+
+static void zram_free_page(struct zram *zram, size_t index)
+{
+	u32 clen;
+	struct page *page = zram->table[index].page;
+	u32 offset = zram->table[index].offset;
+
+	if (unlikely(!page)) {
+		/*
+		 * No memory is allocated for zero filled pages.
+		 * Simply clear zero page flag.
+		 */
+		if (zram_test_flag(zram, index, ZRAM_ZERO)) {
+			zram_clear_flag(zram, index, ZRAM_ZERO);
+			zram_stat64_sub(zram, &zram->stats.pages_zero, 1);
+		}
+		return;
+	}
+
+	if (unlikely(zram_test_flag(zram, index, ZRAM_UNCOMPRESSED))) {
+		clen = PAGE_SIZE;
+		__free_page(page);
+		zram_clear_flag(zram, index, ZRAM_UNCOMPRESSED);
+		zram_stat64_sub(zram, &zram->stats.pages_expand, 1);
+	} else {
+		clen = zram->table[index].size;
+		xv_free(zram->mem_pool, page, offset);
+		if (clen <= ZRAM_GOOD_COMPRESS_SIZE)
+			zram_stat64_sub(zram, &zram->stats.good_compress, 1);
+	}
+
+	zram_stat64_sub(zram, &zram->stats.compr_size, clen);
+	zram_stat64_sub(zram, &zram->stats.pages_stored, 1);
+
+	zram->table[index].page = NULL;
+	zram->table[index].offset = 0;
+	zram->table[index].size = 0;
+}
+
+static int zram_read_page(struct zram *zram, struct page *page, u32 index)
+{
+	int ret;
+	size_t clen;
+	unsigned char *user_mem, *cmem;
+
+	/* Never written to or a zero page */
+	if (!zram->table[index].page) {
+		user_mem = kmap_atomic(page, KM_USER0);
+		memset(user_mem, 0, PAGE_SIZE);
+		kunmap_atomic(user_mem, KM_USER0);
+		flush_dcache_page(page);
+		return 0;
+	}
+
+	user_mem = kmap_atomic(page, KM_USER0);
+	cmem = kmap_atomic(zram->table[index].page, KM_USER1) +
+		zram->table[index].offset;
+
+	if (unlikely(zram_test_flag(zram, index, ZRAM_UNCOMPRESSED))) {
+		memcpy(user_mem, cmem, PAGE_SIZE);
+		ret = LZO_E_OK;
+		clen = PAGE_SIZE;
+	} else {
+		clen = PAGE_SIZE;
+		ret = lzo1x_decompress_safe(cmem, zram->table[index].size,
+					    user_mem, &clen);
+	}
+
+	kunmap_atomic(user_mem, KM_USER0);
+	kunmap_atomic(cmem, KM_USER1);
+
+	/* Should NEVER happen. Return bio error if it does. */
+	if (unlikely(ret != LZO_E_OK || clen != PAGE_SIZE)) {
+		pr_err("Decompression failed! err=%d, page=%u\n", ret, index);
+		return -EIO;
+	}
+
+	flush_dcache_page(page);
+
+	return 0;
+}
+
+static int zram_write_page(struct zram *zram, struct page *page, u32 index)
+{
+	int ret, uncompressed = 0;
+	u32 offset;
+	size_t clen;
+	struct page *page_store;
+	unsigned char *user_mem, *cmem, *src;
+
+	mutex_lock(&zram->lock);
+
+	/*
+	 * System overwrites unused sectors. Free memory associated
+	 * with this sector now.
+	 */
+	spin_lock(&zram->table_lock);
+	if (zram->table[index].page ||
+	    zram_test_flag(zram, index, ZRAM_ZERO))
+		zram_free_page(zram, index);
+	spin_unlock(&zram->table_lock);
+
+	user_mem = kmap_atomic(page, KM_USER0);
+	if (page_zero_filled(user_mem)) {
+		kunmap_atomic(user_mem, KM_USER0);
+		spin_lock(&zram->table_lock);
+		zram_set_flag(zram, index, ZRAM_ZERO);
+		zram_stat64_inc(zram, &zram->stats.pages_zero);
+		spin_unlock(&zram->table_lock);
+		mutex_unlock(&zram->lock);
+		return 0;
+	}
+
+	ret = lzo1x_1_compress(user_mem, PAGE_SIZE, zram->compress_buffer,
+			       &clen, zram->compress_workmem);
+
+	kunmap_atomic(user_mem, KM_USER0);
+
+	if (unlikely(ret != LZO_E_OK)) {
+		mutex_unlock(&zram->lock);
+		pr_err("Compression failed! err=%d\n", ret);
+		return -EIO;
+	}
+
+	src = zram->compress_buffer;
+
+	/* Page is incompressible. Store it as-is (uncompressed) */
+	if (unlikely(clen > ZRAM_MAX_ZPAGE_SIZE)) {
+		clen = PAGE_SIZE;
+		page_store = alloc_page(GFP_NOIO | __GFP_HIGHMEM);
+		if (unlikely(!page_store)) {
+			mutex_unlock(&zram->lock);
+			pr_info("Error allocating memory for incompressible "
+				"page: %u\n", index);
+			return -ENOMEM;
+		}
+
+		offset = 0;
+		uncompressed = 1;
+		src = kmap_atomic(page, KM_USER0);
+	} else if (xv_malloc(zram->mem_pool, clen, &page_store, &offset,
+			     GFP_NOIO | __GFP_HIGHMEM)) {
+		mutex_unlock(&zram->lock);
+		pr_info("Error allocating memory for compressed page: %u, "
+			"size=%zu\n", index, clen);
+		return -ENOMEM;
+	}
+
+	cmem = kmap_atomic(page_store, KM_USER1) + offset;
+
+	memcpy(cmem, src, clen);
+
+	kunmap_atomic(cmem, KM_USER1);
+	if (unlikely(uncompressed))
+		kunmap_atomic(src, KM_USER0);
+
+	/* Only a complete entry is visible to zram_slot_free_notify() */
+	spin_lock(&zram->table_lock);
+	zram->table[index].page = page_store;
+	zram->table[index].offset = offset;
+	if (unlikely(uncompressed))
+		zram_set_flag(zram, index, ZRAM_UNCOMPRESSED);
+	else
+		zram->table[index].size = clen;
+
+	/* Update stats, before a free notify can take them back */
+	if (unlikely(uncompressed))
+		zram_stat64_inc(zram, &zram->stats.pages_expand);
+	zram_stat64_add(zram, &zram->stats.compr_size, clen);
+	zram_stat64_inc(zram, &zram->stats.pages_stored);
+	if (clen <= ZRAM_GOOD_COMPRESS_SIZE)
+		zram_stat64_inc(zram, &zram->stats.good_compress);
+	spin_unlock(&zram->table_lock);
+
+	mutex_unlock(&zram->lock);
+
+	return 0;
+}
+
+/* Free the pages wholly covered by a discard request */
+static void zram_discard(struct zram *zram, struct bio *bio)
+{
+	u64 start = (u64)bio->bi_sector << SECTOR_SHIFT;
+	u64 end = start + bio->bi_size;
+	size_t index;
+
+	if (end > zram->disksize)
+		end = zram->disksize;
+	start = (start + PAGE_SIZE - 1) >> PAGE_SHIFT;
+	end >>= PAGE_SHIFT;
+
+	mutex_lock(&zram->lock);
+	for (index = start; index < end; index++) {
+		spin_lock(&zram->table_lock);
+		if (zram->table[index].page ||
+		    zram_test_flag(zram, index, ZRAM_ZERO)) {
+			zram_free_page(zram, index);
+			zram_stat64_inc(zram, &zram->stats.notify_free);
+		}
+		spin_unlock(&zram->table_lock);
+	}
+	mutex_unlock(&zram->lock);
+}
+
+/*
+ * Check if request is within bounds and page aligned.
+ */
+static inline int valid_io_request(struct zram *zram, struct bio *bio)
+{
+	if (unlikely(
+		(bio->bi_sector >= (zram->disksize >> SECTOR_SHIFT)) ||
+		(bio->bi_sector & (SECTORS_PER_PAGE - 1)) ||
+		(bio->bi_size & (PAGE_SIZE - 1)) ||
+		((u64)(bio->bi_sector << SECTOR_SHIFT) + bio->bi_size >
+			zram->disksize))) {
+
+		return 0;
+	}
+
+	/* I/O request is valid */
+	return 1;
+}
+
+/*
+ * Handler function for all zram I/O requests.
+ */
+static int zram_make_request(struct request_queue *queue, struct bio *bio)
+{
+	int i, ret = 0;
+	u32 index;
+	struct bio_vec *bvec;
+	struct zram *zram = queue->queuedata;
+
+	if (unlikely(!zram->init_done)) {
+		bio_io_error(bio);
+		return 0;
+	}
+
+	/* Discards need not be page aligned; only whole pages are freed */
+	if (bio_rw_flagged(bio, BIO_RW_DISCARD)) {
+		zram_discard(zram, bio);
+		set_bit(BIO_UPTODATE, &bio->bi_flags);
+		bio_endio(bio, 0);
+		return 0;
+	}
+
+	if (!valid_io_request(zram, bio)) {
+		zram_stat64_inc(zram, &zram->stats.invalid_io);
+		bio_io_error(bio);
+		return 0;
+	}
+
+	index = bio->bi_sector >> SECTORS_PER_PAGE_SHIFT;
+
+	bio_for_each_segment(bvec, bio, i) {
+		if (unlikely(bvec->bv_offset || bvec->bv_len != PAGE_SIZE)) {
+			zram_stat64_inc(zram, &zram->stats.invalid_io);
+			ret = -EIO;
+			break;
+		}
+
+		if (bio_data_dir(bio) == READ) {
+			zram_stat64_inc(zram, &zram->stats.num_reads);
+			ret = zram_read_page(zram, bvec->bv_page, index);
+			if (ret)
+				zram_stat64_inc(zram,
+						&zram->stats.failed_reads);
+		} else {
+			zram_stat64_inc(zram, &zram->stats.num_writes);
+			ret = zram_write_page(zram, bvec->bv_page, index);
+			if (ret)
+				zram_stat64_inc(zram,
+						&zram->stats.failed_writes);
+		}
+
+		if (ret)
+			break;
+
+		index++;
+	}
+
+	if (!ret)
+		set_bit(BIO_UPTODATE, &bio->bi_flags);
+	bio_endio(bio, ret);
+
+	return 0;
+}
+
+static void zram_reset_device(struct zram *zram)
+{
+	size_t index;
+
+	mutex_lock(&zram->lock);
+
+	zram->init_done = 0;
+
+	/* Free various per-device buffers */
+	kfree(zram->compress_workmem);
+	free_pages((unsigned long)zram->compress_buffer, 1);
+
+	zram->compress_workmem = NULL;
+	zram->compress_buffer = NULL;
+
+	/* Free all pages that are still in this zram device */
+	if (zram->table) {
+		for (index = 0; index < zram->disksize >> PAGE_SHIFT;
+		     index++)
+			zram_free_page(zram, index);
+	}
+
+	vfree(zram->table);
+	zram->table = NULL;
+
+	if (zram->mem_pool)
+		xv_destroy_pool(zram->mem_pool);
+	zram->mem_pool = NULL;
+
+	/* Reset stats */
+	memset(&zram->stats, 0, sizeof(zram->stats));
+
+	zram->disksize = 0;
+	set_capacity(zram->disk, 0);
+
+	mutex_unlock(&zram->lock);
+}
+
+static int zram_init_device(struct zram *zram, u64 disksize)
+{
+	int ret;
+	size_t num_pages;
+
+	mutex_lock(&zram->lock);
+
+	if (zram->init_done) {
+		mutex_unlock(&zram->lock);
+		return 0;
+	}
+
+	zram->disksize = disksize & PAGE_MASK;
+	if (!zram->disksize) {
+		mutex_unlock(&zram->lock);
+		return -EINVAL;
+	}
+
+	zram->compress_workmem = kzalloc(LZO1X_MEM_COMPRESS, GFP_KERNEL);
+	if (!zram->compress_workmem) {
+		pr_err("Error allocating compressor working memory!\n");
+		ret = -ENOMEM;
+		goto fail;
+	}
+
+	/* LZO may expand incompressible data by a little */
+	zram->compress_buffer =
+		(void *)__get_free_pages(GFP_KERNEL | __GFP_ZERO, 1);
+	if (!zram->compress_buffer) {
+		pr_err("Error allocating compressor buffer space\n");
+		ret = -ENOMEM;
+		goto fail;
+	}
+
+	num_pages = zram->disksize >> PAGE_SHIFT;
+	zram->table = vmalloc(num_pages * sizeof(*zram->table));
+	if (!zram->table) {
+		pr_err("Error allocating zram address table\n");
+		ret = -ENOMEM;
+		goto fail;
+	}
+	memset(zram->table, 0, num_pages * sizeof(*zram->table));
+
+	set_capacity(zram->disk, zram->disksize >> SECTOR_SHIFT);
+
+	/* zram devices sort of resembles non-rotational disks */
+	queue_flag_set_unlocked(QUEUE_FLAG_NONROT, zram->disk->queue);
+
+	zram->mem_pool = xv_create_pool();
+	if (!zram->mem_pool) {
+		pr_err("Error creating memory pool\n");
+		ret = -ENOMEM;
+		goto fail;
+	}
+
+	zram->init_done = 1;
+	mutex_unlock(&zram->lock);
+
+	pr_debug("Initialization done!\n");
+	return 0;
+
+fail:
+	mutex_unlock(&zram->lock);
+	zram_reset_device(zram);
+
+	pr_err("Initialization failed: err=%d\n", ret);
+	return ret;
+}
+
+/*
+ * Called by swap with swap_lock held when a swap slot on this device is
+ * no longer in use, so the memory backing it can be released right away.
+ * zram->lock is a mutex and cannot be taken here: table_lock keeps the
+ * entry consistent with a write to the same slot.
+ */
+static void zram_slot_free_notify(struct block_device *bdev,
+				unsigned long index)
+{
+	struct zram *zram = bdev->bd_disk->private_data;
+
+	if (unlikely(!zram->init_done ||
+		     index >= (zram->disksize >> PAGE_SHIFT)))
+		return;
+
+	/* only count frees of slots that hold something */
+	spin_lock(&zram->table_lock);
+	if (zram->table[index].page ||
+	    zram_test_flag(zram, index, ZRAM_ZERO)) {
+		zram_free_page(zram, index);
+		zram_stat64_inc(zram, &zram->stats.notify_free);
+	}
+	spin_unlock(&zram->table_lock);
+}
+
+static struct block_device_operations zram_devops = {
+	.swap_slot_free_notify = zram_slot_free_notify,
+	.owner = THIS_MODULE
+};
+
+/*-- sysfs interface */
+
+static struct zram *dev_to_zram(struct device *dev)
+{
+	return dev_to_disk(dev)->private_data;
+}
+
+static int zram_in_use(struct zram *zram)
+{
+	struct block_device *bdev;
+	int in_use;
+
+	bdev = bdget_disk(zram->disk, 0);
+	if (!bdev)
+		return 0;
+	in_use = bdev->bd_openers != 0;
+	if (!in_use)
+		fsync_bdev(bdev);
+	bdput(bdev);
+
+	return in_use;
+}
+
+static ssize_t disksize_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%llu\n", dev_to_zram(dev)->disksize);
+}
+
+static ssize_t disksize_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	unsigned long long disksize;
+	int ret;
+
+	ret = strict_strtoull(buf, 10, &disksize);
+	if (ret)
+		return ret;
+
+	if (zram_in_use(zram))
+		return -EBUSY;
+
+	zram_reset_device(zram);
+	ret = zram_init_device(zram, disksize);
+
+	return ret ? ret : len;
+}
+
+static ssize_t initstate_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", dev_to_zram(dev)->init_done);
+}
+
+static ssize_t reset_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	unsigned long do_reset;
+	int ret;
+
+	ret = strict_strtoul(buf, 10, &do_reset);
+	if (ret)
+		return ret;
+
+	if (!do_reset)
+		return -EINVAL;
+
+	if (zram_in_use(zram))
+		return -EBUSY;
+
+	zram_reset_device(zram);
+
+	return len;
+}
+
+#define ZRAM_STAT_ATTR(name, expr)					\
+static ssize_t name##_show(struct device *dev,				\
+		struct device_attribute *attr, char *buf)		\
+{									\
+	struct zram *zram = dev_to_zram(dev);				\
+									\
+	return sprintf(buf, "%llu\n", (unsigned long long)(expr));	\
+}									\
+static DEVICE_ATTR(name, S_IRUGO, name##_show, NULL)
+
+ZRAM_STAT_ATTR(num_reads,
+	zram_stat64_read(zram, &zram->stats.num_reads));
+ZRAM_STAT_ATTR(num_writes,
+	zram_stat64_read(zram, &zram->stats.num_writes));
+ZRAM_STAT_ATTR(failed_reads,
+	zram_stat64_read(zram, &zram->stats.failed_reads));
+ZRAM_STAT_ATTR(failed_writes,
+	zram_stat64_read(zram, &zram->stats.failed_writes));
+ZRAM_STAT_ATTR(invalid_io,
+	zram_stat64_read(zram, &zram->stats.invalid_io));
+ZRAM_STAT_ATTR(notify_free,
+	zram_stat64_read(zram, &zram->stats.notify_free));
+ZRAM_STAT_ATTR(zero_pages,
+	zram_stat64_read(zram, &zram->stats.pages_zero));
+ZRAM_STAT_ATTR(incompressible_pages,
+	zram_stat64_read(zram, &zram->stats.pages_expand));
+ZRAM_STAT_ATTR(good_compress_pages,
+	zram_stat64_read(zram, &zram->stats.good_compress));
+ZRAM_STAT_ATTR(orig_data_size,
+	zram_stat64_read(zram, &zram->stats.pages_stored) << PAGE_SHIFT);
+ZRAM_STAT_ATTR(compr_data_size,
+	zram_stat64_read(zram, &zram->stats.compr_size));
+ZRAM_STAT_ATTR(mem_used_total,
+	zram->init_done ? xv_get_total_size_bytes(zram->mem_pool) +
+		((zram->disksize >> PAGE_SHIFT) * sizeof(*zram->table)) +
+		(zram_stat64_read(zram, &zram->stats.pages_expand) <<
+			PAGE_SHIFT) : 0);
+
+static DEVICE_ATTR(disksize, S_IRUGO | S_IWUSR,
+		disksize_show, disksize_store);
+static DEVICE_ATTR(initstate, S_IRUGO, initstate_show, NULL);
+static DEVICE_ATTR(reset, S_IWUSR, NULL, reset_store);
+
+static struct attribute *zram_disk_attrs[] = {
+	&dev_attr_disksize.attr,
+	&dev_attr_initstate.attr,
+	&dev_attr_reset.attr,
+	&dev_attr_num_reads.attr,
+	&dev_attr_num_writes.attr,
+	&dev_attr_failed_reads.attr,
+	&dev_attr_failed_writes.attr,
+	&dev_attr_invalid_io.attr,
+	&dev_attr_notify_free.attr,
+	&dev_attr_zero_pages.attr,
+	&dev_attr_incompressible_pages.attr,
+	&dev_attr_good_compress_pages.attr,
+	&dev_attr_orig_data_size.attr,
+	&dev_attr_compr_data_size.attr,
+	&dev_attr_mem_used_total.attr,
+	NULL,
+};
+
+static struct attribute_group zram_disk_attr_group = {
+	.attrs = zram_disk_attrs,
+};
+
+static int create_device(struct zram *zram, int device_id)
+{
+	int ret;
+
+	mutex_init(&zram->lock);
+	spin_lock_init(&zram->stat64_lock);
+	spin_lock_init(&zram->table_lock);
+
+	zram->queue = blk_alloc_queue(GFP_KERNEL);
+	if (!zram->queue) {
+		pr_err("Error allocating disk queue for device %d\n",
+			device_id);
+		return -ENOMEM;
+	}
+
+	blk_queue_make_request(zram->queue, zram_make_request);
+	zram->queue->queuedata = zram;
+
+	 /* gendisk structure */
+	zram->disk = alloc_disk(1);
+	if (!zram->disk) {
+		pr_warning("Error allocating disk structure for device %d\n",
+			device_id);
+		ret = -ENOMEM;
+		goto out_free_queue;
+	}
+
+	zram->disk->major = zram_major;
+	zram->disk->first_minor = device_id;
+	zram->disk->fops = &zram_devops;
+	zram->disk->queue = zram->queue;
+	zram->disk->private_data = zram;
+	snprintf(zram->disk->disk_name, 16, "zram%d", device_id);
+
+	/* Actual capacity set using sysfs (/sys/block/zram<id>/disksize) */
+	set_capacity(zram->disk, 0);
+
+	/*
+	 * To ensure that we always get PAGE_SIZE aligned
+	 * and n*PAGE_SIZED sized I/O requests.
+	 */
+	blk_queue_physical_block_size(zram->disk->queue, PAGE_SIZE);
+	blk_queue_logical_block_size(zram->disk->queue, PAGE_SIZE);
+	blk_queue_io_min(zram->disk->queue, PAGE_SIZE);
+	blk_queue_io_opt(zram->disk->queue, PAGE_SIZE);
+
+	/* Swap discards freed clusters and swapon discards everything */
+	queue_flag_set_unlocked(QUEUE_FLAG_DISCARD, zram->disk->queue);
+	blk_queue_max_discard_sectors(zram->disk->queue, UINT_MAX >> 9);
+
+	add_disk(zram->disk);
+
+	ret = sysfs_create_group(&disk_to_dev(zram->disk)->kobj,
+				&zram_disk_attr_group);
+	if (ret < 0) {
+		pr_warning("Error creating sysfs group for device %d\n",
+			device_id);
+		goto out_free_disk;
+	}
+
+	zram->init_done = 0;
+
+	return 0;
+
+out_free_disk:
+	del_gendisk(zram->disk);
+	put_disk(zram->disk);
+	zram->disk = NULL;
+out_free_queue:
+	blk_cleanup_queue(zram->queue);
+	zram->queue = NULL;
+	return ret;
+}
+
+static void destroy_device(struct zram *zram)
+{
+	if (zram->disk) {
+		sysfs_remove_group(&disk_to_dev(zram->disk)->kobj,
+				&zram_disk_attr_group);
+		del_gendisk(zram->disk);
+		put_disk(zram->disk);
+	}
+
+	if (zram->queue)
+		blk_cleanup_queue(zram->queue);
+}
+
+static int __init zram_init(void)
+{
+	int ret, dev_id;
+
+	if (num_devices > 256) {
+		pr_err("Invalid value for num_devices: %u\n", num_devices);
+		ret = -EINVAL;
+		goto out;
+	}
+
+	zram_major = register_blkdev(0, "zram");
+	if (zram_major <= 0) {
+		pr_warning("Unable to get major number\n");
+		ret = -EBUSY;
+		goto out;
+	}
+
+	if (!num_devices) {
+		pr_info("num_devices not specified. Using default: 1\n");
+		num_devices = 1;
+	}
+
+	/* Allocate the device array and initialize each one */
+	pr_info("Creating %u devices ...\n", num_devices);
+	devices = kzalloc(num_devices * sizeof(struct zram), GFP_KERNEL);
+	if (!devices) {
+		ret = -ENOMEM;
+		goto unregister;
+	}
+
+	for (dev_id = 0; dev_id < num_devices; dev_id++) {
+		ret = create_device(&devices[dev_id], dev_id);
+		if (ret)
+			goto free_devices;
+	}
+
+	/* The first device is ready for mkswap/swapon straight away */
+	ret = zram_init_device(&devices[0], zram_default_disksize());
+	if (ret)
+		goto free_devices;
+
+	return 0;
+
+free_devices:
+	/* create_device() cleans up after itself if it fails */
+	while (--dev_id >= 0)
+		destroy_device(&devices[dev_id]);
+	kfree(devices);
+unregister:
+	unregister_blkdev(zram_major, "zram");
+out:
+	return ret;
+}
+
+static void __exit zram_exit(void)
+{
+	int i;
+	struct zram *zram;
+
+	for (i = 0; i < num_devices; i++) {
+		zram = &devices[i];
+
+		if (zram->init_done)
+			zram_reset_device(zram);
+		destroy_device(zram);
+	}
+
+	unregister_blkdev(zram_major, "zram");
+
+	kfree(devices);
+	pr_debug("Cleanup done!\n");
+}
+
+module_param(num_devices, uint, 0);
+MODULE_PARM_DESC(num_devices, "Number of zram devices");
+module_param(disksize_kb, ulong, 0);
+MODULE_PARM_DESC(disksize_kb, "Size of zram0 in KiB (default: 25% of RAM)");
+
+module_init(zram_init);
+module_exit(zram_exit);
+
+MODULE_LICENSE("Dual BSD/GPL");
+MODULE_DESCRIPTION("Compressed RAM Block Device");
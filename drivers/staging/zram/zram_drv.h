@@ -0,0 +1,100 @@
+/*
+ * Compressed RAM block device
+ *
+ * Pages written to the device are compressed with LZO and kept in memory
+ * allocated with xvmalloc.
+ *
+ * Released under the terms of GNU General Public License Version 2.0
+ */
+
+#ifndef _ZRAM_DRV_H_
+#define _ZRAM_DRV_H_
+
+#include <linux/spinlock.h>
+#include <linux/mutex.h>
+
+#include "xvmalloc.h"
+
+/*-- Configurable parameters */
+
+/* Default zram disk size: 25% of total RAM */
+#define ZRAM_DEFAULT_DISKSIZE_PERCENT	25
+
+/*
+ * Pages that compress to a size larger than this are stored
+ * uncompressed in memory.
+ */
+#define ZRAM_MAX_ZPAGE_SIZE	(PAGE_SIZE / 4 * 3)
+
+/*
+ * Compressed pages of this size or less count as "good" compressions
+ * in the statistics.
+ */
+#define ZRAM_GOOD_COMPRESS_SIZE	(PAGE_SIZE / 2)
+
+/*-- End of configurable params */
+
+#define SECTOR_SHIFT		9
+#define SECTOR_SIZE		(1 << SECTOR_SHIFT)
+#define SECTORS_PER_PAGE_SHIFT	(PAGE_SHIFT - SECTOR_SHIFT)
+#define SECTORS_PER_PAGE	(1 << SECTORS_PER_PAGE_SHIFT)
+
+/* Flags for zram pages (table[page_no].flags) */
+enum zram_pageflags {
+	/* Page is stored uncompressed */
+	ZRAM_UNCOMPRESSED,
+
+	/* Page consists entirely of zeros */
+	ZRAM_ZERO,
+
+	__NR_ZRAM_PAGEFLAGS,
+};
+
+/*-- Data structures */
+
+/* Allocated for each disk page */
+struct table {
+	struct page *page;
+	u16 offset;
+	u16 size;	/* compressed size, 0 for zero or uncompressed pages */
+	u8 flags;
+} __attribute__((aligned(4)));
+
+struct zram_stats {
+	/* basic stats */
+	u64 compr_size;		/* compressed size of pages stored */
+	u64 num_reads;		/* failed + successful */
+	u64 num_writes;		/* --do-- */
+	u64 failed_reads;
+	u64 failed_writes;
+	u64 invalid_io;		/* non-page-aligned I/O requests */
+	u64 notify_free;	/* slots freed by swap or discard */
+	u64 pages_zero;		/* no. of zero filled pages */
+	u64 pages_stored;	/* no. of pages currently stored */
+	u64 good_compress;	/* % of pages with compression ratio <= 50% */
+	u64 pages_expand;	/* % of incompressible pages */
+};
+
+struct zram {
+	struct xv_pool *mem_pool;
+	void *compress_workmem;
+	void *compress_buffer;
+	struct table *table;
+	spinlock_t stat64_lock;	/* protect 64-bit stats */
+	spinlock_t table_lock;	/* protect table entries against free notify */
+	struct mutex lock;	/* protect compression buffers and init */
+	struct request_queue *queue;
+	struct gendisk *disk;
+	int init_done;
+	/*
+	 * This is the limit on amount of *uncompressed* worth of data
+	 * we can store in a disk.
+	 */
+	u64 disksize;	/* bytes */
+
+	struct zram_stats stats;
+};
+
+/*-- */
+
+#endif
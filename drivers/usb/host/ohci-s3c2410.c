@@ -495,6 +495,7 @@ static struct platform_driver ohci_hcd_s3c2410_driver = {
 	.driver		= {
 		.owner	= THIS_MODULE,
 		.name	= "s3c2410-ohci",
+		.probe_async = true,
 	},
 };
 
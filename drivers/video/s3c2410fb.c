@@ -1102,6 +1102,7 @@ static struct platform_driver s3c2410fb_driver = {
 	.driver		= {
 		.name	= "s3c2410-lcd",
 		.owner	= THIS_MODULE,
+		.probe_async = true,
 	},
 };
 
@@ -1113,6 +1114,7 @@ static struct platform_driver s3c2412fb_driver = {
 	.driver		= {
 		.name	= "s3c2412-lcd",
 		.owner	= THIS_MODULE,
+		.probe_async = true,
 	},
 };
 
@@ -6,6 +6,7 @@
 #include <linux/nls.h>
 #include <linux/fs.h>
 #include <linux/mutex.h>
+#include <linux/workqueue.h>
 #include <linux/msdos_fs.h>
 
 /*
@@ -44,7 +45,8 @@ struct fat_mount_options {
 		 nocase:1,	  /* Does this need case conversion? 0=need case conversion*/
 		 usefree:1,	  /* Use free_clusters for FAT32 */
 		 tz_utc:1,	  /* Filesystem timestamps are in UTC */
-		 rodir:1;	  /* allow ATTR_RO for directory */
+		 rodir:1,	  /* allow ATTR_RO for directory */
+		 freemap:1;	  /* keep a bitmap of the free clusters */
 };
 
 #define FAT_HASH_BITS	8
@@ -81,6 +83,13 @@ struct msdos_sb_info {
 	struct fatent_operations *fatent_ops;
 	struct inode *fat_inode;
 
+#ifdef CONFIG_FAT_FREE_BITMAP
+	unsigned long *freemap;	     /* clusters in use, NULL if none */
+	unsigned long freemap_next;  /* first cluster not yet in freemap */
+	struct work_struct freemap_work;
+	struct super_block *freemap_sb;
+#endif
+
 	spinlock_t inode_hash_lock;
 	struct hlist_head inode_hashtable[FAT_HASH_SIZE];
 };
@@ -295,6 +304,17 @@ extern int fat_alloc_clusters(struct inode *inode, int *cluster,
 			      int nr_cluster);
 extern int fat_free_clusters(struct inode *inode, int cluster);
 extern int fat_count_free_clusters(struct super_block *sb);
+#ifdef CONFIG_FAT_FREE_BITMAP
+extern void fat_freemap_init(struct super_block *sb);
+extern void fat_freemap_exit(struct super_block *sb);
+#else
+static inline void fat_freemap_init(struct super_block *sb)
+{
+}
+static inline void fat_freemap_exit(struct super_block *sb)
+{
+}
+#endif
 
 /* fat/file.c */
 extern int fat_generic_ioctl(struct inode *inode, struct file *filp,
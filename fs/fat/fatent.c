@@ -7,6 +7,7 @@
 #include <linux/fs.h>
 #include <linux/msdos_fs.h>
 #include <linux/blkdev.h>
+#include <linux/vmalloc.h>
 #include "fat.h"
 
 struct fatent_operations {
@@ -452,6 +453,279 @@ static void fat_collect_bhs(struct buffer_head **bhs, int *nr_bhs,
 	}
 }
 
+/* 128kb is the whole sectors for FAT12 and FAT16 */
+#define FAT_READA_SIZE		(128 * 1024)
+
+static void fat_ent_reada(struct super_block *sb, struct fat_entry *fatent,
+			  unsigned long reada_blocks)
+{
+	struct fatent_operations *ops = MSDOS_SB(sb)->fatent_ops;
+	sector_t blocknr;
+	int i, offset;
+
+	ops->ent_blocknr(sb, fatent->entry, &offset, &blocknr);
+
+	for (i = 0; i < reada_blocks; i++)
+		sb_breadahead(sb, blocknr + i);
+}
+
+#ifdef CONFIG_FAT_FREE_BITMAP
+/*
+ * The free cluster bitmap has a bit set for every cluster in use. It is
+ * filled in from the FAT by a work item after mount, a readahead window
+ * at a time, and is only used once the whole FAT has been read in;
+ * until then the clusters are found by walking the FAT as before.
+ * Changes made to clusters not read in yet are picked up when the FAT
+ * is read, so alloc and free can update the bitmap unconditionally.
+ *
+ * The bitmap takes max_cluster / 8 bytes, and isn't built for FATs of
+ * more than FAT_FREEMAP_MAX clusters.
+ */
+#define FAT_FREEMAP_MAX		(16 << 20)	/* 2MB of bitmap */
+
+static inline int fat_freemap_ready(struct msdos_sb_info *sbi)
+{
+	return sbi->freemap && sbi->freemap_next >= sbi->max_cluster;
+}
+
+static inline void fat_freemap_mark(struct msdos_sb_info *sbi, int entry)
+{
+	if (sbi->freemap)
+		__set_bit(entry, sbi->freemap);
+}
+
+static inline void fat_freemap_unmark(struct msdos_sb_info *sbi, int entry)
+{
+	if (sbi->freemap)
+		__clear_bit(entry, sbi->freemap);
+}
+
+static void fat_freemap_drop(struct msdos_sb_info *sbi)
+{
+	vfree(sbi->freemap);
+	sbi->freemap = NULL;
+}
+
+/* Reads the next readahead window of the FAT into the bitmap. */
+static int fat_freemap_fill(struct super_block *sb)
+{
+	struct msdos_sb_info *sbi = MSDOS_SB(sb);
+	struct fatent_operations *ops = sbi->fatent_ops;
+	struct fat_entry fatent;
+	unsigned long reada_blocks, rest, n;
+	sector_t blocknr;
+	int err = 0, offset;
+
+	reada_blocks = FAT_READA_SIZE >> sb->s_blocksize_bits;
+
+	fatent_init(&fatent);
+	fatent_set_entry(&fatent, sbi->freemap_next);
+	ops->ent_blocknr(sb, fatent.entry, &offset, &blocknr);
+	rest = sbi->fat_start + sbi->fat_length - blocknr;
+	fat_ent_reada(sb, &fatent, min(reada_blocks, rest));
+
+	for (n = 0; n < reada_blocks && fatent.entry < sbi->max_cluster; n++) {
+		err = fat_ent_read_block(sb, &fatent);
+		if (err)
+			goto out;
+
+		do {
+			if (ops->ent_get(&fatent) == FAT_ENT_FREE)
+				__clear_bit(fatent.entry, sbi->freemap);
+			else
+				__set_bit(fatent.entry, sbi->freemap);
+		} while (fat_ent_next(sbi, &fatent));
+	}
+	sbi->freemap_next = fatent.entry;
+
+	if (fat_freemap_ready(sbi)) {
+		sbi->free_clusters = sbi->max_cluster -
+			bitmap_weight(sbi->freemap, sbi->max_cluster);
+		sbi->free_clus_valid = 1;
+		sb->s_dirt = 1;
+	}
+out:
+	fatent_brelse(&fatent);
+	return err;
+}
+
+static void fat_freemap_work(struct work_struct *work)
+{
+	struct msdos_sb_info *sbi =
+		container_of(work, struct msdos_sb_info, freemap_work);
+
+	lock_fat(sbi);
+	if (sbi->freemap && !fat_freemap_ready(sbi)) {
+		if (fat_freemap_fill(sbi->freemap_sb))
+			fat_freemap_drop(sbi);
+		else if (!fat_freemap_ready(sbi))
+			schedule_work(&sbi->freemap_work);
+	}
+	unlock_fat(sbi);
+}
+
+void fat_freemap_init(struct super_block *sb)
+{
+	struct msdos_sb_info *sbi = MSDOS_SB(sb);
+	unsigned long size;
+
+	INIT_WORK(&sbi->freemap_work, fat_freemap_work);
+	sbi->freemap_sb = sb;
+
+	if (!sbi->options.freemap || sbi->max_cluster > FAT_FREEMAP_MAX)
+		return;
+
+	size = BITS_TO_LONGS(sbi->max_cluster) * sizeof(unsigned long);
+	sbi->freemap = vmalloc(size);
+	if (!sbi->freemap)
+		return;
+	memset(sbi->freemap, 0, size);
+	/* the first two entries are reserved */
+	__set_bit(0, sbi->freemap);
+	__set_bit(1, sbi->freemap);
+	sbi->freemap_next = FAT_START_ENT;
+
+	schedule_work(&sbi->freemap_work);
+}
+
+void fat_freemap_exit(struct super_block *sb)
+{
+	struct msdos_sb_info *sbi = MSDOS_SB(sb);
+
+	cancel_work_sync(&sbi->freemap_work);
+	fat_freemap_drop(sbi);
+}
+
+/*
+ * Returns the first free cluster at or after @start, wrapping around
+ * to the start of the FAT, or max_cluster if there is none.
+ */
+static unsigned long fat_freemap_next(struct msdos_sb_info *sbi,
+				      unsigned long start)
+{
+	unsigned long entry = sbi->max_cluster;
+
+	if (start < sbi->max_cluster)
+		entry = find_next_zero_bit(sbi->freemap, sbi->max_cluster,
+					   start);
+	if (entry >= sbi->max_cluster)
+		entry = find_next_zero_bit(sbi->freemap, sbi->max_cluster,
+					   FAT_START_ENT);
+	return entry;
+}
+
+/* Returns the first of @nr free clusters in a row at or after @start. */
+static unsigned long fat_freemap_run(struct msdos_sb_info *sbi,
+				     unsigned long start, int nr)
+{
+	unsigned long entry, end;
+
+	while (start + nr <= sbi->max_cluster) {
+		entry = find_next_zero_bit(sbi->freemap, sbi->max_cluster,
+					   start);
+		if (entry + nr > sbi->max_cluster)
+			break;
+		end = find_next_bit(sbi->freemap, entry + nr, entry);
+		if (end >= entry + nr)
+			return entry;
+		start = end + 1;
+	}
+	return sbi->max_cluster;
+}
+
+static int fat_freemap_alloc(struct inode *inode, int *cluster,
+			     int nr_cluster, struct buffer_head **bhs,
+			     int *nr_bhs, int *idx_clus)
+{
+	struct super_block *sb = inode->i_sb;
+	struct msdos_sb_info *sbi = MSDOS_SB(sb);
+	struct fatent_operations *ops = sbi->fatent_ops;
+	struct fat_entry fatent, prev_ent;
+	unsigned long start, entry;
+	int err = 0;
+
+	/* Keep the new chain in one piece if there is room for it */
+	start = sbi->prev_free + 1;
+	if (nr_cluster > 1) {
+		entry = fat_freemap_run(sbi, start, nr_cluster);
+		if (entry >= sbi->max_cluster)
+			entry = fat_freemap_run(sbi, FAT_START_ENT, nr_cluster);
+		if (entry < sbi->max_cluster)
+			start = entry;
+	}
+
+	fatent_init(&prev_ent);
+	fatent_init(&fatent);
+	while (*idx_clus < nr_cluster) {
+		entry = fat_freemap_next(sbi, start);
+		if (entry >= sbi->max_cluster) {
+			/* Couldn't allocate the free entries */
+			sbi->free_clusters = 0;
+			sbi->free_clus_valid = 1;
+			sb->s_dirt = 1;
+			err = -ENOSPC;
+			break;
+		}
+
+		err = fat_ent_read(inode, &fatent, entry);
+		if (err < 0)
+			break;
+		__set_bit(entry, sbi->freemap);
+		start = entry + 1;
+		/* The FAT was changed behind our back, skip the entry */
+		if (err != FAT_ENT_FREE) {
+			err = 0;
+			continue;
+		}
+		err = 0;
+
+		/* make the cluster chain */
+		ops->ent_put(&fatent, FAT_ENT_EOF);
+		if (prev_ent.nr_bhs)
+			ops->ent_put(&prev_ent, entry);
+
+		fat_collect_bhs(bhs, nr_bhs, &fatent);
+
+		sbi->prev_free = entry;
+		if (sbi->free_clusters != -1)
+			sbi->free_clusters--;
+		sb->s_dirt = 1;
+
+		cluster[*idx_clus] = entry;
+		(*idx_clus)++;
+
+		/*
+		 * fat_collect_bhs() gets ref-count of bhs,
+		 * so we can still use the prev_ent.
+		 */
+		prev_ent = fatent;
+	}
+	fatent_brelse(&fatent);
+
+	return err;
+}
+#else /* !CONFIG_FAT_FREE_BITMAP */
+static inline int fat_freemap_ready(struct msdos_sb_info *sbi)
+{
+	return 0;
+}
+
+static inline void fat_freemap_mark(struct msdos_sb_info *sbi, int entry)
+{
+}
+
+static inline void fat_freemap_unmark(struct msdos_sb_info *sbi, int entry)
+{
+}
+
+static inline int fat_freemap_alloc(struct inode *inode, int *cluster,
+				    int nr_cluster, struct buffer_head **bhs,
+				    int *nr_bhs, int *idx_clus)
+{
+	return -ENOSPC;
+}
+#endif /* CONFIG_FAT_FREE_BITMAP */
+
 int fat_alloc_clusters(struct inode *inode, int *cluster, int nr_cluster)
 {
 	struct super_block *sb = inode->i_sb;
@@ -474,6 +748,12 @@ int fat_alloc_clusters(struct inode *inode, int *cluster, int nr_cluster)
 	count = FAT_START_ENT;
 	fatent_init(&prev_ent);
 	fatent_init(&fatent);
+	if (fat_freemap_ready(sbi)) {
+		err = fat_freemap_alloc(inode, cluster, nr_cluster,
+					bhs, &nr_bhs, &idx_clus);
+		goto out;
+	}
+
 	fatent_set_entry(&fatent, sbi->prev_free + 1);
 	while (count < sbi->max_cluster) {
 		if (fatent.entry >= sbi->max_cluster)
@@ -495,6 +775,7 @@ int fat_alloc_clusters(struct inode *inode, int *cluster, int nr_cluster)
 
 				fat_collect_bhs(bhs, &nr_bhs, &fatent);
 
+				fat_freemap_mark(sbi, entry);
 				sbi->prev_free = entry;
 				if (sbi->free_clusters != -1)
 					sbi->free_clusters--;
@@ -579,6 +860,7 @@ int fat_free_clusters(struct inode *inode, int cluster)
 		}
 
 		ops->ent_put(&fatent, FAT_ENT_FREE);
+		fat_freemap_unmark(sbi, fatent.entry);
 		if (sbi->free_clusters != -1) {
 			sbi->free_clusters++;
 			sb->s_dirt = 1;
@@ -617,22 +899,6 @@ error:
 
 EXPORT_SYMBOL_GPL(fat_free_clusters);
 
-/* 128kb is the whole sectors for FAT12 and FAT16 */
-#define FAT_READA_SIZE		(128 * 1024)
-
-static void fat_ent_reada(struct super_block *sb, struct fat_entry *fatent,
-			  unsigned long reada_blocks)
-{
-	struct fatent_operations *ops = MSDOS_SB(sb)->fatent_ops;
-	sector_t blocknr;
-	int i, offset;
-
-	ops->ent_blocknr(sb, fatent->entry, &offset, &blocknr);
-
-	for (i = 0; i < reada_blocks; i++)
-		sb_breadahead(sb, blocknr + i);
-}
-
 int fat_count_free_clusters(struct super_block *sb)
 {
 	struct msdos_sb_info *sbi = MSDOS_SB(sb);
@@ -645,6 +911,19 @@ int fat_count_free_clusters(struct super_block *sb)
 	if (sbi->free_clusters != -1 && sbi->free_clus_valid)
 		goto out;
 
+#ifdef CONFIG_FAT_FREE_BITMAP
+	/* Finish the bitmap instead, it counts the free clusters too */
+	if (sbi->freemap) {
+		while (!err && !fat_freemap_ready(sbi))
+			err = fat_freemap_fill(sb);
+		if (!err)
+			goto out;
+		/* do without it, and count by scanning the FAT */
+		fat_freemap_drop(sbi);
+		err = 0;
+	}
+#endif
+
 	reada_blocks = FAT_READA_SIZE >> sb->s_blocksize_bits;
 	reada_mask = reada_blocks - 1;
 	cur_block = 0;
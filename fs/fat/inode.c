@@ -469,6 +469,8 @@ static void fat_put_super(struct super_block *sb)
 
 	lock_kernel();
 
+	fat_freemap_exit(sb);
+
 	if (sb->s_dirt)
 		fat_write_super(sb);
 
@@ -827,6 +829,8 @@ static int fat_show_options(struct seq_file *m, struct vfsmount *mnt)
 		seq_printf(m, ",check=%c", opts->name_check);
 	if (opts->usefree)
 		seq_puts(m, ",usefree");
+	if (!opts->freemap)
+		seq_puts(m, ",nofreemap");
 	if (opts->quiet)
 		seq_puts(m, ",quiet");
 	if (opts->showexec)
@@ -865,7 +869,7 @@ static int fat_show_options(struct seq_file *m, struct vfsmount *mnt)
 enum {
 	Opt_check_n, Opt_check_r, Opt_check_s, Opt_uid, Opt_gid,
 	Opt_umask, Opt_dmask, Opt_fmask, Opt_allow_utime, Opt_codepage,
-	Opt_usefree, Opt_nocase, Opt_quiet, Opt_showexec, Opt_debug,
+	Opt_usefree, Opt_nofreemap, Opt_nocase, Opt_quiet, Opt_showexec, Opt_debug,
 	Opt_immutable, Opt_dots, Opt_nodots,
 	Opt_charset, Opt_shortname_lower, Opt_shortname_win95,
 	Opt_shortname_winnt, Opt_shortname_mixed, Opt_utf8_no, Opt_utf8_yes,
@@ -889,6 +893,7 @@ static const match_table_t fat_tokens = {
 	{Opt_allow_utime, "allow_utime=%o"},
 	{Opt_codepage, "codepage=%u"},
 	{Opt_usefree, "usefree"},
+	{Opt_nofreemap, "nofreemap"},
 	{Opt_nocase, "nocase"},
 	{Opt_quiet, "quiet"},
 	{Opt_showexec, "showexec"},
@@ -978,6 +983,7 @@ static int parse_options(char *options, int is_vfat, int silent, int *debug,
 	opts->utf8 = opts->unicode_xlate = 0;
 	opts->numtail = 1;
 	opts->usefree = opts->nocase = 0;
+	opts->freemap = 1;
 	opts->tz_utc = 0;
 	opts->errors = FAT_ERRORS_RO;
 	*debug = 0;
@@ -1010,6 +1016,9 @@ static int parse_options(char *options, int is_vfat, int silent, int *debug,
 		case Opt_usefree:
 			opts->usefree = 1;
 			break;
+		case Opt_nofreemap:
+			opts->freemap = 0;
+			break;
 		case Opt_nocase:
 			if (!is_vfat)
 				opts->nocase = 1;
@@ -1473,6 +1482,8 @@ int fat_fill_super(struct super_block *sb, void *data, int silent,
 		goto out_fail;
 	}
 
+	fat_freemap_init(sb);
+
 	return 0;
 
 out_invalid:
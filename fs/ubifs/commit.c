@@ -39,8 +39,8 @@
  * to use the file system while the bulk of the commit I/O is performed. The
  * purpose of this two-step approach is to prevent the commit from causing any
  * latency blips. Note that in any case, the commit does not prevent lookups
- * (as permitted by the TNC mutex), or access to VFS data structures e.g. page
- * cache.
+ * (as permitted by the TNC semaphore), or access to VFS data structures e.g.
+ * page cache.
  */
 
 #include <linux/freezer.h>
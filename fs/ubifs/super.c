@@ -1907,7 +1907,7 @@ static int ubifs_fill_super(struct super_block *sb, void *data, int silent)
 	spin_lock_init(&c->orphan_lock);
 	init_rwsem(&c->commit_sem);
 	mutex_init(&c->lp_mutex);
-	mutex_init(&c->tnc_mutex);
+	init_rwsem(&c->tnc_sem);
 	mutex_init(&c->log_mutex);
 	mutex_init(&c->mst_mutex);
 	mutex_init(&c->umount_mutex);
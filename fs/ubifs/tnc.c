@@ -25,9 +25,13 @@
  * the UBIFS B-tree.
  *
  * At the moment the locking rules of the TNC tree are quite simple and
- * straightforward. We just have a mutex and lock it when we traverse the
- * tree. If a znode is not in memory, we read it from flash while still having
- * the mutex locked.
+ * straightforward. Everything that changes the tree takes the TNC semaphore
+ * for writing. Lookups take it for reading, so they run in parallel with each
+ * other but never see a znode being changed or dirtied by 'dirty_cow_znode()'.
+ * If a znode is not in memory, a lookup reads it from flash while still
+ * holding the semaphore and attaches it with 'cmpxchg()', so two lookups
+ * loading the same znode only waste a read. Leaf nodes are added to the leaf
+ * node cache in the same way.
  */
 
 #include <linux/crc32.h>
@@ -322,8 +326,11 @@ static struct ubifs_znode *dirty_cow_znode(struct ubifs_info *c,
  * Note, this function does not add the @node object to LNC directly, but
  * allocates a copy of the object and adds the copy to LNC. The reason for this
  * is that @node has been allocated outside of the TNC subsystem and will be
- * used with @c->tnc_mutex unlock upon return from the TNC subsystem. But LNC
+ * used with @c->tnc_sem unlock upon return from the TNC subsystem. But LNC
  * may be changed at any time, e.g. freed by the shrinker.
+ *
+ * Lookups add to LNC holding @c->tnc_sem only for reading, so if another
+ * lookup has cached the same node meanwhile, the copy is dropped.
  */
 static int lnc_add(struct ubifs_info *c, struct ubifs_zbranch *zbr,
 		   const void *node)
@@ -332,7 +339,6 @@ static int lnc_add(struct ubifs_info *c, struct ubifs_zbranch *zbr,
 	void *lnc_node;
 	const struct ubifs_dent_node *dent = node;
 
-	ubifs_assert(!zbr->leaf);
 	ubifs_assert(zbr->len != 0);
 	ubifs_assert(is_hash_key(c, &zbr->key));
 
@@ -349,7 +355,8 @@ static int lnc_add(struct ubifs_info *c, struct ubifs_zbranch *zbr,
 		return 0;
 
 	memcpy(lnc_node, node, zbr->len);
-	zbr->leaf = lnc_node;
+	if (cmpxchg(&zbr->leaf, NULL, lnc_node))
+		kfree(lnc_node);
 	return 0;
 }
 
@@ -360,14 +367,15 @@ static int lnc_add(struct ubifs_info *c, struct ubifs_zbranch *zbr,
  * @node: leaf node
  *
  * This function is similar to 'lnc_add()', but it does not create a copy of
- * @node but inserts @node to TNC directly.
+ * @node but inserts @node to TNC directly. If another lookup has cached the
+ * same node meanwhile, @node is freed, so callers have to use @zbr->leaf
+ * afterwards.
  */
 static int lnc_add_directly(struct ubifs_info *c, struct ubifs_zbranch *zbr,
 			    void *node)
 {
 	int err;
 
-	ubifs_assert(!zbr->leaf);
 	ubifs_assert(zbr->len != 0);
 
 	err = ubifs_validate_entry(c, node);
@@ -377,7 +385,8 @@ static int lnc_add_directly(struct ubifs_info *c, struct ubifs_zbranch *zbr,
 		return err;
 	}
 
-	zbr->leaf = node;
+	if (cmpxchg(&zbr->leaf, NULL, node))
+		kfree(node);
 	return 0;
 }
 
@@ -551,8 +560,8 @@ static int matches_name(struct ubifs_info *c, struct ubifs_zbranch *zbr,
 		err = lnc_add_directly(c, zbr, dent);
 		if (err)
 			goto out_free;
-	} else
-		dent = zbr->leaf;
+	}
+	dent = zbr->leaf;
 
 	nlen = le16_to_cpu(dent->nlen);
 	err = memcmp(dent->name, nm->name, min_t(int, nlen, nm->len));
@@ -844,8 +853,8 @@ static int fallible_matches_name(struct ubifs_info *c,
 		err = lnc_add_directly(c, zbr, dent);
 		if (err)
 			goto out_free;
-	} else
-		dent = zbr->leaf;
+	}
+	dent = zbr->leaf;
 
 	nlen = le16_to_cpu(dent->nlen);
 	err = memcmp(dent->name, nm->name, min_t(int, nlen, nm->len));
@@ -1446,7 +1455,7 @@ int ubifs_tnc_locate(struct ubifs_info *c, const union ubifs_key *key,
 	struct ubifs_zbranch zbr, *zt;
 
 again:
-	mutex_lock(&c->tnc_mutex);
+	down_read(&c->tnc_sem);
 	found = ubifs_lookup_level0(c, key, &znode, &n);
 	if (!found) {
 		err = -ENOENT;
@@ -1463,7 +1472,7 @@ again:
 	if (is_hash_key(c, key)) {
 		/*
 		 * In this case the leaf node cache gets used, so we pass the
-		 * address of the zbranch and keep the mutex locked
+		 * address of the zbranch and keep the semaphore held
 		 */
 		err = tnc_read_node_nm(c, zt, node);
 		goto out;
@@ -1472,10 +1481,10 @@ again:
 		err = ubifs_tnc_read_node(c, zt, node);
 		goto out;
 	}
-	/* Drop the TNC mutex prematurely and race with garbage collection */
+	/* Drop the TNC semaphore prematurely and race with garbage collection */
 	zbr = znode->zbranch[n];
 	gc_seq1 = c->gc_seq;
-	mutex_unlock(&c->tnc_mutex);
+	up_read(&c->tnc_sem);
 
 	if (ubifs_get_wbuf(c, zbr.lnum)) {
 		/* We do not GC journal heads */
@@ -1487,7 +1496,7 @@ again:
 	if (err <= 0 || maybe_leb_gced(c, zbr.lnum, gc_seq1)) {
 		/*
 		 * The node may have been GC'ed out from under us so try again
-		 * while keeping the TNC mutex locked.
+		 * while keeping the TNC semaphore held.
 		 */
 		safely = 1;
 		goto again;
@@ -1495,7 +1504,7 @@ again:
 	return 0;
 
 out:
-	mutex_unlock(&c->tnc_mutex);
+	up_read(&c->tnc_sem);
 	return err;
 }
 
@@ -1523,7 +1532,7 @@ int ubifs_tnc_get_bu_keys(struct ubifs_info *c, struct bu_info *bu)
 	bu->blk_cnt = 0;
 	bu->eof = 0;
 
-	mutex_lock(&c->tnc_mutex);
+	down_read(&c->tnc_sem);
 	/* Find first key */
 	err = ubifs_lookup_level0(c, &bu->key, &znode, &n);
 	if (err < 0)
@@ -1602,7 +1611,7 @@ out:
 		err = 0;
 	}
 	bu->gc_seq = c->gc_seq;
-	mutex_unlock(&c->tnc_mutex);
+	up_read(&c->tnc_sem);
 	if (err)
 		return err;
 	/*
@@ -1807,7 +1816,7 @@ static int do_lookup_nm(struct ubifs_info *c, const union ubifs_key *key,
 	struct ubifs_znode *znode;
 
 	dbg_tnc("name '%.*s' key %s", nm->len, nm->name, DBGKEY(key));
-	mutex_lock(&c->tnc_mutex);
+	down_read(&c->tnc_sem);
 	found = ubifs_lookup_level0(c, key, &znode, &n);
 	if (!found) {
 		err = -ENOENT;
@@ -1831,7 +1840,7 @@ static int do_lookup_nm(struct ubifs_info *c, const union ubifs_key *key,
 	err = tnc_read_node_nm(c, &znode->zbranch[n], node);
 
 out_unlock:
-	mutex_unlock(&c->tnc_mutex);
+	up_read(&c->tnc_sem);
 	return err;
 }
 
@@ -2165,7 +2174,7 @@ int ubifs_tnc_add(struct ubifs_info *c, const union ubifs_key *key, int lnum,
 	int found, n, err = 0;
 	struct ubifs_znode *znode;
 
-	mutex_lock(&c->tnc_mutex);
+	down_write(&c->tnc_sem);
 	dbg_tnc("%d:%d, len %d, key %s", lnum, offs, len, DBGKEY(key));
 	found = lookup_level0_dirty(c, key, &znode, &n);
 	if (!found) {
@@ -2189,7 +2198,7 @@ int ubifs_tnc_add(struct ubifs_info *c, const union ubifs_key *key, int lnum,
 		err = found;
 	if (!err)
 		err = dbg_check_tnc(c, 0);
-	mutex_unlock(&c->tnc_mutex);
+	up_write(&c->tnc_sem);
 
 	return err;
 }
@@ -2214,7 +2223,7 @@ int ubifs_tnc_replace(struct ubifs_info *c, const union ubifs_key *key,
 	int found, n, err = 0;
 	struct ubifs_znode *znode;
 
-	mutex_lock(&c->tnc_mutex);
+	down_write(&c->tnc_sem);
 	dbg_tnc("old LEB %d:%d, new LEB %d:%d, len %d, key %s", old_lnum,
 		old_offs, lnum, offs, len, DBGKEY(key));
 	found = lookup_level0_dirty(c, key, &znode, &n);
@@ -2275,7 +2284,7 @@ int ubifs_tnc_replace(struct ubifs_info *c, const union ubifs_key *key,
 		err = dbg_check_tnc(c, 0);
 
 out_unlock:
-	mutex_unlock(&c->tnc_mutex);
+	up_write(&c->tnc_sem);
 	return err;
 }
 
@@ -2297,7 +2306,7 @@ int ubifs_tnc_add_nm(struct ubifs_info *c, const union ubifs_key *key,
 	int found, n, err = 0;
 	struct ubifs_znode *znode;
 
-	mutex_lock(&c->tnc_mutex);
+	down_write(&c->tnc_sem);
 	dbg_tnc("LEB %d:%d, name '%.*s', key %s", lnum, offs, nm->len, nm->name,
 		DBGKEY(key));
 	found = lookup_level0_dirty(c, key, &znode, &n);
@@ -2360,7 +2369,7 @@ int ubifs_tnc_add_nm(struct ubifs_info *c, const union ubifs_key *key,
 			struct qstr noname = { .len = 0, .name = "" };
 
 			err = dbg_check_tnc(c, 0);
-			mutex_unlock(&c->tnc_mutex);
+			up_write(&c->tnc_sem);
 			if (err)
 				return err;
 			return ubifs_tnc_remove_nm(c, key, &noname);
@@ -2370,7 +2379,7 @@ int ubifs_tnc_add_nm(struct ubifs_info *c, const union ubifs_key *key,
 out_unlock:
 	if (!err)
 		err = dbg_check_tnc(c, 0);
-	mutex_unlock(&c->tnc_mutex);
+	up_write(&c->tnc_sem);
 	return err;
 }
 
@@ -2502,7 +2511,7 @@ int ubifs_tnc_remove(struct ubifs_info *c, const union ubifs_key *key)
 	int found, n, err = 0;
 	struct ubifs_znode *znode;
 
-	mutex_lock(&c->tnc_mutex);
+	down_write(&c->tnc_sem);
 	dbg_tnc("key %s", DBGKEY(key));
 	found = lookup_level0_dirty(c, key, &znode, &n);
 	if (found < 0) {
@@ -2515,7 +2524,7 @@ int ubifs_tnc_remove(struct ubifs_info *c, const union ubifs_key *key)
 		err = dbg_check_tnc(c, 0);
 
 out_unlock:
-	mutex_unlock(&c->tnc_mutex);
+	up_write(&c->tnc_sem);
 	return err;
 }
 
@@ -2533,7 +2542,7 @@ int ubifs_tnc_remove_nm(struct ubifs_info *c, const union ubifs_key *key,
 	int n, err;
 	struct ubifs_znode *znode;
 
-	mutex_lock(&c->tnc_mutex);
+	down_write(&c->tnc_sem);
 	dbg_tnc("%.*s, key %s", nm->len, nm->name, DBGKEY(key));
 	err = lookup_level0_dirty(c, key, &znode, &n);
 	if (err < 0)
@@ -2564,7 +2573,7 @@ int ubifs_tnc_remove_nm(struct ubifs_info *c, const union ubifs_key *key,
 out_unlock:
 	if (!err)
 		err = dbg_check_tnc(c, 0);
-	mutex_unlock(&c->tnc_mutex);
+	up_write(&c->tnc_sem);
 	return err;
 }
 
@@ -2604,7 +2613,7 @@ int ubifs_tnc_remove_range(struct ubifs_info *c, union ubifs_key *from_key,
 	struct ubifs_znode *znode;
 	union ubifs_key *key;
 
-	mutex_lock(&c->tnc_mutex);
+	down_write(&c->tnc_sem);
 	while (1) {
 		/* Find first level 0 znode that contains keys to remove */
 		err = ubifs_lookup_level0(c, from_key, &znode, &n);
@@ -2666,7 +2675,7 @@ int ubifs_tnc_remove_range(struct ubifs_info *c, union ubifs_key *from_key,
 out_unlock:
 	if (!err)
 		err = dbg_check_tnc(c, 0);
-	mutex_unlock(&c->tnc_mutex);
+	up_write(&c->tnc_sem);
 	return err;
 }
 
@@ -2772,7 +2781,7 @@ struct ubifs_dent_node *ubifs_tnc_next_ent(struct ubifs_info *c,
 	dbg_tnc("%s %s", nm->name ? (char *)nm->name : "(lowest)", DBGKEY(key));
 	ubifs_assert(is_hash_key(c, key));
 
-	mutex_lock(&c->tnc_mutex);
+	down_read(&c->tnc_sem);
 	err = ubifs_lookup_level0(c, key, &znode, &n);
 	if (unlikely(err < 0))
 		goto out_unlock;
@@ -2831,13 +2840,13 @@ struct ubifs_dent_node *ubifs_tnc_next_ent(struct ubifs_info *c,
 	if (unlikely(err))
 		goto out_free;
 
-	mutex_unlock(&c->tnc_mutex);
+	up_read(&c->tnc_sem);
 	return dent;
 
 out_free:
 	kfree(dent);
 out_unlock:
-	mutex_unlock(&c->tnc_mutex);
+	up_read(&c->tnc_sem);
 	return ERR_PTR(err);
 }
 
@@ -3209,7 +3218,7 @@ int ubifs_tnc_has_node(struct ubifs_info *c, union ubifs_key *key, int level,
 {
 	int err;
 
-	mutex_lock(&c->tnc_mutex);
+	down_write(&c->tnc_sem);
 	if (is_idx) {
 		err = is_idx_node_in_tnc(c, key, level, lnum, offs);
 		if (err < 0)
@@ -3226,7 +3235,7 @@ int ubifs_tnc_has_node(struct ubifs_info *c, union ubifs_key *key, int level,
 		err = is_leaf_node_in_tnc(c, key, lnum, offs);
 
 out_unlock:
-	mutex_unlock(&c->tnc_mutex);
+	up_write(&c->tnc_sem);
 	return err;
 }
 
@@ -3250,7 +3259,7 @@ int ubifs_dirty_idx_node(struct ubifs_info *c, union ubifs_key *key, int level,
 	struct ubifs_znode *znode;
 	int err = 0;
 
-	mutex_lock(&c->tnc_mutex);
+	down_write(&c->tnc_sem);
 	znode = lookup_znode(c, key, level, lnum, offs);
 	if (!znode)
 		goto out_unlock;
@@ -3265,7 +3274,7 @@ int ubifs_dirty_idx_node(struct ubifs_info *c, union ubifs_key *key, int level,
 	}
 
 out_unlock:
-	mutex_unlock(&c->tnc_mutex);
+	up_write(&c->tnc_sem);
 	return err;
 }
 
@@ -3299,7 +3308,7 @@ int dbg_check_inode_size(struct ubifs_info *c, const struct inode *inode,
 	data_key_init(c, &from_key, inode->i_ino, block);
 	highest_data_key(c, &to_key, inode->i_ino);
 
-	mutex_lock(&c->tnc_mutex);
+	down_write(&c->tnc_sem);
 	err = ubifs_lookup_level0(c, &from_key, &znode, &n);
 	if (err < 0)
 		goto out_unlock;
@@ -3333,7 +3342,7 @@ out_dump:
 	err = -EINVAL;
 
 out_unlock:
-	mutex_unlock(&c->tnc_mutex);
+	up_write(&c->tnc_sem);
 	return err;
 }
 
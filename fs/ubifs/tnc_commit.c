@@ -765,7 +765,7 @@ int ubifs_tnc_start_commit(struct ubifs_info *c, struct ubifs_zbranch *zroot)
 {
 	int err = 0, cnt;
 
-	mutex_lock(&c->tnc_mutex);
+	down_write(&c->tnc_sem);
 	err = dbg_check_tnc(c, 1);
 	if (err)
 		goto out;
@@ -807,7 +807,7 @@ int ubifs_tnc_start_commit(struct ubifs_info *c, struct ubifs_zbranch *zroot)
 	c->budg_uncommitted_idx = 0;
 	c->min_idx_lebs = ubifs_calc_min_idx_lebs(c);
 	spin_unlock(&c->space_lock);
-	mutex_unlock(&c->tnc_mutex);
+	up_write(&c->tnc_sem);
 
 	dbg_cmt("number of index LEBs %d", c->lst.idx_lebs);
 	dbg_cmt("size of index %llu", c->calc_idx_sz);
@@ -816,7 +816,7 @@ int ubifs_tnc_start_commit(struct ubifs_info *c, struct ubifs_zbranch *zroot)
 out_free:
 	free_idx_lebs(c);
 out:
-	mutex_unlock(&c->tnc_mutex);
+	up_write(&c->tnc_sem);
 	return err;
 }
 
@@ -1089,7 +1089,7 @@ int ubifs_tnc_end_commit(struct ubifs_info *c)
 	if (err)
 		return err;
 
-	mutex_lock(&c->tnc_mutex);
+	down_write(&c->tnc_sem);
 
 	dbg_cmt("TNC height is %d", c->zroot.znode->level + 1);
 
@@ -1099,7 +1099,7 @@ int ubifs_tnc_end_commit(struct ubifs_info *c)
 	kfree(c->ilebs);
 	c->ilebs = NULL;
 
-	mutex_unlock(&c->tnc_mutex);
+	up_write(&c->tnc_sem);
 
 	return 0;
 }
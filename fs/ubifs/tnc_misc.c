@@ -402,15 +402,18 @@ out_dump:
  * This function loads znode pointed to by @zbr into the TNC cache and
  * returns pointer to it in case of success and a negative error code in case
  * of failure.
+ *
+ * Lookups call this function holding @c->tnc_sem only for reading, so another
+ * lookup may load the same znode at the same time. Whichever attaches its
+ * znode to @zbr first wins, and the other one is freed.
  */
 struct ubifs_znode *ubifs_load_znode(struct ubifs_info *c,
 				     struct ubifs_zbranch *zbr,
 				     struct ubifs_znode *parent, int iip)
 {
 	int err;
-	struct ubifs_znode *znode;
+	struct ubifs_znode *znode, *old;
 
-	ubifs_assert(!zbr->znode);
 	/*
 	 * A slab cache is not presently used for znodes because the znode size
 	 * depends on the fanout which is stored in the superblock.
@@ -423,6 +426,16 @@ struct ubifs_znode *ubifs_load_znode(struct ubifs_info *c,
 	if (err)
 		goto out;
 
+	znode->parent = parent;
+	znode->time = get_seconds();
+	znode->iip = iip;
+
+	old = cmpxchg(&zbr->znode, NULL, znode);
+	if (old) {
+		kfree(znode);
+		return old;
+	}
+
 	atomic_long_inc(&c->clean_zn_cnt);
 
 	/*
@@ -433,11 +446,6 @@ struct ubifs_znode *ubifs_load_znode(struct ubifs_info *c,
 	 */
 	atomic_long_inc(&ubifs_clean_zn_cnt);
 
-	zbr->znode = znode;
-	znode->parent = parent;
-	znode->time = get_seconds();
-	znode->iip = iip;
-
 	return znode;
 
 out:
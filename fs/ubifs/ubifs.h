@@ -973,8 +973,9 @@ struct ubifs_debug_info;
  * @default_compr: default compression algorithm (%UBIFS_COMPR_LZO, etc)
  * @rw_incompat: the media is not R/W compatible
  *
- * @tnc_mutex: protects the Tree Node Cache (TNC), @zroot, @cnext, @enext, and
- *             @calc_idx_sz
+ * @tnc_sem: protects the Tree Node Cache (TNC), @zroot, @cnext, @enext, and
+ *           @calc_idx_sz; lookups take it for reading, everything that
+ *           changes the TNC takes it for writing
  * @zroot: zbranch which points to the root index node and znode
  * @cnext: next znode to commit
  * @enext: next znode to commit to empty space
@@ -1216,7 +1217,7 @@ struct ubifs_info {
 	unsigned int default_compr:2;
 	unsigned int rw_incompat:1;
 
-	struct mutex tnc_mutex;
+	struct rw_semaphore tnc_sem;
 	struct ubifs_zbranch zroot;
 	struct ubifs_znode *cnext;
 	struct ubifs_znode *enext;
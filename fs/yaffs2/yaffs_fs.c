@@ -97,6 +97,17 @@ extern const char *yaffs_guts_c_version;
 #define YAFFS_USE_WRITE_BEGIN_END 0
 #endif
 
+/* readpages and writepages batch pages so that the gross lock is taken
+ * once per batch instead of once per page.
+ */
+#if (LINUX_VERSION_CODE > KERNEL_VERSION(2, 6, 22))
+#define YAFFS_USE_MULTIPAGE_IO 1
+#include <linux/pagevec.h>
+#include <linux/writeback.h>
+#else
+#define YAFFS_USE_MULTIPAGE_IO 0
+#endif
+
 #if (LINUX_VERSION_CODE > KERNEL_VERSION(2, 6, 28))
 static uint32_t YCALCBLOCKS(uint64_t partition_size, uint32_t block_size)
 {
@@ -242,6 +253,12 @@ static int yaffs_writepage(struct page *page, struct writeback_control *wbc);
 #else
 static int yaffs_writepage(struct page *page);
 #endif
+#if (YAFFS_USE_MULTIPAGE_IO > 0)
+static int yaffs_readpages(struct file *file, struct address_space *mapping,
+				struct list_head *pages, unsigned nr_pages);
+static int yaffs_writepages(struct address_space *mapping,
+				struct writeback_control *wbc);
+#endif
 
 
 #if (YAFFS_USE_WRITE_BEGIN_END != 0)
@@ -270,6 +287,10 @@ static int yaffs_follow_link(struct dentry *dentry, struct nameidata *nd);
 static struct address_space_operations yaffs_file_address_operations = {
 	.readpage = yaffs_readpage,
 	.writepage = yaffs_writepage,
+#if (YAFFS_USE_MULTIPAGE_IO > 0)
+	.readpages = yaffs_readpages,
+	.writepages = yaffs_writepages,
+#endif
 #if (YAFFS_USE_WRITE_BEGIN_END > 0)
 	.write_begin = yaffs_write_begin,
 	.write_end = yaffs_write_end,
@@ -712,24 +733,16 @@ static int yaffs_file_flush(struct file *file)
 	return 0;
 }
 
-static int yaffs_readpage_nolock(struct file *f, struct page *pg)
+/* Fill a locked page from the object. The caller holds the gross lock. */
+static int yaffs_readpage_worker(yaffs_Object *obj, struct page *pg)
 {
-	/* Lifted from jffs2 */
-
-	yaffs_Object *obj;
 	unsigned char *pg_buf;
 	int ret;
 
-	yaffs_Device *dev;
-
 	T(YAFFS_TRACE_OS, ("yaffs_readpage at %08x, size %08x\n",
 			(unsigned)(pg->index << PAGE_CACHE_SHIFT),
 			(unsigned)PAGE_CACHE_SIZE));
 
-	obj = yaffs_DentryToObject(f->f_dentry);
-
-	dev = obj->myDev;
-
 #if (LINUX_VERSION_CODE > KERNEL_VERSION(2, 5, 0))
 	BUG_ON(!PageLocked(pg));
 #else
@@ -740,14 +753,10 @@ static int yaffs_readpage_nolock(struct file *f, struct page *pg)
 	pg_buf = kmap(pg);
 	/* FIXME: Can kmap fail? */
 
-	yaffs_GrossLock(dev);
-
 	ret = yaffs_ReadDataFromFile(obj, pg_buf,
 				pg->index << PAGE_CACHE_SHIFT,
 				PAGE_CACHE_SIZE);
 
-	yaffs_GrossUnlock(dev);
-
 	if (ret >= 0)
 		ret = 0;
 
@@ -766,6 +775,28 @@ static int yaffs_readpage_nolock(struct file *f, struct page *pg)
 	return ret;
 }
 
+static int yaffs_readpage_nolock(struct file *f, struct page *pg)
+{
+	/* Lifted from jffs2 */
+
+	yaffs_Object *obj;
+	int ret;
+
+	yaffs_Device *dev;
+
+	obj = yaffs_DentryToObject(f->f_dentry);
+
+	dev = obj->myDev;
+
+	yaffs_GrossLock(dev);
+
+	ret = yaffs_readpage_worker(obj, pg);
+
+	yaffs_GrossUnlock(dev);
+
+	return ret;
+}
+
 static int yaffs_readpage_unlock(struct file *f, struct page *pg)
 {
 	int ret = yaffs_readpage_nolock(f, pg);
@@ -778,29 +809,18 @@ static int yaffs_readpage(struct file *f, struct page *pg)
 	return yaffs_readpage_unlock(f, pg);
 }
 
-/* writepage inspired by/stolen from smbfs */
-
-#if (LINUX_VERSION_CODE > KERNEL_VERSION(2, 5, 0))
-static int yaffs_writepage(struct page *page, struct writeback_control *wbc)
-#else
-static int yaffs_writepage(struct page *page)
-#endif
+/* Write a locked page to the object. The caller holds the gross lock.
+ * Pages wholly beyond the end of file are not written.
+ */
+static int yaffs_writepage_worker(yaffs_Object *obj, struct inode *inode,
+				struct page *page)
 {
-	struct address_space *mapping = page->mapping;
 	loff_t offset = (loff_t) page->index << PAGE_CACHE_SHIFT;
-	struct inode *inode;
 	unsigned long end_index;
 	char *buffer;
-	yaffs_Object *obj;
 	int nWritten = 0;
 	unsigned nBytes;
 
-	if (!mapping)
-		BUG();
-	inode = mapping->host;
-	if (!inode)
-		BUG();
-
 	if (offset > inode->i_size) {
 		T(YAFFS_TRACE_OS,
 			("yaffs_writepage at %08x, inode size = %08x!!!\n",
@@ -808,7 +828,6 @@ static int yaffs_writepage(struct page *page)
 			(unsigned)inode->i_size));
 		T(YAFFS_TRACE_OS,
 			("                -> don't care!!\n"));
-		unlock_page(page);
 		return 0;
 	}
 
@@ -820,13 +839,8 @@ static int yaffs_writepage(struct page *page)
 	else
 		nBytes = inode->i_size & (PAGE_CACHE_SIZE - 1);
 
-	get_page(page);
-
 	buffer = kmap(page);
 
-	obj = yaffs_InodeToObject(inode);
-	yaffs_GrossLock(obj->myDev);
-
 	T(YAFFS_TRACE_OS,
 		("yaffs_writepage at %08x, size %08x\n",
 		(unsigned)(page->index << PAGE_CACHE_SHIFT), nBytes));
@@ -841,16 +855,212 @@ static int yaffs_writepage(struct page *page)
 		("writepag1: obj = %05x, ino = %05x\n",
 		(int)obj->variant.fileVariant.fileSize, (int)inode->i_size));
 
-	yaffs_GrossUnlock(obj->myDev);
-
 	kunmap(page);
 	SetPageUptodate(page);
+
+	return (nWritten == nBytes) ? 0 : -ENOSPC;
+}
+
+/* writepage inspired by/stolen from smbfs */
+
+#if (LINUX_VERSION_CODE > KERNEL_VERSION(2, 5, 0))
+static int yaffs_writepage(struct page *page, struct writeback_control *wbc)
+#else
+static int yaffs_writepage(struct page *page)
+#endif
+{
+	struct address_space *mapping = page->mapping;
+	struct inode *inode;
+	yaffs_Object *obj;
+	int ret;
+
+	if (!mapping)
+		BUG();
+	inode = mapping->host;
+	if (!inode)
+		BUG();
+
+	get_page(page);
+
+	obj = yaffs_InodeToObject(inode);
+	yaffs_GrossLock(obj->myDev);
+
+	ret = yaffs_writepage_worker(obj, inode, page);
+
+	yaffs_GrossUnlock(obj->myDev);
+
 	UnlockPage(page);
 	put_page(page);
 
-	return (nWritten == nBytes) ? 0 : -ENOSPC;
+	return ret;
+}
+
+#if (YAFFS_USE_MULTIPAGE_IO > 0)
+/* Multi-page reads and writes.
+ * The pages are locked and gathered into a pagevec first, then the whole
+ * batch is transferred under a single gross lock. Page locks are always
+ * taken before the gross lock, as in the single page paths, and never
+ * while holding it: page cache allocation can recurse into writepage.
+ */
+static void yaffs_read_batch(yaffs_Object *obj, struct pagevec *pvec)
+{
+	int i;
+
+	yaffs_GrossLock(obj->myDev);
+
+	for (i = 0; i < pagevec_count(pvec); i++)
+		yaffs_readpage_worker(obj, pvec->pages[i]);
+
+	yaffs_GrossUnlock(obj->myDev);
+
+	for (i = 0; i < pagevec_count(pvec); i++)
+		UnlockPage(pvec->pages[i]);
+
+	pagevec_release(pvec);
+}
+
+static int yaffs_readpages(struct file *f, struct address_space *mapping,
+				struct list_head *pages, unsigned nr_pages)
+{
+	yaffs_Object *obj = yaffs_DentryToObject(f->f_dentry);
+	struct pagevec pvec;
+	struct page *pg;
+	unsigned i;
+
+	T(YAFFS_TRACE_OS, ("yaffs_readpages %u pages\n", nr_pages));
+
+	pagevec_init(&pvec, 0);
+
+	for (i = 0; i < nr_pages; i++) {
+		pg = list_entry(pages->prev, struct page, lru);
+		list_del(&pg->lru);
+
+		if (add_to_page_cache_lru(pg, mapping, pg->index,
+					  GFP_KERNEL)) {
+			page_cache_release(pg);
+			continue;
+		}
+
+		if (!pagevec_add(&pvec, pg))
+			yaffs_read_batch(obj, &pvec);
+	}
+
+	if (pagevec_count(&pvec))
+		yaffs_read_batch(obj, &pvec);
+
+	return 0;
+}
+
+static int yaffs_write_batch(struct inode *inode, struct pagevec *pvec)
+{
+	yaffs_Object *obj = yaffs_InodeToObject(inode);
+	int ret = 0;
+	int err;
+	int i;
+
+	yaffs_GrossLock(obj->myDev);
+
+	for (i = 0; i < pagevec_count(pvec); i++) {
+		err = yaffs_writepage_worker(obj, inode, pvec->pages[i]);
+		if (err && !ret)
+			ret = err;
+	}
+
+	yaffs_GrossUnlock(obj->myDev);
+
+	for (i = 0; i < pagevec_count(pvec); i++)
+		UnlockPage(pvec->pages[i]);
+
+	pagevec_release(pvec);
+
+	return ret;
 }
 
+struct yaffs_writepages_batch {
+	struct pagevec pvec;
+	pgoff_t done_index;	/* one past the last page written */
+};
+
+/* write_cache_pages() callback: hang on to the locked page and write the
+ * batch once it is full.
+ */
+static int yaffs_writepages_gather(struct page *page,
+				struct writeback_control *wbc, void *data)
+{
+	struct yaffs_writepages_batch *batch = data;
+
+	batch->done_index = page->index + 1;
+	get_page(page);
+	if (!pagevec_add(&batch->pvec, page))
+		return yaffs_write_batch(page->mapping->host, &batch->pvec);
+
+	return 0;
+}
+
+/* Write the dirty pages from range_start to range_end, in index order */
+static int yaffs_writepages_range(struct address_space *mapping,
+				struct writeback_control *wbc,
+				struct yaffs_writepages_batch *batch)
+{
+	int ret;
+	int err;
+
+	ret = write_cache_pages(mapping, wbc, yaffs_writepages_gather, batch);
+
+	if (pagevec_count(&batch->pvec)) {
+		err = yaffs_write_batch(mapping->host, &batch->pvec);
+		if (!ret)
+			ret = err;
+	}
+
+	return ret;
+}
+
+/* A range_cyclic write_cache_pages() would wrap back to index 0 while the
+ * batch still holds the locks of the pages at the end of the file. Do the
+ * two halves as separate ranges instead, so that the batch is written and
+ * unlocked before the wrap and page locks are only ever taken in order.
+ */
+static int yaffs_writepages(struct address_space *mapping,
+				struct writeback_control *wbc)
+{
+	struct yaffs_writepages_batch batch;
+	loff_t range_start = wbc->range_start;
+	loff_t range_end = wbc->range_end;
+	pgoff_t start;
+	int ret;
+
+	pagevec_init(&batch.pvec, 0);
+
+	if (!wbc->range_cyclic)
+		return yaffs_writepages_range(mapping, wbc, &batch);
+
+	start = mapping->writeback_index;
+	batch.done_index = start;
+
+	wbc->range_cyclic = 0;
+	wbc->range_start = (loff_t)start << PAGE_CACHE_SHIFT;
+	wbc->range_end = LLONG_MAX;
+	ret = yaffs_writepages_range(mapping, wbc, &batch);
+
+	if (!ret && start > 0 &&
+	    !(wbc->nonblocking && wbc->encountered_congestion) &&
+	    !(wbc->sync_mode == WB_SYNC_NONE && wbc->nr_to_write <= 0)) {
+		wbc->range_start = 0;
+		wbc->range_end = ((loff_t)start << PAGE_CACHE_SHIFT) - 1;
+		ret = yaffs_writepages_range(mapping, wbc, &batch);
+	}
+
+	wbc->range_cyclic = 1;
+	wbc->range_start = range_start;
+	wbc->range_end = range_end;
+	if (!wbc->no_nrwrite_index_update)
+		mapping->writeback_index = batch.done_index;
+
+	return ret;
+}
+#endif
+
 
 #if (YAFFS_USE_WRITE_BEGIN_END > 0)
 static int yaffs_write_begin(struct file *filp, struct address_space *mapping,
@@ -1931,6 +2141,8 @@ typedef struct {
 	int skip_checkpoint_read;
 	int skip_checkpoint_write;
 	int no_cache;
+	int cache_size;
+	int no_name_index;
 	int empty_lost_and_found_overridden;
 	int empty_lost_and_found;
 } yaffs_options;
@@ -1963,6 +2175,21 @@ static int yaffs_parse_options(yaffs_options *options, const char *options_str)
 			options->inband_tags = 1;
 		else if (!strcmp(cur_opt, "no-cache"))
 			options->no_cache = 1;
+		else if (!strncmp(cur_opt, "cache-size=", 11)) {
+			char *end;
+
+			options->cache_size =
+				simple_strtoul(cur_opt + 11, &end, 0);
+			if (*end || options->cache_size < 1 ||
+			    options->cache_size > YAFFS_MAX_SHORT_OP_CACHES) {
+				printk(KERN_INFO
+					"yaffs: Bad cache size \"%s\"\n",
+					cur_opt + 11);
+				error = 1;
+			}
+		}
+		else if (!strcmp(cur_opt, "no-name-index"))
+			options->no_name_index = 1;
 		else if (!strcmp(cur_opt, "no-checkpoint-read"))
 			options->skip_checkpoint_read = 1;
 		else if (!strcmp(cur_opt, "no-checkpoint-write"))
@@ -2187,7 +2414,14 @@ static struct super_block *yaffs_internal_read_super(int yaffsVersion,
 	dev->nChunksPerBlock = YAFFS_CHUNKS_PER_BLOCK;
 	dev->totalBytesPerChunk = YAFFS_BYTES_PER_CHUNK;
 	dev->nReservedBlocks = 5;
-	dev->nShortOpCaches = (options.no_cache) ? 0 : 10;
+	if (options.no_cache)
+		dev->nShortOpCaches = 0;
+	else if (options.cache_size)
+		dev->nShortOpCaches = options.cache_size;
+	else
+		dev->nShortOpCaches = YAFFS_DEFAULT_SHORT_OP_CACHES;
+	dev->nameIndexMaxBytes =
+		(options.no_name_index) ? 0 : YAFFS_DEFAULT_NAME_INDEX_BYTES;
 	dev->inbandTags = options.inband_tags;
 
 	/* ... and the functions. */
@@ -2425,6 +2659,8 @@ static char *yaffs_dump_dev(char *buf, yaffs_Device * dev)
 	buf += sprintf(buf, "tagsEccFixed....... %d\n", dev->tagsEccFixed);
 	buf += sprintf(buf, "tagsEccUnfixed..... %d\n", dev->tagsEccUnfixed);
 	buf += sprintf(buf, "cacheHits.......... %d\n", dev->cacheHits);
+	buf += sprintf(buf, "srDirtyCount....... %d\n", dev->srDirtyCount);
+	buf += sprintf(buf, "nameIndexBytes..... %d\n", dev->nameIndexBytes);
 	buf += sprintf(buf, "nDeletedFiles...... %d\n", dev->nDeletedFiles);
 	buf += sprintf(buf, "nUnlinkedFiles..... %d\n", dev->nUnlinkedFiles);
 	buf +=
@@ -69,6 +69,9 @@ static void yaffs_AddObjectToDirectory(yaffs_Object *directory,
 static int yaffs_UpdateObjectHeader(yaffs_Object *in, const YCHAR *name,
 				int force, int isShrink, int shadows);
 static void yaffs_RemoveObjectFromDirectory(yaffs_Object *obj);
+static void yaffs_NameIndexAdd(yaffs_Object *dir, yaffs_Object *obj);
+static void yaffs_NameIndexRemove(yaffs_Object *dir, yaffs_Object *obj);
+static void yaffs_FreeNameIndex(yaffs_Object *dir);
 static int yaffs_CheckStructures(void);
 static int yaffs_DeleteWorker(yaffs_Object *in, yaffs_Tnode *tn, __u32 level,
 			int chunkOffset, int *limit);
@@ -274,32 +277,6 @@ void yaffs_ReleaseTempBuffer(yaffs_Device *dev, __u8 *buffer,
 
 }
 
-/*
- * Determine if we have a managed buffer.
- */
-int yaffs_IsManagedTempBuffer(yaffs_Device *dev, const __u8 *buffer)
-{
-	int i;
-
-	for (i = 0; i < YAFFS_N_TEMP_BUFFERS; i++) {
-		if (dev->tempBuffer[i].buffer == buffer)
-			return 1;
-	}
-
-	for (i = 0; i < dev->nShortOpCaches; i++) {
-		if (dev->srCache[i].data == buffer)
-			return 1;
-	}
-
-	if (buffer == dev->checkpointBuffer)
-		return 1;
-
-	T(YAFFS_TRACE_ALWAYS,
-		(TSTR("yaffs: unmaged buffer detected.\n" TENDSTR)));
-	return 0;
-}
-
-
 
 /*
  * Chunk bitmap manipulations
@@ -1115,9 +1092,9 @@ static __u16 yaffs_CalcNameSum(const YCHAR *name)
 		while ((*bname) && (i < (YAFFS_MAX_NAME_LENGTH/2))) {
 
 #ifdef CONFIG_YAFFS_CASE_INSENSITIVE
-			sum += yaffs_toupper(*bname) * i;
+			sum = sum * 33 + yaffs_toupper(*bname);
 #else
-			sum += (*bname) * i;
+			sum = sum * 33 + (*bname);
 #endif
 			i++;
 			bname++;
@@ -1128,6 +1105,14 @@ static __u16 yaffs_CalcNameSum(const YCHAR *name)
 
 static void yaffs_SetObjectName(yaffs_Object *obj, const YCHAR *name)
 {
+	yaffs_Object *parent = obj->parent;
+
+	/* The name index is keyed on the sum, so rehash the object if
+	 * its directory is indexed.
+	 */
+	if (parent)
+		yaffs_NameIndexRemove(parent, obj);
+
 #ifdef CONFIG_YAFFS_SHORT_NAMES_IN_RAM
 	memset(obj->shortName, 0, sizeof(YCHAR) * (YAFFS_SHORT_NAME_LENGTH+1));
 	if (name && yaffs_strlen(name) <= YAFFS_SHORT_NAME_LENGTH)
@@ -1136,6 +1121,9 @@ static void yaffs_SetObjectName(yaffs_Object *obj, const YCHAR *name)
 		obj->shortName[0] = _Y('\0');
 #endif
 	obj->sum = yaffs_CalcNameSum(name);
+
+	if (parent)
+		yaffs_NameIndexAdd(parent, obj);
 }
 
 /*-------------------- TNODES -------------------
@@ -1921,12 +1909,14 @@ static yaffs_Object *yaffs_AllocateEmptyObject(yaffs_Device *dev)
 		YINIT_LIST_HEAD(&(tn->hardLinks));
 		YINIT_LIST_HEAD(&(tn->hashLink));
 		YINIT_LIST_HEAD(&tn->siblings);
+		YINIT_LIST_HEAD(&tn->cacheList);
 
 
 		/* Now make the directory sane */
 		if (dev->rootDir) {
 			tn->parent = dev->rootDir;
 			ylist_add(&(tn->siblings), &dev->rootDir->variant.directoryVariant.children);
+			yaffs_NameIndexAdd(dev->rootDir, tn);
 		}
 
 		/* Add it to the lost and found directory.
@@ -1992,6 +1982,9 @@ static void yaffs_FreeObject(yaffs_Object *tn)
 	if (!ylist_empty(&tn->siblings))
 		YBUG();
 
+	if (tn->variantType == YAFFS_OBJECT_TYPE_DIRECTORY)
+		yaffs_FreeNameIndex(tn);
+
 
 #ifdef __KERNEL__
 	if (tn->myInode) {
@@ -2003,6 +1996,8 @@ static void yaffs_FreeObject(yaffs_Object *tn)
 	}
 #endif
 
+	/* Nothing can flush these any more, don't leave them pointing at us */
+	yaffs_InvalidateWholeChunkCache(tn);
 	yaffs_UnhashObject(tn);
 
 #ifdef VALGRIND_TEST
@@ -2031,6 +2026,12 @@ static void yaffs_DeinitialiseObjects(yaffs_Device *dev)
 	/* Free the list of allocated Objects */
 
 	yaffs_ObjectList *tmp;
+	yaffs_NameIndex *ni;
+
+	while (!ylist_empty(&dev->nameIndexList)) {
+		ni = ylist_entry(dev->nameIndexList.next, yaffs_NameIndex, list);
+		yaffs_FreeNameIndex(ni->dir);
+	}
 
 	while (dev->allocatedObjectList) {
 		tmp = dev->allocatedObjectList->next;
@@ -2052,6 +2053,9 @@ static void yaffs_InitialiseObjects(yaffs_Device *dev)
 	dev->freeObjects = NULL;
 	dev->nFreeObjects = 0;
 
+	YINIT_LIST_HEAD(&dev->nameIndexList);
+	dev->nameIndexBytes = 0;
+
 	for (i = 0; i < YAFFS_NOBJECT_BUCKETS; i++) {
 		YINIT_LIST_HEAD(&dev->objectBucket[i].list);
 		dev->objectBucket[i].count = 0;
@@ -2211,6 +2215,7 @@ yaffs_Object *yaffs_CreateNewObject(yaffs_Device *dev, int number,
 		case YAFFS_OBJECT_TYPE_DIRECTORY:
 			YINIT_LIST_HEAD(&theObject->variant.directoryVariant.
 					children);
+			theObject->variant.directoryVariant.nameIndex = NULL;
 			break;
 		case YAFFS_OBJECT_TYPE_SYMLINK:
 		case YAFFS_OBJECT_TYPE_HARDLINK:
@@ -3855,77 +3860,134 @@ int yaffs_UpdateObjectHeader(yaffs_Object *in, const YCHAR *name, int force,
  *   In Linux, the page cache provides read buffering aand the short op cache provides write
  *   buffering.
  *
- *   There are a limited number (~10) of cache chunks per device so that we don't
- *   need a very intelligent search.
+ *   Cache entries are hashed on (object, chunkId) so that lookups stay cheap
+ *   when the cache is configured with hundreds of entries. Every entry is also
+ *   kept on an LRU list: used entries are moved to the head and freed entries
+ *   are moved to the tail, so both allocation and replacement start at the tail.
+ */
+
+static struct ylist_head *yaffs_ChunkCacheBucket(yaffs_Device *dev,
+						const yaffs_Object *obj,
+						int chunkId)
+{
+	__u32 h = obj->objectId * 0x9E3779B1 + chunkId;
+
+	return &dev->srHash[(h ^ (h >> 16)) & dev->srHashMask];
+}
+
+/* Take an entry out of use: unhash it, take it off its object and make it
+ * the first candidate for reuse.
+ */
+static void yaffs_ReleaseChunkCache(yaffs_Device *dev, yaffs_ChunkCache *cache)
+{
+	if (cache->dirty)
+		dev->srDirtyCount--;
+	cache->dirty = 0;
+	cache->object = NULL;
+	ylist_del_init(&cache->hashLink);
+	ylist_del_init(&cache->objLink);
+	ylist_del(&cache->lruLink);
+	ylist_add_tail(&cache->lruLink, &dev->srLru);
+}
+
+/* Enter a freshly grabbed entry into the hash and onto its object's list
+ * once its object and chunkId have been filled in.
  */
+static void yaffs_HashChunkCache(yaffs_Device *dev, yaffs_ChunkCache *cache)
+{
+	ylist_add(&cache->hashLink,
+		  yaffs_ChunkCacheBucket(dev, cache->object, cache->chunkId));
+	ylist_add(&cache->objLink, &cache->object->cacheList);
+}
+
+static void yaffs_CleanChunkCache(yaffs_Device *dev, yaffs_ChunkCache *cache)
+{
+	if (cache->dirty) {
+		cache->dirty = 0;
+		dev->srDirtyCount--;
+	}
+}
 
 static int yaffs_ObjectHasCachedWriteData(yaffs_Object *obj)
 {
 	yaffs_Device *dev = obj->myDev;
-	int i;
+	struct ylist_head *i;
 	yaffs_ChunkCache *cache;
-	int nCaches = obj->myDev->nShortOpCaches;
 
-	for (i = 0; i < nCaches; i++) {
-		cache = &dev->srCache[i];
-		if (cache->object == obj &&
-		    cache->dirty)
+	if (dev->srDirtyCount < 1)
+		return 0;
+
+	ylist_for_each(i, &obj->cacheList) {
+		cache = ylist_entry(i, yaffs_ChunkCache, objLink);
+		if (cache->dirty)
 			return 1;
 	}
 
 	return 0;
 }
 
+static int yaffs_CompareCacheChunkIds(const void *a, const void *b)
+{
+	const yaffs_ChunkCache *ca = *(yaffs_ChunkCache * const *)a;
+	const yaffs_ChunkCache *cb = *(yaffs_ChunkCache * const *)b;
+
+	return ca->chunkId - cb->chunkId;
+}
 
 static void yaffs_FlushFilesChunkCache(yaffs_Object *obj)
 {
 	yaffs_Device *dev = obj->myDev;
-	int lowest = -99;	/* Stop compiler whining. */
+	struct ylist_head *lh;
 	int i;
+	int n;
 	yaffs_ChunkCache *cache;
-	int chunkWritten = 0;
-	int nCaches = obj->myDev->nShortOpCaches;
-
-	if (nCaches > 0) {
-		do {
-			cache = NULL;
-
-			/* Find the dirty cache for this object with the lowest chunk id. */
-			for (i = 0; i < nCaches; i++) {
-				if (dev->srCache[i].object == obj &&
-				    dev->srCache[i].dirty) {
-					if (!cache
-					    || dev->srCache[i].chunkId <
-					    lowest) {
-						cache = &dev->srCache[i];
-						lowest = cache->chunkId;
-					}
-				}
-			}
+	int chunkWritten;
 
-			if (cache && !cache->locked) {
-				/* Write it out and free it up */
+	if (dev->nShortOpCaches < 1 || dev->srDirtyCount < 1)
+		return;
 
-				chunkWritten =
-				    yaffs_WriteChunkDataToObject(cache->object,
-								 cache->chunkId,
-								 cache->data,
-								 cache->nBytes,
-								 1);
-				cache->dirty = 0;
-				cache->object = NULL;
-			}
+	/* Gather the dirty caches for this object and write them out in
+	 * chunk id order, lowest first.
+	 */
+	n = 0;
+	ylist_for_each(lh, &obj->cacheList) {
+		cache = ylist_entry(lh, yaffs_ChunkCache, objLink);
+		if (cache->dirty)
+			dev->srFlushList[n++] = cache;
+	}
 
-		} while (cache && chunkWritten > 0);
+	if (n > 1)
+		yaffs_qsort(dev->srFlushList, n, sizeof(yaffs_ChunkCache *),
+			    yaffs_CompareCacheChunkIds);
 
-		if (cache) {
-			/* Hoosterman, disk full while writing cache out. */
-			T(YAFFS_TRACE_ERROR,
-			  (TSTR("yaffs tragedy: no space during cache write" TENDSTR)));
+	for (i = 0; i < n; i++) {
+		cache = dev->srFlushList[i];
 
-		}
+		/* Writing may have caused the entry to be invalidated. */
+		if (cache->object != obj || !cache->dirty)
+			continue;
+
+		if (cache->locked)
+			break;
+
+		/* Write it out and free it up */
+		chunkWritten =
+		    yaffs_WriteChunkDataToObject(cache->object,
+						 cache->chunkId,
+						 cache->data,
+						 cache->nBytes,
+						 1);
+		if (chunkWritten <= 0)
+			break;
+
+		yaffs_ReleaseChunkCache(dev, cache);
 	}
 
+	if (i < n) {
+		/* Hoosterman, disk full while writing cache out. */
+		T(YAFFS_TRACE_ERROR,
+		  (TSTR("yaffs tragedy: no space during cache write" TENDSTR)));
+	}
 }
 
 /*yaffs_FlushEntireDeviceCache(dev)
@@ -3935,43 +3997,34 @@ static void yaffs_FlushFilesChunkCache(yaffs_Object *obj)
 
 void yaffs_FlushEntireDeviceCache(yaffs_Device *dev)
 {
-	yaffs_Object *obj;
-	int nCaches = dev->nShortOpCaches;
+	yaffs_ChunkCache *cache;
 	int i;
 
-	/* Find a dirty object in the cache and flush it...
-	 * until there are no further dirty objects.
+	/* One pass is enough: flushing an entry's object writes out all of
+	 * that object's dirty entries, found through its own cache list.
 	 */
-	do {
-		obj = NULL;
-		for (i = 0; i < nCaches && !obj; i++) {
-			if (dev->srCache[i].object &&
-			    dev->srCache[i].dirty)
-				obj = dev->srCache[i].object;
-
-		}
-		if (obj)
-			yaffs_FlushFilesChunkCache(obj);
-
-	} while (obj);
-
+	for (i = 0; i < dev->nShortOpCaches && dev->srDirtyCount > 0; i++) {
+		cache = &dev->srCache[i];
+		if (cache->object && cache->dirty)
+			yaffs_FlushFilesChunkCache(cache->object);
+	}
 }
 
 
 /* Grab us a cache chunk for use.
  * First look for an empty one.
- * Then look for the least recently used non-dirty one.
- * Then look for the least recently used dirty one...., flush and look again.
+ * Then look for the least recently used one, flushing its object first if
+ * it is dirty.
+ * Free entries sit at the tail of the LRU list, so both cases start there.
  */
 static yaffs_ChunkCache *yaffs_GrabChunkCacheWorker(yaffs_Device *dev)
 {
-	int i;
+	yaffs_ChunkCache *cache;
 
 	if (dev->nShortOpCaches > 0) {
-		for (i = 0; i < dev->nShortOpCaches; i++) {
-			if (!dev->srCache[i].object)
-				return &dev->srCache[i];
-		}
+		cache = ylist_entry(dev->srLru.prev, yaffs_ChunkCache, lruLink);
+		if (!cache->object)
+			return cache;
 	}
 
 	return NULL;
@@ -3980,44 +4033,30 @@ static yaffs_ChunkCache *yaffs_GrabChunkCacheWorker(yaffs_Device *dev)
 static yaffs_ChunkCache *yaffs_GrabChunkCache(yaffs_Device *dev)
 {
 	yaffs_ChunkCache *cache;
-	yaffs_Object *theObj;
-	int usage;
-	int i;
-	int pushout;
+	struct ylist_head *i;
 
 	if (dev->nShortOpCaches > 0) {
-		/* Try find a non-dirty one... */
+		/* Try find a free one... */
 
 		cache = yaffs_GrabChunkCacheWorker(dev);
 
 		if (!cache) {
-			/* They were all dirty, find the last recently used object and flush
-			 * its cache, then  find again.
-			 * NB what's here is not very accurate, we actually flush the object
-			 * the last recently used page.
+			/* None are free, take the least recently used one that
+			 * is not locked. If it is dirty then flush its object
+			 * and find again.
 			 */
-
-			/* With locking we can't assume we can use entry zero */
-
-			theObj = NULL;
-			usage = -1;
-			cache = NULL;
-			pushout = -1;
-
-			for (i = 0; i < dev->nShortOpCaches; i++) {
-				if (dev->srCache[i].object &&
-				    !dev->srCache[i].locked &&
-				    (dev->srCache[i].lastUse < usage || !cache)) {
-					usage = dev->srCache[i].lastUse;
-					theObj = dev->srCache[i].object;
-					cache = &dev->srCache[i];
-					pushout = i;
-				}
+			for (i = dev->srLru.prev; i != &dev->srLru; i = i->prev) {
+				cache = ylist_entry(i, yaffs_ChunkCache, lruLink);
+				if (!cache->locked)
+					break;
+				cache = NULL;
 			}
 
-			if (!cache || cache->dirty) {
+			if (cache && !cache->dirty) {
+				yaffs_ReleaseChunkCache(dev, cache);
+			} else if (cache) {
 				/* Flush and try again */
-				yaffs_FlushFilesChunkCache(theObj);
+				yaffs_FlushFilesChunkCache(cache->object);
 				cache = yaffs_GrabChunkCacheWorker(dev);
 			}
 
@@ -4033,14 +4072,19 @@ static yaffs_ChunkCache *yaffs_FindChunkCache(const yaffs_Object *obj,
 					      int chunkId)
 {
 	yaffs_Device *dev = obj->myDev;
-	int i;
+	struct ylist_head *bucket;
+	struct ylist_head *i;
+	yaffs_ChunkCache *cache;
+
 	if (dev->nShortOpCaches > 0) {
-		for (i = 0; i < dev->nShortOpCaches; i++) {
-			if (dev->srCache[i].object == obj &&
-			    dev->srCache[i].chunkId == chunkId) {
+		bucket = yaffs_ChunkCacheBucket(dev, obj, chunkId);
+		ylist_for_each(i, bucket) {
+			cache = ylist_entry(i, yaffs_ChunkCache, hashLink);
+			if (cache->object == obj &&
+			    cache->chunkId == chunkId) {
 				dev->cacheHits++;
 
-				return &dev->srCache[i];
+				return cache;
 			}
 		}
 	}
@@ -4053,21 +4097,13 @@ static void yaffs_UseChunkCache(yaffs_Device *dev, yaffs_ChunkCache *cache,
 {
 
 	if (dev->nShortOpCaches > 0) {
-		if (dev->srLastUse < 0 || dev->srLastUse > 100000000) {
-			/* Reset the cache usages */
-			int i;
-			for (i = 1; i < dev->nShortOpCaches; i++)
-				dev->srCache[i].lastUse = 0;
-
-			dev->srLastUse = 0;
-		}
+		ylist_del(&cache->lruLink);
+		ylist_add(&cache->lruLink, &dev->srLru);
 
-		dev->srLastUse++;
-
-		cache->lastUse = dev->srLastUse;
-
-		if (isAWrite)
+		if (isAWrite && !cache->dirty) {
 			cache->dirty = 1;
+			dev->srDirtyCount++;
+		}
 	}
 }
 
@@ -4081,7 +4117,7 @@ static void yaffs_InvalidateChunkCache(yaffs_Object *object, int chunkId)
 		yaffs_ChunkCache *cache = yaffs_FindChunkCache(object, chunkId);
 
 		if (cache)
-			cache->object = NULL;
+			yaffs_ReleaseChunkCache(object->myDev, cache);
 	}
 }
 
@@ -4090,16 +4126,13 @@ static void yaffs_InvalidateChunkCache(yaffs_Object *object, int chunkId)
  */
 static void yaffs_InvalidateWholeChunkCache(yaffs_Object *in)
 {
-	int i;
+	struct ylist_head *i;
+	struct ylist_head *n;
 	yaffs_Device *dev = in->myDev;
 
-	if (dev->nShortOpCaches > 0) {
-		/* Invalidate it. */
-		for (i = 0; i < dev->nShortOpCaches; i++) {
-			if (dev->srCache[i].object == in)
-				dev->srCache[i].object = NULL;
-		}
-	}
+	ylist_for_each_safe(i, n, &in->cacheList)
+		yaffs_ReleaseChunkCache(dev,
+			ylist_entry(i, yaffs_ChunkCache, objLink));
 }
 
 /*--------------------- Checkpointing --------------------*/
@@ -4724,6 +4757,7 @@ int yaffs_ReadDataFromFile(yaffs_Object *in, __u8 *buffer, loff_t offset,
 					cache->chunkId = chunk;
 					cache->dirty = 0;
 					cache->locked = 0;
+					yaffs_HashChunkCache(dev, cache);
 					yaffs_ReadChunkDataFromObject(in, chunk,
 								      cache->
 								      data);
@@ -4854,6 +4888,7 @@ int yaffs_WriteDataToFile(yaffs_Object *in, const __u8 *buffer, loff_t offset,
 					cache->chunkId = chunk;
 					cache->dirty = 0;
 					cache->locked = 0;
+					yaffs_HashChunkCache(dev, cache);
 					yaffs_ReadChunkDataFromObject(in, chunk,
 								      cache->
 								      data);
@@ -4885,7 +4920,7 @@ int yaffs_WriteDataToFile(yaffs_Object *in, const __u8 *buffer, loff_t offset,
 						     cache->chunkId,
 						     cache->data, cache->nBytes,
 						     1);
-						cache->dirty = 0;
+						yaffs_CleanChunkCache(dev, cache);
 					}
 
 				} else {
@@ -5293,6 +5328,7 @@ static int yaffs_UnlinkWorker(yaffs_Object *obj)
 		hl = ylist_entry(obj->hardLinks.next, yaffs_Object, hardLinks);
 
 		ylist_del_init(&hl->hardLinks);
+		yaffs_NameIndexRemove(hl->parent, hl);
 		ylist_del_init(&hl->siblings);
 
 		yaffs_GetObjectName(hl, name, YAFFS_MAX_NAME_LENGTH + 1);
@@ -5896,6 +5932,8 @@ static int yaffs_Scan(yaffs_Device *dev)
 						YINIT_LIST_HEAD(&parent->variant.
 								directoryVariant.
 								children);
+						parent->variant.directoryVariant.
+							nameIndex = NULL;
 					} else if (!parent || parent->variantType !=
 						   YAFFS_OBJECT_TYPE_DIRECTORY) {
 						/* Hoosterman, another problem....
@@ -6626,6 +6664,8 @@ static int yaffs_ScanBackwards(yaffs_Device *dev)
 						YINIT_LIST_HEAD(&parent->variant.
 							directoryVariant.
 							children);
+						parent->variant.directoryVariant.
+							nameIndex = NULL;
 					} else if (!parent || parent->variantType !=
 						   YAFFS_OBJECT_TYPE_DIRECTORY) {
 						/* Hoosterman, another problem....
@@ -6862,6 +6902,8 @@ static void yaffs_RemoveObjectFromDirectory(yaffs_Object *obj)
 	if (dev && dev->removeObjectCallback)
 		dev->removeObjectCallback(obj);
 
+	if (parent)
+		yaffs_NameIndexRemove(parent, obj);
 
 	ylist_del_init(&obj->siblings);
 	obj->parent = NULL;
@@ -6902,6 +6944,7 @@ static void yaffs_AddObjectToDirectory(yaffs_Object *directory,
 	/* Now add it */
 	ylist_add(&obj->siblings, &directory->variant.directoryVariant.children);
 	obj->parent = directory;
+	yaffs_NameIndexAdd(directory, obj);
 
 	if (directory == obj->myDev->unlinkedDir
 			|| directory == obj->myDev->deletedDir) {
@@ -6914,15 +6957,254 @@ static void yaffs_AddObjectToDirectory(yaffs_Object *directory,
 	yaffs_VerifyObjectInDirectory(obj);
 }
 
+/*------------------------ Directory name index -----------------------------
+ * Looking up a name walks the directory's children comparing name sums, which
+ * gets slow for directories with thousands of entries. Large directories get
+ * an open addressed table of their children keyed on the name sum. The index
+ * is built on the first lookup that has to walk a large directory and is kept
+ * up to date as objects are added, removed and renamed. Small directories and
+ * directories that would take the device over nameIndexMaxBytes just use the
+ * list.
+ */
+
+static int yaffs_NameIndexSlotBytes(int nSlots)
+{
+	return nSlots * sizeof(yaffs_Object *);
+}
+
+static void yaffs_FreeNameIndex(yaffs_Object *dir)
+{
+	yaffs_NameIndex *ni = dir->variant.directoryVariant.nameIndex;
+
+	if (!ni)
+		return;
+
+	dir->myDev->nameIndexBytes -= sizeof(yaffs_NameIndex) +
+				yaffs_NameIndexSlotBytes(ni->mask + 1);
+	ylist_del(&ni->list);
+	YFREE(ni->slots);
+	YFREE(ni);
+	dir->variant.directoryVariant.nameIndex = NULL;
+}
+
+static yaffs_NameIndex *yaffs_GetNameIndex(yaffs_Object *dir)
+{
+	if (!dir || dir->variantType != YAFFS_OBJECT_TYPE_DIRECTORY)
+		return NULL;
+	return dir->variant.directoryVariant.nameIndex;
+}
+
+static void yaffs_NameIndexInsertSlot(yaffs_NameIndex *ni, yaffs_Object *obj)
+{
+	int i = obj->sum & ni->mask;
+
+	while (ni->slots[i]) {
+		if (ni->slots[i] == obj)
+			return;
+		i = (i + 1) & ni->mask;
+	}
+
+	ni->slots[i] = obj;
+	ni->nEntries++;
+}
+
+/* Rehash the index into nSlots slots. Fails if that would take the device
+ * over its budget or memory is short.
+ */
+static int yaffs_ResizeNameIndex(yaffs_NameIndex *ni, int nSlots)
+{
+	yaffs_Device *dev = ni->dir->myDev;
+	yaffs_Object **oldSlots = ni->slots;
+	int oldBytes = yaffs_NameIndexSlotBytes(ni->mask + 1);
+	int newBytes = yaffs_NameIndexSlotBytes(nSlots);
+	int i;
+
+	if (dev->nameIndexBytes - oldBytes + newBytes > dev->nameIndexMaxBytes)
+		return YAFFS_FAIL;
+
+	ni->slots = YMALLOC(newBytes);
+	if (!ni->slots) {
+		ni->slots = oldSlots;
+		return YAFFS_FAIL;
+	}
+	memset(ni->slots, 0, newBytes);
+
+	ni->nEntries = 0;
+	ni->mask = nSlots - 1;
+	for (i = 0; i < (oldBytes / (int)sizeof(yaffs_Object *)); i++) {
+		if (oldSlots[i])
+			yaffs_NameIndexInsertSlot(ni, oldSlots[i]);
+	}
+
+	YFREE(oldSlots);
+	dev->nameIndexBytes += newBytes - oldBytes;
+
+	return YAFFS_OK;
+}
+
+static void yaffs_NameIndexAdd(yaffs_Object *dir, yaffs_Object *obj)
+{
+	yaffs_NameIndex *ni = yaffs_GetNameIndex(dir);
+
+	if (!ni)
+		return;
+
+	/* Lazy loaded objects don't have a valid sum yet. Loading the
+	 * details sets the name, which adds the object to the index.
+	 */
+	if (obj->lazyLoaded) {
+		yaffs_CheckObjectDetailsLoaded(obj);
+		ni = yaffs_GetNameIndex(dir);
+		if (!ni)
+			return;
+	}
+
+	/* Keep the table at most 3/4 full, else give up on indexing */
+	if ((ni->nEntries + 1) * 4 > (ni->mask + 1) * 3 &&
+	    yaffs_ResizeNameIndex(ni, (ni->mask + 1) * 2) != YAFFS_OK) {
+		yaffs_FreeNameIndex(dir);
+		return;
+	}
+
+	yaffs_NameIndexInsertSlot(ni, obj);
+}
+
+static void yaffs_NameIndexRemove(yaffs_Object *dir, yaffs_Object *obj)
+{
+	yaffs_NameIndex *ni = yaffs_GetNameIndex(dir);
+	yaffs_Object *l;
+	int i;
+	int j;
+	int home;
+
+	if (!ni)
+		return;
+
+	for (i = obj->sum & ni->mask; ni->slots[i] != obj;
+	     i = (i + 1) & ni->mask) {
+		if (!ni->slots[i])
+			return;
+	}
+
+	/* Shift back any later entries in the run that would otherwise
+	 * become unreachable.
+	 */
+	for (j = (i + 1) & ni->mask; ni->slots[j]; j = (j + 1) & ni->mask) {
+		l = ni->slots[j];
+		home = l->sum & ni->mask;
+		if (((j - home) & ni->mask) >= ((j - i) & ni->mask)) {
+			ni->slots[i] = l;
+			i = j;
+		}
+	}
+	ni->slots[i] = NULL;
+	ni->nEntries--;
+
+	if (ni->nEntries < YAFFS_NAME_INDEX_THRESHOLD / 2)
+		yaffs_FreeNameIndex(dir);
+}
+
+static void yaffs_BuildNameIndex(yaffs_Object *dir, int nWalked)
+{
+	yaffs_Device *dev = dir->myDev;
+	yaffs_NameIndex *ni;
+	struct ylist_head *i;
+	int nChildren = 0;
+	int nSlots;
+	int nBytes;
+
+	/* nWalked is a lower bound on the size, don't bother counting
+	 * if even that would not fit.
+	 */
+	if (nWalked * 2 * (int)sizeof(yaffs_Object *) +
+	    dev->nameIndexBytes > dev->nameIndexMaxBytes)
+		return;
+
+	ylist_for_each(i, &dir->variant.directoryVariant.children)
+		nChildren++;
+
+	for (nSlots = 1; nSlots < nChildren * 2; nSlots <<= 1)
+		;
+
+	nBytes = sizeof(yaffs_NameIndex) + yaffs_NameIndexSlotBytes(nSlots);
+	if (dev->nameIndexBytes + nBytes > dev->nameIndexMaxBytes)
+		return;
+
+	ni = YMALLOC(sizeof(yaffs_NameIndex));
+	if (!ni)
+		return;
+	ni->slots = YMALLOC(yaffs_NameIndexSlotBytes(nSlots));
+	if (!ni->slots) {
+		YFREE(ni);
+		return;
+	}
+	memset(ni->slots, 0, yaffs_NameIndexSlotBytes(nSlots));
+	ni->dir = dir;
+	ni->nEntries = 0;
+	ni->mask = nSlots - 1;
+
+	ylist_for_each(i, &dir->variant.directoryVariant.children) {
+		yaffs_Object *l = ylist_entry(i, yaffs_Object, siblings);
+
+		yaffs_CheckObjectDetailsLoaded(l);
+		yaffs_NameIndexInsertSlot(ni, l);
+	}
+
+	ylist_add(&ni->list, &dev->nameIndexList);
+	dev->nameIndexBytes += nBytes;
+	dir->variant.directoryVariant.nameIndex = ni;
+}
+
+/* Objects that are not found by their name sum: lost+found and objects
+ * without a header, which get a made up name with the lost+found prefix.
+ */
+static int yaffs_NameNeedsListSearch(const YCHAR *name)
+{
+	return yaffs_strcmp(name, YAFFS_LOSTNFOUND_NAME) == 0 ||
+		yaffs_strncmp(name, YAFFS_LOSTNFOUND_PREFIX,
+			      yaffs_strlen(YAFFS_LOSTNFOUND_PREFIX)) == 0;
+}
+
+static int yaffs_ObjectNameMatches(yaffs_Object *l, const YCHAR *name,
+				YCHAR *buffer)
+{
+	/* Special case for lost-n-found */
+	if (l->objectId == YAFFS_OBJECTID_LOSTNFOUND)
+		return yaffs_strcmp(name, YAFFS_LOSTNFOUND_NAME) == 0;
+
+	yaffs_GetObjectName(l, buffer, YAFFS_MAX_NAME_LENGTH + 1);
+	return yaffs_strncmp(name, buffer, YAFFS_MAX_NAME_LENGTH) == 0;
+}
+
+static yaffs_Object *yaffs_NameIndexFind(yaffs_NameIndex *ni,
+					const YCHAR *name, int sum,
+					YCHAR *buffer)
+{
+	yaffs_Object *l;
+	int i;
+
+	for (i = sum & ni->mask; (l = ni->slots[i]) != NULL;
+	     i = (i + 1) & ni->mask) {
+		if (yaffs_SumCompare(l->sum, sum) &&
+		    yaffs_ObjectNameMatches(l, name, buffer))
+			return l;
+	}
+
+	return NULL;
+}
+
 yaffs_Object *yaffs_FindObjectByName(yaffs_Object *directory,
 				     const YCHAR *name)
 {
 	int sum;
+	int nWalked = 0;
 
 	struct ylist_head *i;
 	YCHAR buffer[YAFFS_MAX_NAME_LENGTH + 1];
 
 	yaffs_Object *l;
+	yaffs_Object *found = NULL;
+	yaffs_NameIndex *ni;
 
 	if (!name)
 		return NULL;
@@ -6944,6 +7226,13 @@ yaffs_Object *yaffs_FindObjectByName(yaffs_Object *directory,
 
 	sum = yaffs_CalcNameSum(name);
 
+	ni = directory->variant.directoryVariant.nameIndex;
+	if (ni) {
+		found = yaffs_NameIndexFind(ni, name, sum, buffer);
+		if (found || !yaffs_NameNeedsListSearch(name))
+			return found;
+	}
+
 	ylist_for_each(i, &directory->variant.directoryVariant.children) {
 		if (i) {
 			l = ylist_entry(i, yaffs_Object, siblings);
@@ -6951,25 +7240,28 @@ yaffs_Object *yaffs_FindObjectByName(yaffs_Object *directory,
 			if (l->parent != directory)
 				YBUG();
 
+			nWalked++;
+
 			yaffs_CheckObjectDetailsLoaded(l);
 
-			/* Special case for lost-n-found */
-			if (l->objectId == YAFFS_OBJECTID_LOSTNFOUND) {
-				if (yaffs_strcmp(name, YAFFS_LOSTNFOUND_NAME) == 0)
-					return l;
-			} else if (yaffs_SumCompare(l->sum, sum) || l->hdrChunk <= 0) {
+			if (l->objectId == YAFFS_OBJECTID_LOSTNFOUND ||
+			    yaffs_SumCompare(l->sum, sum) || l->hdrChunk <= 0) {
 				/* LostnFound chunk called Objxxx
 				 * Do a real check
 				 */
-				yaffs_GetObjectName(l, buffer,
-						    YAFFS_MAX_NAME_LENGTH + 1);
-				if (yaffs_strncmp(name, buffer, YAFFS_MAX_NAME_LENGTH) == 0)
-					return l;
+				if (yaffs_ObjectNameMatches(l, name, buffer)) {
+					found = l;
+					break;
+				}
 			}
 		}
 	}
 
-	return NULL;
+	if (!ni && nWalked >= YAFFS_NAME_INDEX_THRESHOLD &&
+	    directory->myDev->nameIndexMaxBytes > 0)
+		yaffs_BuildNameIndex(directory, nWalked);
+
+	return found;
 }
 
 
@@ -7465,28 +7757,47 @@ int yaffs_GutsInitialise(yaffs_Device *dev)
 	    dev->nShortOpCaches > 0) {
 		int i;
 		void *buf;
-		int srCacheBytes = dev->nShortOpCaches * sizeof(yaffs_ChunkCache);
+		int srCacheBytes;
+		int nBuckets;
 
 		if (dev->nShortOpCaches > YAFFS_MAX_SHORT_OP_CACHES)
 			dev->nShortOpCaches = YAFFS_MAX_SHORT_OP_CACHES;
 
+		srCacheBytes = dev->nShortOpCaches * sizeof(yaffs_ChunkCache);
+
+		/* Power of two buckets, roughly one per cache entry */
+		for (nBuckets = 1; nBuckets < dev->nShortOpCaches; nBuckets <<= 1)
+			;
+
 		dev->srCache =  YMALLOC(srCacheBytes);
+		dev->srHash = YMALLOC(nBuckets * sizeof(struct ylist_head));
+		dev->srFlushList = YMALLOC(dev->nShortOpCaches *
+					   sizeof(yaffs_ChunkCache *));
+		dev->srHashMask = nBuckets - 1;
+		dev->srDirtyCount = 0;
+		YINIT_LIST_HEAD(&dev->srLru);
 
 		buf = (__u8 *) dev->srCache;
 
 		if (dev->srCache)
 			memset(dev->srCache, 0, srCacheBytes);
 
+		if (!dev->srHash || !dev->srFlushList)
+			buf = NULL;
+
+		for (i = 0; i < nBuckets && buf; i++)
+			YINIT_LIST_HEAD(&dev->srHash[i]);
+
 		for (i = 0; i < dev->nShortOpCaches && buf; i++) {
 			dev->srCache[i].object = NULL;
-			dev->srCache[i].lastUse = 0;
 			dev->srCache[i].dirty = 0;
+			YINIT_LIST_HEAD(&dev->srCache[i].hashLink);
+			YINIT_LIST_HEAD(&dev->srCache[i].objLink);
+			ylist_add_tail(&dev->srCache[i].lruLink, &dev->srLru);
 			dev->srCache[i].data = buf = YMALLOC_DMA(dev->totalBytesPerChunk);
 		}
 		if (!buf)
 			init_failed = 1;
-
-		dev->srLastUse = 0;
 	}
 
 	dev->cacheHits = 0;
@@ -7607,6 +7918,10 @@ void yaffs_Deinitialise(yaffs_Device *dev)
 
 			YFREE(dev->srCache);
 			dev->srCache = NULL;
+			YFREE(dev->srHash);
+			dev->srHash = NULL;
+			YFREE(dev->srFlushList);
+			dev->srFlushList = NULL;
 		}
 
 		YFREE(dev->gcCleanupList);
@@ -7656,7 +7971,6 @@ int yaffs_GetNumberOfFreeChunks(yaffs_Device *dev)
 	int nFree;
 	int nDirtyCacheChunks;
 	int blocksForCheckpoint;
-	int i;
 
 #if 1
 	nFree = dev->nFreeChunks;
@@ -7668,10 +7982,7 @@ int yaffs_GetNumberOfFreeChunks(yaffs_Device *dev)
 
 	/* Now count the number of dirty chunks in the cache and subtract those */
 
-	for (nDirtyCacheChunks = 0, i = 0; i < dev->nShortOpCaches; i++) {
-		if (dev->srCache[i].dirty)
-			nDirtyCacheChunks++;
-	}
+	nDirtyCacheChunks = dev->srDirtyCount;
 
 	nFree -= nDirtyCacheChunks;
 
@@ -88,7 +88,14 @@
 
 /* */
 
-#define YAFFS_MAX_SHORT_OP_CACHES	20
+#define YAFFS_MAX_SHORT_OP_CACHES	512
+#define YAFFS_DEFAULT_SHORT_OP_CACHES	10
+
+/* Directories are given a name index once a lookup walks this many
+ * entries. The memory used by all the indexes on a device is capped.
+ */
+#define YAFFS_NAME_INDEX_THRESHOLD	64
+#define YAFFS_DEFAULT_NAME_INDEX_BYTES	(64 * 1024)
 
 #define YAFFS_N_TEMP_BUFFERS		6
 
@@ -111,11 +118,17 @@
 /* Special sequence number for bad block that failed to be marked bad */
 #define YAFFS_SEQUENCE_BAD_BLOCK	0xFFFF0000
 
-/* ChunkCache is used for short read/write operations.*/
+/* ChunkCache is used for short read/write operations.
+ * Entries in use are hashed on (object, chunkId) and listed on their object.
+ * All entries live on the device LRU list, most recently used at the head
+ * and free ones at the tail.
+ */
 typedef struct {
+	struct ylist_head hashLink;	/* entries in this hash bucket */
+	struct ylist_head objLink;	/* entries for the same object */
+	struct ylist_head lruLink;	/* position in the device LRU list */
 	struct yaffs_ObjectStruct *object;
 	int chunkId;
-	int lastUse;
 	int dirty;
 	int nBytes;		/* Only valid if the cache is dirty */
 	int locked;		/* Can't push out or flush while locked. */
@@ -385,8 +398,21 @@ typedef struct {
 	yaffs_Tnode *top;
 } yaffs_FileStructure;
 
+/* Name index for large directories.
+ * An open addressed table of child objects keyed on the name sum, built
+ * lazily when a lookup has to walk a large directory.
+ */
+typedef struct {
+	struct ylist_head list;		/* all the indexes on this device */
+	struct yaffs_ObjectStruct *dir;	/* the directory being indexed */
+	int nEntries;
+	int mask;			/* number of slots - 1 */
+	struct yaffs_ObjectStruct **slots;
+} yaffs_NameIndex;
+
 typedef struct {
 	struct ylist_head children;     /* list of child links */
+	yaffs_NameIndex *nameIndex;	/* NULL unless the directory is large */
 } yaffs_DirectoryStructure;
 
 typedef struct {
@@ -435,6 +461,8 @@ struct yaffs_ObjectStruct {
 
 	struct ylist_head hardLinks;    /* all the equivalent hard linked objects */
 
+	struct ylist_head cacheList;    /* short op cache entries for this object */
+
 	/* directory structure stuff */
 	/* also used for linking up the free list */
 	struct yaffs_ObjectStruct *parent;
@@ -558,6 +586,8 @@ struct yaffs_DeviceStruct {
 
 	int useHeaderFileSize;	/* Flag to determine if we should use file sizes from the header */
 
+	int nameIndexMaxBytes;	/* Memory cap for directory name indexes, 0 disables them */
+
 	int emptyLostAndFound;  /* Flasg to determine if lst+found should be emptied on init */
 
 	int useNANDECC;		/* Flag to decide whether or not to use NANDECC */
@@ -749,7 +779,14 @@ struct yaffs_DeviceStruct {
 	int doingBufferedBlockRewrite;
 
 	yaffs_ChunkCache *srCache;
-	int srLastUse;
+	struct ylist_head *srHash;	/* hash buckets, srHashMask + 1 of them */
+	int srHashMask;
+	struct ylist_head srLru;	/* LRU order, free entries at the tail */
+	int srDirtyCount;		/* number of dirty cache entries */
+	yaffs_ChunkCache **srFlushList;	/* scratch space for ordered flushes */
+
+	struct ylist_head nameIndexList;	/* directory name indexes */
+	int nameIndexBytes;		/* memory used by them */
 
 	int cacheHits;
 
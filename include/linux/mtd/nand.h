@@ -84,6 +84,8 @@ extern void nand_wait_ready(struct mtd_info *mtd);
 #define NAND_CMD_READSTART	0x30
 #define NAND_CMD_RNDOUTSTART	0xE0
 #define NAND_CMD_CACHEDPROG	0x15
+#define NAND_CMD_READCACHESEQ	0x31
+#define NAND_CMD_READCACHEEND	0x3f
 
 /* Extended commands for AG-AND device */
 /*
@@ -167,6 +169,9 @@ typedef enum {
 #define NAND_NO_READRDY		0x00000100
 /* Chip does not allow subpage writes */
 #define NAND_NO_SUBPAGE_WRITE	0x00000200
+/* Chip has sequential cache read function. This can not be told
+ * from the id, so the board driver sets it after nand_scan_ident() */
+#define NAND_CACHERD		0x00000400
 
 
 /* Options valid for Samsung large page devices */
@@ -177,6 +182,7 @@ typedef enum {
 #define NAND_CANAUTOINCR(chip) (!(chip->options & NAND_NO_AUTOINCR))
 #define NAND_MUST_PAD(chip) (!(chip->options & NAND_NO_PADDING))
 #define NAND_HAS_CACHEPROG(chip) ((chip->options & NAND_CACHEPRG))
+#define NAND_HAS_CACHEREAD(chip) ((chip->options & NAND_CACHERD))
 #define NAND_HAS_COPYBACK(chip) ((chip->options & NAND_COPYBACK))
 /* Large page NAND with SOFT_ECC should support subpage reads */
 #define NAND_SUBPAGE_READ(chip) ((chip->ecc.mode == NAND_ECC_SOFT) \
@@ -327,6 +333,10 @@ struct nand_buffers {
  * @dev_ready:		[BOARDSPECIFIC] hardwarespecific function for accesing device ready/busy line
  *			If set to NULL no access to ready/busy is available and the ready/busy information
  *			is read from the chip status register
+ * @dev_wait:		[OPTIONAL] sleep until the ready/busy line signals ready or
+ *			the timeout (in jiffies) expires, for controllers which can
+ *			interrupt on it. Used while waiting for program and erase,
+ *			returns non zero if the device is ready
  * @cmdfunc:		[REPLACEABLE] hardwarespecific function for writing commands to the chip
  * @waitfunc:		[REPLACEABLE] hardwarespecific function for wait on ready
  * @ecc:		[BOARDSPECIFIC] ecc control ctructure
@@ -350,6 +360,8 @@ struct nand_buffers {
  * @chipsize:		[INTERN] the size of one chip for multichip arrays
  * @pagemask:		[INTERN] page number mask = number of (pages / chip) - 1
  * @pagebuf:		[INTERN] holds the pagenumber which is currently in data_buf
+ * @cacheprg:		[INTERN] a cache program is running, its status is not known yet
+ * @cacheprg_fail:	[INTERN] the last write failed on the previous, cached page
  * @subpagesize:	[INTERN] holds the subpagesize
  * @ecclayout:		[REPLACEABLE] the default ecc placement scheme
  * @bbt:		[INTERN] bad block table pointer
@@ -379,6 +391,7 @@ struct nand_chip {
 	void		(*cmd_ctrl)(struct mtd_info *mtd, int dat,
 				    unsigned int ctrl);
 	int		(*dev_ready)(struct mtd_info *mtd);
+	int		(*dev_wait)(struct mtd_info *mtd, unsigned long timeout);
 	void		(*cmdfunc)(struct mtd_info *mtd, unsigned command, int column, int page_addr);
 	int		(*waitfunc)(struct mtd_info *mtd, struct nand_chip *this);
 	void		(*erase_cmd)(struct mtd_info *mtd, int page);
@@ -398,6 +411,8 @@ struct nand_chip {
 	uint64_t	chipsize;
 	int		pagemask;
 	int		pagebuf;
+	int		cacheprg;
+	int		cacheprg_fail;
 	int		subpagesize;
 	uint8_t		cellinfo;
 	int		badblockpos;
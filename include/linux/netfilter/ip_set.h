@@ -0,0 +1,137 @@
+#ifndef _IP_SET_H
+#define _IP_SET_H
+
+/*
+ * IP sets: named sets of addresses, networks or ports, kept in hash
+ * tables or bitmaps, managed over nfnetlink (NFNL_SUBSYS_IPSET) and
+ * matched by the xtables "set" match and "SET" target.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/types.h>
+
+#define IPSET_MAXNAMELEN	32
+
+/* Messages of the NFNL_SUBSYS_IPSET subsystem */
+enum ipset_msg_types {
+	IPSET_MSG_CREATE,	/* NAME, TYPE [, HASHSIZE, MAXELEM,
+				 * PORT_FROM, PORT_TO] */
+	IPSET_MSG_DESTROY,	/* [NAME], all unused sets without it */
+	IPSET_MSG_FLUSH,	/* [NAME], all sets without it */
+	IPSET_MSG_ADD,		/* NAME, IP [, CIDR] or PORT [, PORT_TO] */
+	IPSET_MSG_DEL,		/* same */
+	IPSET_MSG_TEST,		/* NAME, IP or PORT, -ENOENT if not in set */
+	IPSET_MSG_LIST,		/* [NAME], with NLM_F_DUMP */
+	IPSET_MSG_MAX
+};
+
+enum ipset_attr {
+	IPSET_ATTR_UNSPEC,
+	IPSET_ATTR_NAME,	/* NLA_NUL_STRING */
+	IPSET_ATTR_TYPE,	/* NLA_NUL_STRING: "hash:ip", "hash:net",
+				 * "bitmap:port" */
+	IPSET_ATTR_HASHSIZE,	/* NLA_U32: initial buckets of a hash */
+	IPSET_ATTR_MAXELEM,	/* NLA_U32: maximum number of elements */
+	IPSET_ATTR_PORT_FROM,	/* NLA_U16, big endian: bitmap:port range */
+	IPSET_ATTR_PORT_TO,	/* NLA_U16, big endian */
+	IPSET_ATTR_IP,		/* NLA_U32, big endian */
+	IPSET_ATTR_CIDR,	/* NLA_U8: prefix length, hash:net */
+	IPSET_ATTR_PORT,	/* NLA_U16, big endian */
+	IPSET_ATTR_ELEMENTS,	/* NLA_U32: list only */
+	IPSET_ATTR_REFERENCES,	/* NLA_U32: list only, rules using the set */
+	IPSET_ATTR_MEMSIZE,	/* NLA_U32: list only, bytes of memory */
+	IPSET_ATTR_ADT,		/* NLA_NESTED: list only, of IPSET_ATTR_DATA */
+	IPSET_ATTR_DATA,	/* NLA_NESTED: one element, IP/CIDR or PORT */
+	__IPSET_ATTR_MAX
+};
+#define IPSET_ATTR_MAX (__IPSET_ATTR_MAX - 1)
+
+/* Which address or port of the packet a set is looked up with */
+#define IPSET_SRC		0x01
+#define IPSET_DST		0x02
+
+#ifdef __KERNEL__
+
+#include <linux/list.h>
+#include <linux/spinlock.h>
+#include <linux/skbuff.h>
+#include <net/netlink.h>
+
+enum ip_set_adt {
+	IPSET_ADD,
+	IPSET_DEL,
+	IPSET_TEST,
+};
+
+struct ip_set;
+
+struct ip_set_type {
+	struct list_head	list;
+	const char		*name;
+	struct module		*me;
+
+	/* Set up set->data from the attributes of IPSET_MSG_CREATE */
+	int (*create)(struct ip_set *set, const struct nlattr * const tb[]);
+	void (*destroy)(struct ip_set *set);
+	void (*flush)(struct ip_set *set);
+
+	/* Add, delete or test an element given over netlink, in process
+	 * context. Add returns -EEXIST and del -ENOENT if there is nothing
+	 * to do, test returns 1 if the element is in the set. */
+	int (*uadt)(struct ip_set *set, const struct nlattr * const tb[],
+		    enum ip_set_adt adt);
+	/* The same for the address or port of a packet, in softirq */
+	int (*kadt)(struct ip_set *set, const struct sk_buff *skb,
+		    enum ip_set_adt adt, u_int8_t flags);
+
+	/* Put the type specific attributes of the set header */
+	int (*head)(struct ip_set *set, struct sk_buff *skb);
+	/* Put IPSET_ATTR_DATA for the elements from *pos on, and advance
+	 * *pos. Returns -EMSGSIZE if the skb filled up before the end. */
+	int (*dump)(struct ip_set *set, struct sk_buff *skb,
+		    unsigned long *pos);
+};
+
+struct ip_set {
+	struct list_head	list;
+	char			name[IPSET_MAXNAMELEN];
+	const struct ip_set_type *type;
+	/* Taken by the types: for reading by packets, for writing by
+	 * changes to the set */
+	rwlock_t		lock;
+	/* Rules using the set */
+	atomic_t		ref;
+	u_int32_t		maxelem;
+	u_int32_t		elements;
+	size_t			memsize;
+	void			*data;
+};
+
+extern int ip_set_type_register(struct ip_set_type *type);
+extern void ip_set_type_unregister(struct ip_set_type *type);
+
+extern struct ip_set *ip_set_create(const char *name, const char *typename,
+				    const struct nlattr * const tb[]);
+extern int ip_set_destroy(struct ip_set *set);
+
+/* Look a set up by name for a rule, and let it go again */
+extern struct ip_set *ip_set_get_byname(const char *name);
+extern void ip_set_put(struct ip_set *set);
+
+extern int ip_set_uadt(struct ip_set *set, const struct nlattr * const tb[],
+		       enum ip_set_adt adt);
+extern int ip_set_add(struct ip_set *set, const struct sk_buff *skb,
+		      u_int8_t flags);
+extern int ip_set_del(struct ip_set *set, const struct sk_buff *skb,
+		      u_int8_t flags);
+extern int ip_set_test(struct ip_set *set, const struct sk_buff *skb,
+		       u_int8_t flags);
+
+extern void *ip_set_alloc(size_t size);
+extern void ip_set_free(void *p);
+
+#endif /* __KERNEL__ */
+#endif /* _IP_SET_H */
@@ -0,0 +1,31 @@
+#ifndef _XT_SET_H
+#define _XT_SET_H
+
+#include <linux/types.h>
+#include <linux/netfilter/ip_set.h>
+
+struct ip_set;
+
+#define XT_SET_INVERT		0x01
+
+struct xt_set_info {
+	char		name[IPSET_MAXNAMELEN];	/* empty: no set */
+	__u8		dim;		/* IPSET_SRC or IPSET_DST */
+	__u8		flags;		/* XT_SET_INVERT, match only */
+
+	/* Used internally by the kernel */
+	struct ip_set	*set __attribute__((aligned(8)));
+};
+
+/* "set" match */
+struct xt_set_info_match {
+	struct xt_set_info	match_set;
+};
+
+/* "SET" target: add to one set and/or delete from another */
+struct xt_set_info_target {
+	struct xt_set_info	add_set;
+	struct xt_set_info	del_set;
+};
+
+#endif /* _XT_SET_H */
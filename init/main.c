@@ -819,6 +819,10 @@ static noinline int init_post(void)
 
 	current->signal->flags |= SIGNAL_UNKILLABLE;
 
+	if (initcall_debug)
+		printk("starting userspace after %Ld usecs\n",
+		       (long long)ktime_to_us(ktime_get()));
+
 	if (ramdisk_execute_command) {
 		run_init_process(ramdisk_execute_command);
 		printk(KERN_WARNING "Failed to execute %s\n",
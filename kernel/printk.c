@@ -33,6 +33,9 @@
 #include <linux/bootmem.h>
 #include <linux/syscalls.h>
 #include <linux/kexec.h>
+#include <linux/kthread.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include <asm/uaccess.h>
 
@@ -137,6 +140,36 @@ EXPORT_SYMBOL(console_set_on_cmdline);
 /* Flag: console code may call schedule() */
 static int console_may_schedule;
 
+/*
+ * Work printk() leaves for the next timer tick on this cpu, for when
+ * it cannot safely wake anybody up itself.
+ */
+#define PRINTK_PENDING_KLOGD	0x01
+#define PRINTK_PENDING_CONSOLE	0x02
+
+static DEFINE_PER_CPU(int, printk_pending);
+
+#ifndef CONFIG_PRINTK_ASYNC_CONSOLE
+static inline int console_async_defer(void)
+{
+	return 0;
+}
+
+static inline int console_async_thread(void)
+{
+	return 0;
+}
+
+static inline unsigned console_async_chunk_end(unsigned start, unsigned end)
+{
+	return end;
+}
+
+static inline void console_async_kick(unsigned long flags)
+{
+}
+#endif
+
 #ifdef CONFIG_PRINTK
 
 static char __log_buf[__LOG_BUF_LEN];
@@ -144,6 +177,121 @@ static char *log_buf = __log_buf;
 static int log_buf_len = __LOG_BUF_LEN;
 static unsigned logged_chars; /* Number of chars produced since last read+clear operation */
 
+#ifdef CONFIG_PRINTK_ASYNC_CONSOLE
+/*
+ * Asynchronous console output.
+ *
+ * Writing to a serial console polls the UART for every character, so
+ * a burst of messages can keep the printk() caller busy - with
+ * interrupts off - for a long time. When printk_async_console is set,
+ * printk() only appends to log_buf and kconsoled pushes the text out
+ * to the console drivers from process context.
+ *
+ * Output goes out synchronously again when the kernel is crashing
+ * (oops_in_progress), shutting down or rebooting, and from anywhere
+ * before the thread has been started.
+ */
+int printk_async_console = 1;
+
+static struct task_struct *console_task;
+
+/* how much kconsoled writes with interrupts disabled, in bytes */
+#define CONSOLE_ASYNC_CHUNK	128
+
+static int __init console_async_setup(char *str)
+{
+	printk_async_console = simple_strtoul(str, NULL, 0) != 0;
+	return 1;
+}
+__setup("console_async=", console_async_setup);
+
+/*
+ * Should printk() leave the console output to kconsoled?
+ * Called with logbuf_lock held.
+ */
+static inline int console_async_defer(void)
+{
+	if (!printk_async_console || !console_task || oops_in_progress)
+		return 0;
+	if (system_state != SYSTEM_BOOTING && system_state != SYSTEM_RUNNING)
+		return 0;
+	return current != console_task;
+}
+
+static inline int console_async_thread(void)
+{
+	return console_task && current == console_task;
+}
+
+/*
+ * Limit a flush by kconsoled to about CONSOLE_ASYNC_CHUNK bytes, ending
+ * on a line boundary so the loglevel tags are parsed properly.
+ * Called with logbuf_lock held.
+ */
+static unsigned console_async_chunk_end(unsigned start, unsigned end)
+{
+	unsigned limit;
+
+	if (end - start <= CONSOLE_ASYNC_CHUNK)
+		return end;
+
+	limit = start + CONSOLE_ASYNC_CHUNK;
+	while (limit != end && LOG_BUF(limit - 1) != '\n')
+		limit++;
+	return limit;
+}
+
+static void console_async_wake(void)
+{
+	if (console_task)
+		wake_up_process(console_task);
+}
+
+/*
+ * Called by printk() after it has queued output for kconsoled.
+ * @flags are the interrupt flags of the printk() caller: with
+ * interrupts disabled it may be holding the runqueue lock, so the
+ * wakeup is left to the next timer tick.
+ */
+static void console_async_kick(unsigned long flags)
+{
+	if (raw_irqs_disabled_flags(flags))
+		__raw_get_cpu_var(printk_pending) |= PRINTK_PENDING_CONSOLE;
+	else
+		console_async_wake();
+}
+
+static int console_thread(void *unused)
+{
+	for (;;) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		/* resume_console() flushes whatever piles up meanwhile */
+		if (con_start == log_end || console_suspended)
+			schedule();
+		__set_current_state(TASK_RUNNING);
+
+		acquire_console_sem();
+		release_console_sem();
+	}
+	return 0;
+}
+
+static int __init console_async_init(void)
+{
+	struct task_struct *task;
+
+	task = kthread_run(console_thread, NULL, "kconsoled");
+	if (IS_ERR(task)) {
+		printk(KERN_ERR "printk: unable to start kconsoled, "
+		       "console output stays synchronous\n");
+		return PTR_ERR(task);
+	}
+	console_task = task;
+	return 0;
+}
+early_initcall(console_async_init);
+#endif /* CONFIG_PRINTK_ASYNC_CONSOLE */
+
 #ifdef CONFIG_KEXEC
 /*
  * This appends the listed symbols to /proc/vmcoreinfo
@@ -667,11 +815,123 @@ static inline void printk_delay(void)
 	}
 }
 
+#ifdef CONFIG_PRINTK_CONSOLE_LATENCY
+/*
+ * Time printk() callers spend writing to the consoles themselves,
+ * exported in debugfs as printk_console_latency. Protected by logbuf_lock.
+ */
+static struct {
+	unsigned long	calls;		/* printk()s that fed the consoles */
+	unsigned long	deferred;	/* printk()s left to kconsoled */
+	u64		total_ns;
+	u64		max_ns;
+} console_latency;
+
+static inline u64 console_latency_start(int cpu)
+{
+	return cpu_clock(cpu);
+}
+
+/* Called with interrupts disabled */
+static void console_latency_end(int cpu, u64 start)
+{
+	u64 delta = cpu_clock(cpu) - start;
+
+	spin_lock(&logbuf_lock);
+	console_latency.calls++;
+	console_latency.total_ns += delta;
+	if (delta > console_latency.max_ns)
+		console_latency.max_ns = delta;
+	spin_unlock(&logbuf_lock);
+}
+
+/* Called with logbuf_lock held */
+static inline void console_latency_deferred(void)
+{
+	console_latency.deferred++;
+}
+
+static int console_latency_show(struct seq_file *m, void *v)
+{
+	unsigned long flags;
+	u64 total, max, avg;
+	unsigned long calls, deferred;
+
+	spin_lock_irqsave(&logbuf_lock, flags);
+	calls = console_latency.calls;
+	deferred = console_latency.deferred;
+	total = console_latency.total_ns;
+	max = console_latency.max_ns;
+	spin_unlock_irqrestore(&logbuf_lock, flags);
+
+	avg = total;
+	if (calls)
+		do_div(avg, calls);
+	do_div(total, 1000);
+	do_div(avg, 1000);
+	do_div(max, 1000);
+
+	seq_printf(m, "calls:    %lu\n", calls);
+	seq_printf(m, "deferred: %lu\n", deferred);
+	seq_printf(m, "total_us: %llu\n", (unsigned long long)total);
+	seq_printf(m, "avg_us:   %llu\n", (unsigned long long)avg);
+	seq_printf(m, "max_us:   %llu\n", (unsigned long long)max);
+	return 0;
+}
+
+static int console_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, console_latency_show, NULL);
+}
+
+/* any write clears the counters */
+static ssize_t console_latency_write(struct file *file,
+		const char __user *buf, size_t count, loff_t *ppos)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&logbuf_lock, flags);
+	memset(&console_latency, 0, sizeof(console_latency));
+	spin_unlock_irqrestore(&logbuf_lock, flags);
+	return count;
+}
+
+static const struct file_operations console_latency_fops = {
+	.open		= console_latency_open,
+	.read		= seq_read,
+	.write		= console_latency_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init console_latency_init(void)
+{
+	debugfs_create_file("printk_console_latency", 0644, NULL, NULL,
+			    &console_latency_fops);
+	return 0;
+}
+late_initcall(console_latency_init);
+#else
+static inline u64 console_latency_start(int cpu)
+{
+	return 0;
+}
+
+static inline void console_latency_end(int cpu, u64 start)
+{
+}
+
+static inline void console_latency_deferred(void)
+{
+}
+#endif /* CONFIG_PRINTK_CONSOLE_LATENCY */
+
 asmlinkage int vprintk(const char *fmt, va_list args)
 {
 	int printed_len = 0;
 	int current_log_level = default_message_loglevel;
 	unsigned long flags;
+	u64 console_start_time;
 	int this_cpu;
 	char *p;
 
@@ -778,6 +1038,18 @@ asmlinkage int vprintk(const char *fmt, va_list args)
 			new_text_line = 1;
 	}
 
+	/*
+	 * In asynchronous mode kconsoled writes the text out;
+	 * all we have to do is to make sure it will run.
+	 */
+	if (console_async_defer()) {
+		printk_cpu = UINT_MAX;
+		console_latency_deferred();
+		spin_unlock(&logbuf_lock);
+		console_async_kick(flags);
+		goto out;
+	}
+
 	/*
 	 * Try to acquire and then immediately release the
 	 * console semaphore. The release will do all the
@@ -788,8 +1060,11 @@ asmlinkage int vprintk(const char *fmt, va_list args)
 	 * will release 'logbuf_lock' regardless of whether it
 	 * actually gets the semaphore or not.
 	 */
+	console_start_time = console_latency_start(this_cpu);
 	if (acquire_console_semaphore_for_printk(this_cpu))
 		release_console_sem();
+	console_latency_end(this_cpu, console_start_time);
+out:
 
 	lockdep_on();
 out_restore_irqs:
@@ -1002,13 +1277,18 @@ int is_console_locked(void)
 	return console_locked;
 }
 
-static DEFINE_PER_CPU(int, printk_pending);
-
 void printk_tick(void)
 {
-	if (__get_cpu_var(printk_pending)) {
+	int pending = __get_cpu_var(printk_pending);
+
+	if (pending) {
 		__get_cpu_var(printk_pending) = 0;
-		wake_up_interruptible(&log_wait);
+		if (pending & PRINTK_PENDING_KLOGD)
+			wake_up_interruptible(&log_wait);
+#ifdef CONFIG_PRINTK_ASYNC_CONSOLE
+		if (pending & PRINTK_PENDING_CONSOLE)
+			console_async_wake();
+#endif
 	}
 }
 
@@ -1020,7 +1300,7 @@ int printk_needs_cpu(int cpu)
 void wake_up_klogd(void)
 {
 	if (waitqueue_active(&log_wait))
-		__raw_get_cpu_var(printk_pending) = 1;
+		__raw_get_cpu_var(printk_pending) |= PRINTK_PENDING_KLOGD;
 }
 
 /**
@@ -1042,6 +1322,7 @@ void release_console_sem(void)
 	unsigned long flags;
 	unsigned _con_start, _log_end;
 	unsigned wake_klogd = 0;
+	int async = console_async_thread();
 
 	if (console_suspended) {
 		up(&console_sem);
@@ -1057,12 +1338,20 @@ void release_console_sem(void)
 			break;			/* Nothing to print */
 		_con_start = con_start;
 		_log_end = log_end;
-		con_start = log_end;		/* Flush */
+		/*
+		 * kconsoled works in small pieces so that interrupts
+		 * are not held off while a long backlog drains.
+		 */
+		if (async)
+			_log_end = console_async_chunk_end(_con_start, _log_end);
+		con_start = _log_end;		/* Flush */
 		spin_unlock(&logbuf_lock);
 		stop_critical_timings();	/* don't trace print latency */
 		call_console_drivers(_con_start, _log_end);
 		start_critical_timings();
 		local_irq_restore(flags);
+		if (async)
+			cond_resched();
 	}
 	console_locked = 0;
 	up(&console_sem);
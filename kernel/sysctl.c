@@ -744,6 +744,19 @@ static struct ctl_table kern_table[] = {
 		.extra1		= &zero,
 		.extra2		= &ten_thousand,
 	},
+#ifdef CONFIG_PRINTK_ASYNC_CONSOLE
+	{
+		.ctl_name	= CTL_UNNUMBERED,
+		.procname	= "printk_async_console",
+		.data		= &printk_async_console,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= &proc_dointvec_minmax,
+		.strategy	= &sysctl_intvec,
+		.extra1		= &zero,
+		.extra2		= &one,
+	},
+#endif
 #endif
 	{
 		.ctl_name	= KERN_NGROUPS_MAX,
@@ -0,0 +1,290 @@
+/*
+ * lzop stream decompressor for the kernel image, initramfs and initrd
+ *
+ * Decodes the container written by lzop(1): a file header followed by
+ * blocks of at most 256KiB of data, each compressed on its own with
+ * LZO1X. The blocks themselves are handed to lib/lzo. The checksums
+ * lzop stores are skipped rather than verified; the LZO decoder does
+ * its own bounds checking and the image formats carry their own
+ * consistency checks.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifdef STATIC
+#include "lzo/lzo1x_decompress.c"
+#else
+#include <linux/decompress/unlzo.h>
+#include <linux/slab.h>
+#endif
+
+#include <linux/types.h>
+#include <linux/lzo.h>
+#include <linux/decompress/mm.h>
+
+#include <linux/compiler.h>
+#include <asm/unaligned.h>
+
+static const unsigned char lzop_magic[] = {
+	0x89, 0x4c, 0x5a, 0x4f, 0x00, 0x0d, 0x0a, 0x1a, 0x0a };
+
+#define LZO_BLOCK_SIZE		(256 * 1024l)
+
+/* room for a whole compressed block plus its headers */
+#define LZO_IN_BUF_SIZE		(lzo1x_worst_compress(LZO_BLOCK_SIZE) + 512)
+
+/* lzop header flags */
+#define F_ADLER32_D		0x00000001L
+#define F_ADLER32_C		0x00000002L
+#define F_H_EXTRA_FIELD		0x00000040L
+#define F_CRC32_D		0x00000100L
+#define F_CRC32_C		0x00000200L
+#define F_H_FILTER		0x00000800L
+
+/* lzop methods, all of them produce LZO1X streams */
+#define M_LZO1X_1		1
+#define M_LZO1X_1_15		2
+#define M_LZO1X_999		3
+
+struct unlzo_input {
+	u8 *buf;		/* start of the buffer */
+	u8 *ptr;		/* next byte to be consumed */
+	long avail;		/* valid bytes at ptr */
+	long size;		/* size of buf when refilled by fill() */
+	int pos;		/* bytes consumed so far */
+	int (*fill)(void *, unsigned int);
+};
+
+/*
+ * Return a pointer to the next @len bytes of input and consume them,
+ * or NULL if the input ends first.
+ */
+static u8 * INIT unlzo_take(struct unlzo_input *in, long len)
+{
+	u8 *p;
+	long i;
+	int got;
+
+	while (in->avail < len) {
+		if (!in->fill || len > in->size)
+			return NULL;
+
+		/* slide what is left to the front and top the buffer up */
+		for (i = 0; i < in->avail; i++)
+			in->buf[i] = in->ptr[i];
+		in->ptr = in->buf;
+
+		got = in->fill(in->buf + in->avail, in->size - in->avail);
+		if (got <= 0)
+			return NULL;
+		in->avail += got;
+	}
+
+	p = in->ptr;
+	in->ptr += len;
+	in->avail -= len;
+	in->pos += len;
+	return p;
+}
+
+static int INIT parse_header(struct unlzo_input *in, u32 *flags)
+{
+	u8 *p;
+	u16 version;
+	int l;
+
+	p = unlzo_take(in, sizeof(lzop_magic));
+	if (!p)
+		return 0;
+	for (l = 0; l < sizeof(lzop_magic); l++)
+		if (p[l] != lzop_magic[l])
+			return 0;
+
+	/* lzop version, then the library version */
+	p = unlzo_take(in, 4);
+	if (!p)
+		return 0;
+	version = get_unaligned_be16(p);
+
+	/* version needed to extract, only written by lzop >= 0.94 */
+	if (version >= 0x0940 && !unlzo_take(in, 2))
+		return 0;
+
+	p = unlzo_take(in, 1);
+	if (!p || (*p != M_LZO1X_1 && *p != M_LZO1X_1_15 &&
+		   *p != M_LZO1X_999))
+		return 0;
+
+	/* compression level */
+	if (version >= 0x0940 && !unlzo_take(in, 1))
+		return 0;
+
+	p = unlzo_take(in, 4);
+	if (!p)
+		return 0;
+	*flags = get_unaligned_be32(p);
+
+	if ((*flags & F_H_FILTER) && !unlzo_take(in, 4))
+		return 0;
+
+	/* mode and mtime */
+	if (!unlzo_take(in, version >= 0x0940 ? 12 : 8))
+		return 0;
+
+	/* file name, then the header checksum */
+	p = unlzo_take(in, 1);
+	if (!p || !unlzo_take(in, *p + 4))
+		return 0;
+
+	if (*flags & F_H_EXTRA_FIELD) {
+		p = unlzo_take(in, 4);
+		if (!p || !unlzo_take(in, get_unaligned_be32(p) + 4))
+			return 0;
+	}
+
+	return 1;
+}
+
+STATIC int INIT unlzo(u8 *input, int in_len,
+		      int (*fill) (void *, unsigned int),
+		      int (*flush) (void *, unsigned int),
+		      u8 *output, int *posp,
+		      void (*error_fn) (char *x))
+{
+	struct unlzo_input in;
+	u32 flags, src_len, dst_len;
+	size_t tmp;
+	u8 *in_buf = NULL, *out_buf, *src, *dst;
+	int r, ret = -1;
+
+	set_error_fn(error_fn);
+
+	if (output) {
+		out_buf = output;
+	} else if (!flush) {
+		error("NULL output pointer and no flush function provided");
+		goto exit;
+	} else {
+		out_buf = large_malloc(LZO_BLOCK_SIZE);
+		if (!out_buf) {
+			error("Could not allocate output buffer");
+			goto exit;
+		}
+	}
+
+	in.fill = NULL;
+	in.pos = 0;
+	if (input) {
+		in.buf = input;
+		in.avail = in_len;
+		in.size = in_len;
+	} else if (!fill) {
+		error("NULL input pointer and missing fill function");
+		goto exit_1;
+	} else {
+		in_buf = large_malloc(LZO_IN_BUF_SIZE);
+		if (!in_buf) {
+			error("Could not allocate input buffer");
+			goto exit_1;
+		}
+		in.buf = in_buf;
+		in.avail = 0;
+		in.size = LZO_IN_BUF_SIZE;
+		in.fill = fill;
+	}
+	in.ptr = in.buf;
+
+	if (!parse_header(&in, &flags)) {
+		error("invalid header");
+		goto exit_2;
+	}
+
+	dst = out_buf;
+	for (;;) {
+		/* uncompressed block size, zero marks the end */
+		src = unlzo_take(&in, 4);
+		if (!src)
+			goto truncated;
+		dst_len = get_unaligned_be32(src);
+		if (dst_len == 0)
+			break;
+
+		if (dst_len > LZO_BLOCK_SIZE) {
+			error("dest len longer than block size");
+			goto exit_2;
+		}
+
+		src = unlzo_take(&in, 4);
+		if (!src)
+			goto truncated;
+		src_len = get_unaligned_be32(src);
+		if (src_len == 0 || src_len > dst_len) {
+			error("file corrupted");
+			goto exit_2;
+		}
+
+		/* skip the checksums of the uncompressed and compressed data */
+		tmp = 0;
+		if (flags & F_ADLER32_D)
+			tmp += 4;
+		if (flags & F_CRC32_D)
+			tmp += 4;
+		if (src_len < dst_len) {
+			if (flags & F_ADLER32_C)
+				tmp += 4;
+			if (flags & F_CRC32_C)
+				tmp += 4;
+		}
+		if (tmp && !unlzo_take(&in, tmp))
+			goto truncated;
+
+		src = unlzo_take(&in, src_len);
+		if (!src)
+			goto truncated;
+
+		/* lzop stores blocks that do not compress as they are */
+		if (src_len == dst_len) {
+			if (output)
+				memcpy(dst, src, src_len);
+			else
+				dst = src;
+		} else {
+			tmp = dst_len;
+			r = lzo1x_decompress_safe(src, src_len, dst, &tmp);
+			if (r != LZO_E_OK || tmp != dst_len) {
+				error("Compressed data violation");
+				goto exit_2;
+			}
+		}
+
+		if (flush && flush(dst, dst_len) != dst_len) {
+			error("write error");
+			goto exit_2;
+		}
+
+		if (output)
+			dst += dst_len;
+		else
+			dst = out_buf;
+	}
+
+	if (posp)
+		*posp = in.pos;
+	ret = 0;
+	goto exit_2;
+
+truncated:
+	error("unexpected end of input");
+exit_2:
+	if (in_buf)
+		large_free(in_buf);
+exit_1:
+	if (!output)
+		large_free(out_buf);
+exit:
+	return ret;
+}
+
+#define decompress unlzo
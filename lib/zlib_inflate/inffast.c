@@ -29,6 +29,119 @@
 #  define PUP(a) *++(a)
 #endif
 
+#ifdef CONFIG_ZLIB_INFLATE_WORD_COPY
+#include <asm/byteorder.h>
+
+/*
+   Word at a time copies for long matches. Byte copies are used up to the
+   first aligned output word, then whole words are stored. When the source
+   is not aligned the same way as the output, each word is assembled from
+   the two aligned source words it straddles, so no unaligned accesses are
+   made. The aligned words read may include bytes outside of the match;
+   they are in the same word, hence the same page, and are thrown away.
+
+   A copy from the output overlaps its destination. Since every source
+   word is read before the output word that follows it is written, this is
+   safe as long as the distance is at least two words.
+ */
+#define WORD_BYTES      sizeof(unsigned long)
+#define WORD_MASK       (WORD_BYTES - 1)
+#define WORD_MIN        (2 * WORD_BYTES)    /* minimum length and distance */
+
+#ifdef __BIG_ENDIAN
+#  define WORD_MERGE(lo, hi, sh) \
+        (((lo) << (sh)) | ((hi) >> (8 * WORD_BYTES - (sh))))
+#else
+#  define WORD_MERGE(lo, hi, sh) \
+        (((lo) >> (sh)) | ((hi) << (8 * WORD_BYTES - (sh))))
+#endif
+
+#if defined(CONFIG_ZLIB_INFLATE_SELF_TEST) || \
+    defined(CONFIG_ZLIB_INFLATE_SELF_TEST_MODULE)
+/* lets the self test time the byte copies against the word copies */
+int zlib_inflate_word_copy = 1;
+#  define word_copy_ok(len) (zlib_inflate_word_copy && (len) >= WORD_MIN)
+#else
+#  define word_copy_ok(len) ((len) >= WORD_MIN)
+#endif
+
+/*
+   Copy len bytes following from to the bytes following out, and return
+   the new out. len must be at least WORD_MIN.
+ */
+static inline unsigned char *copy_words(unsigned char *out,
+                                        const unsigned char *from,
+                                        unsigned len)
+{
+    const unsigned long *src;
+    unsigned long *dst;
+    unsigned long lo, hi;
+    unsigned words, shift;
+
+    out += OFF;
+    from += OFF;
+    while ((unsigned long)out & WORD_MASK) {
+        *out++ = *from++;
+        len--;
+    }
+    dst = (unsigned long *)out;
+    words = len / WORD_BYTES;
+    shift = ((unsigned long)from & WORD_MASK) * 8;
+    src = (const unsigned long *)((unsigned long)from & ~WORD_MASK);
+    if (shift == 0) {
+        do {
+            *dst++ = *src++;
+        } while (--words);
+    }
+    else {
+        lo = *src++;
+        do {
+            hi = *src++;
+            *dst++ = WORD_MERGE(lo, hi, shift);
+            lo = hi;
+        } while (--words);
+    }
+    out = (unsigned char *)dst;
+    from += len & ~WORD_MASK;
+    len &= WORD_MASK;
+    while (len--)
+        *out++ = *from++;
+    return out - OFF;
+}
+
+/* Store len copies of the byte at out, used for matches at distance one */
+static inline unsigned char *fill_words(unsigned char *out, unsigned len)
+{
+    unsigned char c;
+    unsigned long *dst;
+    unsigned long pat;
+    unsigned words;
+
+    out += OFF;
+    c = out[-1];
+    while ((unsigned long)out & WORD_MASK) {
+        *out++ = c;
+        len--;
+    }
+    pat = c * (~0UL / 0xff);
+    dst = (unsigned long *)out;
+    words = len / WORD_BYTES;
+    do {
+        *dst++ = pat;
+    } while (--words);
+    out = (unsigned char *)dst;
+    len &= WORD_MASK;
+    while (len--)
+        *out++ = c;
+    return out - OFF;
+}
+#else
+#  define WORD_MIN        0
+#  define word_copy_ok(len) 0
+#  define copy_words(out, from, len) (out)
+#  define fill_words(out, len) (out)
+#endif /* CONFIG_ZLIB_INFLATE_WORD_COPY */
+
 /*
    Decode literal, length, and distance codes and write out the resulting
    literal and match bytes until either not enough input or output is
@@ -191,9 +304,12 @@ void inflate_fast(z_streamp strm, unsigned start)
                         from += wsize - op;
                         if (op < len) {         /* some from window */
                             len -= op;
-                            do {
-                                PUP(out) = PUP(from);
-                            } while (--op);
+                            if (word_copy_ok(op))
+                                out = copy_words(out, from, op);
+                            else
+                                do {
+                                    PUP(out) = PUP(from);
+                                } while (--op);
                             from = out - dist;  /* rest from output */
                         }
                     }
@@ -202,16 +318,22 @@ void inflate_fast(z_streamp strm, unsigned start)
                         op -= write;
                         if (op < len) {         /* some from end of window */
                             len -= op;
-                            do {
-                                PUP(out) = PUP(from);
-                            } while (--op);
+                            if (word_copy_ok(op))
+                                out = copy_words(out, from, op);
+                            else
+                                do {
+                                    PUP(out) = PUP(from);
+                                } while (--op);
                             from = window - OFF;
                             if (write < len) {  /* some from start of window */
                                 op = write;
                                 len -= op;
-                                do {
-                                    PUP(out) = PUP(from);
-                                } while (--op);
+                                if (word_copy_ok(op))
+                                    out = copy_words(out, from, op);
+                                else
+                                    do {
+                                        PUP(out) = PUP(from);
+                                    } while (--op);
                                 from = out - dist;      /* rest from output */
                             }
                         }
@@ -220,12 +342,20 @@ void inflate_fast(z_streamp strm, unsigned start)
                         from += write - op;
                         if (op < len) {         /* some from window */
                             len -= op;
-                            do {
-                                PUP(out) = PUP(from);
-                            } while (--op);
+                            if (word_copy_ok(op))
+                                out = copy_words(out, from, op);
+                            else
+                                do {
+                                    PUP(out) = PUP(from);
+                                } while (--op);
                             from = out - dist;  /* rest from output */
                         }
                     }
+                    if (word_copy_ok(len) && (dist >= WORD_MIN ||
+                                              from != out - dist)) {
+                        out = copy_words(out, from, len);
+                        len = 0;
+                    }
                     while (len > 2) {
                         PUP(out) = PUP(from);
                         PUP(out) = PUP(from);
@@ -238,6 +368,12 @@ void inflate_fast(z_streamp strm, unsigned start)
                             PUP(out) = PUP(from);
                     }
                 }
+                else if (word_copy_ok(len) && dist >= WORD_MIN) {
+                    out = copy_words(out, out - dist, len);
+                }
+                else if (word_copy_ok(len) && dist == 1) {
+                    out = fill_words(out, len);
+                }
                 else {
                     from = out - dist;          /* copy direct from output */
                     do {                        /* minimum length is three */
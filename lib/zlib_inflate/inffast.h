@@ -9,3 +9,8 @@
  */
 
 void inflate_fast (z_streamp strm, unsigned start);
+
+#if defined(CONFIG_ZLIB_INFLATE_SELF_TEST) || \
+    defined(CONFIG_ZLIB_INFLATE_SELF_TEST_MODULE)
+extern int zlib_inflate_word_copy;
+#endif
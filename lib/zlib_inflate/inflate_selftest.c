@@ -0,0 +1,308 @@
+/*
+ * linux/lib/zlib_inflate/inflate_selftest.c
+ *
+ * Self test for the word copies of inflate_fast()
+ *
+ * A few generated buffers, each shaped after a kind of data the kernel
+ * inflates, are compressed with zlib_deflate and inflated again with
+ * word copies and with byte copies. Output is requested in pieces of
+ * several sizes so that matches get copied out of the sliding window
+ * as well as out of the output buffer, and at every output alignment.
+ * The decompression speed of both copy methods is printed at the end.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/hrtimer.h>
+#include <linux/math64.h>
+#include <linux/string.h>
+#include <linux/vmalloc.h>
+#include <linux/zlib.h>
+
+#include "inffast.h"
+
+#define CORPUS_SIZE	(256 * 1024)
+#define TIMED_RUNS	8
+
+static const int levels[] = { 1, 6, 9 };
+static const int window_bits[] = { 9, 12, MAX_WBITS };
+static const unsigned int chunks[] = { 0, 300, 1000, 4093 };
+
+static u32 seed;
+
+static u32 __init next_rand(void)
+{
+	seed = seed * 1103515245 + 12345;
+	return seed >> 8;
+}
+
+/* a match of @len bytes at distance @dist */
+static unsigned int __init put_match(u8 *buf, unsigned int pos,
+				     unsigned int dist, unsigned int len)
+{
+	if (dist > pos)
+		dist = pos;
+	if (!dist)
+		return pos;
+	while (len-- && pos < CORPUS_SIZE) {
+		buf[pos] = buf[pos - dist];
+		pos++;
+	}
+	return pos;
+}
+
+/* words and punctuation, like source code and configuration files */
+static void __init make_text(u8 *buf)
+{
+	static const char * const words[] = {
+		"static ", "int ", "struct ", "return ", "if (", ") {\n",
+		"\t", "\t\t", "}\n", "unsigned long ", "->", " = ", ";\n",
+		"inode", "page", "buffer", "NULL", "0", "err", "/* ", " */\n",
+	};
+	unsigned int pos = 0, len;
+	const char *w;
+
+	while (pos < CORPUS_SIZE) {
+		w = words[next_rand() % ARRAY_SIZE(words)];
+		len = min_t(unsigned int, strlen(w), CORPUS_SIZE - pos);
+		memcpy(buf + pos, w, len);
+		pos += len;
+	}
+}
+
+/* mostly zeroes with a few islands of noise, like filesystem images */
+static void __init make_sparse(u8 *buf)
+{
+	unsigned int pos = 0, len;
+
+	memset(buf, 0, CORPUS_SIZE);
+	while (pos < CORPUS_SIZE) {
+		pos += next_rand() % 8192;
+		len = next_rand() % 512;
+		while (len-- && pos < CORPUS_SIZE)
+			buf[pos++] = next_rand();
+	}
+}
+
+/*
+ * Short and long matches at every distance up to the window size,
+ * including the short distances that are copied byte by byte, with
+ * literals in between, like executables and libraries.
+ */
+static void __init make_matches(u8 *buf)
+{
+	unsigned int pos = 0, len, dist;
+
+	while (pos < CORPUS_SIZE) {
+		len = next_rand() % 16;
+		while (len-- && pos < CORPUS_SIZE)
+			buf[pos++] = next_rand() % 8;
+
+		len = 3 + next_rand() % 256;
+		switch (next_rand() % 4) {
+		case 0:
+			dist = 1 + next_rand() % 16;
+			break;
+		case 1:
+			dist = 1 + next_rand() % 512;
+			break;
+		default:
+			dist = 1 + next_rand() % 32768;
+			break;
+		}
+		pos = put_match(buf, pos, dist, len);
+	}
+}
+
+static const struct {
+	const char *name;
+	void (*make)(u8 *buf);
+} corpora[] = {
+	{ "text", make_text },
+	{ "sparse", make_sparse },
+	{ "matches", make_matches },
+};
+
+static int __init deflate_corpus(z_stream *strm, const u8 *src, u8 *dst,
+				 unsigned int dst_len, int level, int wbits)
+{
+	int ret;
+
+	ret = zlib_deflateInit2(strm, level, Z_DEFLATED, wbits,
+				DEF_MEM_LEVEL, Z_DEFAULT_STRATEGY);
+	if (ret != Z_OK)
+		return -EINVAL;
+
+	strm->next_in = src;
+	strm->avail_in = CORPUS_SIZE;
+	strm->next_out = dst;
+	strm->avail_out = dst_len;
+	ret = zlib_deflate(strm, Z_FINISH);
+	zlib_deflateEnd(strm);
+
+	return ret == Z_STREAM_END ? strm->total_out : -EINVAL;
+}
+
+/* inflate to @dst, at most @chunk bytes per call unless @chunk is zero */
+static int __init inflate_corpus(z_stream *strm, const u8 *src,
+				 unsigned int src_len, u8 *dst, int wbits,
+				 unsigned int chunk)
+{
+	unsigned int left;
+	int ret;
+
+	ret = zlib_inflateInit2(strm, wbits);
+	if (ret != Z_OK)
+		return -EINVAL;
+
+	strm->next_in = src;
+	strm->avail_in = src_len;
+	strm->next_out = dst;
+	do {
+		left = CORPUS_SIZE - (strm->next_out - dst);
+		strm->avail_out = chunk && chunk < left ? chunk : left;
+		ret = zlib_inflate(strm, Z_NO_FLUSH);
+	} while (ret == Z_OK);
+	zlib_inflateEnd(strm);
+
+	return ret == Z_STREAM_END ? strm->total_out : -EINVAL;
+}
+
+/*
+ * Inflate @comp in every way listed in chunks[], at every output
+ * alignment and with both copy methods, and return how many of them
+ * did not give back @orig.
+ */
+static int __init check_corpus(const char *name, z_stream *strm,
+			       const u8 *orig, const u8 *comp,
+			       unsigned int comp_len, u8 *out, int wbits)
+{
+	int i, off, copy, failed = 0;
+
+	for (i = 0; i < ARRAY_SIZE(chunks); i++) {
+		for (off = 0; off < sizeof(long); off++) {
+			for (copy = 0; copy < 2; copy++) {
+				zlib_inflate_word_copy = copy;
+				memset(out, 0xa5, CORPUS_SIZE + sizeof(long));
+				if (inflate_corpus(strm, comp, comp_len,
+						   out + off, wbits,
+						   chunks[i]) == CORPUS_SIZE &&
+				    !memcmp(out + off, orig, CORPUS_SIZE))
+					continue;
+
+				printk(KERN_ERR "zlib inflate self test: %s, "
+				       "window bits %d, chunk %u, offset %d, "
+				       "%s copies: bad output\n", name, wbits,
+				       chunks[i], off, copy ? "word" : "byte");
+				failed++;
+			}
+		}
+	}
+	zlib_inflate_word_copy = 1;
+
+	return failed;
+}
+
+/* decompression speed in KB/s */
+static unsigned long __init time_inflate(z_stream *strm, const u8 *src,
+					 unsigned int src_len, u8 *dst)
+{
+	ktime_t start;
+	u64 ns;
+	int i;
+
+	start = ktime_get();
+	for (i = 0; i < TIMED_RUNS; i++)
+		inflate_corpus(strm, src, src_len, dst, MAX_WBITS, 0);
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	ns = div_u64(ns, 1000);
+	if (!ns)
+		ns = 1;
+	return div_u64((u64)TIMED_RUNS * CORPUS_SIZE * 1000, ns);
+}
+
+static int __init inflate_selftest_init(void)
+{
+	z_stream strm;
+	u8 *orig, *comp, *out;
+	unsigned int comp_size = CORPUS_SIZE + CORPUS_SIZE / 8 + 64;
+	unsigned long byte_kbs, word_kbs;
+	int c, l, w, len, failed = 0, ret = -ENOMEM;
+
+	memset(&strm, 0, sizeof(strm));
+	strm.workspace = vmalloc(max(zlib_deflate_workspacesize(),
+				     zlib_inflate_workspacesize()));
+	orig = vmalloc(CORPUS_SIZE);
+	comp = vmalloc(comp_size);
+	out = vmalloc(CORPUS_SIZE + sizeof(long));
+	if (!strm.workspace || !orig || !comp || !out)
+		goto out_free;
+
+	for (c = 0; c < ARRAY_SIZE(corpora); c++) {
+		seed = c + 1;
+		corpora[c].make(orig);
+
+		for (l = 0; l < ARRAY_SIZE(levels); l++) {
+			for (w = 0; w < ARRAY_SIZE(window_bits); w++) {
+				len = deflate_corpus(&strm, orig, comp,
+						     comp_size, levels[l],
+						     window_bits[w]);
+				if (len < 0) {
+					printk(KERN_ERR "zlib inflate self "
+					       "test: deflate failed\n");
+					ret = -EINVAL;
+					goto out_free;
+				}
+				failed += check_corpus(corpora[c].name, &strm,
+						       orig, comp, len, out,
+						       window_bits[w]);
+			}
+		}
+
+		len = deflate_corpus(&strm, orig, comp, comp_size,
+				     Z_DEFAULT_COMPRESSION, MAX_WBITS);
+		zlib_inflate_word_copy = 0;
+		byte_kbs = time_inflate(&strm, comp, len, out);
+		zlib_inflate_word_copy = 1;
+		word_kbs = time_inflate(&strm, comp, len, out);
+
+		printk(KERN_INFO "zlib inflate self test: %-7s %6d -> %6d "
+		       "bytes, byte copies %lu.%02lu MB/s, "
+		       "word copies %lu.%02lu MB/s\n",
+		       corpora[c].name, CORPUS_SIZE, len,
+		       byte_kbs / 1000, byte_kbs % 1000 / 10,
+		       word_kbs / 1000, word_kbs % 1000 / 10);
+	}
+
+	if (failed) {
+		printk(KERN_ERR "zlib inflate self test: %d cases FAILED\n",
+		       failed);
+		ret = -EINVAL;
+	} else {
+		printk(KERN_INFO "zlib inflate self test: passed\n");
+		ret = 0;
+	}
+
+out_free:
+	vfree(out);
+	vfree(comp);
+	vfree(orig);
+	vfree(strm.workspace);
+	return ret;
+}
+
+static void __exit inflate_selftest_exit(void)
+{
+}
+
+module_init(inflate_selftest_init);
+module_exit(inflate_selftest_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("zlib inflate word copy self test");
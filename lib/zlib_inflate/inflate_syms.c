@@ -9,6 +9,7 @@
 #include <linux/init.h>
 
 #include <linux/zlib.h>
+#include "inffast.h"
 
 EXPORT_SYMBOL(zlib_inflate_workspacesize);
 EXPORT_SYMBOL(zlib_inflate);
@@ -17,4 +18,8 @@ EXPORT_SYMBOL(zlib_inflateEnd);
 EXPORT_SYMBOL(zlib_inflateReset);
 EXPORT_SYMBOL(zlib_inflateIncomp); 
 EXPORT_SYMBOL(zlib_inflate_blob);
+#if defined(CONFIG_ZLIB_INFLATE_SELF_TEST) || \
+    defined(CONFIG_ZLIB_INFLATE_SELF_TEST_MODULE)
+EXPORT_SYMBOL(zlib_inflate_word_copy);
+#endif
 MODULE_LICENSE("GPL");
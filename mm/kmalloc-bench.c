@@ -0,0 +1,218 @@
+/*
+ * mm/kmalloc-bench.c
+ *
+ * kmalloc latency and fragmentation benchmark
+ *
+ * For each of a few object size mixes, a set of live kmalloc objects is
+ * built up and then churned: random objects are freed and replaced by
+ * new ones of a random size from the same mix. Every kmalloc() and
+ * kfree() of the churn is timed, and the pages taken from the page
+ * allocator are compared with the bytes that are live in them. The
+ * module does not depend on the slab allocator it is built with, so
+ * SLAB, SLUB and SLOB kernels can be compared on the same board.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/mm.h>
+#include <linux/hrtimer.h>
+#include <linux/sched.h>
+#include <linux/sort.h>
+
+#if defined(CONFIG_SLOB)
+#define ALLOCATOR	"SLOB"
+#elif defined(CONFIG_SLUB)
+#define ALLOCATOR	"SLUB"
+#else
+#define ALLOCATOR	"SLAB"
+#endif
+
+static unsigned int live_kb = 1024;
+module_param(live_kb, uint, 0444);
+MODULE_PARM_DESC(live_kb, "bytes kept allocated, in KB");
+
+static unsigned int ops = 50000;
+module_param(ops, uint, 0444);
+MODULE_PARM_DESC(ops, "objects replaced for each size mix");
+
+struct band {
+	unsigned int percent;
+	unsigned int min, max;
+};
+
+static const struct {
+	const char *name;
+	struct band bands[4];
+} mixes[] = {
+	{ "small",  { { 100, 8, 256 } } },
+	{ "medium", { { 100, 256, 1024 } } },
+	/* roughly what a small board allocates while busy with I/O */
+	{ "mixed",  { { 50, 8, 64 }, { 30, 64, 256 }, { 15, 256, 1024 },
+		      { 5, 1024, 4000 } } },
+};
+
+struct object {
+	void *p;
+	unsigned int size;
+};
+
+static u32 seed;
+
+static u32 next_rand(void)
+{
+	seed = seed * 1103515245 + 12345;
+	return seed >> 8;
+}
+
+static unsigned int pick_size(const struct band *bands)
+{
+	unsigned int r = next_rand() % 100;
+
+	while (r >= bands->percent) {
+		r -= bands->percent;
+		bands++;
+	}
+	return bands->min + next_rand() % (bands->max - bands->min);
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+	u32 x = *(const u32 *)a, y = *(const u32 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static u32 elapsed_ns(ktime_t start)
+{
+	return min_t(s64, ktime_to_ns(ktime_sub(ktime_get(), start)), ~0U);
+}
+
+/* print the mean, median, 99th, 99.9th percentile and maximum of @lat */
+static void report(const char *mix, const char *op, u32 *lat, unsigned int n)
+{
+	u64 sum = 0;
+	unsigned int i;
+
+	for (i = 0; i < n; i++)
+		sum += lat[i];
+	sort(lat, n, sizeof(*lat), cmp_u32, NULL);
+
+	printk(KERN_INFO "kmalloc bench: %s %-6s %-7s avg %6llu p50 %6u "
+	       "p99 %6u p99.9 %7u max %7u ns\n", ALLOCATOR, mix, op,
+	       div_u64(sum, n), lat[n / 2], lat[n / 100 * 99],
+	       lat[n / 1000 * 999], lat[n - 1]);
+}
+
+static int run_mix(int m, struct object *obj, unsigned int max_obj,
+		   u32 *alloc_lat, u32 *free_lat)
+{
+	const struct band *bands = mixes[m].bands;
+	unsigned long before, pages;
+	unsigned long live = 0, target = live_kb * 1024UL;
+	unsigned int nr = 0, i, k, size;
+	ktime_t start;
+	int ret = 0;
+
+	seed = m + 1;
+	before = global_page_state(NR_FREE_PAGES);
+
+	while (live < target && nr < max_obj) {
+		size = pick_size(bands);
+		obj[nr].p = kmalloc(size, GFP_KERNEL);
+		if (!obj[nr].p) {
+			ret = -ENOMEM;
+			goto out;
+		}
+		obj[nr].size = size;
+		live += size;
+		nr++;
+	}
+
+	for (i = 0; i < ops; i++) {
+		k = next_rand() % nr;
+
+		start = ktime_get();
+		kfree(obj[k].p);
+		free_lat[i] = elapsed_ns(start);
+		live -= obj[k].size;
+
+		size = pick_size(bands);
+		start = ktime_get();
+		obj[k].p = kmalloc(size, GFP_KERNEL);
+		alloc_lat[i] = elapsed_ns(start);
+		if (!obj[k].p) {
+			obj[k] = obj[--nr];
+			ret = -ENOMEM;
+			goto out;
+		}
+		obj[k].size = size;
+		live += size;
+
+		if (!(i % 256))
+			cond_resched();
+	}
+
+	/* pages used up since the start, not only by the objects */
+	pages = global_page_state(NR_FREE_PAGES);
+	pages = before > pages ? before - pages : 0;
+	printk(KERN_INFO "kmalloc bench: %s %-6s %u objects, %lu KB in %lu "
+	       "pages, %lu%% used\n", ALLOCATOR, mixes[m].name, nr,
+	       live / 1024, pages,
+	       pages ? live * 100 / (pages * PAGE_SIZE) : 0);
+	report(mixes[m].name, "kmalloc", alloc_lat, ops);
+	report(mixes[m].name, "kfree", free_lat, ops);
+
+out:
+	while (nr)
+		kfree(obj[--nr].p);
+	return ret;
+}
+
+static int __init kmalloc_bench_init(void)
+{
+	unsigned int max_obj = live_kb * 1024 / 8 + 1;
+	struct object *obj;
+	u32 *alloc_lat, *free_lat;
+	int m, ret = -ENOMEM;
+
+	if (!ops || !live_kb)
+		return -EINVAL;
+
+	obj = vmalloc(max_obj * sizeof(*obj));
+	alloc_lat = vmalloc(ops * sizeof(*alloc_lat));
+	free_lat = vmalloc(ops * sizeof(*free_lat));
+	if (!obj || !alloc_lat || !free_lat)
+		goto out_free;
+
+	for (m = 0; m < ARRAY_SIZE(mixes); m++) {
+		ret = run_mix(m, obj, max_obj, alloc_lat, free_lat);
+		if (ret) {
+			printk(KERN_ERR "kmalloc bench: %s: out of memory\n",
+			       mixes[m].name);
+			break;
+		}
+	}
+
+out_free:
+	vfree(free_lat);
+	vfree(alloc_lat);
+	vfree(obj);
+	return ret;
+}
+
+static void __exit kmalloc_bench_exit(void)
+{
+}
+
+module_init(kmalloc_bench_init);
+module_exit(kmalloc_bench_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("kmalloc latency and fragmentation benchmark");
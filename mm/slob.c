@@ -15,14 +15,20 @@
  * The slob heap is a set of linked list of pages from alloc_pages(),
  * and within each page, there is a singly-linked list of free blocks
  * (slob_t). The heap is grown on demand. To reduce fragmentation,
- * heap pages are segregated into three lists, with objects less than
+ * heap pages are segregated into three pools, with objects less than
  * 256 bytes, objects less than 1024 bytes, and all other objects.
+ * Within a pool, partially free pages are kept on size class lists by
+ * the largest free block they hold: one class for each size below 16
+ * units and four for each power of two above that, with a bitmap of
+ * the lists that are not empty.
  *
- * Allocation from heap involves first searching for a page with
- * sufficient free blocks (using a next-fit-like approach) followed by
- * a first-fit scan of the page. Deallocation inserts objects back
- * into the free list in address order, so this is effectively an
- * address-ordered first fit.
+ * Allocation from heap involves first finding the smallest class in
+ * the pool whose pages all have a large enough block, with a single
+ * bitmap search, followed by a first-fit scan of the first page on its
+ * list. Taking the page whose largest block fits most closely leaves
+ * the large free blocks of other pages intact. Deallocation inserts
+ * objects back into the free list in address order, so within a page
+ * this is an address-ordered first fit.
  *
  * Above this is an implementation of kmalloc/kfree. Blocks returned
  * from kmalloc are prepended with a 4-byte header with the kmalloc size.
@@ -100,7 +106,8 @@ struct slob_page {
 			unsigned long flags;	/* mandatory */
 			atomic_t _count;	/* mandatory */
 			slobidx_t units;	/* free units left in page */
-			unsigned long pad[2];
+			unsigned long list_nr;	/* free_slob_pages index */
+			unsigned long pad;
 			slob_t *free;		/* first free slob_t in page */
 			struct list_head list;	/* linked list of free pages */
 		};
@@ -116,18 +123,10 @@ static inline void struct_slob_page_wrong_size(void)
 static inline void free_slob_page(struct slob_page *sp)
 {
 	reset_page_mapcount(&sp->page);
+	set_page_private(&sp->page, 0);
 	sp->page.mapping = NULL;
 }
 
-/*
- * All partially free slob pages go on these lists.
- */
-#define SLOB_BREAK1 256
-#define SLOB_BREAK2 1024
-static LIST_HEAD(free_slob_small);
-static LIST_HEAD(free_slob_medium);
-static LIST_HEAD(free_slob_large);
-
 /*
  * is_slob_page: True for all slob pages (false for bigblock pages)
  */
@@ -151,29 +150,96 @@ static inline struct slob_page *slob_page(const void *addr)
 	return (struct slob_page *)virt_to_page(addr);
 }
 
+#define SLOB_UNIT sizeof(slob_t)
+#define SLOB_UNITS(size) (((size) + SLOB_UNIT - 1)/SLOB_UNIT)
+#define SLOB_ALIGN L1_CACHE_BYTES
+
 /*
- * slob_page_free: true for pages on free_slob_pages list.
+ * All partially free slob pages go on these lists, one for each size
+ * class in each of the three pools. A page stays in the pool it was
+ * created for, and its class is that of the largest free block in it.
+ * Classes below SLOB_EXACT are one size each, and every power of two
+ * above is split into 1 << SLOB_SUB_SHIFT classes. A list is only
+ * valid while its bit is set in free_slob_map.
+ */
+#define SLOB_BREAK1 256
+#define SLOB_BREAK2 1024
+#define SLOB_EXACT_SHIFT 4
+#define SLOB_EXACT (1 << SLOB_EXACT_SHIFT)
+#define SLOB_SUB_SHIFT 2
+#define SLOB_MAX_SHIFT (PAGE_SHIFT - (SLOB_UNIT == 2 ? 1 : 2))
+#define SLOB_CLASSES \
+	(SLOB_EXACT + ((SLOB_MAX_SHIFT - SLOB_EXACT_SHIFT + 1) << SLOB_SUB_SHIFT))
+#define SLOB_LISTS (3 * SLOB_CLASSES)
+
+static struct list_head free_slob_pages[SLOB_LISTS];
+static unsigned long free_slob_map[BITS_TO_LONGS(SLOB_LISTS)];
+
+/*
+ * Return the size class of a free block: the highest class whose
+ * blocks are all no larger.
+ */
+static inline int slob_class(int units)
+{
+	int shift;
+
+	if (units < SLOB_EXACT)
+		return units;
+
+	shift = fls(units) - 1;
+	return SLOB_EXACT + ((shift - SLOB_EXACT_SHIFT) << SLOB_SUB_SHIFT) +
+		((units >> (shift - SLOB_SUB_SHIFT)) &
+		 ((1 << SLOB_SUB_SHIFT) - 1));
+}
+
+/*
+ * slob_page_free: true for pages on one of the free_slob_pages lists.
  */
 static inline int slob_page_free(struct slob_page *sp)
 {
 	return PageSlobFree((struct page *)sp);
 }
 
-static void set_slob_page_free(struct slob_page *sp, struct list_head *list)
+static void set_slob_page_free(struct slob_page *sp, int nr)
 {
-	list_add(&sp->list, list);
+	if (!test_bit(nr, free_slob_map)) {
+		INIT_LIST_HEAD(&free_slob_pages[nr]);
+		__set_bit(nr, free_slob_map);
+	}
+	list_add(&sp->list, &free_slob_pages[nr]);
+	sp->list_nr = nr;
 	__SetPageSlobFree((struct page *)sp);
 }
 
+/* list_nr is kept, so the page goes back to its own pool later */
 static inline void clear_slob_page_free(struct slob_page *sp)
 {
 	list_del(&sp->list);
+	if (list_empty(&free_slob_pages[sp->list_nr]))
+		__clear_bit(sp->list_nr, free_slob_map);
 	__ClearPageSlobFree((struct page *)sp);
 }
 
-#define SLOB_UNIT sizeof(slob_t)
-#define SLOB_UNITS(size) (((size) + SLOB_UNIT - 1)/SLOB_UNIT)
-#define SLOB_ALIGN L1_CACHE_BYTES
+static inline int slob_page_class(struct slob_page *sp)
+{
+	return sp->list_nr % SLOB_CLASSES;
+}
+
+/*
+ * Put a page on the list of its pool for a free block of the given size,
+ * which may be on the free list already.
+ */
+static void set_slob_page_class(struct slob_page *sp, slobidx_t units)
+{
+	int nr = sp->list_nr - slob_page_class(sp) + slob_class(units);
+
+	if (!slob_page_free(sp))
+		set_slob_page_free(sp, nr);
+	else if (nr != sp->list_nr) {
+		clear_slob_page_free(sp);
+		set_slob_page_free(sp, nr);
+	}
+}
 
 /*
  * struct slob_rcu is inserted at the tail of allocated slob blocks, which
@@ -238,6 +304,21 @@ static int slob_last(slob_t *s)
 	return !((unsigned long)slob_next(s) & ~PAGE_MASK);
 }
 
+/*
+ * Return the size of the largest free block in a partially free page.
+ */
+static slobidx_t slob_page_largest(struct slob_page *sp)
+{
+	slobidx_t largest = 0;
+	slob_t *cur;
+
+	for (cur = sp->free; ; cur = slob_next(cur)) {
+		largest = max(largest, slob_units(cur));
+		if (slob_last(cur))
+			return largest;
+	}
+}
+
 static void *slob_new_pages(gfp_t gfp, int order, int node)
 {
 	void *page;
@@ -272,6 +353,7 @@ static void *slob_page_alloc(struct slob_page *sp, size_t size, int align)
 
 	for (prev = NULL, cur = sp->free; ; prev = cur, cur = slob_next(cur)) {
 		slobidx_t avail = slob_units(cur);
+		slobidx_t block = avail;
 
 		if (align) {
 			aligned = (slob_t *)ALIGN((unsigned long)cur, align);
@@ -306,6 +388,9 @@ static void *slob_page_alloc(struct slob_page *sp, size_t size, int align)
 			sp->units -= units;
 			if (!sp->units)
 				clear_slob_page_free(sp);
+			else if (slob_class(block) == slob_page_class(sp))
+				/* may have been the largest block */
+				set_slob_page_class(sp, slob_page_largest(sp));
 			return cur;
 		}
 		if (slob_last(cur))
@@ -319,47 +404,44 @@ static void *slob_page_alloc(struct slob_page *sp, size_t size, int align)
 static void *slob_alloc(size_t size, gfp_t gfp, int align, int node)
 {
 	struct slob_page *sp;
-	struct list_head *prev;
-	struct list_head *slob_list;
 	slob_t *b = NULL;
 	unsigned long flags;
+	int pool, nr, units;
 
 	if (size < SLOB_BREAK1)
-		slob_list = &free_slob_small;
+		pool = 0;
 	else if (size < SLOB_BREAK2)
-		slob_list = &free_slob_medium;
+		pool = SLOB_CLASSES;
 	else
-		slob_list = &free_slob_large;
+		pool = 2 * SLOB_CLASSES;
+
+	/* leave room to align the block, so the first page tried has room */
+	units = SLOB_UNITS(size);
+	if (align)
+		units += SLOB_UNITS(align) - 1;
 
 	spin_lock_irqsave(&slob_lock, flags);
-	/* Iterate through each partially free page, try to find room */
-	list_for_each_entry(sp, slob_list, list) {
+	/* Every page from this class up has a large enough free block */
+	nr = pool + slob_class(units - 1) + 1;
+	for (nr = find_next_bit(free_slob_map, pool + SLOB_CLASSES, nr);
+	     nr < pool + SLOB_CLASSES;
+	     nr = find_next_bit(free_slob_map, pool + SLOB_CLASSES, nr + 1)) {
+		list_for_each_entry(sp, &free_slob_pages[nr], list) {
 #ifdef CONFIG_NUMA
-		/*
-		 * If there's a node specification, search for a partial
-		 * page with a matching node id in the freelist.
-		 */
-		if (node != -1 && page_to_nid(&sp->page) != node)
-			continue;
+			/*
+			 * If there's a node specification, search for a
+			 * partial page with a matching node id in the
+			 * freelist.
+			 */
+			if (node != -1 && page_to_nid(&sp->page) != node)
+				continue;
 #endif
-		/* Enough room on this page? */
-		if (sp->units < SLOB_UNITS(size))
-			continue;
-
-		/* Attempt to alloc */
-		prev = sp->list.prev;
-		b = slob_page_alloc(sp, size, align);
-		if (!b)
-			continue;
-
-		/* Improve fragment distribution and reduce our average
-		 * search time by starting our next search here. (see
-		 * Knuth vol 1, sec 2.5, pg 449) */
-		if (prev != slob_list->prev &&
-				slob_list->next != prev->next)
-			list_move_tail(slob_list, prev->next);
-		break;
+			b = slob_page_alloc(sp, size, align);
+			if (b)
+				goto found;
+		}
 	}
+found:
 	spin_unlock_irqrestore(&slob_lock, flags);
 
 	/* Not enough space: must allocate a new page */
@@ -375,7 +457,8 @@ static void *slob_alloc(size_t size, gfp_t gfp, int align, int node)
 		sp->free = b;
 		INIT_LIST_HEAD(&sp->list);
 		set_slob(b, SLOB_UNITS(PAGE_SIZE), b + SLOB_UNITS(PAGE_SIZE));
-		set_slob_page_free(sp, slob_list);
+		set_slob_page_free(sp,
+				   pool + slob_class(SLOB_UNITS(PAGE_SIZE)));
 		b = slob_page_alloc(sp, size, align);
 		BUG_ON(!b);
 		spin_unlock_irqrestore(&slob_lock, flags);
@@ -422,7 +505,7 @@ static void slob_free(void *block, int size)
 		set_slob(b, units,
 			(void *)((unsigned long)(b +
 					SLOB_UNITS(PAGE_SIZE)) & PAGE_MASK));
-		set_slob_page_free(sp, &free_slob_small);
+		set_slob_page_class(sp, units);
 		goto out;
 	}
 
@@ -459,6 +542,10 @@ static void slob_free(void *block, int size)
 		} else
 			set_slob(prev, slob_units(prev), b);
 	}
+
+	/* units is now the size of the free block the object went into */
+	if (slob_class(units) > slob_page_class(sp))
+		set_slob_page_class(sp, units);
 out:
 	spin_unlock_irqrestore(&slob_lock, flags);
 }
@@ -53,6 +53,7 @@
 #include <linux/root_dev.h>
 #include <linux/delay.h>
 #include <linux/nfs_fs.h>
+#include <linux/device.h>
 #include <net/net_namespace.h>
 #include <net/arp.h>
 #include <net/ip.h>
@@ -1323,6 +1324,10 @@ static int __init ip_auto_config(void)
 		return 0;
 
 	DBG(("IP-Config: Entered.\n"));
+
+	/* network drivers may still be probing asynchronously */
+	wait_for_device_probe();
+
 #ifdef IPCONFIG_DYNAMIC
  try_try_again:
 #endif
@@ -0,0 +1,595 @@
+/*
+ * Forwarding fast path for established IPv4 connections
+ *
+ * Once a forwarded TCP or UDP connection is assured, the first packet
+ * of each direction that leaves through POST_ROUTING records the result
+ * of routing and NAT in a flow table. Later packets of that direction
+ * are looked up in it at the very start of PRE_ROUTING, translated,
+ * have their TTL decremented and are handed straight to the neighbour
+ * layer, skipping conntrack, the iptables chains, the route lookup and
+ * ip_forward(). The conntrack timeout and counters are still updated.
+ *
+ * Anything unusual goes the slow way: fragments, IP options, an expiring
+ * TTL, packets larger than the MTU and TCP segments with SYN, FIN or RST
+ * set. The last of these also remove both directions of the connection
+ * from the table, so conntrack sees the end of every connection.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#include <linux/types.h>
+#include <linux/ip.h>
+#include <linux/tcp.h>
+#include <linux/udp.h>
+#include <linux/netfilter.h>
+#include <linux/netfilter_ipv4.h>
+#include <linux/module.h>
+#include <linux/skbuff.h>
+#include <linux/slab.h>
+#include <linux/jhash.h>
+#include <linux/random.h>
+#include <linux/percpu.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <linux/spinlock.h>
+#include <linux/timer.h>
+#include <net/ip.h>
+#include <net/route.h>
+#include <net/dst.h>
+#include <net/neighbour.h>
+#include <net/checksum.h>
+
+#include <net/netfilter/nf_conntrack.h>
+#include <net/netfilter/nf_conntrack_core.h>
+#include <net/netfilter/nf_conntrack_helper.h>
+#include <net/netfilter/ipv4/nf_conntrack_ipv4.h>
+
+#define FASTPATH_HSIZE	256
+
+static int enable = 1;
+module_param(enable, bool, 0644);
+MODULE_PARM_DESC(enable, "forward established flows on the fast path");
+
+static unsigned int max_flows = 1024;
+module_param(max_flows, uint, 0644);
+MODULE_PARM_DESC(max_flows, "maximum number of flows in the table");
+
+static unsigned int lifetime = 30;
+module_param(lifetime, uint, 0644);
+MODULE_PARM_DESC(lifetime, "seconds before a flow is routed and checked "
+		 "by the rules again");
+
+/* one direction of a connection */
+struct fastpath_flow {
+	struct hlist_node	hnode;
+	struct rcu_head		rcu;
+
+	/* the packet as it arrives */
+	__be32			saddr, daddr;
+	__be16			sport, dport;
+	u_int8_t		protonum;
+	u_int8_t		dir;
+	int			iif;
+
+	/* and as it leaves */
+	__be32			new_saddr, new_daddr;
+	__be16			new_sport, new_dport;
+
+	struct nf_conn		*ct;
+	struct dst_entry	*dst;
+	unsigned long		timeout;	/* to refresh the conntrack with */
+	unsigned long		created;
+	unsigned long		packets;
+};
+
+struct fastpath_stat {
+	unsigned int		hit;
+	unsigned int		added;
+	unsigned int		removed;
+	unsigned int		teardown;
+};
+
+static struct hlist_head fastpath_hash[FASTPATH_HSIZE];
+static DEFINE_SPINLOCK(fastpath_lock);
+static unsigned int fastpath_count;
+static u_int32_t fastpath_rnd __read_mostly;
+static struct kmem_cache *fastpath_cachep __read_mostly;
+static struct timer_list fastpath_gc_timer;
+static DEFINE_PER_CPU(struct fastpath_stat, fastpath_stat);
+
+#define FASTPATH_STAT_INC(count) (__get_cpu_var(fastpath_stat).count++)
+
+static inline unsigned int fastpath_hashfn(__be32 saddr, __be32 daddr,
+					   __be16 sport, __be16 dport,
+					   u_int8_t protonum)
+{
+	return jhash_3words((__force u32)saddr, (__force u32)daddr,
+			    ((__force u32)sport << 16 | (__force u32)dport) ^
+			    protonum, fastpath_rnd) & (FASTPATH_HSIZE - 1);
+}
+
+/* Called with rcu_read_lock or fastpath_lock held */
+static struct fastpath_flow *
+fastpath_find(__be32 saddr, __be32 daddr, __be16 sport, __be16 dport,
+	      u_int8_t protonum)
+{
+	struct fastpath_flow *flow;
+	struct hlist_node *n;
+	unsigned int h = fastpath_hashfn(saddr, daddr, sport, dport, protonum);
+
+	hlist_for_each_entry_rcu(flow, n, &fastpath_hash[h], hnode) {
+		if (flow->saddr == saddr && flow->daddr == daddr &&
+		    flow->sport == sport && flow->dport == dport &&
+		    flow->protonum == protonum)
+			return flow;
+	}
+	return NULL;
+}
+
+static struct fastpath_flow *
+fastpath_find_tuple(const struct nf_conntrack_tuple *t)
+{
+	return fastpath_find(t->src.u3.ip, t->dst.u3.ip, t->src.u.all,
+			     t->dst.u.all, t->dst.protonum);
+}
+
+static void fastpath_free_rcu(struct rcu_head *head)
+{
+	struct fastpath_flow *flow =
+		container_of(head, struct fastpath_flow, rcu);
+
+	dst_release(flow->dst);
+	nf_ct_put(flow->ct);
+	kmem_cache_free(fastpath_cachep, flow);
+}
+
+/* Called with fastpath_lock held */
+static void fastpath_del(struct fastpath_flow *flow)
+{
+	hlist_del_rcu(&flow->hnode);
+	fastpath_count--;
+	FASTPATH_STAT_INC(removed);
+	call_rcu(&flow->rcu, fastpath_free_rcu);
+}
+
+/* Remove both directions of @ct, the slow path takes over */
+static void fastpath_teardown(struct nf_conn *ct)
+{
+	struct fastpath_flow *flow;
+	int dir;
+
+	spin_lock_bh(&fastpath_lock);
+	for (dir = 0; dir < IP_CT_DIR_MAX; dir++) {
+		flow = fastpath_find_tuple(&ct->tuplehash[dir].tuple);
+		if (flow && flow->ct == ct)
+			fastpath_del(flow);
+	}
+	spin_unlock_bh(&fastpath_lock);
+}
+
+static bool fastpath_stale(const struct fastpath_flow *flow)
+{
+	return nf_ct_is_dying(flow->ct) ||
+	       !timer_pending(&flow->ct->timeout) ||
+	       flow->dst->obsolete > 0 ||
+	       time_after(jiffies, flow->created + lifetime * HZ);
+}
+
+static void fastpath_gc(unsigned long data)
+{
+	struct fastpath_flow *flow;
+	struct hlist_node *n, *next;
+	unsigned int h;
+
+	spin_lock(&fastpath_lock);
+	for (h = 0; h < FASTPATH_HSIZE && fastpath_count; h++) {
+		hlist_for_each_entry_safe(flow, n, next, &fastpath_hash[h],
+					  hnode) {
+			if (!enable || fastpath_stale(flow))
+				fastpath_del(flow);
+		}
+	}
+	spin_unlock(&fastpath_lock);
+
+	mod_timer(&fastpath_gc_timer, jiffies + HZ);
+}
+
+static bool fastpath_suitable(struct nf_conn *ct,
+			      const struct sk_buff *skb)
+{
+	const struct dst_entry *dst = skb_dst(skb);
+
+	if (!(IPCB(skb)->flags & IPSKB_FORWARDED) ||
+	    !net_eq(nf_ct_net(ct), &init_net) ||
+	    !test_bit(IPS_ASSURED_BIT, &ct->status) ||
+	    test_bit(IPS_SEQ_ADJUST_BIT, &ct->status) ||
+	    nf_ct_is_dying(ct) || nfct_help(ct))
+		return false;
+
+	switch (nf_ct_protonum(ct)) {
+	case IPPROTO_TCP:
+		if (ct->proto.tcp.state != TCP_CONNTRACK_ESTABLISHED)
+			return false;
+		break;
+	case IPPROTO_UDP:
+		break;
+	default:
+		return false;
+	}
+
+	if (ip_hdr(skb)->ihl != 5 || dst == NULL || dst->obsolete ||
+	    ((struct rtable *)dst)->rt_type != RTN_UNICAST)
+		return false;
+#ifdef CONFIG_XFRM
+	if (dst->xfrm)
+		return false;
+#endif
+	return true;
+}
+
+/* Record the result of routing and NAT for this direction of @ct */
+static void fastpath_add(struct nf_conn *ct, enum ip_conntrack_info ctinfo,
+			 struct sk_buff *skb)
+{
+	enum ip_conntrack_dir dir = CTINFO2DIR(ctinfo);
+	const struct nf_conntrack_tuple *in = &ct->tuplehash[dir].tuple;
+	const struct nf_conntrack_tuple *out = &ct->tuplehash[!dir].tuple;
+	struct fastpath_flow *flow;
+	unsigned int h;
+	long timeout;
+
+	timeout = (long)(ct->timeout.expires - jiffies);
+	if (timeout <= 0)
+		return;
+
+	flow = kmem_cache_alloc(fastpath_cachep, GFP_ATOMIC);
+	if (flow == NULL)
+		return;
+
+	flow->saddr = in->src.u3.ip;
+	flow->daddr = in->dst.u3.ip;
+	flow->sport = in->src.u.all;
+	flow->dport = in->dst.u.all;
+	flow->protonum = in->dst.protonum;
+	flow->dir = dir;
+	flow->iif = skb->iif;
+	flow->new_saddr = out->dst.u3.ip;
+	flow->new_daddr = out->src.u3.ip;
+	flow->new_sport = out->dst.u.all;
+	flow->new_dport = out->src.u.all;
+	flow->timeout = timeout;
+	flow->created = jiffies;
+	flow->packets = 0;
+
+	spin_lock_bh(&fastpath_lock);
+	if (fastpath_count >= max_flows ||
+	    fastpath_find(flow->saddr, flow->daddr, flow->sport, flow->dport,
+			  flow->protonum)) {
+		spin_unlock_bh(&fastpath_lock);
+		kmem_cache_free(fastpath_cachep, flow);
+		return;
+	}
+
+	/* Packets of this connection no longer all pass through conntrack,
+	 * so the TCP window it knows about falls behind. Don't let it
+	 * reject the final segments when they go the slow way again. */
+	if (flow->protonum == IPPROTO_TCP) {
+		spin_lock(&ct->lock);
+		ct->proto.tcp.seen[0].flags |= IP_CT_TCP_FLAG_BE_LIBERAL;
+		ct->proto.tcp.seen[1].flags |= IP_CT_TCP_FLAG_BE_LIBERAL;
+		spin_unlock(&ct->lock);
+	}
+
+	nf_conntrack_get(&ct->ct_general);
+	flow->ct = ct;
+	flow->dst = dst_clone(skb_dst(skb));
+
+	h = fastpath_hashfn(flow->saddr, flow->daddr, flow->sport, flow->dport,
+			    flow->protonum);
+	hlist_add_head_rcu(&flow->hnode, &fastpath_hash[h]);
+	fastpath_count++;
+	FASTPATH_STAT_INC(added);
+	spin_unlock_bh(&fastpath_lock);
+}
+
+static unsigned int fastpath_out(unsigned int hooknum,
+				 struct sk_buff *skb,
+				 const struct net_device *in,
+				 const struct net_device *out,
+				 int (*okfn)(struct sk_buff *))
+{
+	enum ip_conntrack_info ctinfo;
+	struct nf_conn *ct;
+
+	if (!enable)
+		return NF_ACCEPT;
+
+	ct = nf_ct_get(skb, &ctinfo);
+	if (ct == NULL || ct == &nf_conntrack_untracked ||
+	    !fastpath_suitable(ct, skb))
+		return NF_ACCEPT;
+
+	if (fastpath_find_tuple(&ct->tuplehash[CTINFO2DIR(ctinfo)].tuple))
+		return NF_ACCEPT;
+
+	fastpath_add(ct, ctinfo, skb);
+	return NF_ACCEPT;
+}
+
+static void fastpath_nat(struct sk_buff *skb, struct iphdr *iph,
+			 __be16 *ports, const struct fastpath_flow *flow)
+{
+	__sum16 *check;
+
+	if (iph->protocol == IPPROTO_TCP)
+		check = &((struct tcphdr *)ports)->check;
+	else {
+		check = &((struct udphdr *)ports)->check;
+		/* no checksum */
+		if (!*check)
+			check = NULL;
+	}
+
+	if (iph->saddr != flow->new_saddr) {
+		if (check)
+			inet_proto_csum_replace4(check, skb, iph->saddr,
+						 flow->new_saddr, 1);
+		csum_replace4(&iph->check, iph->saddr, flow->new_saddr);
+		iph->saddr = flow->new_saddr;
+	}
+	if (iph->daddr != flow->new_daddr) {
+		if (check)
+			inet_proto_csum_replace4(check, skb, iph->daddr,
+						 flow->new_daddr, 1);
+		csum_replace4(&iph->check, iph->daddr, flow->new_daddr);
+		iph->daddr = flow->new_daddr;
+	}
+	if (ports[0] != flow->new_sport) {
+		if (check)
+			inet_proto_csum_replace2(check, skb, ports[0],
+						 flow->new_sport, 0);
+		ports[0] = flow->new_sport;
+	}
+	if (ports[1] != flow->new_dport) {
+		if (check)
+			inet_proto_csum_replace2(check, skb, ports[1],
+						 flow->new_dport, 0);
+		ports[1] = flow->new_dport;
+	}
+
+	if (check && iph->protocol == IPPROTO_UDP && !*check)
+		*check = CSUM_MANGLED_0;
+}
+
+static unsigned int fastpath_in(unsigned int hooknum,
+				struct sk_buff *skb,
+				const struct net_device *in,
+				const struct net_device *out,
+				int (*okfn)(struct sk_buff *))
+{
+	struct fastpath_flow *flow;
+	struct dst_entry *dst;
+	struct iphdr *iph;
+	__be16 *ports;
+	unsigned int l4len;
+
+	if (!enable || !fastpath_count)
+		return NF_ACCEPT;
+
+	if (skb->pkt_type != PACKET_HOST || skb->nfct != NULL ||
+	    skb_is_gso(skb) || !net_eq(dev_net(in), &init_net))
+		return NF_ACCEPT;
+
+	iph = ip_hdr(skb);
+	if (iph->ihl != 5 || iph->ttl <= 1 ||
+	    (iph->frag_off & htons(IP_MF | IP_OFFSET)))
+		return NF_ACCEPT;
+
+	switch (iph->protocol) {
+	case IPPROTO_TCP:
+		l4len = sizeof(struct tcphdr);
+		break;
+	case IPPROTO_UDP:
+		l4len = sizeof(struct udphdr);
+		break;
+	default:
+		return NF_ACCEPT;
+	}
+	if (!pskb_may_pull(skb, sizeof(*iph) + l4len))
+		return NF_ACCEPT;
+	iph = ip_hdr(skb);
+	ports = (__be16 *)(skb_network_header(skb) + sizeof(*iph));
+
+	flow = fastpath_find(iph->saddr, iph->daddr, ports[0], ports[1],
+			     iph->protocol);
+	if (flow == NULL || flow->iif != in->ifindex || fastpath_stale(flow))
+		return NF_ACCEPT;
+
+	if (iph->protocol == IPPROTO_TCP) {
+		if (tcp_flag_word(ports) &
+		    (TCP_FLAG_SYN | TCP_FLAG_FIN | TCP_FLAG_RST)) {
+			FASTPATH_STAT_INC(teardown);
+			fastpath_teardown(flow->ct);
+			return NF_ACCEPT;
+		}
+		if (flow->ct->proto.tcp.state != TCP_CONNTRACK_ESTABLISHED)
+			return NF_ACCEPT;
+	}
+
+	dst = flow->dst;
+	if (skb->len > dst_mtu(dst))
+		return NF_ACCEPT;
+
+	/* We are about to mangle packet. Copy it! */
+	if (skb_cow(skb, LL_RESERVED_SPACE(dst->dev) + dst->header_len))
+		return NF_ACCEPT;
+	iph = ip_hdr(skb);
+	ports = (__be16 *)(skb_network_header(skb) + sizeof(*iph));
+
+	skb_forward_csum(skb);
+	fastpath_nat(skb, iph, ports, flow);
+	ip_decrease_ttl(iph);
+
+	nf_ct_refresh_acct(flow->ct, flow->dir == IP_CT_DIR_ORIGINAL ?
+			   IP_CT_ESTABLISHED : IP_CT_ESTABLISHED + IP_CT_IS_REPLY,
+			   skb,
+			   flow->timeout);
+	flow->packets++;
+	FASTPATH_STAT_INC(hit);
+
+	skb->priority = rt_tos2priority(iph->tos);
+	skb_dst_drop(skb);
+	skb_dst_set(skb, dst_clone(dst));
+	skb->dev = dst->dev;
+	skb->protocol = htons(ETH_P_IP);
+
+	IP_INC_STATS_BH(&init_net, IPSTATS_MIB_OUTFORWDATAGRAMS);
+	IP_UPD_PO_STATS_BH(&init_net, IPSTATS_MIB_OUT, skb->len);
+
+	if (dst->hh)
+		neigh_hh_output(dst->hh, skb);
+	else if (dst->neighbour)
+		dst->neighbour->output(skb);
+	else
+		kfree_skb(skb);
+	return NF_STOLEN;
+}
+
+static struct nf_hook_ops fastpath_ops[] __read_mostly = {
+	{
+		.hook		= fastpath_in,
+		.owner		= THIS_MODULE,
+		.pf		= NFPROTO_IPV4,
+		.hooknum	= NF_INET_PRE_ROUTING,
+		.priority	= NF_IP_PRI_FIRST,
+	},
+	{
+		.hook		= fastpath_out,
+		.owner		= THIS_MODULE,
+		.pf		= NFPROTO_IPV4,
+		.hooknum	= NF_INET_POST_ROUTING,
+		.priority	= NF_IP_PRI_LAST,
+	},
+};
+
+#ifdef CONFIG_PROC_FS
+static int fastpath_seq_show(struct seq_file *s, void *v)
+{
+	struct fastpath_stat sum = { 0 };
+	struct fastpath_flow *flow;
+	struct hlist_node *n;
+	unsigned int h;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		const struct fastpath_stat *st = &per_cpu(fastpath_stat, cpu);
+
+		sum.hit += st->hit;
+		sum.added += st->added;
+		sum.removed += st->removed;
+		sum.teardown += st->teardown;
+	}
+
+	spin_lock_bh(&fastpath_lock);
+	seq_printf(s, "flows %u hit %u added %u removed %u teardown %u\n",
+		   fastpath_count, sum.hit, sum.added, sum.removed,
+		   sum.teardown);
+
+	for (h = 0; h < FASTPATH_HSIZE; h++) {
+		hlist_for_each_entry(flow, n, &fastpath_hash[h], hnode) {
+			seq_printf(s, "%s %pI4:%u > %pI4:%u to %pI4:%u > "
+				   "%pI4:%u dev %s packets %lu\n",
+				   flow->protonum == IPPROTO_TCP ? "tcp" : "udp",
+				   &flow->saddr, ntohs(flow->sport),
+				   &flow->daddr, ntohs(flow->dport),
+				   &flow->new_saddr, ntohs(flow->new_sport),
+				   &flow->new_daddr, ntohs(flow->new_dport),
+				   flow->dst->dev->name, flow->packets);
+		}
+	}
+	spin_unlock_bh(&fastpath_lock);
+	return 0;
+}
+
+static int fastpath_seq_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, fastpath_seq_show, NULL);
+}
+
+static const struct file_operations fastpath_fops = {
+	.owner		= THIS_MODULE,
+	.open		= fastpath_seq_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+#endif
+
+static int __init nf_fastpath_init(void)
+{
+	int ret;
+
+	need_ipv4_conntrack();
+	get_random_bytes(&fastpath_rnd, sizeof(fastpath_rnd));
+
+	fastpath_cachep = kmem_cache_create("nf_fastpath",
+					    sizeof(struct fastpath_flow), 0,
+					    0, NULL);
+	if (fastpath_cachep == NULL)
+		return -ENOMEM;
+
+#ifdef CONFIG_PROC_FS
+	if (!proc_net_fops_create(&init_net, "nf_fastpath", S_IRUGO,
+				  &fastpath_fops)) {
+		ret = -ENOMEM;
+		goto err_cache;
+	}
+#endif
+
+	setup_timer(&fastpath_gc_timer, fastpath_gc, 0);
+	mod_timer(&fastpath_gc_timer, jiffies + HZ);
+
+	ret = nf_register_hooks(fastpath_ops, ARRAY_SIZE(fastpath_ops));
+	if (ret < 0)
+		goto err_timer;
+	return 0;
+
+err_timer:
+	del_timer_sync(&fastpath_gc_timer);
+#ifdef CONFIG_PROC_FS
+	proc_net_remove(&init_net, "nf_fastpath");
+err_cache:
+#endif
+	kmem_cache_destroy(fastpath_cachep);
+	return ret;
+}
+
+static void __exit nf_fastpath_fini(void)
+{
+	struct fastpath_flow *flow;
+	struct hlist_node *n, *next;
+	unsigned int h;
+
+	nf_unregister_hooks(fastpath_ops, ARRAY_SIZE(fastpath_ops));
+	del_timer_sync(&fastpath_gc_timer);
+#ifdef CONFIG_PROC_FS
+	proc_net_remove(&init_net, "nf_fastpath");
+#endif
+
+	spin_lock_bh(&fastpath_lock);
+	for (h = 0; h < FASTPATH_HSIZE; h++)
+		hlist_for_each_entry_safe(flow, n, next, &fastpath_hash[h],
+					  hnode)
+			fastpath_del(flow);
+	spin_unlock_bh(&fastpath_lock);
+
+	rcu_barrier();
+	kmem_cache_destroy(fastpath_cachep);
+}
+
+module_init(nf_fastpath_init);
+module_exit(nf_fastpath_fini);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("IPv4 forwarding fast path for established connections");
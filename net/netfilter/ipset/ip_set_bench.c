@@ -0,0 +1,382 @@
+/*
+ * IP set lookup benchmark
+ *
+ * For sets of 10, 1000 and 10000 entries, time ip_set_test() for
+ * packets half of which are in the set, and compare it with a chain of
+ * as many "-s address -j DROP" rules. The chain is laid out and walked
+ * the way ipt_do_table() does: struct ipt_standard entries one after the
+ * other, each rejected by the source address test of ip_packet_match().
+ * bitmap:port is timed with the same number of ports.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/err.h>
+#include <linux/hrtimer.h>
+#include <linux/sched.h>
+#include <linux/vmalloc.h>
+#include <linux/skbuff.h>
+#include <linux/ip.h>
+#include <linux/tcp.h>
+#include <linux/inetdevice.h>
+#include <linux/netfilter_ipv4/ip_tables.h>
+
+#include <linux/netfilter/ip_set.h>
+
+static unsigned int ops = 100000;
+module_param(ops, uint, 0444);
+MODULE_PARM_DESC(ops, "lookups timed for each set");
+
+#define NR_PROBES	1024
+#define BATCH		256
+
+static const unsigned int sizes[] = { 10, 1000, 10000 };
+
+static u32 seed;
+
+static u32 next_rand(void)
+{
+	seed = seed * 1103515245 + 12345;
+	return seed;
+}
+
+/* A TCP packet to look up, the addresses and ports are changed per probe */
+static struct sk_buff *bench_skb(void)
+{
+	struct sk_buff *skb;
+	struct iphdr *iph;
+	struct tcphdr *th;
+
+	skb = alloc_skb(sizeof(*iph) + sizeof(*th), GFP_KERNEL);
+	if (skb == NULL)
+		return NULL;
+
+	skb_reset_network_header(skb);
+	iph = (struct iphdr *)skb_put(skb, sizeof(*iph));
+	memset(iph, 0, sizeof(*iph));
+	iph->version = 4;
+	iph->ihl = 5;
+	iph->ttl = 64;
+	iph->protocol = IPPROTO_TCP;
+	iph->daddr = htonl(0x0a000001);
+
+	skb_set_transport_header(skb, sizeof(*iph));
+	th = (struct tcphdr *)skb_put(skb, sizeof(*th));
+	memset(th, 0, sizeof(*th));
+	return skb;
+}
+
+static void set_saddr(struct sk_buff *skb, __be32 addr)
+{
+	ip_hdr(skb)->saddr = addr;
+}
+
+static void set_dport(struct sk_buff *skb, u_int16_t port)
+{
+	tcp_hdr(skb)->dest = htons(port);
+}
+
+/*
+ * Create a set under a name nobody else uses, and hold a reference so
+ * that it can't be destroyed from userspace while it is timed.
+ */
+static struct ip_set *bench_create(const char *type,
+				   const struct nlattr * const tb[])
+{
+	char name[IPSET_MAXNAMELEN];
+	struct ip_set *set;
+	unsigned int i = 0;
+
+	do {
+		snprintf(name, sizeof(name), "ip_set_bench.%u", i);
+		set = ip_set_create(name, type, tb);
+	} while (IS_ERR(set) && PTR_ERR(set) == -EEXIST && ++i < 100);
+
+	if (!IS_ERR(set))
+		atomic_inc(&set->ref);
+	return set;
+}
+
+static void bench_destroy(struct ip_set *set)
+{
+	ip_set_put(set);
+	ip_set_destroy(set);
+}
+
+static u64 elapsed_ns(ktime_t start)
+{
+	return ktime_to_ns(ktime_sub(ktime_get(), start));
+}
+
+/* Time @n lookups of the probes in @set, in ns per lookup */
+static unsigned int time_set(struct ip_set *set, struct sk_buff *skb,
+			     const u32 *probes, bool port, unsigned int n)
+{
+	unsigned int i, matched = 0;
+	u64 ns = 0;
+	ktime_t start;
+
+	for (i = 0; i < n; i++) {
+		if (port)
+			set_dport(skb, probes[i % NR_PROBES]);
+		else
+			set_saddr(skb, probes[i % NR_PROBES]);
+
+		if (!(i % BATCH)) {
+			if (i)
+				ns += elapsed_ns(start);
+			cond_resched();
+			start = ktime_get();
+		}
+		matched += ip_set_test(set, skb, port ? IPSET_DST : IPSET_SRC);
+	}
+	ns += elapsed_ns(start);
+
+	/* keep the lookups from being optimised out */
+	if (matched > n)
+		printk(KERN_DEBUG "ip_set bench: %u\n", matched);
+	return div_u64(ns, n);
+}
+
+/* The rules of a chain, as ipt_do_table() finds them */
+static struct ipt_standard *build_chain(const __be32 *addrs, unsigned int n)
+{
+	struct ipt_standard *chain;
+	unsigned int i;
+
+	chain = vmalloc((n + 1) * sizeof(*chain));
+	if (chain == NULL)
+		return NULL;
+	memset(chain, 0, (n + 1) * sizeof(*chain));
+
+	for (i = 0; i <= n; i++) {
+		chain[i].entry.target_offset = sizeof(struct ipt_entry);
+		chain[i].entry.next_offset = sizeof(struct ipt_standard);
+		/* the last one is the policy, it matches everything */
+		if (i < n) {
+			chain[i].entry.ip.src.s_addr = addrs[i];
+			chain[i].entry.ip.smsk.s_addr = htonl(0xffffffff);
+		}
+	}
+	return chain;
+}
+
+static unsigned int walk_chain(const struct ipt_standard *chain,
+			       const struct iphdr *iph)
+{
+	const struct ipt_entry *e = &chain->entry;
+	unsigned int rules = 0;
+
+	for (;;) {
+		const struct ipt_ip *ipinfo = &e->ip;
+
+		if (!(((iph->saddr & ipinfo->smsk.s_addr) != ipinfo->src.s_addr)
+		      ^ !!(ipinfo->invflags & IPT_INV_SRCIP)) &&
+		    !(((iph->daddr & ipinfo->dmsk.s_addr) != ipinfo->dst.s_addr)
+		      ^ !!(ipinfo->invflags & IPT_INV_DSTIP)))
+			return rules;
+		rules++;
+		e = (const void *)e + e->next_offset;
+	}
+}
+
+/* Time @n walks of @chain for the probes, in ns per packet */
+static unsigned int time_chain(const struct ipt_standard *chain,
+			       struct sk_buff *skb, const u32 *probes,
+			       unsigned int n)
+{
+	unsigned int i, rules = 0;
+	u64 ns = 0;
+	ktime_t start;
+
+	for (i = 0; i < n; i++) {
+		set_saddr(skb, probes[i % NR_PROBES]);
+
+		if (!(i % BATCH)) {
+			if (i)
+				ns += elapsed_ns(start);
+			cond_resched();
+			start = ktime_get();
+		}
+		rules += walk_chain(chain, ip_hdr(skb));
+	}
+	ns += elapsed_ns(start);
+
+	if (rules == 0)
+		printk(KERN_DEBUG "ip_set bench: empty chain\n");
+	return div_u64(ns, n);
+}
+
+static int bench_hash(const char *type, unsigned int size,
+		      struct sk_buff *skb, __be32 *addrs, u32 *probes)
+{
+	static const u_int8_t prefixes[] = { 16, 20, 24, 28, 32 };
+	const struct nlattr *tb[IPSET_ATTR_MAX + 1] = { NULL };
+	struct {
+		struct nlattr	nla;
+		__be32		ip;
+	} ip_attr;
+	struct {
+		struct nlattr	nla;
+		u_int8_t	cidr;
+		u_int8_t	pad[3];
+	} cidr_attr;
+	struct ipt_standard *chain;
+	struct ip_set *set;
+	unsigned int i, set_ns, chain_ns, n;
+	bool net = !strcmp(type, "hash:net");
+	int ret = 0;
+
+	set = bench_create(type, NULL);
+	if (IS_ERR(set))
+		return PTR_ERR(set);
+
+	seed = size;
+	for (i = 0; i < size; i++) {
+		addrs[i] = htonl(next_rand());
+		if (net)
+			addrs[i] &= inet_make_mask(prefixes[i %
+						ARRAY_SIZE(prefixes)]);
+	}
+
+	/* fill the set the way userspace does, so that the hash grows */
+	ip_attr.nla.nla_type = IPSET_ATTR_IP;
+	ip_attr.nla.nla_len = nla_attr_size(sizeof(__be32));
+	cidr_attr.nla.nla_type = IPSET_ATTR_CIDR;
+	cidr_attr.nla.nla_len = nla_attr_size(sizeof(u_int8_t));
+	tb[IPSET_ATTR_IP] = &ip_attr.nla;
+	if (net)
+		tb[IPSET_ATTR_CIDR] = &cidr_attr.nla;
+
+	for (i = 0; i < size; i++) {
+		ip_attr.ip = addrs[i];
+		cidr_attr.cidr = prefixes[i % ARRAY_SIZE(prefixes)];
+		ip_set_uadt(set, tb, IPSET_ADD);
+	}
+
+	/* half of the probes are in the set */
+	for (i = 0; i < NR_PROBES; i++)
+		probes[i] = i & 1 ? addrs[next_rand() % size] :
+				    htonl(next_rand());
+
+	set_ns = time_set(set, skb, probes, false, ops);
+
+	/* a chain of this length costs ~size times more, time fewer */
+	if (!net) {
+		chain = build_chain(addrs, size);
+		if (chain == NULL) {
+			ret = -ENOMEM;
+			goto out;
+		}
+		n = max(ops / size * 10, 1000U);
+		chain_ns = time_chain(chain, skb, probes, n);
+		printk(KERN_INFO "ip_set bench: %-11s %5u entries: set %6u "
+		       "ns/pkt, chain of rules %8u ns/pkt\n", type, size,
+		       set_ns, chain_ns);
+		vfree(chain);
+	} else {
+		printk(KERN_INFO "ip_set bench: %-11s %5u entries: set %6u "
+		       "ns/pkt, %u prefix lengths\n", type, size, set_ns,
+		       min_t(unsigned int, size, ARRAY_SIZE(prefixes)));
+	}
+
+	printk(KERN_INFO "ip_set bench: %-11s %5u entries: %u bytes\n",
+	       type, size, (unsigned int)set->memsize);
+out:
+	bench_destroy(set);
+	return ret;
+}
+
+static int bench_port(unsigned int size, struct sk_buff *skb, u32 *probes)
+{
+	const struct nlattr *tb[IPSET_ATTR_MAX + 1] = { NULL };
+	struct {
+		struct nlattr	nla;
+		__be16		port;
+		u_int8_t	pad[2];
+	} from, to;
+	struct ip_set *set;
+	unsigned int i;
+
+	from.nla.nla_type = IPSET_ATTR_PORT_FROM;
+	from.nla.nla_len = nla_attr_size(sizeof(__be16));
+	from.port = htons(0);
+	to.nla.nla_type = IPSET_ATTR_PORT_TO;
+	to.nla.nla_len = nla_attr_size(sizeof(__be16));
+	to.port = htons(65535);
+	tb[IPSET_ATTR_PORT_FROM] = &from.nla;
+	tb[IPSET_ATTR_PORT_TO] = &to.nla;
+
+	set = bench_create("bitmap:port", tb);
+	if (IS_ERR(set))
+		return PTR_ERR(set);
+
+	seed = size;
+	for (i = 0; i < size; i++) {
+		set_dport(skb, next_rand() & 0xffff);
+		ip_set_add(set, skb, IPSET_DST);
+	}
+	for (i = 0; i < NR_PROBES; i++)
+		probes[i] = next_rand() & 0xffff;
+
+	printk(KERN_INFO "ip_set bench: %-11s %5u entries: set %6u ns/pkt\n",
+	       "bitmap:port", size, time_set(set, skb, probes, true, ops));
+
+	bench_destroy(set);
+	return 0;
+}
+
+static int __init ip_set_bench_init(void)
+{
+	static const char * const types[] = { "hash:ip", "hash:net" };
+	struct sk_buff *skb;
+	__be32 *addrs;
+	u32 *probes;
+	unsigned int s, t;
+	int ret = -ENOMEM;
+
+	if (!ops)
+		return -EINVAL;
+
+	skb = bench_skb();
+	addrs = vmalloc(sizes[ARRAY_SIZE(sizes) - 1] * sizeof(*addrs));
+	probes = vmalloc(NR_PROBES * sizeof(*probes));
+	if (skb == NULL || addrs == NULL || probes == NULL)
+		goto out;
+
+	for (s = 0; s < ARRAY_SIZE(sizes); s++) {
+		for (t = 0; t < ARRAY_SIZE(types); t++) {
+			ret = bench_hash(types[t], sizes[s], skb, addrs, probes);
+			if (ret < 0)
+				goto fail;
+		}
+		ret = bench_port(sizes[s], skb, probes);
+		if (ret < 0)
+			goto fail;
+	}
+	ret = 0;
+	goto out;
+
+fail:
+	printk(KERN_ERR "ip_set bench: failed: %d\n", ret);
+out:
+	vfree(probes);
+	vfree(addrs);
+	kfree_skb(skb);
+	return ret;
+}
+
+static void __exit ip_set_bench_exit(void)
+{
+}
+
+module_init(ip_set_bench_init);
+module_exit(ip_set_bench_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("IP set lookup benchmark");
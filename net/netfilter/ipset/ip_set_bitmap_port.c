@@ -0,0 +1,227 @@
+/*
+ * IP set type bitmap:port
+ *
+ * A bit for each TCP or UDP port of a range given at creation, so a
+ * lookup is a single bit test. Packets of other protocols and fragments
+ * after the first are never in the set.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/slab.h>
+#include <linux/bitops.h>
+#include <linux/ip.h>
+#include <linux/skbuff.h>
+#include <net/ip.h>
+#include <net/netlink.h>
+
+#include <linux/netfilter/ip_set.h>
+
+struct ip_set_bitmap_port {
+	unsigned long		*map;
+	u_int16_t		first, last;
+};
+
+static int bitmap_port_create(struct ip_set *set,
+			      const struct nlattr * const tb[])
+{
+	struct ip_set_bitmap_port *b;
+	u_int16_t first, last;
+	size_t size;
+
+	if (!tb[IPSET_ATTR_PORT_FROM] || !tb[IPSET_ATTR_PORT_TO])
+		return -EINVAL;
+	first = ntohs(nla_get_be16(tb[IPSET_ATTR_PORT_FROM]));
+	last = ntohs(nla_get_be16(tb[IPSET_ATTR_PORT_TO]));
+	if (first > last)
+		swap(first, last);
+
+	b = kzalloc(sizeof(*b), GFP_KERNEL);
+	if (b == NULL)
+		return -ENOMEM;
+	size = BITS_TO_LONGS(last - first + 1) * sizeof(unsigned long);
+	b->map = ip_set_alloc(size);
+	if (b->map == NULL) {
+		kfree(b);
+		return -ENOMEM;
+	}
+	b->first = first;
+	b->last = last;
+
+	set->data = b;
+	set->memsize = sizeof(*b) + size;
+	return 0;
+}
+
+static void bitmap_port_flush(struct ip_set *set)
+{
+	struct ip_set_bitmap_port *b = set->data;
+
+	write_lock_bh(&set->lock);
+	bitmap_zero(b->map, b->last - b->first + 1);
+	set->elements = 0;
+	write_unlock_bh(&set->lock);
+}
+
+static void bitmap_port_destroy(struct ip_set *set)
+{
+	struct ip_set_bitmap_port *b = set->data;
+
+	ip_set_free(b->map);
+	kfree(b);
+}
+
+/* Called with set->lock held for writing */
+static int bitmap_port_adt(struct ip_set *set, u_int16_t from, u_int16_t to,
+			   enum ip_set_adt adt)
+{
+	struct ip_set_bitmap_port *b = set->data;
+	unsigned int port;
+	int ret = adt == IPSET_ADD ? -EEXIST : -ENOENT;
+
+	for (port = from; port <= to; port++) {
+		if (adt == IPSET_ADD) {
+			if (set->elements >= set->maxelem)
+				return -ENOSPC;
+			if (!test_and_set_bit(port - b->first, b->map)) {
+				set->elements++;
+				ret = 0;
+			}
+		} else if (test_and_clear_bit(port - b->first, b->map)) {
+			set->elements--;
+			ret = 0;
+		}
+	}
+	return ret;
+}
+
+static int bitmap_port_uadt(struct ip_set *set,
+			    const struct nlattr * const tb[],
+			    enum ip_set_adt adt)
+{
+	struct ip_set_bitmap_port *b = set->data;
+	u_int16_t from, to;
+	int ret;
+
+	if (!tb[IPSET_ATTR_PORT])
+		return -EINVAL;
+	from = to = ntohs(nla_get_be16(tb[IPSET_ATTR_PORT]));
+	if (tb[IPSET_ATTR_PORT_TO] && adt != IPSET_TEST)
+		to = ntohs(nla_get_be16(tb[IPSET_ATTR_PORT_TO]));
+	if (from > to)
+		swap(from, to);
+	if (from < b->first || to > b->last)
+		return adt == IPSET_TEST ? 0 : -ERANGE;
+
+	if (adt == IPSET_TEST)
+		return test_bit(from - b->first, b->map);
+
+	write_lock_bh(&set->lock);
+	ret = bitmap_port_adt(set, from, to, adt);
+	write_unlock_bh(&set->lock);
+	return ret;
+}
+
+static int bitmap_port_kadt(struct ip_set *set, const struct sk_buff *skb,
+			    enum ip_set_adt adt, u_int8_t flags)
+{
+	struct ip_set_bitmap_port *b = set->data;
+	const struct iphdr *iph = ip_hdr(skb);
+	__be16 _ports[2];
+	const __be16 *ports;
+	u_int16_t port;
+	int ret;
+
+	if (iph->protocol != IPPROTO_TCP && iph->protocol != IPPROTO_UDP)
+		return adt == IPSET_TEST ? 0 : -EINVAL;
+	if (iph->frag_off & htons(IP_OFFSET))
+		return adt == IPSET_TEST ? 0 : -EINVAL;
+
+	ports = skb_header_pointer(skb, ip_hdrlen(skb), sizeof(_ports),
+				   _ports);
+	if (ports == NULL)
+		return adt == IPSET_TEST ? 0 : -EINVAL;
+	port = ntohs(flags & IPSET_SRC ? ports[0] : ports[1]);
+
+	if (port < b->first || port > b->last)
+		return adt == IPSET_TEST ? 0 : -ERANGE;
+
+	/* a bit is read atomically, changes need the element count */
+	if (adt == IPSET_TEST)
+		return test_bit(port - b->first, b->map);
+
+	write_lock_bh(&set->lock);
+	ret = bitmap_port_adt(set, port, port, adt);
+	write_unlock_bh(&set->lock);
+	return ret;
+}
+
+static int bitmap_port_head(struct ip_set *set, struct sk_buff *skb)
+{
+	const struct ip_set_bitmap_port *b = set->data;
+
+	NLA_PUT_BE16(skb, IPSET_ATTR_PORT_FROM, htons(b->first));
+	NLA_PUT_BE16(skb, IPSET_ATTR_PORT_TO, htons(b->last));
+	return 0;
+
+nla_put_failure:
+	return -EMSGSIZE;
+}
+
+/* *pos is the offset of the next port to look at */
+static int bitmap_port_dump(struct ip_set *set, struct sk_buff *skb,
+			    unsigned long *pos)
+{
+	const struct ip_set_bitmap_port *b = set->data;
+	unsigned long size = b->last - b->first + 1;
+	struct nlattr *nest;
+
+	for (; *pos < size; (*pos)++) {
+		if (!test_bit(*pos, b->map))
+			continue;
+		nest = nla_nest_start(skb, IPSET_ATTR_DATA | NLA_F_NESTED);
+		if (nest == NULL)
+			return -EMSGSIZE;
+		NLA_PUT_BE16(skb, IPSET_ATTR_PORT, htons(b->first + *pos));
+		nla_nest_end(skb, nest);
+	}
+	return 0;
+
+nla_put_failure:
+	nla_nest_cancel(skb, nest);
+	return -EMSGSIZE;
+}
+
+static struct ip_set_type bitmap_port_type = {
+	.name		= "bitmap:port",
+	.me		= THIS_MODULE,
+	.create		= bitmap_port_create,
+	.destroy	= bitmap_port_destroy,
+	.flush		= bitmap_port_flush,
+	.uadt		= bitmap_port_uadt,
+	.kadt		= bitmap_port_kadt,
+	.head		= bitmap_port_head,
+	.dump		= bitmap_port_dump,
+};
+
+static int __init ip_set_bitmap_port_init(void)
+{
+	return ip_set_type_register(&bitmap_port_type);
+}
+
+static void __exit ip_set_bitmap_port_fini(void)
+{
+	ip_set_type_unregister(&bitmap_port_type);
+}
+
+module_init(ip_set_bitmap_port_init);
+module_exit(ip_set_bitmap_port_fini);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("IP set type bitmap:port");
+MODULE_ALIAS("ip_set_bitmap:port");
@@ -0,0 +1,535 @@
+/*
+ * IP sets core: set types, named sets and their nfnetlink interface
+ *
+ * A set is created with a type, which keeps its elements in a hash table
+ * or a bitmap, and is then filled and queried over nfnetlink. Rules find
+ * sets by name through the xtables "set" match and "SET" target, and a
+ * set cannot be destroyed while a rule uses it.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/kmod.h>
+#include <linux/list.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/mm.h>
+#include <linux/err.h>
+#include <linux/netlink.h>
+#include <linux/skbuff.h>
+#include <net/netlink.h>
+
+#include <linux/netfilter.h>
+#include <linux/netfilter/nfnetlink.h>
+#include <linux/netfilter/ip_set.h>
+
+#define IPSET_DEFAULT_MAXELEM	65536
+
+static LIST_HEAD(ip_set_types);
+static LIST_HEAD(ip_set_list);
+/* Protects both lists and the references of the sets */
+static DEFINE_MUTEX(ip_set_mutex);
+
+static const struct nlattr *ip_set_no_attrs[IPSET_ATTR_MAX + 1];
+
+void *ip_set_alloc(size_t size)
+{
+	void *p = NULL;
+
+	if (size <= PAGE_SIZE << 1)
+		p = kzalloc(size, GFP_KERNEL | __GFP_NOWARN);
+	if (p == NULL) {
+		p = vmalloc(size);
+		if (p)
+			memset(p, 0, size);
+	}
+	return p;
+}
+EXPORT_SYMBOL_GPL(ip_set_alloc);
+
+void ip_set_free(void *p)
+{
+	if (is_vmalloc_addr(p))
+		vfree(p);
+	else
+		kfree(p);
+}
+EXPORT_SYMBOL_GPL(ip_set_free);
+
+/* Called with ip_set_mutex held */
+static struct ip_set_type *__ip_set_find_type(const char *name)
+{
+	struct ip_set_type *type;
+
+	list_for_each_entry(type, &ip_set_types, list)
+		if (!strcmp(type->name, name))
+			return type;
+	return NULL;
+}
+
+/* Called with ip_set_mutex held */
+static struct ip_set *__ip_set_find(const char *name)
+{
+	struct ip_set *set;
+
+	list_for_each_entry(set, &ip_set_list, list)
+		if (!strcmp(set->name, name))
+			return set;
+	return NULL;
+}
+
+int ip_set_type_register(struct ip_set_type *type)
+{
+	int ret = 0;
+
+	mutex_lock(&ip_set_mutex);
+	if (__ip_set_find_type(type->name))
+		ret = -EEXIST;
+	else
+		list_add_tail(&type->list, &ip_set_types);
+	mutex_unlock(&ip_set_mutex);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(ip_set_type_register);
+
+void ip_set_type_unregister(struct ip_set_type *type)
+{
+	mutex_lock(&ip_set_mutex);
+	list_del(&type->list);
+	mutex_unlock(&ip_set_mutex);
+}
+EXPORT_SYMBOL_GPL(ip_set_type_unregister);
+
+struct ip_set *ip_set_create(const char *name, const char *typename,
+			     const struct nlattr * const tb[])
+{
+	struct ip_set_type *type;
+	struct ip_set *set;
+	int ret;
+
+	if (strlen(name) >= IPSET_MAXNAMELEN)
+		return ERR_PTR(-ENAMETOOLONG);
+	if (tb == NULL)
+		tb = ip_set_no_attrs;
+
+	set = kzalloc(sizeof(*set), GFP_KERNEL);
+	if (set == NULL)
+		return ERR_PTR(-ENOMEM);
+	strlcpy(set->name, name, sizeof(set->name));
+	rwlock_init(&set->lock);
+	atomic_set(&set->ref, 0);
+	set->maxelem = IPSET_DEFAULT_MAXELEM;
+	if (tb[IPSET_ATTR_MAXELEM])
+		set->maxelem = nla_get_u32(tb[IPSET_ATTR_MAXELEM]);
+
+	mutex_lock(&ip_set_mutex);
+	type = __ip_set_find_type(typename);
+#ifdef CONFIG_MODULES
+	if (type == NULL) {
+		mutex_unlock(&ip_set_mutex);
+		request_module("ip_set_%s", typename);
+		mutex_lock(&ip_set_mutex);
+		type = __ip_set_find_type(typename);
+	}
+#endif
+	ret = -EOPNOTSUPP;
+	if (type == NULL || !try_module_get(type->me))
+		goto err_unlock;
+
+	ret = -EEXIST;
+	if (__ip_set_find(name))
+		goto err_put;
+
+	set->type = type;
+	ret = type->create(set, tb);
+	if (ret < 0)
+		goto err_put;
+
+	list_add_tail(&set->list, &ip_set_list);
+	mutex_unlock(&ip_set_mutex);
+	return set;
+
+err_put:
+	module_put(type->me);
+err_unlock:
+	mutex_unlock(&ip_set_mutex);
+	kfree(set);
+	return ERR_PTR(ret);
+}
+EXPORT_SYMBOL_GPL(ip_set_create);
+
+/* The set must be off the list already */
+static void ip_set_release(struct ip_set *set)
+{
+	set->type->destroy(set);
+	module_put(set->type->me);
+	kfree(set);
+}
+
+int ip_set_destroy(struct ip_set *set)
+{
+	mutex_lock(&ip_set_mutex);
+	if (atomic_read(&set->ref)) {
+		mutex_unlock(&ip_set_mutex);
+		return -EBUSY;
+	}
+	list_del(&set->list);
+	mutex_unlock(&ip_set_mutex);
+
+	ip_set_release(set);
+	return 0;
+}
+EXPORT_SYMBOL_GPL(ip_set_destroy);
+
+struct ip_set *ip_set_get_byname(const char *name)
+{
+	struct ip_set *set;
+
+	mutex_lock(&ip_set_mutex);
+	set = __ip_set_find(name);
+	if (set)
+		atomic_inc(&set->ref);
+	mutex_unlock(&ip_set_mutex);
+	return set;
+}
+EXPORT_SYMBOL_GPL(ip_set_get_byname);
+
+void ip_set_put(struct ip_set *set)
+{
+	atomic_dec(&set->ref);
+}
+EXPORT_SYMBOL_GPL(ip_set_put);
+
+/* Add, delete or test with netlink attributes, the way userspace does */
+int ip_set_uadt(struct ip_set *set, const struct nlattr * const tb[],
+		enum ip_set_adt adt)
+{
+	int ret;
+
+	mutex_lock(&ip_set_mutex);
+	ret = set->type->uadt(set, tb, adt);
+	mutex_unlock(&ip_set_mutex);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(ip_set_uadt);
+
+int ip_set_add(struct ip_set *set, const struct sk_buff *skb, u_int8_t flags)
+{
+	return set->type->kadt(set, skb, IPSET_ADD, flags);
+}
+EXPORT_SYMBOL_GPL(ip_set_add);
+
+int ip_set_del(struct ip_set *set, const struct sk_buff *skb, u_int8_t flags)
+{
+	return set->type->kadt(set, skb, IPSET_DEL, flags);
+}
+EXPORT_SYMBOL_GPL(ip_set_del);
+
+int ip_set_test(struct ip_set *set, const struct sk_buff *skb, u_int8_t flags)
+{
+	return set->type->kadt(set, skb, IPSET_TEST, flags) > 0;
+}
+EXPORT_SYMBOL_GPL(ip_set_test);
+
+/* nfnetlink interface */
+
+static const struct nla_policy ip_set_policy[IPSET_ATTR_MAX + 1] = {
+	[IPSET_ATTR_NAME]	= { .type = NLA_NUL_STRING,
+				    .len = IPSET_MAXNAMELEN - 1 },
+	[IPSET_ATTR_TYPE]	= { .type = NLA_NUL_STRING,
+				    .len = IPSET_MAXNAMELEN - 1 },
+	[IPSET_ATTR_HASHSIZE]	= { .type = NLA_U32 },
+	[IPSET_ATTR_MAXELEM]	= { .type = NLA_U32 },
+	[IPSET_ATTR_PORT_FROM]	= { .type = NLA_U16 },
+	[IPSET_ATTR_PORT_TO]	= { .type = NLA_U16 },
+	[IPSET_ATTR_IP]		= { .type = NLA_U32 },
+	[IPSET_ATTR_CIDR]	= { .type = NLA_U8 },
+	[IPSET_ATTR_PORT]	= { .type = NLA_U16 },
+};
+
+static int ip_set_nl_create(struct sock *ctnl, struct sk_buff *skb,
+			    const struct nlmsghdr *nlh,
+			    const struct nlattr * const attr[])
+{
+	struct ip_set *set;
+
+	if (!attr[IPSET_ATTR_NAME] || !attr[IPSET_ATTR_TYPE])
+		return -EINVAL;
+
+	set = ip_set_create(nla_data(attr[IPSET_ATTR_NAME]),
+			    nla_data(attr[IPSET_ATTR_TYPE]), attr);
+	return IS_ERR(set) ? PTR_ERR(set) : 0;
+}
+
+static int ip_set_nl_destroy(struct sock *ctnl, struct sk_buff *skb,
+			     const struct nlmsghdr *nlh,
+			     const struct nlattr * const attr[])
+{
+	struct ip_set *set, *next;
+	LIST_HEAD(gone);
+
+	mutex_lock(&ip_set_mutex);
+	if (attr[IPSET_ATTR_NAME]) {
+		set = __ip_set_find(nla_data(attr[IPSET_ATTR_NAME]));
+		if (set == NULL) {
+			mutex_unlock(&ip_set_mutex);
+			return -ENOENT;
+		}
+		if (atomic_read(&set->ref)) {
+			mutex_unlock(&ip_set_mutex);
+			return -EBUSY;
+		}
+		list_move(&set->list, &gone);
+	} else {
+		/* all or nothing */
+		list_for_each_entry(set, &ip_set_list, list) {
+			if (atomic_read(&set->ref)) {
+				mutex_unlock(&ip_set_mutex);
+				return -EBUSY;
+			}
+		}
+		list_splice_init(&ip_set_list, &gone);
+	}
+	mutex_unlock(&ip_set_mutex);
+
+	list_for_each_entry_safe(set, next, &gone, list)
+		ip_set_release(set);
+	return 0;
+}
+
+static int ip_set_nl_flush(struct sock *ctnl, struct sk_buff *skb,
+			   const struct nlmsghdr *nlh,
+			   const struct nlattr * const attr[])
+{
+	const char *name = NULL;
+	struct ip_set *set;
+	int ret = -ENOENT;
+
+	if (attr[IPSET_ATTR_NAME])
+		name = nla_data(attr[IPSET_ATTR_NAME]);
+
+	mutex_lock(&ip_set_mutex);
+	list_for_each_entry(set, &ip_set_list, list) {
+		if (name && strcmp(set->name, name))
+			continue;
+		set->type->flush(set);
+		ret = 0;
+	}
+	mutex_unlock(&ip_set_mutex);
+
+	return name ? ret : 0;
+}
+
+static int ip_set_nl_uadt(const struct nlmsghdr *nlh,
+			  const struct nlattr * const attr[],
+			  enum ip_set_adt adt)
+{
+	struct ip_set *set;
+	int ret;
+
+	if (!attr[IPSET_ATTR_NAME])
+		return -EINVAL;
+
+	mutex_lock(&ip_set_mutex);
+	set = __ip_set_find(nla_data(attr[IPSET_ATTR_NAME]));
+	ret = set ? set->type->uadt(set, attr, adt) : -ENOENT;
+	mutex_unlock(&ip_set_mutex);
+
+	switch (adt) {
+	case IPSET_ADD:
+		if (ret == -EEXIST && !(nlh->nlmsg_flags & NLM_F_EXCL))
+			ret = 0;
+		break;
+	case IPSET_DEL:
+		break;
+	case IPSET_TEST:
+		if (ret == 0)
+			ret = -ENOENT;
+		else if (ret > 0)
+			ret = 0;
+		break;
+	}
+	return ret;
+}
+
+static int ip_set_nl_add(struct sock *ctnl, struct sk_buff *skb,
+			 const struct nlmsghdr *nlh,
+			 const struct nlattr * const attr[])
+{
+	return ip_set_nl_uadt(nlh, attr, IPSET_ADD);
+}
+
+static int ip_set_nl_del(struct sock *ctnl, struct sk_buff *skb,
+			 const struct nlmsghdr *nlh,
+			 const struct nlattr * const attr[])
+{
+	return ip_set_nl_uadt(nlh, attr, IPSET_DEL);
+}
+
+static int ip_set_nl_test(struct sock *ctnl, struct sk_buff *skb,
+			  const struct nlmsghdr *nlh,
+			  const struct nlattr * const attr[])
+{
+	return ip_set_nl_uadt(nlh, attr, IPSET_TEST);
+}
+
+/* Put one message for @set, with its elements from cb->args[1] on. A large
+ * set is split over several messages, each with the set header. */
+static int ip_set_dump_set(struct sk_buff *skb, struct netlink_callback *cb,
+			   struct ip_set *set)
+{
+	struct nlmsghdr *nlh;
+	struct nfgenmsg *nfmsg;
+	struct nlattr *nest;
+	int ret;
+
+	nlh = nlmsg_put(skb, NETLINK_CB(cb->skb).pid, cb->nlh->nlmsg_seq,
+			NFNL_SUBSYS_IPSET << 8 | IPSET_MSG_LIST,
+			sizeof(*nfmsg), NLM_F_MULTI);
+	if (nlh == NULL)
+		return -EMSGSIZE;
+
+	nfmsg = nlmsg_data(nlh);
+	nfmsg->nfgen_family = AF_INET;
+	nfmsg->version = NFNETLINK_V0;
+	nfmsg->res_id = 0;
+
+	read_lock_bh(&set->lock);
+	if (nla_put_string(skb, IPSET_ATTR_NAME, set->name) ||
+	    nla_put_string(skb, IPSET_ATTR_TYPE, set->type->name) ||
+	    nla_put_u32(skb, IPSET_ATTR_MAXELEM, set->maxelem) ||
+	    nla_put_u32(skb, IPSET_ATTR_ELEMENTS, set->elements) ||
+	    nla_put_u32(skb, IPSET_ATTR_REFERENCES,
+			atomic_read(&set->ref)) ||
+	    nla_put_u32(skb, IPSET_ATTR_MEMSIZE, set->memsize) ||
+	    set->type->head(set, skb) < 0)
+		goto nla_put_failure;
+
+	nest = nla_nest_start(skb, IPSET_ATTR_ADT | NLA_F_NESTED);
+	if (nest == NULL)
+		goto nla_put_failure;
+	ret = set->type->dump(set, skb, &cb->args[1]);
+	read_unlock_bh(&set->lock);
+
+	nla_nest_end(skb, nest);
+	nlmsg_end(skb, nlh);
+	return ret;
+
+nla_put_failure:
+	read_unlock_bh(&set->lock);
+	nlmsg_cancel(skb, nlh);
+	return -EMSGSIZE;
+}
+
+/* cb->args[0] is the index of the set, cb->args[1] the position in it */
+static int ip_set_dump(struct sk_buff *skb, struct netlink_callback *cb)
+{
+	struct nlattr *tb[IPSET_ATTR_MAX + 1];
+	const char *name = NULL;
+	struct ip_set *set;
+	unsigned long idx = 0;
+
+	if (nlmsg_parse(cb->nlh, sizeof(struct nfgenmsg), tb, IPSET_ATTR_MAX,
+			ip_set_policy) == 0 && tb[IPSET_ATTR_NAME])
+		name = nla_data(tb[IPSET_ATTR_NAME]);
+
+	mutex_lock(&ip_set_mutex);
+	list_for_each_entry(set, &ip_set_list, list) {
+		if (idx++ < cb->args[0])
+			continue;
+		if (!name || !strcmp(set->name, name)) {
+			if (ip_set_dump_set(skb, cb, set) < 0)
+				break;
+		}
+		cb->args[0] = idx;
+		cb->args[1] = 0;
+	}
+	mutex_unlock(&ip_set_mutex);
+
+	return skb->len;
+}
+
+static int ip_set_nl_list(struct sock *ctnl, struct sk_buff *skb,
+			  const struct nlmsghdr *nlh,
+			  const struct nlattr * const attr[])
+{
+	if (!(nlh->nlmsg_flags & NLM_F_DUMP))
+		return -EINVAL;
+
+	return netlink_dump_start(ctnl, skb, nlh, ip_set_dump, NULL);
+}
+
+static const struct nfnl_callback ip_set_nl_cb[IPSET_MSG_MAX] = {
+	[IPSET_MSG_CREATE]	= {
+		.call		= ip_set_nl_create,
+		.attr_count	= IPSET_ATTR_MAX,
+		.policy		= ip_set_policy,
+	},
+	[IPSET_MSG_DESTROY]	= {
+		.call		= ip_set_nl_destroy,
+		.attr_count	= IPSET_ATTR_MAX,
+		.policy		= ip_set_policy,
+	},
+	[IPSET_MSG_FLUSH]	= {
+		.call		= ip_set_nl_flush,
+		.attr_count	= IPSET_ATTR_MAX,
+		.policy		= ip_set_policy,
+	},
+	[IPSET_MSG_ADD]		= {
+		.call		= ip_set_nl_add,
+		.attr_count	= IPSET_ATTR_MAX,
+		.policy		= ip_set_policy,
+	},
+	[IPSET_MSG_DEL]		= {
+		.call		= ip_set_nl_del,
+		.attr_count	= IPSET_ATTR_MAX,
+		.policy		= ip_set_policy,
+	},
+	[IPSET_MSG_TEST]	= {
+		.call		= ip_set_nl_test,
+		.attr_count	= IPSET_ATTR_MAX,
+		.policy		= ip_set_policy,
+	},
+	[IPSET_MSG_LIST]	= {
+		.call		= ip_set_nl_list,
+		.attr_count	= IPSET_ATTR_MAX,
+		.policy		= ip_set_policy,
+	},
+};
+
+static const struct nfnetlink_subsystem ip_set_nl_subsys = {
+	.name		= "ip_set",
+	.subsys_id	= NFNL_SUBSYS_IPSET,
+	.cb_count	= IPSET_MSG_MAX,
+	.cb		= ip_set_nl_cb,
+};
+
+static int __init ip_set_init(void)
+{
+	int ret;
+
+	ret = nfnetlink_subsys_register(&ip_set_nl_subsys);
+	if (ret < 0)
+		printk(KERN_ERR "ip_set: cannot register with nfnetlink\n");
+	return ret;
+}
+
+static void __exit ip_set_fini(void)
+{
+	/* The types hold the module and the sets hold their type, so
+	 * there are no sets left here. */
+	nfnetlink_subsys_unregister(&ip_set_nl_subsys);
+}
+
+module_init(ip_set_init);
+module_exit(ip_set_fini);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("IP sets core");
+MODULE_ALIAS_NFNL_SUBSYS(NFNL_SUBSYS_IPSET);
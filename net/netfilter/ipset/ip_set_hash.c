@@ -0,0 +1,430 @@
+/*
+ * IP set types hash:ip and hash:net
+ *
+ * hash:ip holds IPv4 addresses, hash:net IPv4 networks of any prefix
+ * length. The elements are chained in a hash table that doubles when it
+ * holds twice as many elements as buckets, so a lookup costs one hash and
+ * a short chain whatever the size of the set. hash:net looks an address
+ * up once for each prefix length in the set, the longest first.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/slab.h>
+#include <linux/jhash.h>
+#include <linux/random.h>
+#include <linux/log2.h>
+#include <linux/ip.h>
+#include <linux/inetdevice.h>
+#include <linux/skbuff.h>
+#include <net/netlink.h>
+
+#include <linux/netfilter/ip_set.h>
+
+#define HASH_MIN_SIZE		64
+#define HASH_DEFAULT_SIZE	1024
+#define HASH_MAX_SIZE		65536
+
+struct hash_elem {
+	struct hlist_node	node;
+	__be32			ip;
+	u_int8_t		cidr;
+};
+
+struct ip_set_hash {
+	struct hlist_head	*table;
+	unsigned int		hsize;		/* buckets, a power of two */
+	u_int32_t		initval;
+	bool			net;		/* hash:net */
+	/* Prefix lengths in the set: bit n - 1 for /n, and their users */
+	u_int32_t		cidr_map;
+	u_int32_t		nets[33];
+};
+
+static struct kmem_cache *hash_cachep __read_mostly;
+
+static inline unsigned int hash_bucket(const struct ip_set_hash *h,
+				       __be32 ip, u_int8_t cidr,
+				       unsigned int hsize)
+{
+	return jhash_2words((__force u32)ip, cidr, h->initval) & (hsize - 1);
+}
+
+/* Called with set->lock held */
+static struct hash_elem *hash_find(const struct ip_set_hash *h, __be32 ip,
+				   u_int8_t cidr)
+{
+	struct hash_elem *e;
+	struct hlist_node *n;
+
+	hlist_for_each_entry(e, n, &h->table[hash_bucket(h, ip, cidr, h->hsize)],
+			     node) {
+		if (e->ip == ip && e->cidr == cidr)
+			return e;
+	}
+	return NULL;
+}
+
+/* Called with set->lock held */
+static bool hash_test(const struct ip_set_hash *h, __be32 ip)
+{
+	u_int32_t map = h->cidr_map;
+	int cidr;
+
+	/* most specific first */
+	while (map) {
+		cidr = fls(map);
+		if (hash_find(h, ip & inet_make_mask(cidr), cidr))
+			return true;
+		map &= ~(1U << (cidr - 1));
+	}
+	return false;
+}
+
+/* Called with set->lock held for writing */
+static int hash_add(struct ip_set *set, struct hash_elem *e)
+{
+	struct ip_set_hash *h = set->data;
+
+	if (hash_find(h, e->ip, e->cidr))
+		return -EEXIST;
+	if (set->elements >= set->maxelem)
+		return -ENOSPC;
+
+	hlist_add_head(&e->node,
+		       &h->table[hash_bucket(h, e->ip, e->cidr, h->hsize)]);
+	if (!h->nets[e->cidr]++)
+		h->cidr_map |= 1U << (e->cidr - 1);
+	set->elements++;
+	set->memsize += sizeof(*e);
+	return 0;
+}
+
+/* Called with set->lock held for writing */
+static int hash_del(struct ip_set *set, __be32 ip, u_int8_t cidr)
+{
+	struct ip_set_hash *h = set->data;
+	struct hash_elem *e;
+
+	e = hash_find(h, ip, cidr);
+	if (e == NULL)
+		return -ENOENT;
+
+	hlist_del(&e->node);
+	if (!--h->nets[cidr])
+		h->cidr_map &= ~(1U << (cidr - 1));
+	set->elements--;
+	set->memsize -= sizeof(*e);
+	kmem_cache_free(hash_cachep, e);
+	return 0;
+}
+
+/* Double the table when the chains get long. Process context only. */
+static void hash_grow(struct ip_set *set)
+{
+	struct ip_set_hash *h = set->data;
+	struct hlist_head *table, *old;
+	struct hash_elem *e;
+	struct hlist_node *n, *next;
+	unsigned int hsize, i;
+
+	if (set->elements < h->hsize * 2 || h->hsize >= HASH_MAX_SIZE)
+		return;
+
+	hsize = h->hsize * 2;
+	table = ip_set_alloc(hsize * sizeof(*table));
+	if (table == NULL)
+		return;		/* keep the longer chains */
+
+	write_lock_bh(&set->lock);
+	old = h->table;
+	for (i = 0; i < h->hsize; i++) {
+		hlist_for_each_entry_safe(e, n, next, &old[i], node) {
+			hlist_del(&e->node);
+			hlist_add_head(&e->node, &table[hash_bucket(h, e->ip,
+							e->cidr, hsize)]);
+		}
+	}
+	h->table = table;
+	set->memsize += (hsize - h->hsize) * sizeof(*table);
+	h->hsize = hsize;
+	write_unlock_bh(&set->lock);
+
+	ip_set_free(old);
+}
+
+static int hash_create(struct ip_set *set, const struct nlattr * const tb[],
+		       bool net)
+{
+	struct ip_set_hash *h;
+	unsigned int hsize = HASH_DEFAULT_SIZE;
+
+	if (tb[IPSET_ATTR_HASHSIZE]) {
+		hsize = nla_get_u32(tb[IPSET_ATTR_HASHSIZE]);
+		hsize = roundup_pow_of_two(clamp_t(unsigned int, hsize,
+						   HASH_MIN_SIZE,
+						   HASH_MAX_SIZE));
+	}
+
+	h = kzalloc(sizeof(*h), GFP_KERNEL);
+	if (h == NULL)
+		return -ENOMEM;
+	h->table = ip_set_alloc(hsize * sizeof(*h->table));
+	if (h->table == NULL) {
+		kfree(h);
+		return -ENOMEM;
+	}
+	h->hsize = hsize;
+	h->net = net;
+	get_random_bytes(&h->initval, sizeof(h->initval));
+
+	set->data = h;
+	set->memsize = sizeof(*h) + hsize * sizeof(*h->table);
+	return 0;
+}
+
+static int hash_ip_create(struct ip_set *set, const struct nlattr * const tb[])
+{
+	return hash_create(set, tb, false);
+}
+
+static int hash_net_create(struct ip_set *set, const struct nlattr * const tb[])
+{
+	return hash_create(set, tb, true);
+}
+
+static void hash_flush(struct ip_set *set)
+{
+	struct ip_set_hash *h = set->data;
+	struct hash_elem *e;
+	struct hlist_node *n, *next;
+	unsigned int i;
+
+	write_lock_bh(&set->lock);
+	for (i = 0; i < h->hsize; i++) {
+		hlist_for_each_entry_safe(e, n, next, &h->table[i], node) {
+			hlist_del(&e->node);
+			kmem_cache_free(hash_cachep, e);
+		}
+	}
+	memset(h->nets, 0, sizeof(h->nets));
+	h->cidr_map = 0;
+	set->memsize -= set->elements * sizeof(*e);
+	set->elements = 0;
+	write_unlock_bh(&set->lock);
+}
+
+static void hash_destroy(struct ip_set *set)
+{
+	struct ip_set_hash *h = set->data;
+
+	hash_flush(set);
+	ip_set_free(h->table);
+	kfree(h);
+}
+
+static int hash_uadt(struct ip_set *set, const struct nlattr * const tb[],
+		     enum ip_set_adt adt)
+{
+	struct ip_set_hash *h = set->data;
+	struct hash_elem *e;
+	u_int8_t cidr = 32;
+	__be32 ip;
+	int ret;
+
+	if (!tb[IPSET_ATTR_IP])
+		return -EINVAL;
+	ip = nla_get_be32(tb[IPSET_ATTR_IP]);
+
+	if (tb[IPSET_ATTR_CIDR]) {
+		cidr = nla_get_u8(tb[IPSET_ATTR_CIDR]);
+		if (cidr < 1 || cidr > 32 || (!h->net && cidr != 32))
+			return -EINVAL;
+	}
+	ip &= inet_make_mask(cidr);
+
+	switch (adt) {
+	case IPSET_TEST:
+		read_lock_bh(&set->lock);
+		/* without a prefix length, is the address in any network */
+		if (tb[IPSET_ATTR_CIDR])
+			ret = hash_find(h, ip, cidr) != NULL;
+		else
+			ret = hash_test(h, ip);
+		read_unlock_bh(&set->lock);
+		return ret;
+	case IPSET_DEL:
+		write_lock_bh(&set->lock);
+		ret = hash_del(set, ip, cidr);
+		write_unlock_bh(&set->lock);
+		return ret;
+	case IPSET_ADD:
+		hash_grow(set);
+		e = kmem_cache_alloc(hash_cachep, GFP_KERNEL);
+		if (e == NULL)
+			return -ENOMEM;
+		e->ip = ip;
+		e->cidr = cidr;
+		write_lock_bh(&set->lock);
+		ret = hash_add(set, e);
+		write_unlock_bh(&set->lock);
+		if (ret < 0)
+			kmem_cache_free(hash_cachep, e);
+		return ret;
+	}
+	return -EINVAL;
+}
+
+/* Packets add and delete single addresses, as a /32 in hash:net */
+static int hash_kadt(struct ip_set *set, const struct sk_buff *skb,
+		     enum ip_set_adt adt, u_int8_t flags)
+{
+	struct ip_set_hash *h = set->data;
+	struct hash_elem *e;
+	__be32 ip;
+	int ret;
+
+	ip = flags & IPSET_SRC ? ip_hdr(skb)->saddr : ip_hdr(skb)->daddr;
+
+	switch (adt) {
+	case IPSET_TEST:
+		read_lock_bh(&set->lock);
+		ret = hash_test(h, ip);
+		read_unlock_bh(&set->lock);
+		return ret;
+	case IPSET_DEL:
+		write_lock_bh(&set->lock);
+		ret = hash_del(set, ip, 32);
+		write_unlock_bh(&set->lock);
+		return ret;
+	case IPSET_ADD:
+		read_lock_bh(&set->lock);
+		ret = hash_find(h, ip, 32) != NULL;
+		read_unlock_bh(&set->lock);
+		if (ret)
+			return -EEXIST;
+
+		e = kmem_cache_alloc(hash_cachep, GFP_ATOMIC);
+		if (e == NULL)
+			return -ENOMEM;
+		e->ip = ip;
+		e->cidr = 32;
+		write_lock_bh(&set->lock);
+		ret = hash_add(set, e);
+		write_unlock_bh(&set->lock);
+		if (ret < 0)
+			kmem_cache_free(hash_cachep, e);
+		return ret;
+	}
+	return -EINVAL;
+}
+
+static int hash_head(struct ip_set *set, struct sk_buff *skb)
+{
+	const struct ip_set_hash *h = set->data;
+
+	NLA_PUT_U32(skb, IPSET_ATTR_HASHSIZE, h->hsize);
+	return 0;
+
+nla_put_failure:
+	return -EMSGSIZE;
+}
+
+static int hash_dump(struct ip_set *set, struct sk_buff *skb,
+		     unsigned long *pos)
+{
+	const struct ip_set_hash *h = set->data;
+	struct hash_elem *e;
+	struct hlist_node *n;
+	struct nlattr *nest;
+	unsigned long i = 0;
+	unsigned int b;
+
+	for (b = 0; b < h->hsize; b++) {
+		hlist_for_each_entry(e, n, &h->table[b], node) {
+			if (i++ < *pos)
+				continue;
+			nest = nla_nest_start(skb, IPSET_ATTR_DATA | NLA_F_NESTED);
+			if (nest == NULL)
+				return -EMSGSIZE;
+			NLA_PUT_BE32(skb, IPSET_ATTR_IP, e->ip);
+			if (h->net)
+				NLA_PUT_U8(skb, IPSET_ATTR_CIDR, e->cidr);
+			nla_nest_end(skb, nest);
+			(*pos)++;
+		}
+	}
+	return 0;
+
+nla_put_failure:
+	nla_nest_cancel(skb, nest);
+	return -EMSGSIZE;
+}
+
+static struct ip_set_type hash_ip_type = {
+	.name		= "hash:ip",
+	.me		= THIS_MODULE,
+	.create		= hash_ip_create,
+	.destroy	= hash_destroy,
+	.flush		= hash_flush,
+	.uadt		= hash_uadt,
+	.kadt		= hash_kadt,
+	.head		= hash_head,
+	.dump		= hash_dump,
+};
+
+static struct ip_set_type hash_net_type = {
+	.name		= "hash:net",
+	.me		= THIS_MODULE,
+	.create		= hash_net_create,
+	.destroy	= hash_destroy,
+	.flush		= hash_flush,
+	.uadt		= hash_uadt,
+	.kadt		= hash_kadt,
+	.head		= hash_head,
+	.dump		= hash_dump,
+};
+
+static int __init ip_set_hash_init(void)
+{
+	int ret;
+
+	hash_cachep = kmem_cache_create("ip_set_hash", sizeof(struct hash_elem),
+					0, 0, NULL);
+	if (hash_cachep == NULL)
+		return -ENOMEM;
+
+	ret = ip_set_type_register(&hash_ip_type);
+	if (ret < 0)
+		goto err_cache;
+	ret = ip_set_type_register(&hash_net_type);
+	if (ret < 0)
+		goto err_ip;
+	return 0;
+
+err_ip:
+	ip_set_type_unregister(&hash_ip_type);
+err_cache:
+	kmem_cache_destroy(hash_cachep);
+	return ret;
+}
+
+static void __exit ip_set_hash_fini(void)
+{
+	ip_set_type_unregister(&hash_net_type);
+	ip_set_type_unregister(&hash_ip_type);
+	kmem_cache_destroy(hash_cachep);
+}
+
+module_init(ip_set_hash_init);
+module_exit(ip_set_hash_fini);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("IP set types hash:ip and hash:net");
+MODULE_ALIAS("ip_set_hash:ip");
+MODULE_ALIAS("ip_set_hash:net");
@@ -0,0 +1,154 @@
+/*
+ * xt_set - match and target for IP sets
+ *
+ * The "set" match tests whether the source or destination address or
+ * port of a packet is in a set, which a single hash or bitmap lookup
+ * answers however large the set is. The "SET" target adds it to a set,
+ * deletes it from one, or both.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/skbuff.h>
+
+#include <linux/netfilter/x_tables.h>
+#include <linux/netfilter/ip_set.h>
+#include <linux/netfilter/xt_set.h>
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Xtables: IP set match and target");
+MODULE_ALIAS("ipt_set");
+MODULE_ALIAS("ipt_SET");
+
+/* Look the set up and hold it. An empty name is no set. */
+static bool set_info_get(struct xt_set_info *info)
+{
+	info->set = NULL;
+	if (info->name[sizeof(info->name) - 1] != '\0')
+		return false;
+	if (info->name[0] == '\0')
+		return true;
+	if (info->dim != IPSET_SRC && info->dim != IPSET_DST)
+		return false;
+
+	info->set = ip_set_get_byname(info->name);
+	if (info->set == NULL) {
+		printk(KERN_WARNING "xt_set: no set named %s\n", info->name);
+		return false;
+	}
+	return true;
+}
+
+static void set_info_put(struct xt_set_info *info)
+{
+	if (info->set)
+		ip_set_put(info->set);
+}
+
+static bool set_mt(const struct sk_buff *skb, const struct xt_match_param *par)
+{
+	const struct xt_set_info_match *info = par->matchinfo;
+
+	return ip_set_test(info->match_set.set, skb, info->match_set.dim) ^
+	       !!(info->match_set.flags & XT_SET_INVERT);
+}
+
+static bool set_mt_check(const struct xt_mtchk_param *par)
+{
+	struct xt_set_info_match *info = par->matchinfo;
+
+	if (info->match_set.name[0] == '\0')
+		return false;
+	return set_info_get(&info->match_set);
+}
+
+static void set_mt_destroy(const struct xt_mtdtor_param *par)
+{
+	struct xt_set_info_match *info = par->matchinfo;
+
+	set_info_put(&info->match_set);
+}
+
+static unsigned int set_tg(struct sk_buff *skb,
+			   const struct xt_target_param *par)
+{
+	const struct xt_set_info_target *info = par->targinfo;
+
+	if (info->add_set.set)
+		ip_set_add(info->add_set.set, skb, info->add_set.dim);
+	if (info->del_set.set)
+		ip_set_del(info->del_set.set, skb, info->del_set.dim);
+
+	return XT_CONTINUE;
+}
+
+static bool set_tg_check(const struct xt_tgchk_param *par)
+{
+	struct xt_set_info_target *info = par->targinfo;
+
+	if (info->add_set.name[0] == '\0' && info->del_set.name[0] == '\0')
+		return false;
+	if (!set_info_get(&info->add_set))
+		return false;
+	if (!set_info_get(&info->del_set)) {
+		set_info_put(&info->add_set);
+		return false;
+	}
+	return true;
+}
+
+static void set_tg_destroy(const struct xt_tgdtor_param *par)
+{
+	struct xt_set_info_target *info = par->targinfo;
+
+	set_info_put(&info->add_set);
+	set_info_put(&info->del_set);
+}
+
+static struct xt_match set_mt_reg __read_mostly = {
+	.name		= "set",
+	.revision	= 0,
+	.family		= NFPROTO_IPV4,
+	.match		= set_mt,
+	.checkentry	= set_mt_check,
+	.destroy	= set_mt_destroy,
+	.matchsize	= sizeof(struct xt_set_info_match),
+	.me		= THIS_MODULE,
+};
+
+static struct xt_target set_tg_reg __read_mostly = {
+	.name		= "SET",
+	.revision	= 0,
+	.family		= NFPROTO_IPV4,
+	.target		= set_tg,
+	.checkentry	= set_tg_check,
+	.destroy	= set_tg_destroy,
+	.targetsize	= sizeof(struct xt_set_info_target),
+	.me		= THIS_MODULE,
+};
+
+static int __init set_init(void)
+{
+	int ret;
+
+	ret = xt_register_match(&set_mt_reg);
+	if (ret < 0)
+		return ret;
+	ret = xt_register_target(&set_tg_reg);
+	if (ret < 0)
+		xt_unregister_match(&set_mt_reg);
+	return ret;
+}
+
+static void __exit set_exit(void)
+{
+	xt_unregister_target(&set_tg_reg);
+	xt_unregister_match(&set_mt_reg);
+}
+
+module_init(set_init);
+module_exit(set_exit);
@@ -156,9 +156,33 @@ struct packet_mreq_max {
 };
 
 #ifdef CONFIG_PACKET_MMAP
-static int packet_set_ring(struct sock *sk, struct tpacket_req *req,
+static int packet_set_ring(struct sock *sk, union tpacket_req_u *req_u,
 		int closing, int tx_ring);
 
+#define BLK_HDR_LEN		ALIGN(sizeof(struct tpacket_block_desc), 8)
+#define BLK_PLUS_PRIV(sz)	(BLK_HDR_LEN + ALIGN((sz), 8))
+#define DEFAULT_PRB_RETIRE_TOV	8	/* msecs */
+
+/*
+ * A TPACKET_V3 rx ring is filled a block at a time: packets are packed
+ * into the current block, which goes to the user when the next packet
+ * does not fit or retire_tov after its first packet.
+ * Protected by sk_receive_queue.lock.
+ */
+struct packet_block_queue {
+	unsigned int		cur;		/* block being filled */
+	unsigned int		open:1;		/* cur has packets */
+	char			*nxt;		/* where the next packet goes */
+	char			*end;
+	unsigned int		nr_blocks;
+	unsigned int		blk_size;
+	unsigned int		first_offset;
+	unsigned int		max_frame_len;
+	unsigned long		retire_tov;	/* jiffies */
+	u64			seq_num;
+	struct timer_list	retire_timer;
+};
+
 struct packet_ring_buffer {
 	char			**pg_vec;
 	unsigned int		head;
@@ -171,6 +195,8 @@ struct packet_ring_buffer {
 	unsigned int		pg_vec_len;
 
 	atomic_t		pending;
+
+	struct packet_block_queue	bdq;
 };
 
 struct packet_sock;
@@ -312,6 +338,149 @@ static inline void packet_increment_head(struct packet_ring_buffer *buff)
 	buff->head = buff->head != buff->frame_max ? buff->head+1 : 0;
 }
 
+static inline struct tpacket_block_desc *packet_block(
+		struct packet_ring_buffer *rb, unsigned int n)
+{
+	return (struct tpacket_block_desc *)rb->pg_vec[n];
+}
+
+static int __packet_get_block_status(struct tpacket_block_desc *desc)
+{
+	smp_rmb();
+	flush_dcache_page(virt_to_page(&desc->hdr.bh1.block_status));
+	return desc->hdr.bh1.block_status;
+}
+
+static inline struct tpacket_block_desc *packet_previous_block(
+		struct packet_sock *po, int status)
+{
+	struct packet_block_queue *bdq = &po->rx_ring.bdq;
+	unsigned int previous = bdq->cur ? bdq->cur - 1 : bdq->nr_blocks - 1;
+	struct tpacket_block_desc *desc = packet_block(&po->rx_ring, previous);
+
+	if (status != __packet_get_block_status(desc))
+		return NULL;
+
+	return desc;
+}
+
+static void packet_init_block_queue(struct packet_ring_buffer *rb,
+		struct tpacket_req3 *req3)
+{
+	struct packet_block_queue *bdq = &rb->bdq;
+	unsigned int tov = req3->tp_retire_blk_tov ? : DEFAULT_PRB_RETIRE_TOV;
+
+	bdq->cur = 0;
+	bdq->open = 0;
+	bdq->nr_blocks = req3->tp_block_nr;
+	bdq->blk_size = req3->tp_block_size;
+	bdq->first_offset = BLK_PLUS_PRIV(req3->tp_sizeof_priv);
+	/* so that an aligned frame of max_frame_len ends in the block */
+	bdq->max_frame_len = (bdq->blk_size - bdq->first_offset) &
+			     ~(TPACKET_ALIGNMENT - 1);
+	bdq->retire_tov = msecs_to_jiffies(tov) ? : 1;
+	bdq->seq_num = 0;
+}
+
+/* Hand the current block to the user and move on to the next one */
+static void packet_retire_block(struct packet_sock *po, int status)
+{
+	struct packet_block_queue *bdq = &po->rx_ring.bdq;
+	struct tpacket_block_desc *desc = packet_block(&po->rx_ring, bdq->cur);
+	struct page *p_start, *p_end;
+
+	if (po->stats.tp_drops)
+		status |= TP_STATUS_LOSING;
+
+	desc->hdr.bh1.blk_len = bdq->nxt - (char *)desc;
+
+	p_start = virt_to_page(desc);
+	p_end = virt_to_page(bdq->nxt - 1);
+	while (p_start <= p_end) {
+		flush_dcache_page(p_start);
+		p_start++;
+	}
+	smp_wmb();
+
+	desc->hdr.bh1.block_status = TP_STATUS_USER | status;
+	flush_dcache_page(virt_to_page(&desc->hdr.bh1.block_status));
+	smp_wmb();
+
+	bdq->open = 0;
+	bdq->cur = bdq->cur != bdq->nr_blocks - 1 ? bdq->cur + 1 : 0;
+}
+
+/*
+ * Find room for a packet of @len bytes, retiring the current block if it
+ * does not fit. Returns NULL if the block to open still belongs to the
+ * user.
+ */
+static void *packet_block_space(struct packet_sock *po, unsigned int len,
+		int *retired)
+{
+	struct packet_block_queue *bdq = &po->rx_ring.bdq;
+	struct tpacket_block_desc *desc;
+	void *frame;
+
+	len = TPACKET_ALIGN(len);
+	if (bdq->open && bdq->nxt + len > bdq->end) {
+		packet_retire_block(po, 0);
+		*retired = 1;
+	}
+
+	desc = packet_block(&po->rx_ring, bdq->cur);
+	if (!bdq->open) {
+		if (__packet_get_block_status(desc) != TP_STATUS_KERNEL)
+			return NULL;
+
+		desc->version = TPACKET_V3;
+		desc->offset_to_priv = BLK_HDR_LEN;
+		desc->hdr.bh1.num_pkts = 0;
+		desc->hdr.bh1.offset_to_first_pkt = bdq->first_offset;
+		desc->hdr.bh1.seq_num = ++bdq->seq_num;
+		bdq->nxt = (char *)desc + bdq->first_offset;
+		bdq->end = (char *)desc + bdq->blk_size;
+		bdq->open = 1;
+		mod_timer(&bdq->retire_timer, jiffies + bdq->retire_tov);
+	}
+
+	frame = bdq->nxt;
+	bdq->nxt += len;
+	desc->hdr.bh1.num_pkts++;
+	return frame;
+}
+
+static void packet_stamp_block(struct packet_sock *po, struct timespec *ts)
+{
+	struct tpacket_hdr_v1 *bh1;
+
+	bh1 = &packet_block(&po->rx_ring, po->rx_ring.bdq.cur)->hdr.bh1;
+	if (bh1->num_pkts == 1) {
+		bh1->ts_first_pkt.ts_sec = ts->tv_sec;
+		bh1->ts_first_pkt.ts_nsec = ts->tv_nsec;
+	}
+	bh1->ts_last_pkt.ts_sec = ts->tv_sec;
+	bh1->ts_last_pkt.ts_nsec = ts->tv_nsec;
+}
+
+/* Retire a block that has waited retire_tov for more packets */
+static void packet_retire_timer(unsigned long data)
+{
+	struct packet_sock *po = (struct packet_sock *)data;
+	struct sock *sk = &po->sk;
+	int retired = 0;
+
+	spin_lock(&sk->sk_receive_queue.lock);
+	if (po->rx_ring.pg_vec && po->rx_ring.bdq.open) {
+		packet_retire_block(po, TP_STATUS_BLK_TMO);
+		retired = 1;
+	}
+	spin_unlock(&sk->sk_receive_queue.lock);
+
+	if (retired)
+		sk->sk_data_ready(sk, 0);
+}
+
 #endif
 
 static inline struct packet_sock *pkt_sk(struct sock *sk)
@@ -517,7 +686,7 @@ static inline unsigned int run_filter(struct sk_buff *skb, struct sock *sk,
 	rcu_read_lock_bh();
 	filter = rcu_dereference(sk->sk_filter);
 	if (filter != NULL)
-		res = sk_run_filter(skb, filter->insns, filter->len);
+		res = SK_RUN_FILTER(filter, skb);
 	rcu_read_unlock_bh();
 
 	return res;
@@ -656,11 +825,13 @@ static int tpacket_rcv(struct sk_buff *skb, struct net_device *dev,
 	union {
 		struct tpacket_hdr *h1;
 		struct tpacket2_hdr *h2;
+		struct tpacket3_hdr *h3;
 		void *raw;
 	} h;
 	u8 *skb_head = skb->data;
 	int skb_len = skb->len;
 	unsigned int snaplen, res;
+	int retired = 0;
 	unsigned long status = TP_STATUS_LOSING|TP_STATUS_USER;
 	unsigned short macoff, netoff, hdrlen;
 	struct sk_buff *copy_skb = NULL;
@@ -707,7 +878,17 @@ static int tpacket_rcv(struct sk_buff *skb, struct net_device *dev,
 		macoff = netoff - maclen;
 	}
 
-	if (macoff + snaplen > po->rx_ring.frame_size) {
+	if (po->tp_version == TPACKET_V3) {
+		unsigned int max_frame_len = po->rx_ring.bdq.max_frame_len;
+
+		if (macoff + snaplen > max_frame_len) {
+			snaplen = max_frame_len - macoff;
+			if ((int)snaplen < 0) {
+				snaplen = 0;
+				macoff = max_frame_len;
+			}
+		}
+	} else if (macoff + snaplen > po->rx_ring.frame_size) {
 		if (po->copy_thresh &&
 		    atomic_read(&sk->sk_rmem_alloc) + skb->truesize <
 		    (unsigned)sk->sk_rcvbuf) {
@@ -726,10 +907,17 @@ static int tpacket_rcv(struct sk_buff *skb, struct net_device *dev,
 	}
 
 	spin_lock(&sk->sk_receive_queue.lock);
-	h.raw = packet_current_frame(po, &po->rx_ring, TP_STATUS_KERNEL);
-	if (!h.raw)
-		goto ring_is_full;
-	packet_increment_head(&po->rx_ring);
+	if (po->tp_version == TPACKET_V3) {
+		h.raw = packet_block_space(po, macoff + snaplen, &retired);
+		if (!h.raw)
+			goto ring_is_full;
+	} else {
+		h.raw = packet_current_frame(po, &po->rx_ring,
+					     TP_STATUS_KERNEL);
+		if (!h.raw)
+			goto ring_is_full;
+		packet_increment_head(&po->rx_ring);
+	}
 	po->stats.tp_packets++;
 	if (copy_skb) {
 		status |= TP_STATUS_COPY;
@@ -737,7 +925,10 @@ static int tpacket_rcv(struct sk_buff *skb, struct net_device *dev,
 	}
 	if (!po->stats.tp_drops)
 		status &= ~TP_STATUS_LOSING;
-	spin_unlock(&sk->sk_receive_queue.lock);
+	/* A block is filled under the lock, so that it is complete when the
+	 * next packet or the timer retires it. */
+	if (po->tp_version != TPACKET_V3)
+		spin_unlock(&sk->sk_receive_queue.lock);
 
 	skb_copy_bits(skb, 0, h.raw + macoff, snaplen);
 
@@ -769,6 +960,24 @@ static int tpacket_rcv(struct sk_buff *skb, struct net_device *dev,
 		h.h2->tp_vlan_tci = skb->vlan_tci;
 		hdrlen = sizeof(*h.h2);
 		break;
+	case TPACKET_V3:
+		h.h3->tp_next_offset = TPACKET_ALIGN(macoff + snaplen);
+		h.h3->tp_status = status;
+		h.h3->tp_len = skb->len;
+		h.h3->tp_snaplen = snaplen;
+		h.h3->tp_mac = macoff;
+		h.h3->tp_net = netoff;
+		if (skb->tstamp.tv64)
+			ts = ktime_to_timespec(skb->tstamp);
+		else
+			getnstimeofday(&ts);
+		h.h3->tp_sec = ts.tv_sec;
+		h.h3->tp_nsec = ts.tv_nsec;
+		h.h3->hv1.tp_rxhash = 0;
+		h.h3->hv1.tp_vlan_tci = skb->vlan_tci;
+		packet_stamp_block(po, &ts);
+		hdrlen = sizeof(*h.h3);
+		break;
 	default:
 		BUG();
 	}
@@ -784,6 +993,14 @@ static int tpacket_rcv(struct sk_buff *skb, struct net_device *dev,
 	else
 		sll->sll_ifindex = dev->ifindex;
 
+	if (po->tp_version == TPACKET_V3) {
+		spin_unlock(&sk->sk_receive_queue.lock);
+		/* the user is woken once per block */
+		if (retired)
+			sk->sk_data_ready(sk, 0);
+		goto drop_n_restore;
+	}
+
 	__packet_set_status(po, h.raw, status);
 	smp_mb();
 	{
@@ -1168,7 +1385,7 @@ static int packet_release(struct socket *sock)
 	struct packet_sock *po;
 	struct net *net;
 #ifdef CONFIG_PACKET_MMAP
-	struct tpacket_req req;
+	union tpacket_req_u req_u;
 #endif
 
 	if (!sk)
@@ -1199,13 +1416,13 @@ static int packet_release(struct socket *sock)
 	packet_flush_mclist(sk);
 
 #ifdef CONFIG_PACKET_MMAP
-	memset(&req, 0, sizeof(req));
+	memset(&req_u, 0, sizeof(req_u));
 
 	if (po->rx_ring.pg_vec)
-		packet_set_ring(sk, &req, 1, 0);
+		packet_set_ring(sk, &req_u, 1, 0);
 
 	if (po->tx_ring.pg_vec)
-		packet_set_ring(sk, &req, 1, 1);
+		packet_set_ring(sk, &req_u, 1, 1);
 #endif
 
 	/*
@@ -1380,6 +1597,10 @@ static int packet_create(struct net *net, struct socket *sock, int protocol)
 
 	spin_lock_init(&po->bind_lock);
 	mutex_init(&po->pg_vec_lock);
+#ifdef CONFIG_PACKET_MMAP
+	setup_timer(&po->rx_ring.bdq.retire_timer, packet_retire_timer,
+		    (unsigned long)po);
+#endif
 	po->prot_hook.func = packet_rcv;
 
 	if (sock->type == SOCK_PACKET)
@@ -1733,13 +1954,25 @@ packet_setsockopt(struct socket *sock, int level, int optname, char __user *optv
 	case PACKET_RX_RING:
 	case PACKET_TX_RING:
 	{
-		struct tpacket_req req;
+		union tpacket_req_u req_u;
+		int len;
 
-		if (optlen < sizeof(req))
+		switch (po->tp_version) {
+		case TPACKET_V1:
+		case TPACKET_V2:
+			len = sizeof(req_u.req);
+			break;
+		case TPACKET_V3:
+		default:
+			len = sizeof(req_u.req3);
+			break;
+		}
+		if (optlen < len)
 			return -EINVAL;
-		if (copy_from_user(&req, optval, sizeof(req)))
+		if (copy_from_user(&req_u, optval, len))
 			return -EFAULT;
-		return packet_set_ring(sk, &req, 0, optname == PACKET_TX_RING);
+		return packet_set_ring(sk, &req_u, 0,
+				       optname == PACKET_TX_RING);
 	}
 	case PACKET_COPY_THRESH:
 	{
@@ -1766,6 +1999,7 @@ packet_setsockopt(struct socket *sock, int level, int optname, char __user *optv
 		switch (val) {
 		case TPACKET_V1:
 		case TPACKET_V2:
+		case TPACKET_V3:
 			po->tp_version = val;
 			return 0;
 		default:
@@ -1836,7 +2070,8 @@ static int packet_getsockopt(struct socket *sock, int level, int optname,
 	struct sock *sk = sock->sk;
 	struct packet_sock *po = pkt_sk(sk);
 	void *data;
-	struct tpacket_stats st;
+	union tpacket_stats_u st;
+	int lv = sizeof(struct tpacket_stats);
 
 	if (level != SOL_PACKET)
 		return -ENOPROTOOPT;
@@ -1849,13 +2084,19 @@ static int packet_getsockopt(struct socket *sock, int level, int optname,
 
 	switch (optname) {
 	case PACKET_STATISTICS:
-		if (len > sizeof(struct tpacket_stats))
-			len = sizeof(struct tpacket_stats);
+		memset(&st, 0, sizeof(st));
 		spin_lock_bh(&sk->sk_receive_queue.lock);
-		st = po->stats;
-		memset(&po->stats, 0, sizeof(st));
+		st.stats1 = po->stats;
+		memset(&po->stats, 0, sizeof(po->stats));
 		spin_unlock_bh(&sk->sk_receive_queue.lock);
-		st.tp_packets += st.tp_drops;
+		st.stats1.tp_packets += st.stats1.tp_drops;
+#ifdef CONFIG_PACKET_MMAP
+		/* same counters, tp_freeze_q_cnt stays 0 */
+		if (po->tp_version == TPACKET_V3)
+			lv = sizeof(struct tpacket_stats_v3);
+#endif
+		if (len > lv)
+			len = lv;
 
 		data = &st;
 		break;
@@ -1892,6 +2133,9 @@ static int packet_getsockopt(struct socket *sock, int level, int optname,
 		case TPACKET_V2:
 			val = sizeof(struct tpacket2_hdr);
 			break;
+		case TPACKET_V3:
+			val = sizeof(struct tpacket3_hdr);
+			break;
 		default:
 			return -EINVAL;
 		}
@@ -2043,7 +2287,11 @@ static unsigned int packet_poll(struct file *file, struct socket *sock,
 
 	spin_lock_bh(&sk->sk_receive_queue.lock);
 	if (po->rx_ring.pg_vec) {
-		if (!packet_previous_frame(po, &po->rx_ring, TP_STATUS_KERNEL))
+		if (po->tp_version == TPACKET_V3) {
+			if (!packet_previous_block(po, TP_STATUS_KERNEL))
+				mask |= POLLIN | POLLRDNORM;
+		} else if (!packet_previous_frame(po, &po->rx_ring,
+						  TP_STATUS_KERNEL))
 			mask |= POLLIN | POLLRDNORM;
 	}
 	spin_unlock_bh(&sk->sk_receive_queue.lock);
@@ -2129,9 +2377,10 @@ out_free_pgvec:
 	goto out;
 }
 
-static int packet_set_ring(struct sock *sk, struct tpacket_req *req,
+static int packet_set_ring(struct sock *sk, union tpacket_req_u *req_u,
 		int closing, int tx_ring)
 {
+	struct tpacket_req *req = &req_u->req;
 	char **pg_vec = NULL;
 	struct packet_sock *po = pkt_sk(sk);
 	int was_running, order = 0;
@@ -2164,9 +2413,15 @@ static int packet_set_ring(struct sock *sk, struct tpacket_req *req,
 		case TPACKET_V2:
 			po->tp_hdrlen = TPACKET2_HDRLEN;
 			break;
+		case TPACKET_V3:
+			po->tp_hdrlen = TPACKET3_HDRLEN;
+			break;
 		}
 
 		err = -EINVAL;
+		/* blocks are only for receiving */
+		if (unlikely(po->tp_version == TPACKET_V3 && tx_ring))
+			goto out;
 		if (unlikely((int)req->tp_block_size <= 0))
 			goto out;
 		if (unlikely(req->tp_block_size & (PAGE_SIZE - 1)))
@@ -2183,6 +2438,14 @@ static int packet_set_ring(struct sock *sk, struct tpacket_req *req,
 		if (unlikely((rb->frames_per_block * req->tp_block_nr) !=
 					req->tp_frame_nr))
 			goto out;
+		if (po->tp_version == TPACKET_V3) {
+			unsigned int priv = req_u->req3.tp_sizeof_priv;
+
+			if (unlikely(priv >= req->tp_block_size ||
+				     BLK_PLUS_PRIV(priv) + po->tp_hdrlen +
+				     po->tp_reserve > req->tp_block_size))
+				goto out;
+		}
 
 		err = -ENOMEM;
 		order = get_order(req->tp_block_size);
@@ -2223,8 +2486,14 @@ static int packet_set_ring(struct sock *sk, struct tpacket_req *req,
 		rb->frame_max = (req->tp_frame_nr - 1);
 		rb->head = 0;
 		rb->frame_size = req->tp_frame_size;
+		if (po->tp_version == TPACKET_V3 && !tx_ring)
+			packet_init_block_queue(rb, &req_u->req3);
 		spin_unlock_bh(&rb_queue->lock);
 
+		/* the old blocks are freed below */
+		if (!tx_ring)
+			del_timer_sync(&rb->bdq.retire_timer);
+
 		order = XC(rb->pg_vec_order, order);
 		req->tp_block_nr = XC(rb->pg_vec_len, req->tp_block_nr);
 
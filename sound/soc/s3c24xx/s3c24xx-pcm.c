@@ -47,7 +47,7 @@ static const struct snd_pcm_hardware s3c24xx_pcm_hardware = {
 	.channels_min		= 2,
 	.channels_max		= 2,
 	.buffer_bytes_max	= 128*1024,
-	.period_bytes_min	= PAGE_SIZE,
+	.period_bytes_min	= 128,
 	.period_bytes_max	= PAGE_SIZE*2,
 	.periods_min		= 2,
 	.periods_max		= 128,
@@ -204,10 +204,11 @@ static int s3c24xx_pcm_hw_free(struct snd_pcm_substream *substream)
 
 	pr_debug("Entered %s\n", __func__);
 
-	/* TODO - do we need to ensure DMA flushed */
 	snd_pcm_set_runtime_buffer(substream, NULL);
 
 	if (prtd->params) {
+		/* the periods of a circular channel stay queued otherwise */
+		s3c2410_dma_ctrl(prtd->params->channel, S3C2410_DMAOP_FLUSH);
 		s3c2410_dma_free(prtd->params->channel, prtd->params->client);
 		prtd->params = NULL;
 	}
@@ -309,16 +310,15 @@ s3c24xx_pcm_pointer(struct snd_pcm_substream *substream)
 
 	pr_debug("Pointer %x %x\n", src, dst);
 
-	/* we seem to be getting the odd error from the pcm library due
-	 * to out-of-bounds pointers. this is maybe due to the dma engine
-	 * not having loaded the new values for the channel before being
-	 * callled... (todo - fix )
+	/* the address registers may still hold the end of the last
+	 * period of the buffer, or an old address if the dma engine has
+	 * not yet loaded the new values for the channel, so wrap anything
+	 * out of bounds back to the start instead of confusing the pcm
+	 * library with it.
 	 */
 
-	if (res >= snd_pcm_lib_buffer_bytes(substream)) {
-		if (res == snd_pcm_lib_buffer_bytes(substream))
-			res = 0;
-	}
+	if (res >= snd_pcm_lib_buffer_bytes(substream))
+		res = 0;
 
 	return bytes_to_frames(substream->runtime, res);
 }